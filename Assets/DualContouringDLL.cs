@@ -10,29 +10,451 @@ public class DualContouringDLL : MonoBehaviour {
 
     
     [DllImport("DualContouringPlugin", EntryPoint = "CreateOctreeAndDualContour")]
-    public static extern void CreateOctreeDLL(int x, int y, int z, int octreeSize, float res, out int indiciesLength, out IntPtr indiciesArray, out int vertexBufferLength, out IntPtr vertexBufferArray);
+    public static extern void CreateOctreeDLL(IntPtr context, int x, int y, int z, int octreeSize, float res, out int indiciesLength, out IntPtr indiciesArray, out int vertexBufferLength, out IntPtr vertexBufferArray);
 
 
     [DllImport("DualContouringPlugin", EntryPoint = "FastDualContour")]
-    public static extern void FastDualContourDLL(int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeLength, float maxError, float minAngleCosine, out float debugVal, out float debugVal2, out int indiciesLength, out IntPtr indiciesArray, out int vertexBufferLength, out IntPtr vertexBufferArray, out int dataLength, out IntPtr dataArray);
+    public static extern void FastDualContourDLL(IntPtr context, int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeLength, float maxError, float minAngleCosine, out float debugVal, out float debugVal2, out int indiciesLength, out IntPtr indiciesArray, out int vertexBufferLength, out IntPtr vertexBufferArray, out int dataLength, out IntPtr dataArray);
+
+    //job api, the plugin owns the worker threads so nothing here blocks or creates threads
+    [DllImport("DualContouringPlugin")]
+    public static extern int SubmitOctreeJob(IntPtr context, int x, int y, int z, int octreeSize, float res);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int SubmitFastDualContourJob(IntPtr context, int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeLength, float maxError, float minAngleCosine);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int PollJob(IntPtr context, int job);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void CancelJob(IntPtr context, int job);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int GetJobResult(IntPtr context, int job, out int indiciesLength, out IntPtr indiciesArray, out int vertexBufferLength, out IntPtr vertexBufferArray);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int GetJobCellData(IntPtr context, int job, out int dataLength, out IntPtr dataArray);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void ReleaseJob(IntPtr context, int job);
+
+    //every call takes a context, the context owns the worker threads, density settings and stats so
+    //separate worlds (or an editor preview) can each have their own
+    [DllImport("DualContouringPlugin")]
+    public static extern IntPtr CreateContext(int numThreads);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void DestroyContext(IntPtr context);
+
+    //matches DensityParams in density.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DensityParams {
+        public float maxHeight;
+        public float noiseScale;
+        public int noiseOctaves;
+        public float noiseFrequency;
+        public float noiseLacunarity;
+        public float noisePersistence;
+        public Vector3 sphereOrigin;
+        public float sphereRadius;
+    }
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void SetDensityParams(IntPtr context, ref DensityParams density);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void GetDensityParams(IntPtr context, out DensityParams density);
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ContextStats {
+        public long chunksGenerated;
+        public long chunksCancelled;
+        public long verticesGenerated;
+        public long trianglesGenerated;
+        public long generationMicroseconds;
+        public long chunksFromArchive;
+        public long chunksRejected; //empty or solid by the bounds pass, also in chunksGenerated
+        public long chunksFromCache; //found in the mesh cache when queued, not generated
+    }
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void GetContextStats(IntPtr context, out ContextStats stats);
+
+    //matches ViewerParams in job_system.h, pending chunks are generated nearest the viewer first
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ViewerParams {
+        public Vector3 position;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 24)]
+        public float[] frustumPlanes; //6 x (normal, distance), as GeometryUtility.CalculateFrustumPlanes
+        public int numFrustumPlanes;
+        public float outsideFrustumScale;
+        public float cancelDistance; //0 never cancels
+    }
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void SetViewer(IntPtr context, ref ViewerParams viewer);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int GetPendingJobCount(IntPtr context);
+
+    //matches CompletedJob in completion_queue.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct CompletedJob {
+        public int job;
+        public int status;
+        public int bytes; //vertex + index data, 0 when cancelled
+        public ChunkContents contents;
+    }
+
+    /// <summary>
+    /// Jobs which have finished or been cancelled since the last call, oldest first.  Stops at maxJobs or once
+    /// maxBytes of mesh data has been returned.  overflowed is set when the native queue filled up and dropped entries
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int DrainCompletedJobs(IntPtr context, [Out] CompletedJob[] jobs, int maxJobs, int maxBytes, out int overflowed);
+
+    /// <summary>
+    /// Generates queued chunks on the calling thread for up to the given time, a chunk that doesn't fit carries on
+    /// next call.  Returns the number of jobs that finished
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int RunJobsFor(IntPtr context, int microseconds);
+
+    //matches ClipmapParams in clipmap.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ClipmapParams {
+        public int chunkSize; //LOD 0 extent, LOD n chunks are chunkSize << n wide with the same voxel count
+        public int numLods;
+        public int halfExtent;
+        public int verticalHalfExtent;
+        public int pipeline; //0 octree, 1 fast dc
+        public float prefetchSeconds; //how far ahead SetClipmapViewerMotion's velocity is followed, 0 never prefetches
+        public int heightfieldLod; //LODs from here on are 2.5D heightfields where the terrain has no overhangs, 0 never
+        public int mergeLod; //LODs from here on merge each block of chunks into one mesh once it has loaded, 0 never
+        public int mergeBlock; //chunks per side of a merged block, at least 2
+    }
+
+    //matches ClipmapPrefetchStats in clipmap.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ClipmapPrefetchStats {
+        public long hits; //prefetched chunks the rings went on to use
+        public long misses; //cancelled when the viewer went elsewhere
+        public int numPrefetched;
+    }
+
+    //matches MemoryUsage in memory_governor.h, bytes held natively by category
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MemoryUsage {
+        public long budget; //0 when there is no budget
+        public long total;
+        public long jobResults; //finished meshes not released yet
+        public long prefetch; //finished prefetched chunks nobody has asked for yet
+        public long generation; //chunks being generated
+        public long meshCache; //finished chunks kept for when they come back
+        public long evictions;
+        public long evictedBytes;
+    }
+
+    public enum ClipmapEventType {
+        Load = 0,
+        Unload = 1,
+        Seam = 2,
+        Merge = 3,
+        Unmerge = 4
+    }
+
+    //matches ClipmapEvent in clipmap.h, read the job's mesh on Load, it's released once the Unload has been drained.
+    //Seam means a neighbour changed and the job's mesh (its seam submesh) should be read again.
+    //Merge hands over one mesh for the block (x, y, z, size) to draw instead of its chunks of that lod, until the Unmerge
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ClipmapEvent {
+        public ClipmapEventType type;
+        public int job;
+        public int lod;
+        public int x, y, z; //chunk (or block) centre
+        public int size;
+    }
+
+    /// <summary>
+    /// Keeps rings of chunks at increasing LODs around the viewer, the plugin decides what to generate and retire. Returns 0 and changes
+    /// nothing if the params are out of range: 1-16 LODs, a positive chunkSize and halfExtent, and a chunkSize the pipeline accepts
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int EnableClipmap(IntPtr context, ref ClipmapParams clipmap);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void DisableClipmap(IntPtr context);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void SetClipmapViewer(IntPtr context, float x, float y, float z);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int DrainClipmapEvents(IntPtr context, [Out] ClipmapEvent[] events, int maxEvents);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int GetClipmapChunkCount(IntPtr context, out int numLoaded);
+
+    /// <summary>
+    /// SetClipmapViewer plus the velocity (units per second) and look direction, the chunks the viewer is heading for are
+    /// generated ahead of time at a lower priority and cancelled if it goes elsewhere
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern void SetClipmapViewerMotion(IntPtr context, float x, float y, float z, float velocityX, float velocityY, float velocityZ, float lookX, float lookY, float lookZ);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void GetClipmapPrefetchStats(IntPtr context, out ClipmapPrefetchStats stats);
+
+    /// <summary>
+    /// Caps the memory the plugin holds, over budget the prefetched chunks least worth keeping are dropped first. 0 removes the budget
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern void SetMemoryBudget(IntPtr context, long bytes);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void GetMemoryUsage(IntPtr context, out MemoryUsage usage);
+
+    /// <summary>
+    /// Chunks which unload and come back are copied out of an in-memory cache instead of generated, 0 turns it off.
+    /// Call InvalidateMeshCache with the bounds of anything that changes the volume.
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern void SetMeshCacheCapacity(IntPtr context, long bytes);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void InvalidateMeshCache(IntPtr context, int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+    public enum DensityEditShape {
+        Sphere = 0, //radius is size.x
+        Box = 1 //size is the half extents
+    }
+
+    public enum DensityEditOperation {
+        Add = 0,
+        Subtract = 1
+    }
+
+    //matches DensityEdit in sparse_volume.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DensityEdit {
+        public DensityEditShape shape;
+        public DensityEditOperation operation;
+        public Vector3 centre;
+        public Vector3 size;
+    }
+
+    //matches DensityEditStats in sparse_volume.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DensityEditStats {
+        public int numNodes;
+        public int numLeaves;
+        public int numTiles; //leaf sized regions stored as all inside or all outside
+        public int numActiveVoxels; //voxels near enough the surface to keep their density
+        public long bytes;
+    }
+
+    /// <summary>
+    /// Adds or carves a shape out of the volume.  The result is stored near the surface and sampled instead of the density
+    /// by chunks queued from then on, loaded chunks in the region have to be requested again to see it
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern void EditDensity(IntPtr context, ref DensityEdit edit);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void ClearDensityEdits(IntPtr context);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void GetDensityEditStats(IntPtr context, out DensityEditStats stats);
+
+    //matches SignDagStats in sign_dag.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SignDagStats {
+        public int size; //corners along each side, 0 when none is loaded
+        public int numNodes;
+        public int numLeaves;
+        public float compression; //one bit per corner over bytes
+        public long bytes;
+    }
+
+    /// <summary>
+    /// Loads corner signs baked by region_bake --sign-dag, read by the meshers instead of sampling the density wherever
+    /// they were baked from the current density and haven't been edited since.  Returns 0 if the file can't be read
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int LoadSignDag(IntPtr context, string path);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void UnloadSignDag(IntPtr context);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void GetSignDagStats(IntPtr context, out SignDagStats stats);
+
+    /// <summary>
+    /// Keeps generated chunks in a file between sessions, chunks already in it are loaded instead of generated
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int OpenChunkArchive(IntPtr context, string path);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void CloseChunkArchive(IntPtr context);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int CompactChunkArchive(IntPtr context);
+
+    /// <summary>
+    /// Logs every plugin call with its arguments and timing to a binary trace, replay it with the TraceReplay tool
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int StartRecording(string path);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void StopRecording();
+
+    //when set, everything from the shared context's creation until quit is recorded here
+    public static string traceRecordingPath = "";
+
+    //when set, the shared context caches chunks in this archive, only read when the context is created
+    public static string chunkArchivePath = "";
+
+    //generate on the main thread within a per frame budget instead of on worker threads, only read when the context is created
+    public static bool generateOnMainThread = false;
+    public static int mainThreadBudgetMicroseconds = 2000;
+
+    //the context shared by every DualContouringDLL in the scene, created on first use
+    static IntPtr sharedContext = IntPtr.Zero;
+
+    public static IntPtr Context {
+        get {
+            if(sharedContext == IntPtr.Zero) {
+                if(!string.IsNullOrEmpty(traceRecordingPath) && StartRecording(traceRecordingPath) == 0) {
+                    UnityEngine.Debug.LogWarning("Can't record a trace to " + traceRecordingPath);
+                }
+                sharedContext = CreateContext(generateOnMainThread ? -1 : 0);
+                if(!string.IsNullOrEmpty(chunkArchivePath) && OpenChunkArchive(sharedContext, chunkArchivePath) == 0) {
+                    UnityEngine.Debug.LogWarning("Can't open the chunk archive " + chunkArchivePath);
+                }
+            }
+            return sharedContext;
+        }
+    }
+
+    //batch api, one call for a whole ring of chunks instead of one per chunk
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ChunkDesc {
+        public int x, y, z;
+        public int size; //world units, voxels are (1 << lod) wide
+        public int lod;
+        public int pipeline; //0 = octree, 1 = fast dc, 2 = heightfield (far field terrain without overhangs)
+        public float octreeThreshold;
+        public float targetPolygonPercent;
+        public int maxSimplifyIterations;
+        public float edgeFraction;
+        public float maxEdgeLength;
+        public float maxError;
+        public float minAngleCosine;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ChunkMeshDesc {
+        public int job;
+        public int status;
+        public int indiciesLength;
+        public IntPtr indiciesArray;
+        public int vertexBufferLength;
+        public IntPtr vertexBufferArray;
+    }
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void SubmitChunkBatch(IntPtr context, [In] ChunkDesc[] chunks, int numChunks, [Out] int[] jobs);
+
+    /// <summary>
+    /// Blocks until every chunk is done.  The buffers in each ChunkMeshDesc belong to its job, copy them out then pass the jobs to ReleaseJobs
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int GenerateChunkBatch(IntPtr context, [In] ChunkDesc[] chunks, int numChunks, [Out] ChunkMeshDesc[] meshes);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern void ReleaseJobs(IntPtr context, [In] int[] jobs, int numJobs);
+
+    //mesh data in the layout the advanced Mesh API consumes, see UnityMeshDesc in DualContouringPlugin.h
+    [StructLayout(LayoutKind.Sequential)]
+    public struct UnityMeshDesc {
+        public int vertexCount;
+        public int vertexStride; //bytes, float3 position + float3 normal
+        public IntPtr vertexData;
+        public int indexCount;
+        public int indexFormat; //0 = UInt16, 1 = UInt32
+        public IntPtr indexData;
+        public int subMeshCount;
+        public Vector3 boundsMin;
+        public Vector3 boundsMax;
+        public ChunkContents contents;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct UnitySubMeshDesc {
+        public int indexStart;
+        public int indexCount;
+        public int firstVertex;
+        public int vertexCount;
+        public Vector3 boundsMin;
+        public Vector3 boundsMax;
+    }
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int GetJobUnityMesh(IntPtr context, int job, out UnityMeshDesc mesh);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int GetJobUnityMeshes(IntPtr context, [In] int[] jobs, int numJobs, [Out] UnityMeshDesc[] meshes);
+
+    [DllImport("DualContouringPlugin")]
+    public static extern int GetJobUnitySubMeshes(IntPtr context, int job, [Out] UnitySubMeshDesc[] subMeshes, int maxSubMeshes);
+
+    //closes the cracks on the job's min faces against its neighbours (any LOD), added as a second submesh
+    [DllImport("DualContouringPlugin")]
+    public static extern int BuildJobSeam(IntPtr context, int job, [In] int[] neighbours, int numNeighbours);
+
+    /// <summary>
+    /// Merges finished jobs into a new job with one mesh, welding the vertices they share, so distant chunks cost one draw
+    /// call. optimizeVertexCache (0/1) also reorders the triangles for the GPU's vertex cache. Release it to unmerge.
+    /// </summary>
+    [DllImport("DualContouringPlugin")]
+    public static extern int MergeJobMeshes(IntPtr context, [In] int[] jobs, int numJobs, int optimizeVertexCache);
+
+    //matches ChunkContents in chunk_generator.h, empty and solid chunks are found without sampling the volume and have no mesh
+    public enum ChunkContents {
+        Surface = 0,
+        Empty = 1,
+        Solid = 2
+    }
+
+    //matches JobStatus in job_system.h
+    public enum JobStatus {
+        Invalid = -1,
+        Pending = 0,
+        Running = 1,
+        Done = 2,
+        Cancelled = 3,
+        Failed = 4
+    }
 
 
     public float res = 0f;
     public float lastRes = 0;
 
-    public Thread generationThread;
-    public List<Action> mainThreadCallbacks = new List<Action>();
+    public int job = 0; //0 is never a valid job handle
 
     public Vector3 pos = new Vector3();
     public float startTime = 1f;
 
     public bool fastDC = false;
+    public int cellSize = 16;
+    public float cancelDistance = 0f; //queued chunks further than this from the camera are dropped, 0 keeps them
 
     [Header("Simplify Options")]
     public int maxSimplifyIterations = 10;
-    public float targetPolygonPercent = 1f;
+    public float targetPolygonPercent = 1f; //fast dc only, 1 turns simplification off
     public float edgeFraction = 0.125f;
-    public float maxEdgeLength = 0.5f;
+    public float maxEdgeLength = 0.5f; //world units, voxels are 1 wide so nothing collapses until this is over 1
     public float maxError = 1.0f;
     public float minAngleCosine = 0.8f;
 
@@ -45,97 +467,77 @@ public class DualContouringDLL : MonoBehaviour {
 
 
     /// <summary>
-    /// Starts the Octree version of DC in a thread and once it returns generates a mesh
+    /// Queues the Octree version of DC on the plugin's worker threads, Update builds the mesh once it's done
     /// </summary>
     public void StartOctreeDC() {
+        CancelCurrentJob();
+        w.Reset();
         w.Start();
-        generationThread = new Thread(() => { GenerateOctreeAndMesh((int)pos.x, (int)pos.y, (int)pos.z); });
-        generationThread.Start();
+        TrackJob(SubmitOctreeJob(Context, (int)pos.x, (int)pos.y, (int)pos.z, 128, 1.0f));
     }
 
     /// <summary>
-    /// starts the Fast DC in a thread and generates a mesh
+    /// Queues the Fast DC on the plugin's worker threads, Update builds the mesh once it's done
+    ///
+    ///x/y/z offset works (but doesn't correspond to the gameobjects position.  Gameobject pos should be 0,0,0 and we set the pos property in this class to handle offsets
+    /// cell size works.  Cell size is how many voxels you create on every axis.  first cell starts at center - cellSize/2.  Cells are always 1m I think, might be good to make a way to increase res
+    /// targetPolygonPercent below 1 simplifies the chunk, maxEdgeLength has to be longer than a voxel for any edges to collapse
     /// </summary>
     public void StartFastDC() {
+        CancelCurrentJob();
+        w.Reset();
         w.Start();
-        generationThread = new Thread(() => { FastDualContour((int)pos.x, (int)pos.y, (int)pos.z, (int)res, targetPolygonPercent, maxSimplifyIterations, edgeFraction, maxEdgeLength, maxError, minAngleCosine); });
-        generationThread.Start();
+        TrackJob(SubmitFastDualContourJob(Context, (int)pos.x, (int)pos.y, (int)pos.z, cellSize, targetPolygonPercent, maxSimplifyIterations, edgeFraction, maxEdgeLength, maxError, minAngleCosine));
     }
 
     /// <summary>
-    /// Calls into the C++ plugin to generate our mesh data.
-    /// 
-    /// Not super familiar with C++, so this may or may not leak memory.
-    /// 
-    ///x/y/z offset works (but doesn't correspond to the gameobjects position.  Gameobject pos should be 0,0,0 and we set the pos property in this class to handle offsets
-    /// cell size works.  Cell size is how many voxels you create on every axis.  first cell starts at center - cellSize/2.  Cells are always 1m I think, might be good to make a way to increase res
-    /// targetPolygonPercent does not work.  Not sure why..
+    /// Drops the in flight job (if any), e.g. when the player has moved away from this chunk
     /// </summary>
-    public void FastDualContour(int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeLength, float maxError, float minAngleCosine) {
-        int indiciesLength;
-        IntPtr indiciesArrayPtr;
-
-        int vertexBufferLength;
-        IntPtr vertexBufferArrayPtr;
-        float debugVal = 0;
-        float debugVal2 = 0;
-
-        int dataLength;
-        IntPtr dataArrayPtr;
-
-        FastDualContourDLL(0, 0, 0, 16, 0.05f, 10, 0.125f, 0.5f, 1f, 0.8f, out debugVal, out debugVal2, out indiciesLength, out indiciesArrayPtr, out vertexBufferLength, out vertexBufferArrayPtr, out dataLength, out dataArrayPtr);
-
-        //FastDualContourDLL(x, y, z, cellSize, targetPolygonPercent, maxSimplifyIterations, edgeFraction, maxEdgeLength, maxError, minAngleCosine, out debugVal, out debugVal2, out indiciesLength, out indiciesArrayPtr, out vertexBufferLength, out vertexBufferArrayPtr);
-        int[] indiciesArray = new int[indiciesLength];
-        float[] vertexBufferArray = new float[vertexBufferLength];
-        float[] cellDataArray = new float[dataLength];
-        //Debug.Log(vertexBufferLength);
-        Marshal.Copy(indiciesArrayPtr, indiciesArray, 0, indiciesLength);
-        Marshal.FreeCoTaskMem(indiciesArrayPtr);
-
-        Marshal.Copy(vertexBufferArrayPtr, vertexBufferArray, 0, vertexBufferLength);
-        Marshal.FreeCoTaskMem(vertexBufferArrayPtr);
-
-        Marshal.Copy(dataArrayPtr, cellDataArray, 0, dataLength);
-        Marshal.FreeCoTaskMem(dataArrayPtr);
-
-        mainThreadCallbacks.Add(() => { BuildMesh(vertexBufferArray, indiciesArray, cellDataArray); });
+    public void CancelCurrentJob() {
+        if(job == 0) return;
+        CancelJob(Context, job);
+        ReleaseJob(Context, job);
+        ForgetJob();
     }
 
-  
     /// <summary>
-    /// x/y/z is world offset.
+    /// Builds the mesh straight from the finished job's buffers and releases it.  The native buffers are owned
+    /// by the job so there's nothing to free on this side
     /// </summary>
-    public void GenerateOctreeAndMesh(int x, int y, int z) {
-        int indiciesLength;
-        IntPtr indiciesArrayPtr;
+    void CompleteJob() {
+        UnityMeshDesc meshDesc;
+        GetJobUnityMesh(Context, job, out meshDesc);
+
+        UnitySubMeshDesc[] subMeshes = new UnitySubMeshDesc[Mathf.Max(meshDesc.subMeshCount, 1)];
+        GetJobUnitySubMeshes(Context, job, subMeshes, subMeshes.Length);
 
-        int vertexBufferLength;
-        IntPtr vertexBufferArrayPtr;
+        int dataLength;
+        IntPtr dataArrayPtr;
+        GetJobCellData(Context, job, out dataLength, out dataArrayPtr);
 
-        CreateOctreeDLL(x, y, z, 128, 1.0f, out indiciesLength, out indiciesArrayPtr, out vertexBufferLength, out vertexBufferArrayPtr);
-        int[] indiciesArray = new int[indiciesLength];
-        float[] vertexBufferArray = new float[vertexBufferLength];
-        //Debug.Log(vertexBufferLength);
-        Marshal.Copy(indiciesArrayPtr, indiciesArray, 0, indiciesLength);
-        Marshal.FreeCoTaskMem(indiciesArrayPtr);
+        float[] cellDataArray = null;
+        if(dataLength > 0) {
+            cellDataArray = new float[dataLength];
+            Marshal.Copy(dataArrayPtr, cellDataArray, 0, dataLength);
+        }
 
-        Marshal.Copy(vertexBufferArrayPtr, vertexBufferArray, 0, vertexBufferLength);
+        BuildMesh(meshDesc, subMeshes, cellDataArray);
 
-        //need to push this to the main thread
-        mainThreadCallbacks.Add(() => { BuildMesh(vertexBufferArray, indiciesArray, null); });
+        ReleaseJob(Context, job);
+        ForgetJob();
     }
 
     public static int count = 0;
 
     /// <summary>
-    /// Build mesh function.  Takes in a flat array of vertex (which is actually processed 6 at a time)
-    /// because I don't know how to C++ and this was the only way that made sense to me to return
-    /// each entry in the array is one component of a vec3.  goes vertexX, vertexY, vertexZ, normalX, normalY, normalZ, ...
+    /// Build mesh function.  The plugin hands back the vertex stream already interleaved as
+    /// position.xyz, normal.xyz (24 bytes a vertex), the index buffer as 16 bit whenever there are fewer than
+    /// 65536 verts, and the bounds, so the buffers are block copied into the mesh with no per vertex loop
+    /// and Unity doesn't need to recalculate the bounds.
     /// 
-    /// Indicies array is the triangles list
+    /// The advanced Mesh API needs 2019.3, older editors fall back to unpacking the vertex stream.
     /// </summary>
-    public void BuildMesh(float[] vertexArray, int[] indiciesArray, float[] cells) {
+    public void BuildMesh(UnityMeshDesc meshDesc, UnitySubMeshDesc[] subMeshes, float[] cells) {
         MeshRenderer mr = this.gameObject.GetComponent<MeshRenderer>();
         MeshFilter mf = null;
         if(mr == null) {
@@ -145,35 +547,77 @@ public class DualContouringDLL : MonoBehaviour {
             mf = this.gameObject.GetComponent<MeshFilter>();
         }
 
-        mf.mesh.Clear();
-        mr.sharedMaterial = Resources.Load("Default") as Material;
-
-        List<Vector3> verts = new List<Vector3>();
-        List<Vector3> norms = new List<Vector3>();
+        Mesh mesh = mf.mesh;
+        mesh.Clear();
+        //the seam submesh draws with the same material as the chunk
+        Material material = Resources.Load("Default") as Material;
+        Material[] materials = new Material[Mathf.Max(meshDesc.subMeshCount, 1)];
+        for(int i = 0; i < materials.Length; i++) materials[i] = material;
+        mr.sharedMaterials = materials;
+
+        Bounds bounds = new Bounds();
+        bounds.SetMinMax(meshDesc.boundsMin, meshDesc.boundsMax);
+
+#if UNITY_2019_3_OR_NEWER
+        mesh.SetVertexBufferParams(meshDesc.vertexCount,
+            new UnityEngine.Rendering.VertexAttributeDescriptor(UnityEngine.Rendering.VertexAttribute.Position, UnityEngine.Rendering.VertexAttributeFormat.Float32, 3),
+            new UnityEngine.Rendering.VertexAttributeDescriptor(UnityEngine.Rendering.VertexAttribute.Normal, UnityEngine.Rendering.VertexAttributeFormat.Float32, 3));
+
+        float[] vertexStream = new float[meshDesc.vertexCount * meshDesc.vertexStride / sizeof(float)];
+        if(vertexStream.Length > 0) Marshal.Copy(meshDesc.vertexData, vertexStream, 0, vertexStream.Length);
+        mesh.SetVertexBufferData(vertexStream, 0, 0, vertexStream.Length);
+
+        const UnityEngine.Rendering.MeshUpdateFlags flags = UnityEngine.Rendering.MeshUpdateFlags.DontRecalculateBounds | UnityEngine.Rendering.MeshUpdateFlags.DontValidateIndices;
+        if(meshDesc.indexFormat == 0) {
+            short[] indexStream = new short[meshDesc.indexCount];
+            if(indexStream.Length > 0) Marshal.Copy(meshDesc.indexData, indexStream, 0, indexStream.Length);
+            mesh.SetIndexBufferParams(meshDesc.indexCount, UnityEngine.Rendering.IndexFormat.UInt16);
+            mesh.SetIndexBufferData(indexStream, 0, 0, indexStream.Length, flags);
+        } else {
+            int[] indexStream = new int[meshDesc.indexCount];
+            if(indexStream.Length > 0) Marshal.Copy(meshDesc.indexData, indexStream, 0, indexStream.Length);
+            mesh.SetIndexBufferParams(meshDesc.indexCount, UnityEngine.Rendering.IndexFormat.UInt32);
+            mesh.SetIndexBufferData(indexStream, 0, 0, indexStream.Length, flags);
+        }
 
+        mesh.subMeshCount = meshDesc.subMeshCount;
+        for(int i = 0; i < meshDesc.subMeshCount; i++) {
+            Bounds subMeshBounds = new Bounds();
+            subMeshBounds.SetMinMax(subMeshes[i].boundsMin, subMeshes[i].boundsMax);
 
-        //Debug.Log("length: " + vertexArray.Length);
-        int count = 0;
-        for(int i = 0; i < vertexArray.Length; i += 6) {
-            //Debug.Log("i: " + i);
-            verts.Add(new Vector3(vertexArray[i], vertexArray[i + 1], vertexArray[i + 2]));
-            norms.Add(new Vector3(vertexArray[i + 3], vertexArray[i + 4], vertexArray[i + 5]));
-            //Debug.Log(string.Format("vert[{3}] - {0} - {1} - {2}", vertexArray[i], vertexArray[i + 1], vertexArray[i + 2], count));
-            count++;
-            //Debug.Log(string.Format("{0} - {1} - {2}", vertexArray[i + 3], vertexArray[i + 4], vertexArray[i + 5]));
+            UnityEngine.Rendering.SubMeshDescriptor subMesh = new UnityEngine.Rendering.SubMeshDescriptor(subMeshes[i].indexStart, subMeshes[i].indexCount);
+            subMesh.firstVertex = subMeshes[i].firstVertex;
+            subMesh.vertexCount = subMeshes[i].vertexCount;
+            subMesh.bounds = subMeshBounds;
+            mesh.SetSubMesh(i, subMesh, flags);
+        }
+        mesh.bounds = bounds;
+#else
+        float[] vertexArray = new float[meshDesc.vertexCount * 6];
+        if(vertexArray.Length > 0) Marshal.Copy(meshDesc.vertexData, vertexArray, 0, vertexArray.Length);
+
+        int[] indiciesArray = new int[meshDesc.indexCount];
+        if(meshDesc.indexFormat == 0) {
+            short[] indexStream = new short[meshDesc.indexCount];
+            if(indexStream.Length > 0) Marshal.Copy(meshDesc.indexData, indexStream, 0, indexStream.Length);
+            for(int i = 0; i < indexStream.Length; i++) indiciesArray[i] = (ushort)indexStream[i];
+        } else if(indiciesArray.Length > 0) {
+            Marshal.Copy(meshDesc.indexData, indiciesArray, 0, indiciesArray.Length);
         }
 
+        Vector3[] verts = new Vector3[meshDesc.vertexCount];
+        Vector3[] norms = new Vector3[meshDesc.vertexCount];
+        for(int i = 0; i < meshDesc.vertexCount; i++) {
+            verts[i] = new Vector3(vertexArray[i * 6], vertexArray[i * 6 + 1], vertexArray[i * 6 + 2]);
+            norms[i] = new Vector3(vertexArray[i * 6 + 3], vertexArray[i * 6 + 4], vertexArray[i * 6 + 5]);
+        }
 
-        UnityEngine.Debug.Log(string.Format("verts - {0}", verts.Count)); //always returns 8043, doesn't matter what the simplification options are
-
-        mf.mesh.vertices = verts.ToArray();
-        mf.mesh.normals = norms.ToArray();
-        mf.mesh.triangles = indiciesArray;
-        //mf.mesh.RecalculateNormals(); //just do this for now...
+        mesh.vertices = verts;
+        mesh.normals = norms;
+        mesh.triangles = indiciesArray;
+        mesh.bounds = bounds;
+#endif
 
-        //for(int i = 0; i < norms.Count; i++) {
-        //    Debug.Log(string.Format("normal[{0}] - {1}", i, norms[i].ToString()));
-        //}
         w.Stop();
         UIConsole.instance.AddText(("\n[" + count + "] - generation time- " + w.ElapsedMilliseconds / 1000f +"s"));
         count++;
@@ -187,7 +631,109 @@ public class DualContouringDLL : MonoBehaviour {
         }
     }
 
+    static int lastViewerFrame = -1;
+
+    /// <summary>
+    /// Hands the main camera to the scheduler, once per frame however many chunks are in the scene
+    /// </summary>
+    static void UpdateViewer(float cancelDistance) {
+        Camera camera = Camera.main;
+        if(camera == null || lastViewerFrame == Time.frameCount) return;
+        lastViewerFrame = Time.frameCount;
+
+        Plane[] planes = GeometryUtility.CalculateFrustumPlanes(camera);
+
+        ViewerParams viewer = new ViewerParams();
+        viewer.position = camera.transform.position;
+        viewer.frustumPlanes = new float[24];
+        for(int i = 0; i < planes.Length; i++) {
+            viewer.frustumPlanes[i * 4 + 0] = planes[i].normal.x;
+            viewer.frustumPlanes[i * 4 + 1] = planes[i].normal.y;
+            viewer.frustumPlanes[i * 4 + 2] = planes[i].normal.z;
+            viewer.frustumPlanes[i * 4 + 3] = planes[i].distance;
+        }
+        viewer.numFrustumPlanes = planes.Length;
+        viewer.outsideFrustumScale = 4f;
+        viewer.cancelDistance = cancelDistance;
+
+        SetViewer(Context, ref viewer);
+    }
+
+    //every component's in flight job, so the per frame drain can hand completions back to their owner
+    static Dictionary<int, DualContouringDLL> jobOwners = new Dictionary<int, DualContouringDLL>();
+
+    void TrackJob(int newJob) {
+        job = newJob;
+        if(job != 0) jobOwners[job] = this;
+    }
+
+    void ForgetJob() {
+        jobOwners.Remove(job);
+        job = 0;
+    }
+
+    //completion budget per frame, shared by every chunk
+    public static int maxCompletionsPerFrame = 32;
+    public static int maxCompletionBytesPerFrame = 8 << 20;
+
+    static CompletedJob[] completedJobs = new CompletedJob[256];
+    static int lastDrainFrame = -1;
+
+    /// <summary>
+    /// Hands finished jobs to their components, one native call per frame however many chunks are in flight.
+    /// Anything over the budget stays queued until next frame
+    /// </summary>
+    static void DrainCompletions() {
+        if(lastDrainFrame == Time.frameCount) return;
+        lastDrainFrame = Time.frameCount;
+
+        int overflowed;
+        int count = DrainCompletedJobs(Context, completedJobs, Mathf.Min(maxCompletionsPerFrame, completedJobs.Length), maxCompletionBytesPerFrame, out overflowed);
+        for(int i = 0; i < count; i++) {
+            DualContouringDLL owner;
+            if(jobOwners.TryGetValue(completedJobs[i].job, out owner)) owner.OnJobFinished((JobStatus)completedJobs[i].status);
+        }
+
+        //the queue dropped entries, fall back to polling every outstanding job once
+        if(overflowed != 0) {
+            foreach(DualContouringDLL owner in new List<DualContouringDLL>(jobOwners.Values)) {
+                owner.OnJobFinished((JobStatus)PollJob(Context, owner.job));
+            }
+        }
+    }
+
+    static int lastRunFrame = -1;
+
+    static void RunMainThreadJobs() {
+        if(!generateOnMainThread || lastRunFrame == Time.frameCount) return;
+        lastRunFrame = Time.frameCount;
+
+        RunJobsFor(Context, mainThreadBudgetMicroseconds);
+    }
+
+    void OnJobFinished(JobStatus status) {
+        switch(status) {
+            case JobStatus.Done:
+                CompleteJob();
+                break;
+            case JobStatus.Failed:
+                UnityEngine.Debug.LogWarning("Chunk request rejected, check its size, lod and pipeline");
+                ReleaseJob(Context, job);
+                ForgetJob();
+                break;
+            case JobStatus.Cancelled:
+            case JobStatus.Invalid:
+                ReleaseJob(Context, job);
+                ForgetJob();
+                break;
+        }
+    }
+
     public void Update() {
+        UpdateViewer(cancelDistance);
+        RunMainThreadJobs();
+        DrainCompletions();
+
         if(res != lastRes) {
             //regen
             //we don't need to regen the octree, just re-contour the mesh right?
@@ -195,12 +741,17 @@ public class DualContouringDLL : MonoBehaviour {
             //GenerateOctreeAndMesh();
         }
         lastRes = res;
+    }
 
-        while(mainThreadCallbacks.Count > 0) {
-            Action act = mainThreadCallbacks[0];
-            mainThreadCallbacks.RemoveAt(0);
-            act();
-        }
-    }
-
-}
+    void OnDestroy() {
+        CancelCurrentJob();
+    }
+
+    void OnApplicationQuit() {
+        if(sharedContext == IntPtr.Zero) return;
+        DestroyContext(sharedContext);
+        sharedContext = IntPtr.Zero;
+        StopRecording();
+    }
+
+}
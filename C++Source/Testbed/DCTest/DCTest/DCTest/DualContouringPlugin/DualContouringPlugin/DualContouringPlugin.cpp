@@ -4,32 +4,128 @@
 #include "octree.h"
 #include "ng_mesh_simplify.h"
 #include "fast_dc.h"
+#include "chunk_generator.h"
+#include "generator_context.h"
+#include "mesh_export.h"
+#include "call_recorder.h"
+
+// ----------------------------------------------------------------------------
+
+static void CopyMeshOut(const VertexData& vertices, const IndexBuffer& indices, int* indexBufferLength, int **indexBufferData, int* vertexBufferLength, float **vertexBufferData)
+{
+	*indexBufferLength = (int)indices.size();
+	auto indexBufferSize = (*indexBufferLength) * sizeof(int);
+	*indexBufferData = static_cast<int*>(malloc(indexBufferSize));
+	memcpy(*indexBufferData, indices.data(), indexBufferSize);
+
+	*vertexBufferLength = (int)vertices.size();
+	auto vertexBufferSize = (*vertexBufferLength) * sizeof(float);
+	*vertexBufferData = static_cast<float*>(malloc(vertexBufferSize));
+	memcpy(*vertexBufferData, vertices.data(), vertexBufferSize);
+}
+
+// ----------------------------------------------------------------------------
+
+static ChunkRequest FastDualContourRequest(int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeSize, float maxError, float minAngleCosine)
+{
+	ChunkRequest request;
+	request.position = glm::ivec3(x, y, z);
+	request.size = cellSize;
+	request.pipeline = Pipeline_FastDC;
+	request.simplify.targetPercentage = targetPolygonPercent;
+	request.simplify.maxIterations = maxSimplifyIterations;
+	request.simplify.edgeFraction = edgeFraction;
+	request.simplify.maxEdgeSize = maxEdgeSize;
+	request.simplify.maxError = maxError;
+	request.simplify.minAngleCosine = minAngleCosine;
+	return request;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkRequest RequestFromDesc(const ChunkDesc& desc)
+{
+	ChunkRequest request = FastDualContourRequest(desc.x, desc.y, desc.z, desc.size, desc.targetPolygonPercent, desc.maxSimplifyIterations, desc.edgeFraction, desc.maxEdgeSize, desc.maxError, desc.minAngleCosine);
+	request.lod = desc.lod;
+	request.pipeline = desc.pipeline;
+	request.octreeThreshold = desc.octreeThreshold;
+	return request;
+}
+
+// ----------------------------------------------------------------------------
+
+// A context without workers only makes progress through runFor, so instead of
+// waiting on the job this generates the queue on the calling thread (nearest
+// first, as the workers would) until the job is done or cancelled
+static int RunUntilFinished(JobSystem& jobs, const int job)
+{
+	for (;;)
+	{
+		const int status = jobs.poll(job);
+		if (status != JobStatus_Pending && status != JobStatus_Running)
+		{
+			return status;
+		}
 
-extern "C" {
-	void CreateOctreeAndDualContour(int x, int y, int z, int octreeSize, float res, long* indexBufferLength, int **indexBufferData, long* vertexBufferLength, float **vertexBufferData) {
-		OctreeNode* root = nullptr;
-		root = BuildOctree(glm::ivec3(-octreeSize / 2) + glm::ivec3(x, y, z), octreeSize, res);
-		//nodes.push_back(root);
+		jobs.runFor(100000);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static void CopyBounds(const MeshBounds& bounds, float* boundsMin, float* boundsMax)
+{
+	const glm::vec3 min = bounds.empty() ? glm::vec3(0.f) : bounds.min;
+	const glm::vec3 max = bounds.empty() ? glm::vec3(0.f) : bounds.max;
+	for (int i = 0; i < 3; i++)
+	{
+		boundsMin[i] = min[i];
+		boundsMax[i] = max[i];
+	}
+}
 
-		VertexBuffer verticies;
-		IndexBuffer indicies;
-		VertexData vertexData;
+// ----------------------------------------------------------------------------
 
-		//OctreeNode* root = nodes[octreeIndex];
+static bool FillUnityMeshDesc(const ChunkResult* result, UnityMeshDesc* mesh)
+{
+	memset(mesh, 0, sizeof(UnityMeshDesc));
+	if (!result)
+	{
+		return false;
+	}
+
+	const bool use16BitIndices = result->numVertices() < 65536;
+
+	mesh->vertexCount = result->numVertices();
+	mesh->vertexStride = 6 * sizeof(float);
+	mesh->vertexData = const_cast<float*>(result->vertices.data());
+	mesh->indexCount = (int)result->indices.size();
+	mesh->indexFormat = use16BitIndices ? 0 : 1;
+	mesh->indexData = use16BitIndices ? (void*)result->indices16.data() : (void*)result->indices.data();
+	mesh->subMeshCount = (int)result->subMeshes.size();
+	CopyBounds(result->bounds, mesh->boundsMin, mesh->boundsMax);
+	mesh->contents = result->contents;
 
-		GenerateMeshFromOctree(root, verticies, indicies, vertexData);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+extern "C" {
+	void CreateOctreeAndDualContour(GeneratorContext* context, int x, int y, int z, int octreeSize, float res, int* indexBufferLength, int **indexBufferData, int* vertexBufferLength, float **vertexBufferData) {
+		CallRecord record(Call_CreateOctreeAndDualContour, context);
+		record << x << y << z << octreeSize << res;
 
-		//return data.verticies;
-		//sending the index buffer out
-		*indexBufferLength = indicies.size();
-		auto indexBufferSize = (*indexBufferLength) * sizeof(int);
-		*indexBufferData = static_cast<int*>(malloc(indexBufferSize));
-		memcpy(*indexBufferData, indicies.data(), indexBufferSize);
+		ChunkRequest request;
+		request.position = glm::ivec3(x, y, z);
+		request.size = octreeSize;
+		request.pipeline = Pipeline_Octree;
+		request.octreeThreshold = res;
 
-		*vertexBufferLength = vertexData.size();
-		auto vertexBufferSize = (*vertexBufferLength) * sizeof(float);
-		*vertexBufferData = static_cast<float*>(malloc(vertexBufferSize));
-		memcpy(*vertexBufferData, vertexData.data(), vertexBufferSize);
+		ChunkResult result;
+		context->generate(request, result);
+
+		CopyMeshOut(result.vertices, result.indices, indexBufferLength, indexBufferData, vertexBufferLength, vertexBufferData);
 	}
 
 	//we can't generate the mesh at different levels without regenerating the octree I think
@@ -39,6 +135,7 @@ extern "C" {
 	//and pull in some 3rd party simplfication lib to do some fast polygon simplifications to generate lods? 
 
 	void FastDualContourTest() {
+		CallRecord record(Call_FastDualContourTest, nullptr);
 		printf("Starting FastDualContourTest\n");
 		MeshSimplificationOptions options;
 		options.targetPercentage = 0.05f; //0.05f
@@ -57,7 +154,7 @@ extern "C" {
 
 		printf("Generating Mesh\n");
 		VertexData cellData;
-		MeshBuffer* buffer = GenerateMesh(x, y, z, cellSize, dVal, cellData);
+		MeshBuffer* buffer = GenerateMesh(DensityParams(), x, y, z, cellSize, 1, dVal, cellData);
 		printf("Generating Mesh Done\n");
 		//CreateGLMesh function
 		MeshBuffer* simplfiedMesh = new MeshBuffer;
@@ -130,107 +227,522 @@ extern "C" {
 		printf("Done\n");
 	}
 
-	void FastDualContour(int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeSize, float maxError, float minAngleCosine, float* debugVal, float* debugVal2,  long* indexBufferLength, int **indexBufferData, long* vertexBufferLength, float **vertexBufferData, long* cellDataLength, float **cellData) {
-		MeshSimplificationOptions options;
-		options.targetPercentage = targetPolygonPercent;
-		options.maxIterations = maxSimplifyIterations;
-		options.edgeFraction = edgeFraction;
-		options.maxEdgeSize = maxEdgeSize;
-		options.maxError = maxError;
-		options.minAngleCosine = minAngleCosine;
-		float dVal = 0;
-		float dVal2 = 0;
+	void FastDualContour(GeneratorContext* context, int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeSize, float maxError, float minAngleCosine, float* debugVal, float* debugVal2,  int* indexBufferLength, int **indexBufferData, int* vertexBufferLength, float **vertexBufferData, int* cellDataLength, float **cellData) {
+		CallRecord record(Call_FastDualContour, context);
+		record << x << y << z << cellSize << targetPolygonPercent << maxSimplifyIterations << edgeFraction << maxEdgeSize << maxError << minAngleCosine;
 
-		VertexData cells;
-		MeshBuffer* buffer = GenerateMesh(x,y,z, cellSize, dVal, cells);
+		const ChunkRequest request = FastDualContourRequest(x, y, z, cellSize, targetPolygonPercent, maxSimplifyIterations, edgeFraction, maxEdgeSize, maxError, minAngleCosine);
 
-		//CreateGLMesh function
-		MeshBuffer* simplfiedMesh = new MeshBuffer;
-		VertexData vertexData;
-		IndexBuffer indicies;
+		ChunkResult result;
+		context->generate(request, result);
 
-		VertexData vertData;
-		IndexBuffer triData;
+		*debugVal = 0.f;
+		*debugVal2 = 0.f;
 
-		
+		CopyMeshOut(result.vertices, result.indices, indexBufferLength, indexBufferData, vertexBufferLength, vertexBufferData);
 
-		simplfiedMesh->numVertices = buffer->numVertices;
-		simplfiedMesh->vertices = (MeshVertex*)malloc(sizeof(MeshVertex) * buffer->numVertices);
-		for (int i = 0; i < buffer->numVertices; i++)
-		{
-			simplfiedMesh->vertices[i].xyz[0] = buffer->vertices[i].xyz[0];
-			simplfiedMesh->vertices[i].xyz[1] = buffer->vertices[i].xyz[1];
-			simplfiedMesh->vertices[i].xyz[2] = buffer->vertices[i].xyz[2];
-			simplfiedMesh->vertices[i].xyz[3] = 1.f;
+		*cellDataLength = (int)result.cells.size();
+		auto cellBufferSize = (*cellDataLength) * sizeof(float);
+		*cellData = static_cast<float*>(malloc(cellBufferSize));
+		memcpy(*cellData, result.cells.data(), cellBufferSize);
+	}
 
-			simplfiedMesh->vertices[i].normal[0] = buffer->vertices[i].normal[0];
-			simplfiedMesh->vertices[i].normal[1] = buffer->vertices[i].normal[1];
-			simplfiedMesh->vertices[i].normal[2] = buffer->vertices[i].normal[2];
-			simplfiedMesh->vertices[i].normal[3] = 0.f;
+	// ----------------------------------------------------------------------------
+	// Asynchronous job API, chunks are generated on the plugin's worker threads
+	// and the managed side polls for completion instead of blocking
 
-			simplfiedMesh->vertices[i].colour[0] = buffer->vertices[i].colour[0];
-			simplfiedMesh->vertices[i].colour[1] = buffer->vertices[i].colour[1];
-			simplfiedMesh->vertices[i].colour[2] = buffer->vertices[i].colour[2];
-			simplfiedMesh->vertices[i].colour[3] = buffer->vertices[i].colour[3];
+	int SubmitOctreeJob(GeneratorContext* context, int x, int y, int z, int octreeSize, float res) {
+		CallRecord record(Call_SubmitOctreeJob, context);
+		record << x << y << z << octreeSize << res;
 
+		ChunkRequest request;
+		request.position = glm::ivec3(x, y, z);
+		request.size = octreeSize;
+		request.pipeline = Pipeline_Octree;
+		request.octreeThreshold = res;
 
-			/*simplfiedMesh->vertices[i].xyz[0] *= 1;
-			simplfiedMesh->vertices[i].xyz[1] *= meshScale;
-			simplfiedMesh->vertices[i].xyz[2] *= meshScale;
-			simplfiedMesh->vertices[i].xyz[3] = 1.f;*/
+		const int job = context->submit(request);
+		record << job;
+		return job;
+	}
+
+	int SubmitFastDualContourJob(GeneratorContext* context, int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeSize, float maxError, float minAngleCosine) {
+		CallRecord record(Call_SubmitFastDualContourJob, context);
+		record << x << y << z << cellSize << targetPolygonPercent << maxSimplifyIterations << edgeFraction << maxEdgeSize << maxError << minAngleCosine;
+
+		const int job = context->submit(FastDualContourRequest(x, y, z, cellSize, targetPolygonPercent, maxSimplifyIterations, edgeFraction, maxEdgeSize, maxError, minAngleCosine));
+		record << job;
+		return job;
+	}
+
+	int PollJob(GeneratorContext* context, int job) {
+		CallRecord record(Call_PollJob, context);
+		const int status = context->jobs().poll(job);
+		record << job << status;
+		return status;
+	}
+
+	int WaitForJob(GeneratorContext* context, int job, int timeoutMs) {
+		CallRecord record(Call_WaitForJob, context);
+		const int status = context->jobs().wait(job, timeoutMs);
+		record << job << timeoutMs << status;
+		return status;
+	}
+
+	void CancelJob(GeneratorContext* context, int job) {
+		CallRecord record(Call_CancelJob, context);
+		record << job;
+		context->jobs().cancel(job);
+	}
+
+	// The returned buffers are owned by the job and stay valid until ReleaseJob
+	int GetJobResult(GeneratorContext* context, int job, int* indexBufferLength, int **indexBufferData, int* vertexBufferLength, float **vertexBufferData) {
+		CallRecord record(Call_GetJobResult, context);
+		record << job;
+
+		const ChunkResult* result = context->jobs().result(job);
+		if (!result) {
+			*indexBufferLength = 0;
+			*indexBufferData = nullptr;
+			*vertexBufferLength = 0;
+			*vertexBufferData = nullptr;
+			return 0;
 		}
 
-		
+		*indexBufferLength = (int)result->indices.size();
+		*indexBufferData = const_cast<int*>(result->indices.data());
+		*vertexBufferLength = (int)result->vertices.size();
+		*vertexBufferData = const_cast<float*>(result->vertices.data());
+		return 1;
+	}
 
-		
-		*debugVal2 = buffer->numVertices;
+	int GetJobCellData(GeneratorContext* context, int job, int* cellDataLength, float **cellData) {
+		CallRecord record(Call_GetJobCellData, context);
+		record << job;
 
-		simplfiedMesh->numTriangles = buffer->numTriangles;
-		simplfiedMesh->triangles = (MeshTriangle*)malloc(sizeof(MeshTriangle)*buffer->numTriangles);
-		memcpy(&simplfiedMesh->triangles[0], &buffer->triangles[0], sizeof(buffer->triangles[0]) * buffer->numTriangles);
+		const ChunkResult* result = context->jobs().result(job);
+		if (!result) {
+			*cellDataLength = 0;
+			*cellData = nullptr;
+			return 0;
+		}
 
-		vec4 offset;
-		offset[0] = 0.f;
-		offset[1] = 0.f;
-		offset[2] = 0.f;
-		offset[3] = 0.f;
+		*cellDataLength = (int)result->cells.size();
+		*cellData = const_cast<float*>(result->cells.data());
+		return 1;
+	}
 
-		
-		//ngMeshSimplifier(simplfiedMesh, offset, options, vertexData, indicies, dVal, dVal2);
-		
-		for (int i = 0; i < simplfiedMesh->numVertices; i++) {
-			vertData.push_back(simplfiedMesh->vertices[i].xyz[0]);
-			vertData.push_back(simplfiedMesh->vertices[i].xyz[1]);
-			vertData.push_back(simplfiedMesh->vertices[i].xyz[2]);
+	void ReleaseJob(GeneratorContext* context, int job) {
+		CallRecord record(Call_ReleaseJob, context);
+		record << job;
+		context->jobs().release(job);
+	}
 
-			vertData.push_back(simplfiedMesh->vertices[i].normal[0]);
-			vertData.push_back(simplfiedMesh->vertices[i].normal[1]);
-			vertData.push_back(simplfiedMesh->vertices[i].normal[2]);
+	// ----------------------------------------------------------------------------
+	// Generator context, owns the worker threads, density configuration and
+	// statistics. Contexts are independent so several can be used at once.
+	// A negative numThreads creates a context without workers, see RunJobsFor.
+
+	GeneratorContext* CreateContext(int numThreads) {
+		CallRecord record(Call_CreateContext, nullptr);
+		record << numThreads;
+
+		GeneratorContext* context = new GeneratorContext(numThreads);
+		record.setContext(context);
+		return context;
+	}
+
+	void DestroyContext(GeneratorContext* context) {
+		CallRecord record(Call_DestroyContext, context);
+		delete context;
+	}
+
+	void SetDensityParams(GeneratorContext* context, const DensityParams* params) {
+		CallRecord record(Call_SetDensityParams, context);
+		record << *params;
+		context->setDensity(*params);
+	}
+
+	void GetDensityParams(GeneratorContext* context, DensityParams* params) {
+		CallRecord record(Call_GetDensityParams, context);
+		*params = context->density();
+	}
+
+	void GetContextStats(GeneratorContext* context, ContextStats* stats) {
+		CallRecord record(Call_GetContextStats, context);
+		context->stats().copyTo(*stats);
+		record << *stats;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Scheduling, pending jobs run nearest the viewer first
+
+	void SetViewer(GeneratorContext* context, const ViewerParams* viewer) {
+		CallRecord record(Call_SetViewer, context);
+		record << *viewer;
+		context->jobs().setViewer(*viewer);
+	}
+
+	int GetPendingJobCount(GeneratorContext* context) {
+		CallRecord record(Call_GetPendingJobCount, context);
+		const int count = context->jobs().numPending();
+		record << count;
+		return count;
+	}
+
+	// Finished and cancelled jobs since the last call, see JobSystem::drainCompleted
+	int DrainCompletedJobs(GeneratorContext* context, CompletedJob* jobs, int maxJobs, int maxBytes, int* overflowed) {
+		CallRecord record(Call_DrainCompletedJobs, context);
+		record << maxJobs << maxBytes;
+
+		bool lost = false;
+		const int count = context->jobs().drainCompleted(jobs, maxJobs, maxBytes, lost);
+		*overflowed = lost ? 1 : 0;
+
+		record.array(jobs, count) << *overflowed;
+		return count;
+	}
+
+	// Generates queued chunks on the calling thread for up to the given time,
+	// normally with a context created with numThreads < 0. See JobSystem::runFor
+	int RunJobsFor(GeneratorContext* context, int microseconds) {
+		CallRecord record(Call_RunJobsFor, context);
+		const int count = context->jobs().runFor(microseconds);
+		record << microseconds << count;
+		return count;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Batch API, a whole set of chunks crosses the P/Invoke boundary in one call
+	// and is queued on the workers together
+
+	void SubmitChunkBatch(GeneratorContext* context, const ChunkDesc* chunks, int numChunks, int* jobs) {
+		CallRecord record(Call_SubmitChunkBatch, context);
+		record.array(chunks, numChunks);
+
+		std::vector<ChunkRequest> requests(numChunks);
+		for (int i = 0; i < numChunks; i++) {
+			requests[i] = RequestFromDesc(chunks[i]);
 		}
 
-		for (int i = 0; i < simplfiedMesh->numTriangles; i++) {
-			triData.push_back(simplfiedMesh->triangles[i].indices_[0]);
-			triData.push_back(simplfiedMesh->triangles[i].indices_[1]);
-			triData.push_back(simplfiedMesh->triangles[i].indices_[2]);
+		context->submit(requests.data(), numChunks, jobs);
+		record.array(jobs, numChunks);
+	}
+
+	// Blocks until every chunk has finished, a context without workers generates
+	// them on the calling thread. The mesh buffers are owned by the jobs, hand
+	// meshes[i].job to ReleaseJobs once they have been copied out.
+	int GenerateChunkBatch(GeneratorContext* context, const ChunkDesc* chunks, int numChunks, ChunkMeshDesc* meshes) {
+		CallRecord record(Call_GenerateChunkBatch, context);
+		record.array(chunks, numChunks);
+
+		JobSystem& jobSystem = context->jobs();
+
+		std::vector<int> jobs(numChunks);
+		SubmitChunkBatch(context, chunks, numChunks, jobs.data());
+		record.array(jobs.data(), numChunks);
+
+		int numCompleted = 0;
+		for (int i = 0; i < numChunks; i++) {
+			ChunkMeshDesc& mesh = meshes[i];
+			mesh.job = jobs[i];
+			mesh.status = jobSystem.numThreads() > 0 ? jobSystem.wait(jobs[i], -1) : RunUntilFinished(jobSystem, jobs[i]);
+
+			const ChunkResult* result = jobSystem.result(jobs[i]);
+			if (!result) {
+				mesh.indexBufferLength = 0;
+				mesh.indexBufferData = nullptr;
+				mesh.vertexBufferLength = 0;
+				mesh.vertexBufferData = nullptr;
+				continue;
+			}
+
+			mesh.indexBufferLength = (int)result->indices.size();
+			mesh.indexBufferData = const_cast<int*>(result->indices.data());
+			mesh.vertexBufferLength = (int)result->vertices.size();
+			mesh.vertexBufferData = const_cast<float*>(result->vertices.data());
+			numCompleted++;
 		}
-		
-		
-		*debugVal = dVal;
-		*debugVal2 = dVal2;
 
-		*indexBufferLength = triData.size();
-		auto indexBufferSize = (*indexBufferLength) * sizeof(int);
-		*indexBufferData = static_cast<int*>(malloc(indexBufferSize));
-		memcpy(*indexBufferData, triData.data(), indexBufferSize);
+		return numCompleted;
+	}
 
-		*vertexBufferLength = vertData.size();
-		auto vertexBufferSize = (*vertexBufferLength) * sizeof(float);
-		*vertexBufferData = static_cast<float*>(malloc(vertexBufferSize));
-		memcpy(*vertexBufferData, vertData.data(), vertexBufferSize);
+	void ReleaseJobs(GeneratorContext* context, const int* jobs, int numJobs) {
+		CallRecord record(Call_ReleaseJobs, context);
+		record.array(jobs, numJobs);
 
-		*cellDataLength = cells.size();
-		auto cellBufferSize = (*cellDataLength) * sizeof(float);
-		*cellData = static_cast<float*>(malloc(cellBufferSize));
-		memcpy(*cellData, cells.data(), cellBufferSize);
+		JobSystem& jobSystem = context->jobs();
+		for (int i = 0; i < numJobs; i++) {
+			jobSystem.release(jobs[i]);
+		}
+	}
+
+	// ----------------------------------------------------------------------------
+	// Unity mesh layout, all pointers are owned by the job and valid until it is released
+
+	int GetJobUnityMesh(GeneratorContext* context, int job, UnityMeshDesc* mesh) {
+		CallRecord record(Call_GetJobUnityMesh, context);
+		record << job;
+		return FillUnityMeshDesc(context->jobs().result(job), mesh) ? 1 : 0;
+	}
+
+	int GetJobUnityMeshes(GeneratorContext* context, const int* jobs, int numJobs, UnityMeshDesc* meshes) {
+		CallRecord record(Call_GetJobUnityMeshes, context);
+		record.array(jobs, numJobs);
+
+		JobSystem& jobSystem = context->jobs();
+
+		int numFound = 0;
+		for (int i = 0; i < numJobs; i++) {
+			numFound += FillUnityMeshDesc(jobSystem.result(jobs[i]), &meshes[i]) ? 1 : 0;
+		}
+
+		return numFound;
+	}
+
+	int GetJobUnitySubMeshes(GeneratorContext* context, int job, UnitySubMeshDesc* subMeshes, int maxSubMeshes) {
+		CallRecord record(Call_GetJobUnitySubMeshes, context);
+		record << job << maxSubMeshes;
+
+		const ChunkResult* result = context->jobs().result(job);
+		if (!result) {
+			return 0;
+		}
+
+		const int count = std::min(maxSubMeshes, (int)result->subMeshes.size());
+		for (int i = 0; i < count; i++) {
+			const SubMesh& subMesh = result->subMeshes[i];
+			subMeshes[i].indexStart = subMesh.indexStart;
+			subMeshes[i].indexCount = subMesh.indexCount;
+			subMeshes[i].firstVertex = subMesh.firstVertex;
+			subMeshes[i].vertexCount = subMesh.vertexCount;
+			CopyBounds(subMesh.bounds, subMeshes[i].boundsMin, subMeshes[i].boundsMax);
+		}
+
+		return count;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Closes the cracks between a fast_dc chunk and its neighbours on its min
+	// faces, at any mix of LODs. The seam becomes the job's second submesh and
+	// replaces any seam built before, so call again when a neighbour changes.
+
+	int BuildJobSeam(GeneratorContext* context, int job, const int* neighbours, int numNeighbours) {
+		CallRecord record(Call_BuildJobSeam, context);
+		record << job;
+		record.array(neighbours, numNeighbours);
+
+		return context->jobs().buildSeam(job, neighbours, numNeighbours) ? 1 : 0;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Merges finished jobs' meshes (seams included) into a new job, welding the
+	// vertices they share, so a block of distant chunks is drawn with one call.
+	// The members are untouched, releasing the merged job unmerges them.
+
+	int MergeJobMeshes(GeneratorContext* context, const int* jobs, int numJobs, int optimizeVertexCache) {
+		CallRecord record(Call_MergeJobMeshes, context);
+		record.array(jobs, numJobs) << optimizeVertexCache;
+
+		const int job = context->jobs().merge(jobs, numJobs, optimizeVertexCache != 0);
+		record << job;
+		return job;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Writes the finished jobs to one file, the format follows the extension
+	// (.ply, .obj, .gltf or .glb). Jobs which aren't done are skipped.
+
+	int ExportJobMeshes(GeneratorContext* context, const int* jobs, int numJobs, const char* path) {
+		CallRecord record(Call_ExportJobMeshes, context);
+		record.array(jobs, numJobs).string(path);
+
+		auto exporter = CreateMeshExporter(path, MeshExportFormatFromPath(path));
+		if (!exporter) {
+			return 0;
+		}
+
+		JobSystem& jobSystem = context->jobs();
+		bool ok = true;
+		for (int i = 0; i < numJobs && ok; i++) {
+			const ChunkResult* result = jobSystem.result(jobs[i]);
+			if (result) {
+				ok = exporter->add(*result);
+			}
+		}
+
+		return exporter->finish() && ok ? 1 : 0;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Clipmap streaming, the context keeps rings of chunks at increasing LODs
+	// around the viewer and reports chunks as they load and unload
+
+	int EnableClipmap(GeneratorContext* context, const ClipmapParams* params) {
+		CallRecord record(Call_EnableClipmap, context);
+		record << *params;
+		return context->enableClipmap(*params) ? 1 : 0;
+	}
+
+	void DisableClipmap(GeneratorContext* context) {
+		CallRecord record(Call_DisableClipmap, context);
+		context->disableClipmap();
+	}
+
+	void SetClipmapViewer(GeneratorContext* context, float x, float y, float z) {
+		CallRecord record(Call_SetClipmapViewer, context);
+		record << x << y << z;
+
+		if (ClipmapManager* clipmap = context->clipmap()) {
+			clipmap->setViewer(glm::vec3(x, y, z));
+		}
+	}
+
+	// Unload events release their job, read a chunk's mesh before draining its unload
+	int DrainClipmapEvents(GeneratorContext* context, ClipmapEvent* events, int maxEvents) {
+		CallRecord record(Call_DrainClipmapEvents, context);
+		record << maxEvents;
+
+		ClipmapManager* clipmap = context->clipmap();
+		const int count = clipmap ? clipmap->drainEvents(events, maxEvents) : 0;
+		record.array(events, count);
+		return count;
+	}
+
+	int GetClipmapChunkCount(GeneratorContext* context, int* numLoaded) {
+		CallRecord record(Call_GetClipmapChunkCount, context);
+
+		ClipmapManager* clipmap = context->clipmap();
+		*numLoaded = clipmap ? clipmap->numLoaded() : 0;
+		return clipmap ? clipmap->numChunks() : 0;
+	}
+
+	// SetClipmapViewer plus the viewer's velocity (world units per second) and
+	// look direction, used to prefetch when ClipmapParams::prefetchSeconds is set
+	void SetClipmapViewerMotion(GeneratorContext* context, float x, float y, float z, float velocityX, float velocityY, float velocityZ, float lookX, float lookY, float lookZ) {
+		CallRecord record(Call_SetClipmapViewerMotion, context);
+		record << x << y << z << velocityX << velocityY << velocityZ << lookX << lookY << lookZ;
+
+		if (ClipmapManager* clipmap = context->clipmap()) {
+			clipmap->setViewer(glm::vec3(x, y, z), glm::vec3(velocityX, velocityY, velocityZ), glm::vec3(lookX, lookY, lookZ));
+		}
+	}
+
+	void GetClipmapPrefetchStats(GeneratorContext* context, ClipmapPrefetchStats* stats) {
+		CallRecord record(Call_GetClipmapPrefetchStats, context);
+
+		ClipmapManager* clipmap = context->clipmap();
+		*stats = clipmap ? clipmap->prefetchStats() : ClipmapPrefetchStats();
+		record << *stats;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Memory, everything the context holds natively counts against one budget.
+	// Over budget, finished prefetches and cached meshes are dropped cheapest to
+	// regenerate first. The mesh cache also has its own capacity, and chunks in
+	// a region which was edited should be invalidated.
+
+	void SetMemoryBudget(GeneratorContext* context, long long bytes) {
+		CallRecord record(Call_SetMemoryBudget, context);
+		record << bytes;
+		context->memory().setBudget(bytes);
+	}
+
+	void GetMemoryUsage(GeneratorContext* context, MemoryUsage* usage) {
+		CallRecord record(Call_GetMemoryUsage, context);
+		context->memory().usage(*usage);
+		record << *usage;
+	}
+
+	void SetMeshCacheCapacity(GeneratorContext* context, long long bytes) {
+		CallRecord record(Call_SetMeshCacheCapacity, context);
+		record << bytes;
+		context->meshCache().setCapacity(bytes);
+	}
+
+	void InvalidateMeshCache(GeneratorContext* context, int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+		CallRecord record(Call_InvalidateMeshCache, context);
+		record << minX << minY << minZ << maxX << maxY << maxZ;
+		context->meshCache().invalidate(glm::ivec3(minX, minY, minZ), glm::ivec3(maxX, maxY, maxZ));
+	}
+
+	// ----------------------------------------------------------------------------
+	// Edits, stamped into a sparse volume near the surface which the meshers
+	// sample in place of the density from then on. Only chunks queued after an
+	// edit see it, loaded chunks in the region have to be requested again.
+
+	void EditDensity(GeneratorContext* context, const DensityEdit* edit) {
+		CallRecord record(Call_EditDensity, context);
+		record << *edit;
+		context->editDensity(*edit);
+	}
+
+	void ClearDensityEdits(GeneratorContext* context) {
+		CallRecord record(Call_ClearDensityEdits, context);
+		context->clearDensityEdits();
+	}
+
+	void GetDensityEditStats(GeneratorContext* context, DensityEditStats* stats) {
+		CallRecord record(Call_GetDensityEditStats, context);
+		*stats = context->densityEditStats();
+		record << *stats;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Baked signs, the sign of every corner of a static world stored as a sparse
+	// voxel DAG (see region_bake --sign-dag). The meshers read them instead of
+	// sampling the density wherever they were baked from the current density,
+	// empty and solid chunks are rejected exactly and meshes don't change.
+
+	int LoadSignDag(GeneratorContext* context, const char* path) {
+		CallRecord record(Call_LoadSignDag, context);
+		record.string(path);
+		return context->loadSignDag(path) ? 1 : 0;
+	}
+
+	void UnloadSignDag(GeneratorContext* context) {
+		CallRecord record(Call_UnloadSignDag, context);
+		context->unloadSignDag();
+	}
+
+	void GetSignDagStats(GeneratorContext* context, SignDagStats* stats) {
+		CallRecord record(Call_GetSignDagStats, context);
+		*stats = context->signDagStats();
+		record << *stats;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Chunk archive, a file which keeps generated chunks between sessions. Jobs
+	// queued while it's open are loaded from it when present and written to it
+	// when generated.
+
+	int OpenChunkArchive(GeneratorContext* context, const char* path) {
+		CallRecord record(Call_OpenChunkArchive, context);
+		record.string(path);
+		return context->openArchive(path) ? 1 : 0;
+	}
+
+	void CloseChunkArchive(GeneratorContext* context) {
+		CallRecord record(Call_CloseChunkArchive, context);
+		context->closeArchive();
+	}
+
+	int CompactChunkArchive(GeneratorContext* context) {
+		CallRecord record(Call_CompactChunkArchive, context);
+
+		const auto archive = context->archive();
+		return archive && archive->compact() ? 1 : 0;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Call recording, every export below is logged with its arguments and timing
+	// to a binary trace which the TraceReplay tool can re-issue offline
+
+	int StartRecording(const char* path) {
+		return StartCallRecording(path) ? 1 : 0;
+	}
+
+	void StopRecording() {
+		StopCallRecording();
 	}
-}
\ No newline at end of file
+}
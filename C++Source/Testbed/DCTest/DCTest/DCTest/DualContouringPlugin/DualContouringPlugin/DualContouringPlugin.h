@@ -1,15 +1,133 @@
-#ifdef UNITY_WIN
+#ifdef _MSC_VER
 #define EXPORT __declspec(dllexport)
 #else
-#define EXPORT
-#endif 
-
-#define EXPORT __declspec(dllexport)
+#define EXPORT __attribute__((visibility("default")))
+#endif
 
 #include "octree.h"
+#include "generator_context.h"
 
 extern "C" {
-	EXPORT void CreateOctreeAndDualContour(int x, int y, int z, int octreeSize, float res, long* indexBufferLength, int **indexBufferData, long* vertexBufferLength, float **vertexBufferData);
+	// Batch descriptors, laid out to match the [StructLayout(Sequential)] structs in DualContouringDLL.cs
+	struct ChunkDesc
+	{
+		int x, y, z;
+		int size;
+		int lod;
+		int pipeline;
+		float octreeThreshold;
+
+		// fast_dc only, see SimplifyChunkMesh. targetPolygonPercent >= 1 or
+		// maxSimplifyIterations <= 0 leaves the mesh unsimplified
+		float targetPolygonPercent;
+		int maxSimplifyIterations;
+		float edgeFraction;
+		float maxEdgeSize;
+		float maxError;
+		float minAngleCosine;
+	};
+
+	struct ChunkMeshDesc
+	{
+		int job;
+		int status;
+		int indexBufferLength;
+		int* indexBufferData;
+		int vertexBufferLength;
+		float* vertexBufferData;
+	};
+
+	// Buffers ready for Mesh.SetVertexBufferData / SetIndexBufferData. The vertex
+	// stream is float3 position + float3 normal, indexFormat follows
+	// UnityEngine.Rendering.IndexFormat (0 = UInt16, 1 = UInt32).
+	struct UnityMeshDesc
+	{
+		int vertexCount;
+		int vertexStride;
+		float* vertexData;
+		int indexCount;
+		int indexFormat;
+		void* indexData;
+		int subMeshCount;
+		float boundsMin[3];
+		float boundsMax[3];
+		int contents;		// ChunkContents
+	};
+
+	struct UnitySubMeshDesc
+	{
+		int indexStart;
+		int indexCount;
+		int firstVertex;
+		int vertexCount;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	EXPORT void CreateOctreeAndDualContour(GeneratorContext* context, int x, int y, int z, int octreeSize, float res, int* indexBufferLength, int **indexBufferData, int* vertexBufferLength, float **vertexBufferData);
 	EXPORT void FastDualContourTest();
-	EXPORT void FastDualContour(int x, int y, int z, int meshScale, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeSize, float maxError, float minAngleCosine, float* debugVal, float* debugVal2, long* indexBufferLength, int **indexBufferData, long* vertexBufferLength, float **vertexBufferData, long* cellDataLength, float **cellData);
-}
\ No newline at end of file
+	EXPORT void FastDualContour(GeneratorContext* context, int x, int y, int z, int meshScale, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeSize, float maxError, float minAngleCosine, float* debugVal, float* debugVal2, int* indexBufferLength, int **indexBufferData, int* vertexBufferLength, float **vertexBufferData, int* cellDataLength, float **cellData);
+
+	EXPORT int SubmitOctreeJob(GeneratorContext* context, int x, int y, int z, int octreeSize, float res);
+	EXPORT int SubmitFastDualContourJob(GeneratorContext* context, int x, int y, int z, int cellSize, float targetPolygonPercent, int maxSimplifyIterations, float edgeFraction, float maxEdgeSize, float maxError, float minAngleCosine);
+	EXPORT int PollJob(GeneratorContext* context, int job);
+	EXPORT int WaitForJob(GeneratorContext* context, int job, int timeoutMs);
+	EXPORT void CancelJob(GeneratorContext* context, int job);
+	EXPORT int GetJobResult(GeneratorContext* context, int job, int* indexBufferLength, int **indexBufferData, int* vertexBufferLength, float **vertexBufferData);
+	EXPORT int GetJobCellData(GeneratorContext* context, int job, int* cellDataLength, float **cellData);
+	EXPORT void ReleaseJob(GeneratorContext* context, int job);
+
+	EXPORT GeneratorContext* CreateContext(int numThreads);
+	EXPORT void DestroyContext(GeneratorContext* context);
+	EXPORT void SetDensityParams(GeneratorContext* context, const DensityParams* params);
+	EXPORT void GetDensityParams(GeneratorContext* context, DensityParams* params);
+	EXPORT void GetContextStats(GeneratorContext* context, ContextStats* stats);
+
+	EXPORT void SetViewer(GeneratorContext* context, const ViewerParams* viewer);
+	EXPORT int GetPendingJobCount(GeneratorContext* context);
+	EXPORT int DrainCompletedJobs(GeneratorContext* context, CompletedJob* jobs, int maxJobs, int maxBytes, int* overflowed);
+	EXPORT int RunJobsFor(GeneratorContext* context, int microseconds);
+
+	EXPORT void SubmitChunkBatch(GeneratorContext* context, const ChunkDesc* chunks, int numChunks, int* jobs);
+	EXPORT int GenerateChunkBatch(GeneratorContext* context, const ChunkDesc* chunks, int numChunks, ChunkMeshDesc* meshes);
+	EXPORT void ReleaseJobs(GeneratorContext* context, const int* jobs, int numJobs);
+
+	EXPORT int GetJobUnityMesh(GeneratorContext* context, int job, UnityMeshDesc* mesh);
+	EXPORT int GetJobUnityMeshes(GeneratorContext* context, const int* jobs, int numJobs, UnityMeshDesc* meshes);
+	EXPORT int GetJobUnitySubMeshes(GeneratorContext* context, int job, UnitySubMeshDesc* subMeshes, int maxSubMeshes);
+	EXPORT int BuildJobSeam(GeneratorContext* context, int job, const int* neighbours, int numNeighbours);
+	EXPORT int MergeJobMeshes(GeneratorContext* context, const int* jobs, int numJobs, int optimizeVertexCache);
+
+	EXPORT int ExportJobMeshes(GeneratorContext* context, const int* jobs, int numJobs, const char* path);
+
+	EXPORT int EnableClipmap(GeneratorContext* context, const ClipmapParams* params);
+	EXPORT void DisableClipmap(GeneratorContext* context);
+	EXPORT void SetClipmapViewer(GeneratorContext* context, float x, float y, float z);
+	EXPORT int DrainClipmapEvents(GeneratorContext* context, ClipmapEvent* events, int maxEvents);
+	EXPORT int GetClipmapChunkCount(GeneratorContext* context, int* numLoaded);
+	EXPORT void SetClipmapViewerMotion(GeneratorContext* context, float x, float y, float z, float velocityX, float velocityY, float velocityZ, float lookX, float lookY, float lookZ);
+	EXPORT void GetClipmapPrefetchStats(GeneratorContext* context, ClipmapPrefetchStats* stats);
+
+	EXPORT void SetMemoryBudget(GeneratorContext* context, long long bytes);
+	EXPORT void GetMemoryUsage(GeneratorContext* context, MemoryUsage* usage);
+	EXPORT void SetMeshCacheCapacity(GeneratorContext* context, long long bytes);
+	EXPORT void InvalidateMeshCache(GeneratorContext* context, int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+	EXPORT void EditDensity(GeneratorContext* context, const DensityEdit* edit);
+	EXPORT void ClearDensityEdits(GeneratorContext* context);
+	EXPORT void GetDensityEditStats(GeneratorContext* context, DensityEditStats* stats);
+
+	EXPORT int LoadSignDag(GeneratorContext* context, const char* path);
+	EXPORT void UnloadSignDag(GeneratorContext* context);
+	EXPORT void GetSignDagStats(GeneratorContext* context, SignDagStats* stats);
+
+	EXPORT int OpenChunkArchive(GeneratorContext* context, const char* path);
+	EXPORT void CloseChunkArchive(GeneratorContext* context);
+	EXPORT int CompactChunkArchive(GeneratorContext* context);
+
+	EXPORT int StartRecording(const char* path);
+	EXPORT void StopRecording();
+}
+
+// Shared with the standalone tools which link the plugin sources directly
+ChunkRequest RequestFromDesc(const ChunkDesc& desc);
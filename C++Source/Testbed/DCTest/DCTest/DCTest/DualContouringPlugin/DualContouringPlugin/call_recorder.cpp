@@ -0,0 +1,348 @@
+#include "call_recorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include <unordered_map>
+
+#include "DualContouringPlugin.h"
+
+// ----------------------------------------------------------------------------
+
+static const char* CALL_NAMES[Call_Count] =
+{
+	"<invalid>",
+	"CreateOctreeAndDualContour",
+	"FastDualContourTest",
+	"FastDualContour",
+	"SubmitOctreeJob",
+	"SubmitFastDualContourJob",
+	"PollJob",
+	"WaitForJob",
+	"CancelJob",
+	"GetJobResult",
+	"GetJobCellData",
+	"ReleaseJob",
+	"CreateContext",
+	"DestroyContext",
+	"SetDensityParams",
+	"GetDensityParams",
+	"GetContextStats",
+	"SetViewer",
+	"GetPendingJobCount",
+	"DrainCompletedJobs",
+	"RunJobsFor",
+	"SubmitChunkBatch",
+	"GenerateChunkBatch",
+	"ReleaseJobs",
+	"GetJobUnityMesh",
+	"GetJobUnityMeshes",
+	"GetJobUnitySubMeshes",
+	"ExportJobMeshes",
+	"EnableClipmap",
+	"DisableClipmap",
+	"SetClipmapViewer",
+	"DrainClipmapEvents",
+	"GetClipmapChunkCount",
+	"OpenChunkArchive",
+	"CloseChunkArchive",
+	"CompactChunkArchive",
+	"BuildJobSeam",
+	"SetClipmapViewerMotion",
+	"GetClipmapPrefetchStats",
+	"SetMemoryBudget",
+	"GetMemoryUsage",
+	"SetMeshCacheCapacity",
+	"InvalidateMeshCache",
+	"MergeJobMeshes",
+	"EditDensity",
+	"ClearDensityEdits",
+	"GetDensityEditStats",
+	"LoadSignDag",
+	"UnloadSignDag",
+	"GetSignDagStats",
+};
+
+// ----------------------------------------------------------------------------
+
+struct CallRecording
+{
+	FILE*				file = nullptr;
+	std::chrono::steady_clock::time_point start;
+	std::unordered_map<const GeneratorContext*, uint32_t> contexts;
+	uint32_t			nextContext = 1;
+};
+
+static std::mutex g_recordingMutex;
+static CallRecording* g_recording = nullptr;
+static std::atomic<bool> g_recordingActive { false };
+static std::atomic<int> g_nextThread { 0 };
+
+// exports calling other exports only record the outer call
+static thread_local int t_callDepth = 0;
+static thread_local int t_thread = -1;
+
+// ----------------------------------------------------------------------------
+
+const char* RecordedCallName(int call)
+{
+	return call > 0 && call < Call_Count ? CALL_NAMES[call] : CALL_NAMES[0];
+}
+
+// ----------------------------------------------------------------------------
+
+TraceHeader CurrentTraceHeader()
+{
+	TraceHeader header;
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.chunkDescSize = sizeof(ChunkDesc);
+	header.densityParamsSize = sizeof(DensityParams);
+	header.viewerParamsSize = sizeof(ViewerParams);
+	header.completedJobSize = sizeof(CompletedJob);
+	header.clipmapParamsSize = sizeof(ClipmapParams);
+	header.clipmapEventSize = sizeof(ClipmapEvent);
+	header.contextStatsSize = sizeof(ContextStats);
+	header.clipmapPrefetchStatsSize = sizeof(ClipmapPrefetchStats);
+	header.memoryUsageSize = sizeof(MemoryUsage);
+	header.densityEditSize = sizeof(DensityEdit);
+	header.densityEditStatsSize = sizeof(DensityEditStats);
+	header.signDagStatsSize = sizeof(SignDagStats);
+	return header;
+}
+
+// ----------------------------------------------------------------------------
+
+bool StartCallRecording(const char* path)
+{
+	StopCallRecording();
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	const TraceHeader header = CurrentTraceHeader();
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+	{
+		fclose(file);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(g_recordingMutex);
+	g_recording = new CallRecording;
+	g_recording->file = file;
+	g_recording->start = std::chrono::steady_clock::now();
+	g_recordingActive = true;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void StopCallRecording()
+{
+	std::lock_guard<std::mutex> lock(g_recordingMutex);
+	g_recordingActive = false;
+
+	if (g_recording)
+	{
+		fclose(g_recording->file);
+		delete g_recording;
+		g_recording = nullptr;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+CallRecord::CallRecord(const RecordedCall call, const GeneratorContext* context)
+	: call_(call)
+	, context_(context)
+{
+	active_ = t_callDepth++ == 0 && g_recordingActive.load(std::memory_order_relaxed);
+	if (active_)
+	{
+		start_ = std::chrono::steady_clock::now();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+CallRecord::~CallRecord()
+{
+	t_callDepth--;
+	if (!active_)
+	{
+		return;
+	}
+
+	const auto finished = std::chrono::steady_clock::now();
+	if (t_thread < 0)
+	{
+		t_thread = g_nextThread++;
+	}
+
+	std::lock_guard<std::mutex> lock(g_recordingMutex);
+	if (!g_recording)
+	{
+		return;
+	}
+
+	TraceRecordHeader record;
+	memset(&record, 0, sizeof(record));
+	record.call = (uint16_t)call_;
+	record.thread = (uint16_t)std::min(t_thread, 0xffff);
+	record.context = 0;
+	record.start = std::max(0LL, (long long)std::chrono::duration_cast<std::chrono::microseconds>(start_ - g_recording->start).count());
+	record.duration = std::chrono::duration_cast<std::chrono::microseconds>(finished - start_).count();
+	record.payloadSize = (uint32_t)payload_.size();
+
+	if (context_)
+	{
+		auto iter = g_recording->contexts.find(context_);
+		if (iter == end(g_recording->contexts))
+		{
+			// contexts created before the recording started are numbered on first use
+			iter = g_recording->contexts.emplace(context_, g_recording->nextContext++).first;
+		}
+
+		record.context = iter->second;
+
+		// the address can be reused by the next context
+		if (call_ == Call_DestroyContext)
+		{
+			g_recording->contexts.erase(iter);
+		}
+	}
+
+	fwrite(&record, sizeof(record), 1, g_recording->file);
+	if (!payload_.empty())
+	{
+		fwrite(payload_.data(), payload_.size(), 1, g_recording->file);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+CallRecord& CallRecord::bytes(const void* data, const size_t size)
+{
+	if (active_ && size > 0)
+	{
+		const uint8_t* begin = static_cast<const uint8_t*>(data);
+		payload_.insert(payload_.end(), begin, begin + size);
+	}
+
+	return *this;
+}
+
+// ----------------------------------------------------------------------------
+
+CallRecord& CallRecord::string(const char* text)
+{
+	const int length = text ? (int)strlen(text) : 0;
+	return array(text, length);
+}
+
+// ----------------------------------------------------------------------------
+
+void CallRecord::setContext(const GeneratorContext* context)
+{
+	context_ = context;
+}
+
+// ----------------------------------------------------------------------------
+
+TraceReader::~TraceReader()
+{
+	if (file_)
+	{
+		fclose(file_);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool TraceReader::open(const char* path, std::string& error)
+{
+	file_ = fopen(path, "rb");
+	if (!file_)
+	{
+		error = "can't open the trace";
+		return false;
+	}
+
+	TraceHeader header;
+	const TraceHeader expected = CurrentTraceHeader();
+	if (fread(&header, sizeof(header), 1, file_) != 1 || header.magic != TRACE_MAGIC)
+	{
+		error = "not a trace file";
+		return false;
+	}
+
+	if (header.version != expected.version)
+	{
+		error = "unsupported trace version";
+		return false;
+	}
+
+	if (header.chunkDescSize != expected.chunkDescSize ||
+		header.densityParamsSize != expected.densityParamsSize ||
+		header.viewerParamsSize != expected.viewerParamsSize ||
+		header.completedJobSize != expected.completedJobSize ||
+		header.clipmapParamsSize != expected.clipmapParamsSize ||
+		header.clipmapEventSize != expected.clipmapEventSize ||
+		header.contextStatsSize != expected.contextStatsSize ||
+		header.clipmapPrefetchStatsSize != expected.clipmapPrefetchStatsSize ||
+		header.memoryUsageSize != expected.memoryUsageSize ||
+		header.densityEditSize != expected.densityEditSize ||
+		header.densityEditStatsSize != expected.densityEditStatsSize ||
+		header.signDagStatsSize != expected.signDagStatsSize)
+	{
+		error = "trace was recorded by a build with different struct layouts";
+		return false;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool TraceReader::next(TraceRecordHeader& record)
+{
+	if (fread(&record, sizeof(record), 1, file_) != 1)
+	{
+		return false;
+	}
+
+	// a recording cut off part way through a record ends at the last whole one
+	payload_.resize(record.payloadSize);
+	offset_ = 0;
+	payloadError_ = false;
+	return record.payloadSize == 0 || fread(payload_.data(), record.payloadSize, 1, file_) == 1;
+}
+
+// ----------------------------------------------------------------------------
+
+void TraceReader::bytes(void* data, const size_t size)
+{
+	if (offset_ + size > payload_.size())
+	{
+		payloadError_ = true;
+		return;
+	}
+
+	memcpy(data, payload_.data() + offset_, size);
+	offset_ += size;
+}
+
+// ----------------------------------------------------------------------------
+
+std::string TraceReader::readString()
+{
+	const std::vector<char> text = readArray<char>();
+	return std::string(text.begin(), text.end());
+}
+
+// ----------------------------------------------------------------------------
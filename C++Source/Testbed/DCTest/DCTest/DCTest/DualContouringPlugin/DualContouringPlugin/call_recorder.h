@@ -0,0 +1,212 @@
+#ifndef		HAS_CALL_RECORDER_H_BEEN_INCLUDED
+#define		HAS_CALL_RECORDER_H_BEEN_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class GeneratorContext;
+
+// ----------------------------------------------------------------------------
+
+// Every exported entry point, values are stored in traces so only append
+enum RecordedCall
+{
+	Call_CreateOctreeAndDualContour = 1,
+	Call_FastDualContourTest,
+	Call_FastDualContour,
+	Call_SubmitOctreeJob,
+	Call_SubmitFastDualContourJob,
+	Call_PollJob,
+	Call_WaitForJob,
+	Call_CancelJob,
+	Call_GetJobResult,
+	Call_GetJobCellData,
+	Call_ReleaseJob,
+	Call_CreateContext,
+	Call_DestroyContext,
+	Call_SetDensityParams,
+	Call_GetDensityParams,
+	Call_GetContextStats,
+	Call_SetViewer,
+	Call_GetPendingJobCount,
+	Call_DrainCompletedJobs,
+	Call_RunJobsFor,
+	Call_SubmitChunkBatch,
+	Call_GenerateChunkBatch,
+	Call_ReleaseJobs,
+	Call_GetJobUnityMesh,
+	Call_GetJobUnityMeshes,
+	Call_GetJobUnitySubMeshes,
+	Call_ExportJobMeshes,
+	Call_EnableClipmap,
+	Call_DisableClipmap,
+	Call_SetClipmapViewer,
+	Call_DrainClipmapEvents,
+	Call_GetClipmapChunkCount,
+	Call_OpenChunkArchive,
+	Call_CloseChunkArchive,
+	Call_CompactChunkArchive,
+	Call_BuildJobSeam,
+	Call_SetClipmapViewerMotion,
+	Call_GetClipmapPrefetchStats,
+	Call_SetMemoryBudget,
+	Call_GetMemoryUsage,
+	Call_SetMeshCacheCapacity,
+	Call_InvalidateMeshCache,
+	Call_MergeJobMeshes,
+	Call_EditDensity,
+	Call_ClearDensityEdits,
+	Call_GetDensityEditStats,
+	Call_LoadSignDag,
+	Call_UnloadSignDag,
+	Call_GetSignDagStats,
+
+	Call_Count
+};
+
+const char* RecordedCallName(int call);
+
+// ----------------------------------------------------------------------------
+
+// A trace is a TraceHeader followed by records, each a TraceRecordHeader and
+// payloadSize bytes of arguments then results in the order the export takes
+// them. Structs are stored as raw bytes so the header carries their sizes,
+// a trace can only be replayed by a build with the same layouts.
+const uint32_t TRACE_MAGIC = 0x52544344;	// "DCTR"
+const uint32_t TRACE_VERSION = 3;
+
+struct TraceHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	chunkDescSize;
+	uint32_t	densityParamsSize;
+	uint32_t	viewerParamsSize;
+	uint32_t	completedJobSize;
+	uint32_t	clipmapParamsSize;
+	uint32_t	clipmapEventSize;
+	uint32_t	contextStatsSize;
+	uint32_t	clipmapPrefetchStatsSize;
+	uint32_t	memoryUsageSize;
+	uint32_t	densityEditSize;
+	uint32_t	densityEditStatsSize;
+	uint32_t	signDagStatsSize;
+};
+
+struct TraceRecordHeader
+{
+	uint16_t	call;
+	uint16_t	thread;			// small per-thread index, in order of first call
+	uint32_t	context;		// 0 if the call has no context, else stable per context
+	int64_t		start;			// microseconds since recording started
+	int64_t		duration;		// microseconds spent inside the export
+	uint32_t	payloadSize;
+};
+
+TraceHeader CurrentTraceHeader();
+
+// ----------------------------------------------------------------------------
+
+// Records every exported call made while a recording is active. One recording
+// exists at a time and covers all contexts. Calls made by other exports (e.g.
+// GenerateChunkBatch submitting its batch) are not recorded separately.
+bool StartCallRecording(const char* path);
+void StopCallRecording();
+
+// Built on the stack at the top of each export, writes the record when it
+// goes out of scope. Does nothing (and allocates nothing) unless recording.
+class CallRecord
+{
+public:
+
+	CallRecord(const RecordedCall call, const GeneratorContext* context);
+	~CallRecord();
+
+	template <typename T>
+	CallRecord& operator<<(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain values can be recorded");
+		return bytes(&value, sizeof(T));
+	}
+
+	template <typename T>
+	CallRecord& array(const T* values, const int count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain values can be recorded");
+		*this << (int32_t)count;
+		return bytes(values, count > 0 ? count * sizeof(T) : 0);
+	}
+
+	CallRecord& string(const char* text);
+
+	// The context a CreateContext call produced
+	void setContext(const GeneratorContext* context);
+
+private:
+
+	CallRecord(const CallRecord&) = delete;
+	CallRecord& operator=(const CallRecord&) = delete;
+
+	CallRecord& bytes(const void* data, const size_t size);
+
+	bool						active_ = false;
+	RecordedCall				call_;
+	const GeneratorContext*		context_ = nullptr;
+	std::chrono::steady_clock::time_point start_;
+	std::vector<uint8_t>		payload_;
+};
+
+// ----------------------------------------------------------------------------
+
+// Reads a trace back, used by the replay tool
+class TraceReader
+{
+public:
+
+	~TraceReader();
+
+	bool open(const char* path, std::string& error);
+	bool next(TraceRecordHeader& record);
+
+	// Payload of the last record returned by next(), read in recorded order.
+	// Reading past the end leaves the value zeroed and sets the error flag.
+	template <typename T>
+	T read()
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read");
+		T value = T();
+		bytes(&value, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	std::vector<T> readArray()
+	{
+		const int count = read<int32_t>();
+		std::vector<T> values(count > 0 ? count : 0);
+		bytes(values.data(), values.size() * sizeof(T));
+		return values;
+	}
+
+	std::string readString();
+
+	bool payloadError() const { return payloadError_; }
+
+private:
+
+	void bytes(void* data, const size_t size);
+
+	FILE*					file_ = nullptr;
+	std::vector<uint8_t>	payload_;
+	size_t					offset_ = 0;
+	bool					payloadError_ = false;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CALL_RECORDER_H_BEEN_INCLUDED
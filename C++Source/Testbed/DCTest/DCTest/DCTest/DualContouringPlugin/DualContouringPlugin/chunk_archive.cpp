@@ -0,0 +1,845 @@
+#include "chunk_archive.h"
+#include "sparse_volume.h"
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------------------
+
+// File layout: ArchiveHeader, records from sizeof(ArchiveHeader) to dataEnd,
+// then indexCount IndexEntry structs if the archive was closed cleanly.
+// Offsets and counts are little endian, as written by the platforms we ship.
+const uint32_t ARCHIVE_MAGIC = 0x41434344;	// "DCCA"
+const uint32_t RECORD_MAGIC = 0x52434344;	// "DCCR"
+const uint32_t ARCHIVE_VERSION = 2;
+
+struct ArchiveHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	dataEnd;
+	uint64_t	indexOffset;	// 0 while records have been appended since the index was written
+	uint32_t	indexCount;
+	uint32_t	reserved;
+};
+
+// Followed by the vertex floats, indices, cell floats and seam voxels, padded
+// to 8 bytes. Seams depend on the neighbours so only the chunk's own mesh is
+// stored, the seam is rebuilt from the voxels.
+struct RecordHeader
+{
+	uint32_t	magic;
+	uint32_t	checksum;		// of the payload, only checked when recovering
+	ChunkArchiveKey key;
+	uint32_t	numVertexFloats;
+	uint32_t	numIndices;
+	uint32_t	numCellFloats;
+	uint32_t	numSeamVoxels;
+};
+
+struct IndexEntry
+{
+	ChunkArchiveKey key;
+	uint64_t	offset;
+};
+
+// Archives which are mostly superseded records are compacted when opened
+const uint64_t COMPACT_MIN_DEAD_BYTES = 16 * 1024 * 1024;
+
+// ----------------------------------------------------------------------------
+
+static uint64_t HashBytes(uint64_t hash, const void* data, const size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+// ----------------------------------------------------------------------------
+
+static uint32_t Checksum(const void* data, const size_t size)
+{
+	const uint64_t hash = HashBytes(0xcbf29ce484222325ULL, data, size);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// ----------------------------------------------------------------------------
+
+static uint64_t PayloadSize(const RecordHeader& header)
+{
+	return ((uint64_t)header.numVertexFloats + header.numIndices + header.numCellFloats) * 4 +
+		(uint64_t)header.numSeamVoxels * sizeof(SeamVoxel);
+}
+
+// ----------------------------------------------------------------------------
+
+static uint64_t RecordSize(const RecordHeader& header)
+{
+	return (sizeof(RecordHeader) + PayloadSize(header) + 7) & ~7ULL;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkArchiveKey MakeChunkArchiveKey(const ChunkRequest& request)
+{
+	ChunkArchiveKey key;
+	key.x = request.position.x;
+	key.y = request.position.y;
+	key.z = request.position.z;
+	key.size = request.size;
+	key.lod = request.lod;
+	key.pipeline = request.pipeline;
+
+	// both structs are plain 4 byte fields so there's no padding to hash
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = HashBytes(hash, &request.density.params, sizeof(request.density.params));
+	hash = HashBytes(hash, &request.octreeThreshold, sizeof(request.octreeThreshold));
+	hash = HashBytes(hash, &request.simplify, sizeof(request.simplify));
+
+	// edits only change the key of the chunks they reach, with the margin the
+	// normals sample beyond the chunk's faces
+	if (request.density.edits)
+	{
+		const int margin = (1 << request.lod) + 1;
+		const glm::ivec3 min = request.position - glm::ivec3(request.size / 2 + margin);
+		const glm::ivec3 max = request.position + glm::ivec3(request.size / 2 + margin);
+
+		const uint64_t edits = request.density.edits->hash(min, max);
+		if (edits != 0)
+		{
+			hash = HashBytes(hash, &edits, sizeof(edits));
+		}
+	}
+	key.paramsHash = hash;
+
+	return key;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t ChunkArchiveKeyHash::operator()(const ChunkArchiveKey& key) const
+{
+	return (size_t)HashBytes(key.paramsHash, &key, offsetof(ChunkArchiveKey, paramsHash));
+}
+
+// ----------------------------------------------------------------------------
+
+// The file handle and its read-only mapping. Only the records which were
+// complete when the file was mapped (mappedEnd) are read through the mapping,
+// anything appended since is picked up by remapping.
+struct ChunkArchive::Platform
+{
+#ifdef _WIN32
+	HANDLE				file = INVALID_HANDLE_VALUE;
+	HANDLE				mapping = nullptr;
+#else
+	int					file = -1;
+	uint64_t			mappedSize = 0;
+#endif
+	const uint8_t*		data = nullptr;
+	uint64_t			mappedEnd = 0;
+
+	~Platform()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+
+	bool open(const std::string& path)
+	{
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		return file != INVALID_HANDLE_VALUE;
+	}
+
+	void close()
+	{
+		unmap();
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+			file = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	bool readAt(void* buffer, const size_t size, const uint64_t offset)
+	{
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+		DWORD done = 0;
+		return ReadFile(file, buffer, (DWORD)size, &done, &overlapped) && done == size;
+	}
+
+	bool writeAt(const void* buffer, const size_t size, const uint64_t offset)
+	{
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+		DWORD done = 0;
+		return WriteFile(file, buffer, (DWORD)size, &done, &overlapped) && done == size;
+	}
+
+	uint64_t size()
+	{
+		LARGE_INTEGER size;
+		return GetFileSizeEx(file, &size) ? (uint64_t)size.QuadPart : 0;
+	}
+
+	// the file can't be cut while it's mapped
+	bool truncate(const uint64_t size)
+	{
+		unmap();
+
+		LARGE_INTEGER position;
+		position.QuadPart = (LONGLONG)size;
+		return SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+	}
+
+	bool map(const uint64_t end)
+	{
+		unmap();
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			return false;
+		}
+
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!data)
+		{
+			unmap();
+			return false;
+		}
+
+		mappedEnd = end;
+		return true;
+	}
+
+	void unmap()
+	{
+		if (data)
+		{
+			UnmapViewOfFile(data);
+			data = nullptr;
+		}
+
+		if (mapping)
+		{
+			CloseHandle(mapping);
+			mapping = nullptr;
+		}
+
+		mappedEnd = 0;
+	}
+
+	static bool replace(const std::string& from, const std::string& to)
+	{
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	}
+
+#else
+
+	bool open(const std::string& path)
+	{
+		file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		return file >= 0;
+	}
+
+	void close()
+	{
+		unmap();
+		if (file >= 0)
+		{
+			::close(file);
+			file = -1;
+		}
+	}
+
+	bool readAt(void* buffer, const size_t size, const uint64_t offset)
+	{
+		return pread(file, buffer, size, (off_t)offset) == (ssize_t)size;
+	}
+
+	bool writeAt(const void* buffer, const size_t size, const uint64_t offset)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+		size_t written = 0;
+		while (written < size)
+		{
+			const ssize_t count = pwrite(file, bytes + written, size - written, (off_t)(offset + written));
+			if (count <= 0)
+			{
+				return false;
+			}
+			written += count;
+		}
+
+		return true;
+	}
+
+	uint64_t size()
+	{
+		struct stat info;
+		return fstat(file, &info) == 0 ? (uint64_t)info.st_size : 0;
+	}
+
+	bool truncate(const uint64_t size)
+	{
+		unmap();
+		return ftruncate(file, (off_t)size) == 0;
+	}
+
+	bool map(const uint64_t end)
+	{
+		unmap();
+
+		const uint64_t fileSize = size();
+		void* view = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, file, 0);
+		if (view == MAP_FAILED)
+		{
+			return false;
+		}
+
+		data = static_cast<const uint8_t*>(view);
+		mappedSize = fileSize;
+		mappedEnd = end;
+		return true;
+	}
+
+	void unmap()
+	{
+		if (data)
+		{
+			munmap(const_cast<uint8_t*>(data), mappedSize);
+			data = nullptr;
+		}
+
+		mappedSize = 0;
+		mappedEnd = 0;
+	}
+
+	static bool replace(const std::string& from, const std::string& to)
+	{
+		return rename(from.c_str(), to.c_str()) == 0;
+	}
+
+#endif
+};
+
+// ----------------------------------------------------------------------------
+
+ChunkArchive::ChunkArchive(const std::string& path)
+	: path_(path)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkArchive::~ChunkArchive()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	closeFile();
+}
+
+// ----------------------------------------------------------------------------
+
+std::unique_ptr<ChunkArchive> ChunkArchive::open(const std::string& path)
+{
+	std::unique_ptr<ChunkArchive> archive(new ChunkArchive(path));
+
+	{
+		std::lock_guard<std::mutex> lock(archive->mutex_);
+		if (!archive->openFile())
+		{
+			return nullptr;
+		}
+	}
+
+	if (archive->deadBytes_ > archive->liveBytes_ && archive->deadBytes_ > COMPACT_MIN_DEAD_BYTES)
+	{
+		archive->compact();
+	}
+
+	return archive;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+bool ChunkArchive::openFile()
+{
+	platform_.reset(new Platform);
+	index_.clear();
+	dataEnd_ = sizeof(ArchiveHeader);
+	liveBytes_ = 0;
+	deadBytes_ = 0;
+	indexDirty_ = false;
+
+	if (!platform_->open(path_))
+	{
+		platform_.reset();
+		return false;
+	}
+
+	if (platform_->size() == 0)
+	{
+		ArchiveHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = ARCHIVE_MAGIC;
+		header.version = ARCHIVE_VERSION;
+		header.dataEnd = dataEnd_;
+		header.indexOffset = dataEnd_;
+
+		if (!platform_->writeAt(&header, sizeof(header), 0))
+		{
+			platform_.reset();
+			return false;
+		}
+	}
+
+	ArchiveHeader header;
+	if (!platform_->readAt(&header, sizeof(header), 0) || header.magic != ARCHIVE_MAGIC)
+	{
+		// never write over something which isn't ours
+		platform_.reset();
+		return false;
+	}
+
+	if (header.version != ARCHIVE_VERSION)
+	{
+		// an archive from an older build is only a cache, start it again
+		memset(&header, 0, sizeof(header));
+		header.magic = ARCHIVE_MAGIC;
+		header.version = ARCHIVE_VERSION;
+		header.dataEnd = dataEnd_;
+		header.indexOffset = dataEnd_;
+
+		if (!platform_->truncate(0) || !platform_->writeAt(&header, sizeof(header), 0))
+		{
+			platform_.reset();
+			return false;
+		}
+	}
+
+	const uint64_t fileSize = platform_->size();
+	if (!platform_->map(0))
+	{
+		platform_.reset();
+		return false;
+	}
+
+	const bool clean = header.indexOffset != 0 && header.indexOffset == header.dataEnd &&
+		header.dataEnd + (uint64_t)header.indexCount * sizeof(IndexEntry) == fileSize;
+	if (clean)
+	{
+		dataEnd_ = header.dataEnd;
+		if (readIndex())
+		{
+			platform_->mappedEnd = dataEnd_;
+			return true;
+		}
+
+		index_.clear();
+		liveBytes_ = 0;
+		deadBytes_ = 0;
+	}
+
+	// the last session didn't close the archive, rebuild the index from the
+	// records and drop whatever follows the last complete one
+	scanRecords();
+	platform_->mappedEnd = dataEnd_;
+	indexDirty_ = true;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_, the file is mapped and dataEnd_ is the header's
+bool ChunkArchive::readIndex()
+{
+	const ArchiveHeader* header = reinterpret_cast<const ArchiveHeader*>(platform_->data);
+	const IndexEntry* entries = reinterpret_cast<const IndexEntry*>(platform_->data + header->indexOffset);
+
+	for (uint32_t i = 0; i < header->indexCount; i++)
+	{
+		const IndexEntry& entry = entries[i];
+		if (entry.offset < sizeof(ArchiveHeader) || entry.offset + sizeof(RecordHeader) > dataEnd_)
+		{
+			return false;
+		}
+
+		const RecordHeader* record = reinterpret_cast<const RecordHeader*>(platform_->data + entry.offset);
+		Entry live;
+		live.offset = entry.offset;
+		live.size = RecordSize(*record);
+		if (record->magic != RECORD_MAGIC || live.offset + live.size > dataEnd_)
+		{
+			return false;
+		}
+
+		addEntry(entry.key, live);
+	}
+
+	// anything the index doesn't reach was superseded
+	deadBytes_ = dataEnd_ - sizeof(ArchiveHeader) - liveBytes_;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_, the whole file is mapped
+void ChunkArchive::scanRecords()
+{
+	const uint64_t fileSize = platform_->size();
+
+	uint64_t offset = sizeof(ArchiveHeader);
+	while (offset + sizeof(RecordHeader) <= fileSize)
+	{
+		const RecordHeader* record = reinterpret_cast<const RecordHeader*>(platform_->data + offset);
+		if (record->magic != RECORD_MAGIC)
+		{
+			break;
+		}
+
+		Entry entry;
+		entry.offset = offset;
+		entry.size = RecordSize(*record);
+		if (offset + entry.size > fileSize ||
+			Checksum(record + 1, (size_t)PayloadSize(*record)) != record->checksum)
+		{
+			break;
+		}
+
+		addEntry(record->key, entry);
+		offset += entry.size;
+	}
+
+	dataEnd_ = offset;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+void ChunkArchive::addEntry(const ChunkArchiveKey& key, const Entry& entry)
+{
+	auto iter = index_.find(key);
+	if (iter != end(index_))
+	{
+		liveBytes_ -= iter->second.size;
+		deadBytes_ += iter->second.size;
+		iter->second = entry;
+	}
+	else
+	{
+		index_.emplace(key, entry);
+	}
+
+	liveBytes_ += entry.size;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_, writes the index after the records and marks it valid
+bool ChunkArchive::writeIndex()
+{
+	std::vector<IndexEntry> entries;
+	entries.reserve(index_.size());
+	for (const auto& pair : index_)
+	{
+		IndexEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.key = pair.first;
+		entry.offset = pair.second.offset;
+		entries.push_back(entry);
+	}
+
+	// in file order, so reopening touches the records front to back
+	std::sort(begin(entries), end(entries), [](const IndexEntry& a, const IndexEntry& b) { return a.offset < b.offset; });
+
+	ArchiveHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_VERSION;
+	header.dataEnd = dataEnd_;
+	header.indexOffset = dataEnd_;
+	header.indexCount = (uint32_t)entries.size();
+
+	const size_t indexBytes = entries.size() * sizeof(IndexEntry);
+	if (!platform_->truncate(dataEnd_ + indexBytes) ||
+		(indexBytes > 0 && !platform_->writeAt(entries.data(), indexBytes, dataEnd_)) ||
+		!platform_->writeAt(&header, sizeof(header), 0))
+	{
+		return false;
+	}
+
+	indexDirty_ = false;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+bool ChunkArchive::remap(const uint64_t end)
+{
+	if (platform_->data && platform_->mappedEnd >= end)
+	{
+		return true;
+	}
+
+	return platform_->map(dataEnd_);
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+void ChunkArchive::closeFile()
+{
+	if (platform_ && indexDirty_)
+	{
+		writeIndex();
+	}
+
+	platform_.reset();
+}
+
+// ----------------------------------------------------------------------------
+
+bool ChunkArchive::load(const ChunkRequest& request, ChunkResult& result)
+{
+	const ChunkArchiveKey key = MakeChunkArchiveKey(request);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!platform_)
+		{
+			return false;
+		}
+
+		const auto iter = index_.find(key);
+		if (iter == end(index_) || !remap(iter->second.offset + iter->second.size))
+		{
+			return false;
+		}
+
+		const RecordHeader* record = reinterpret_cast<const RecordHeader*>(platform_->data + iter->second.offset);
+		const float* vertices = reinterpret_cast<const float*>(record + 1);
+		const int* indices = reinterpret_cast<const int*>(vertices + record->numVertexFloats);
+		const float* cells = reinterpret_cast<const float*>(indices + record->numIndices);
+		const SeamVoxel* seamVoxels = reinterpret_cast<const SeamVoxel*>(cells + record->numCellFloats);
+
+		result.vertices.assign(vertices, vertices + record->numVertexFloats);
+		result.indices.assign(indices, indices + record->numIndices);
+		result.cells.assign(cells, cells + record->numCellFloats);
+		result.seamVoxels.assign(seamVoxels, seamVoxels + record->numSeamVoxels);
+	}
+
+	// cheaper to rebuild than to store
+	BuildUnityMeshLayout(result);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Returns the end of the copy. An empty vector's data() may be null, which
+// memcpy doesn't accept even for 0 bytes.
+static uint8_t* CopyBytes(uint8_t* dest, const void* source, const size_t size)
+{
+	if (size > 0)
+	{
+		memcpy(dest, source, size);
+	}
+
+	return dest + size;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ChunkArchive::store(const ChunkRequest& request, const ChunkResult& result)
+{
+	// not worth the space, the bounds pass rebuilds these in microseconds
+	if (result.contents != ChunkContents_Surface)
+	{
+		return false;
+	}
+
+	RecordHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = RECORD_MAGIC;
+	header.key = MakeChunkArchiveKey(request);
+	header.numVertexFloats = (uint32_t)(result.seamFirstVertex >= 0 ? result.seamFirstVertex * 6 : result.vertices.size());
+	header.numIndices = (uint32_t)(result.seamFirstIndex >= 0 ? result.seamFirstIndex : result.indices.size());
+	header.numCellFloats = (uint32_t)result.cells.size();
+	header.numSeamVoxels = (uint32_t)result.seamVoxels.size();
+
+	// built outside the lock, only the write is serialised
+	const size_t size = (size_t)RecordSize(header);
+	std::vector<uint8_t> buffer(size, 0);
+	uint8_t* payload = buffer.data() + sizeof(RecordHeader);
+	payload = CopyBytes(payload, result.vertices.data(), header.numVertexFloats * sizeof(float));
+	payload = CopyBytes(payload, result.indices.data(), header.numIndices * sizeof(int));
+	payload = CopyBytes(payload, result.cells.data(), result.cells.size() * sizeof(float));
+	payload = CopyBytes(payload, result.seamVoxels.data(), result.seamVoxels.size() * sizeof(SeamVoxel));
+
+	const uint8_t* payloadStart = buffer.data() + sizeof(RecordHeader);
+	header.checksum = Checksum(payloadStart, payload - payloadStart);
+	memcpy(buffer.data(), &header, sizeof(header));
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!platform_)
+	{
+		return false;
+	}
+
+	if (!indexDirty_)
+	{
+		// the first record after the index was written overwrites it, so mark
+		// the index stale first in case the process dies before close
+		ArchiveHeader archiveHeader;
+		memset(&archiveHeader, 0, sizeof(archiveHeader));
+		archiveHeader.magic = ARCHIVE_MAGIC;
+		archiveHeader.version = ARCHIVE_VERSION;
+		archiveHeader.dataEnd = dataEnd_;
+		if (!platform_->writeAt(&archiveHeader, sizeof(archiveHeader), 0))
+		{
+			return false;
+		}
+
+		indexDirty_ = true;
+	}
+
+	if (!platform_->writeAt(buffer.data(), size, dataEnd_))
+	{
+		return false;
+	}
+
+	Entry entry;
+	entry.offset = dataEnd_;
+	entry.size = size;
+	addEntry(header.key, entry);
+	dataEnd_ += size;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ChunkArchive::compact()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!platform_)
+	{
+		return false;
+	}
+
+	if (deadBytes_ == 0)
+	{
+		return true;
+	}
+
+	if (!remap(dataEnd_))
+	{
+		return false;
+	}
+
+	// the live records in file order, copied into a new archive which then
+	// replaces this one
+	std::vector<std::pair<ChunkArchiveKey, Entry>> live(begin(index_), end(index_));
+	std::sort(begin(live), end(live), [](const std::pair<ChunkArchiveKey, Entry>& a, const std::pair<ChunkArchiveKey, Entry>& b)
+	{
+		return a.second.offset < b.second.offset;
+	});
+
+	const std::string compactPath = path_ + ".compact";
+	remove(compactPath.c_str());
+
+	std::unique_ptr<ChunkArchive> compacted(new ChunkArchive(compactPath));
+	compacted->platform_.reset(new Platform);
+	if (!compacted->platform_->open(compactPath))
+	{
+		return false;
+	}
+
+	uint64_t offset = sizeof(ArchiveHeader);
+	for (const auto& record : live)
+	{
+		if (!compacted->platform_->writeAt(platform_->data + record.second.offset, (size_t)record.second.size, offset))
+		{
+			compacted.reset();
+			remove(compactPath.c_str());
+			return false;
+		}
+
+		Entry entry;
+		entry.offset = offset;
+		entry.size = record.second.size;
+		compacted->addEntry(record.first, entry);
+		offset += entry.size;
+	}
+
+	compacted->dataEnd_ = offset;
+	if (!compacted->writeIndex())
+	{
+		compacted.reset();
+		remove(compactPath.c_str());
+		return false;
+	}
+
+	compacted.reset();
+
+	// both handles have to be closed before the rename on Windows
+	closeFile();
+	if (!Platform::replace(compactPath, path_))
+	{
+		remove(compactPath.c_str());
+	}
+
+	return openFile();
+}
+
+// ----------------------------------------------------------------------------
+
+int ChunkArchive::numChunks() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (int)index_.size();
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t ChunkArchive::liveBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return liveBytes_;
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t ChunkArchive::deadBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return deadBytes_;
+}
+
+// ----------------------------------------------------------------------------
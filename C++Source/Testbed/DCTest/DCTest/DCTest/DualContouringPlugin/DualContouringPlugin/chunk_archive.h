@@ -0,0 +1,111 @@
+#ifndef		HAS_CHUNK_ARCHIVE_H_BEEN_INCLUDED
+#define		HAS_CHUNK_ARCHIVE_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+// Identifies a generated chunk. paramsHash covers the density parameters and
+// the pipeline settings, so changing either misses instead of returning a
+// mesh built from different inputs.
+struct ChunkArchiveKey
+{
+	int32_t		x, y, z;
+	int32_t		size;
+	int32_t		lod;
+	int32_t		pipeline;
+	uint64_t	paramsHash;
+
+	bool operator==(const ChunkArchiveKey& other) const
+	{
+		return x == other.x && y == other.y && z == other.z && size == other.size &&
+			lod == other.lod && pipeline == other.pipeline && paramsHash == other.paramsHash;
+	}
+};
+
+ChunkArchiveKey MakeChunkArchiveKey(const ChunkRequest& request);
+
+struct ChunkArchiveKeyHash
+{
+	size_t operator()(const ChunkArchiveKey& key) const;
+};
+
+// ----------------------------------------------------------------------------
+
+// Persistent cache of generated chunks in a single memory-mapped file.
+//
+// Records are only ever appended, a chunk stored twice leaves the old record
+// dead in the file. The index (key -> record offset) is written after the
+// last record when the archive is closed, if it's missing or stale (the
+// process died) the records are scanned instead and the file is cut back to
+// the last complete one. Opening an archive which is mostly dead records
+// compacts it first, compact() can also be called directly.
+//
+// Lookups copy out of the mapping into the caller's ChunkResult, so a hit on
+// a chunk visited before costs a page fault and a memcpy rather than a
+// regeneration. All members are safe to call from any thread.
+class ChunkArchive
+{
+public:
+
+	~ChunkArchive();
+
+	// Creates the file if it doesn't exist. Returns null if the file can't be
+	// opened or isn't an archive.
+	static std::unique_ptr<ChunkArchive> open(const std::string& path);
+
+	bool load(const ChunkRequest& request, ChunkResult& result);
+
+	// Empty and solid chunks (see ClassifyChunk) aren't stored
+	bool store(const ChunkRequest& request, const ChunkResult& result);
+
+	// Rewrites the file with only the live records
+	bool compact();
+
+	int numChunks() const;
+	uint64_t liveBytes() const;
+	uint64_t deadBytes() const;
+
+private:
+
+	struct Entry
+	{
+		uint64_t	offset = 0;
+		uint64_t	size = 0;		// record header + payload
+	};
+
+	struct Platform;
+
+	explicit ChunkArchive(const std::string& path);
+	ChunkArchive(const ChunkArchive&) = delete;
+	ChunkArchive& operator=(const ChunkArchive&) = delete;
+
+	bool openFile();
+	bool readIndex();
+	void scanRecords();
+	bool writeIndex();
+	bool remap(const uint64_t size);
+	void closeFile();
+	void addEntry(const ChunkArchiveKey& key, const Entry& entry);
+
+	const std::string				path_;
+	std::unique_ptr<Platform>		platform_;
+
+	mutable std::mutex				mutex_;
+	std::unordered_map<ChunkArchiveKey, Entry, ChunkArchiveKeyHash> index_;
+	uint64_t						dataEnd_ = 0;
+	uint64_t						liveBytes_ = 0;
+	uint64_t						deadBytes_ = 0;
+	bool							indexDirty_ = false;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CHUNK_ARCHIVE_H_BEEN_INCLUDED
@@ -0,0 +1,424 @@
+#include "chunk_generator.h"
+
+#include "octree.h"
+#include "fast_dc.h"
+#include "heightfield.h"
+#include "sign_dag.h"
+
+// ----------------------------------------------------------------------------
+
+static bool IsCancelled(const std::atomic<bool>* cancel)
+{
+	return cancel && cancel->load();
+}
+
+// ----------------------------------------------------------------------------
+
+static void FlattenMeshBuffer(const MeshBuffer* buffer, ChunkResult& result)
+{
+	result.vertices.reserve(buffer->numVertices * 6);
+	for (int i = 0; i < buffer->numVertices; i++)
+	{
+		const MeshVertex& v = buffer->vertices[i];
+		result.vertices.push_back(v.xyz[0]);
+		result.vertices.push_back(v.xyz[1]);
+		result.vertices.push_back(v.xyz[2]);
+
+		result.vertices.push_back(v.normal[0]);
+		result.vertices.push_back(v.normal[1]);
+		result.vertices.push_back(v.normal[2]);
+	}
+
+	result.indices.reserve(buffer->numTriangles * 3);
+	for (int i = 0; i < buffer->numTriangles; i++)
+	{
+		result.indices.push_back(buffer->triangles[i].indices_[0]);
+		result.indices.push_back(buffer->triangles[i].indices_[1]);
+		result.indices.push_back(buffer->triangles[i].indices_[2]);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void TakeFastDCMesh(FastDCGenerator& generator, ChunkResult& result)
+{
+	MeshBuffer* buffer = generator.takeMesh();
+	if (!buffer)
+	{
+		return;
+	}
+
+	FlattenMeshBuffer(buffer, result);
+	result.cells.swap(generator.cells());
+	result.seamVoxels.swap(generator.seamVoxels());
+
+	free(buffer->vertices);
+	free(buffer->triangles);
+	delete buffer;
+}
+
+// ----------------------------------------------------------------------------
+
+bool WantsSimplification(const MeshSimplificationOptions& options)
+{
+	return options.targetPercentage < 1.f && options.maxIterations > 0;
+}
+
+// ----------------------------------------------------------------------------
+
+bool SimplifyChunkMesh(const ChunkRequest& request, ChunkResult& result)
+{
+	if (request.pipeline != Pipeline_FastDC || !WantsSimplification(request.simplify) || result.seamFirstVertex >= 0)
+	{
+		return false;
+	}
+
+	MeshBuffer buffer;
+	buffer.numVertices = result.numVertices();
+	buffer.numTriangles = (int)result.indices.size() / 3;
+
+	// a chunk only a voxel or two across can have vertices but no triangles,
+	// there's nothing to collapse (and no index data to copy)
+	if (buffer.numVertices == 0 || buffer.numTriangles == 0)
+	{
+		return false;
+	}
+
+	std::vector<MeshVertex> vertices(buffer.numVertices);
+	for (int i = 0; i < buffer.numVertices; i++)
+	{
+		const float* v = &result.vertices[i * 6];
+		vertices[i].xyz = vec4(v[0], v[1], v[2], 1.f);
+		vertices[i].normal = vec4(v[3], v[4], v[5], 0.f);
+		vertices[i].colour = vec4(0.f);
+	}
+
+	std::vector<MeshTriangle> triangles(buffer.numTriangles);
+	memcpy(triangles.data(), result.indices.data(), triangles.size() * sizeof(MeshTriangle));
+
+	buffer.vertices = vertices.data();
+	buffer.triangles = triangles.data();
+
+	// no offset, the vertices on the mesh's border are never collapsed and have
+	// to come back bit for bit to line up with the seams and the neighbours
+	const vec4 offset(0.f);
+
+	VertexData simplifiedVertices;
+	IndexBuffer simplifiedIndices, remap;
+	float debugVal = 0.f, debugVal2 = 0.f;
+	ngMeshSimplifier(&buffer, offset, request.simplify, simplifiedVertices, simplifiedIndices, debugVal, debugVal2, &remap);
+	if (simplifiedVertices.empty())
+	{
+		return false;
+	}
+
+	result.vertices.swap(simplifiedVertices);
+	result.indices.swap(simplifiedIndices);
+	for (SeamVoxel& voxel : result.seamVoxels)
+	{
+		if (voxel.vertex >= 0)
+		{
+			voxel.vertex = remap[voxel.vertex];
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t ChunkResult::memoryBytes() const
+{
+	return vertices.capacity() * sizeof(float) +
+		indices.capacity() * sizeof(int) +
+		indices16.capacity() * sizeof(uint16_t) +
+		subMeshes.capacity() * sizeof(SubMesh) +
+		cells.capacity() * sizeof(float) +
+		seamVoxels.capacity() * sizeof(SeamVoxel);
+}
+
+// ----------------------------------------------------------------------------
+
+bool IsValidChunkRequest(const ChunkRequest& request)
+{
+	if (request.pipeline != Pipeline_Octree && request.pipeline != Pipeline_FastDC && request.pipeline != Pipeline_Heightfield)
+	{
+		return false;
+	}
+
+	if (request.size <= 0 || request.lod < 0 || request.lod >= 31 || (request.size >> request.lod) < 1)
+	{
+		return false;
+	}
+
+	if (request.pipeline == Pipeline_Octree)
+	{
+		// the tree halves the chunk until it reaches the voxel size
+		const int voxels = request.size >> request.lod;
+		return (voxels << request.lod) == request.size && (voxels & (voxels - 1)) == 0;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t EstimateGenerationBytes(const ChunkRequest& request)
+{
+	const size_t voxels = (size_t)(request.size >> request.lod);
+	if (request.pipeline == Pipeline_Octree)
+	{
+		// uniform nodes are deleted as the tree is built, a height field
+		// leaves a couple of leaves per column plus their parents
+		const size_t leaves = 2 * voxels * voxels;
+		return leaves * (sizeof(OctreeNode) + sizeof(OctreeDrawInfo)) * 8 / 7;
+	}
+
+	if (request.pipeline == Pipeline_Heightfield)
+	{
+		return EstimateHeightfieldBytes(request);
+	}
+
+	return (voxels + 1) * (voxels + 1) * (voxels + 1) * sizeof(float);
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkContents ClassifyChunk(const ChunkRequest& request)
+{
+	// the box both pipelines sample, corners included
+	const glm::vec3 min(glm::ivec3(-request.size / 2) + request.position);
+	const glm::vec3 max = min + glm::vec3((float)request.size);
+
+	// exact where the signs are baked, a chunk which only comes near the
+	// surface is rejected as well
+	const SignDag* signs = Density_BakedSigns(request.density, glm::ivec3(min), glm::ivec3(max));
+	if (signs)
+	{
+		switch (signs->classify(glm::ivec3(min), glm::ivec3(max)))
+		{
+		case CornerSigns_Outside:
+			return ChunkContents_Empty;
+
+		case CornerSigns_Inside:
+			return ChunkContents_Solid;
+
+		default:
+			return ChunkContents_Surface;
+		}
+	}
+
+	const DensityRange range = Density_Range(request.density, min, max);
+	if (range.min >= 0.f)
+	{
+		return ChunkContents_Empty;
+	}
+
+	if (range.max < 0.f)
+	{
+		return ChunkContents_Solid;
+	}
+
+	return ChunkContents_Surface;
+}
+
+// ----------------------------------------------------------------------------
+
+static void AddToBounds(MeshBounds& bounds, const float* position)
+{
+	const glm::vec3 p(position[0], position[1], position[2]);
+	bounds.min = glm::min(bounds.min, p);
+	bounds.max = glm::max(bounds.max, p);
+}
+
+// ----------------------------------------------------------------------------
+
+static SubMesh MakeSubMesh(const ChunkResult& result, const int firstVertex, const int vertexCount, const int indexStart, const int indexCount)
+{
+	SubMesh subMesh;
+	subMesh.indexStart = indexStart;
+	subMesh.indexCount = indexCount;
+	subMesh.firstVertex = firstVertex;
+	subMesh.vertexCount = vertexCount;
+
+	// the seam also indexes the chunk's own vertices, so bound what's referenced
+	for (int i = indexStart; i < indexStart + indexCount; i++)
+	{
+		AddToBounds(subMesh.bounds, &result.vertices[result.indices[i] * 6]);
+	}
+
+	return subMesh;
+}
+
+// ----------------------------------------------------------------------------
+
+void BuildUnityMeshLayout(ChunkResult& result)
+{
+	const int numVertices = result.numVertices();
+
+	result.bounds = MeshBounds();
+	for (int i = 0; i < numVertices; i++)
+	{
+		AddToBounds(result.bounds, &result.vertices[i * 6]);
+	}
+
+	result.indices16.clear();
+	if (numVertices < 65536)
+	{
+		result.indices16.assign(begin(result.indices), end(result.indices));
+	}
+
+	result.subMeshes.clear();
+	if (result.seamFirstIndex < 0)
+	{
+		// the pipelines only produce a single submesh, its bounds match the mesh
+		SubMesh subMesh;
+		subMesh.indexStart = 0;
+		subMesh.indexCount = (int)result.indices.size();
+		subMesh.firstVertex = 0;
+		subMesh.vertexCount = numVertices;
+		subMesh.bounds = result.bounds;
+		result.subMeshes.push_back(subMesh);
+		return;
+	}
+
+	result.subMeshes.push_back(MakeSubMesh(result, 0, result.seamFirstVertex, 0, result.seamFirstIndex));
+	result.subMeshes.push_back(MakeSubMesh(result, 0, numVertices, result.seamFirstIndex, (int)result.indices.size() - result.seamFirstIndex));
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkGenerationTask::ChunkGenerationTask(const ChunkRequest& request, ChunkResult& result, const std::atomic<bool>* cancel)
+	: request_(request)
+	, result_(result)
+	, cancel_(cancel)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkGenerationTask::~ChunkGenerationTask()
+{
+}
+
+// ----------------------------------------------------------------------------
+
+bool ChunkGenerationTask::stepGenerate(const Clock::time_point& deadline)
+{
+	switch (request_.pipeline)
+	{
+	case Pipeline_Octree:
+		if (!octree_)
+		{
+			octree_.reset(new OctreeBuilder(request_.density, glm::ivec3(-request_.size / 2) + request_.position, request_.size, 1 << request_.lod, cancel_));
+		}
+
+		// contouring only walks the finished tree and isn't split up, it
+		// waits for the next step if building the tree used up this one
+		if (!octree_->step(deadline) || Clock::now() >= deadline)
+		{
+			return false;
+		}
+
+		if (!IsCancelled(cancel_))
+		{
+			// null when no voxel holds the surface
+			OctreeNode* root = octree_->takeRoot();
+			VertexBuffer verticies;
+			GenerateMeshFromOctree(root, verticies, result_.indices, result_.vertices);
+			DestroyOctree(root);
+		}
+
+		octree_.reset();
+		return true;
+
+	case Pipeline_Heightfield:
+		// a few hundred height samples, not worth splitting up
+		GenerateHeightfieldMesh(request_, result_, cancel_);
+		return true;
+
+	default:
+	case Pipeline_FastDC:
+		if (!fastDC_)
+		{
+			const int voxelSize = 1 << request_.lod;
+			fastDC_.reset(new FastDCGenerator(request_.density, request_.position.x, request_.position.y, request_.position.z, request_.size / voxelSize, voxelSize, cancel_));
+		}
+
+		if (!fastDC_->step(deadline))
+		{
+			return false;
+		}
+
+		TakeFastDCMesh(*fastDC_, result_);
+		fastDC_.reset();
+		return true;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool ChunkGenerationTask::step(const Clock::time_point& deadline)
+{
+	while (!finished())
+	{
+		if (IsCancelled(cancel_))
+		{
+			fastDC_.reset();
+			octree_.reset();
+			result_ = ChunkResult();
+			stage_ = Stage_Cancelled;
+			break;
+		}
+
+		switch (stage_)
+		{
+		case Stage_Bounds:
+			result_.contents = ClassifyChunk(request_);
+			break;
+
+		case Stage_Generate:
+			// an empty or solid chunk goes straight to the (empty) output
+			if (result_.contents == ChunkContents_Surface && !stepGenerate(deadline))
+			{
+				return false;
+			}
+			break;
+
+		case Stage_Simplify:
+			SimplifyChunkMesh(request_, result_);
+			break;
+
+		case Stage_Output:
+			BuildUnityMeshLayout(result_);
+			break;
+
+		default:
+			break;
+		}
+
+		// a cancel raised during the stage wins over its (partial) output
+		if (!IsCancelled(cancel_))
+		{
+			stage_ = (Stage)(stage_ + 1);
+		}
+
+		if (!finished() && Clock::now() >= deadline)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool GenerateChunk(const ChunkRequest& request, ChunkResult& result, const std::atomic<bool>* cancel)
+{
+	ChunkGenerationTask task(request, result, cancel);
+	task.step(ChunkGenerationTask::Clock::time_point::max());
+	return task.completed();
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,211 @@
+#ifndef		HAS_CHUNK_GENERATOR_H_BEEN_INCLUDED
+#define		HAS_CHUNK_GENERATOR_H_BEEN_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <float.h>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "mesh.h"
+#include "ng_mesh_simplify.h"
+#include "density.h"
+#include "fast_dc.h"
+
+// ----------------------------------------------------------------------------
+
+enum ChunkPipeline
+{
+	Pipeline_Octree,
+	Pipeline_FastDC,
+
+	// far field, 2D heights only, for chunks with no overhangs (see heightfield.h)
+	Pipeline_Heightfield,
+};
+
+// What the bounds pass found before any voxels were sampled. Values are shared
+// with the managed side (DualContouringDLL.ChunkContents).
+enum ChunkContents
+{
+	ChunkContents_Surface = 0,		// may hold a surface, the chunk was meshed
+	ChunkContents_Empty = 1,		// entirely outside the surface (air)
+	ChunkContents_Solid = 2,		// entirely inside the surface
+};
+
+// ----------------------------------------------------------------------------
+
+struct ChunkRequest
+{
+	glm::ivec3		position = glm::ivec3(0);
+	int				size = 16;
+	int				pipeline = Pipeline_FastDC;
+
+	// voxels are (1 << lod) units wide, size stays the chunk's extent in world units
+	int				lod = 0;
+
+	// octree pipeline only, passed through to BuildOctree
+	float			octreeThreshold = 1.f;
+
+	// fast_dc pipeline only, see SimplifyChunkMesh
+	MeshSimplificationOptions simplify;
+
+	// copied from the generator context when the request is submitted, so
+	// changing the context's density (or editing it) only affects chunks
+	// queued afterwards
+	DensityField	density;
+};
+
+// ----------------------------------------------------------------------------
+
+struct MeshBounds
+{
+	glm::vec3		min = glm::vec3(FLT_MAX);
+	glm::vec3		max = glm::vec3(-FLT_MAX);
+
+	bool empty() const { return min.x > max.x; }
+};
+
+// ----------------------------------------------------------------------------
+
+// Mirrors UnityEngine.Rendering.SubMeshDescriptor
+struct SubMesh
+{
+	int				indexStart = 0;
+	int				indexCount = 0;
+	int				firstVertex = 0;
+	int				vertexCount = 0;
+	MeshBounds		bounds;
+};
+
+// ----------------------------------------------------------------------------
+
+struct ChunkResult
+{
+	// interleaved as px, py, pz, nx, ny, nz per vertex, which is also the
+	// stream layout Unity's SetVertexBufferData expects for position + normal
+	VertexData		vertices;
+	IndexBuffer		indices;
+
+	// a copy of indices when the mesh has fewer than 65536 vertices, so the
+	// index buffer can be handed to Unity as IndexFormat.UInt16
+	std::vector<uint16_t> indices16;
+
+	MeshBounds		bounds;
+	std::vector<SubMesh> subMeshes;
+
+	// fast_dc only, the solved position of every active voxel (debug view)
+	VertexData		cells;
+
+	// fast_dc only, the voxels on the chunk's faces which seams with its
+	// neighbours are built from, see chunk_seams.h
+	std::vector<SeamVoxel> seamVoxels;
+
+	// where the seam's vertices and indices start, everything before is the
+	// chunk's own mesh. -1 until a seam is built.
+	int				seamFirstVertex = -1;
+	int				seamFirstIndex = -1;
+
+	// ChunkContents, an empty or solid chunk has no mesh
+	int				contents = ChunkContents_Surface;
+
+	int numVertices() const { return (int)vertices.size() / 6; }
+
+	// heap memory held by the buffers, as reported to the MemoryGovernor
+	size_t memoryBytes() const;
+};
+
+// Whether the pipelines can generate the request at all: a known pipeline, a
+// positive size, 0 <= lod < 31 and at least one voxel across. The octree
+// pipeline also needs a power of two voxels across, its leaves would miss the
+// voxel size otherwise. Values from the managed side are checked with this
+// before anything is queued.
+bool IsValidChunkRequest(const ChunkRequest& request);
+
+// Roughly the peak working memory of generating the chunk: the density lattice
+// for fast_dc, the surface leaves for the octree pipeline, the height grid for
+// heightfields
+size_t EstimateGenerationBytes(const ChunkRequest& request);
+
+// Bounds the density over the chunk (see Density_Range), in microseconds
+// rather than the milliseconds sampling the volume takes. A chunk which can't
+// be ruled out is ChunkContents_Surface even if it turns out to have no mesh.
+ChunkContents ClassifyChunk(const ChunkRequest& request);
+
+// Fills in indices16, bounds and subMeshes from the vertex/index data, the
+// seam (if there is one) is the second submesh
+void BuildUnityMeshLayout(ChunkResult& result);
+
+// Moves a finished fast_dc mesh, its cells and seam voxels into the result,
+// does nothing if the generator was cancelled
+void TakeFastDCMesh(FastDCGenerator& generator, ChunkResult& result);
+
+// Whether the options ask for any simplification at all: a targetPercentage
+// below 1 and at least one iteration. Unity's defaults (1, 10) leave it off.
+bool WantsSimplification(const MeshSimplificationOptions& options);
+
+// Runs ngMeshSimplifier over a fast_dc chunk's mesh when request.simplify
+// asks for it, before the Unity layout or a seam is built. The seam voxels
+// are remapped to the simplified vertices, a voxel whose vertex disappeared
+// gets its own vertex in the seam. Returns false if the mesh was left alone,
+// e.g. for the other pipelines or chunks too small for the simplifier.
+bool SimplifyChunkMesh(const ChunkRequest& request, ChunkResult& result);
+
+// ----------------------------------------------------------------------------
+
+class OctreeBuilder;
+
+// The pipeline for one chunk split into steps which can be spread over several
+// frames. step() runs until the deadline passes and returns true once the chunk
+// is finished or cancelled. The fast_dc pipeline stops partway through its
+// stages, the octree pipeline partway through building the tree and before
+// contouring it. Heightfields and simplifying a mesh run in one go.
+class ChunkGenerationTask
+{
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	// result must outlive the task, it's left empty if the task is cancelled
+	ChunkGenerationTask(const ChunkRequest& request, ChunkResult& result, const std::atomic<bool>* cancel = nullptr);
+	~ChunkGenerationTask();
+
+	bool step(const Clock::time_point& deadline);
+
+	bool finished() const { return stage_ == Stage_Done || stage_ == Stage_Cancelled; }
+	bool completed() const { return stage_ == Stage_Done; }
+
+private:
+
+	ChunkGenerationTask(const ChunkGenerationTask&) = delete;
+	ChunkGenerationTask& operator=(const ChunkGenerationTask&) = delete;
+
+	enum Stage
+	{
+		Stage_Bounds,
+		Stage_Generate,
+		Stage_Simplify,
+		Stage_Output,
+		Stage_Done,
+		Stage_Cancelled,
+	};
+
+	bool stepGenerate(const Clock::time_point& deadline);
+
+	ChunkRequest					request_;
+	ChunkResult&					result_;
+	const std::atomic<bool>*		cancel_ = nullptr;
+
+	Stage							stage_ = Stage_Bounds;
+	std::unique_ptr<FastDCGenerator> fastDC_;
+	std::unique_ptr<OctreeBuilder>	octree_;
+};
+
+// Runs the whole pipeline for one chunk. Returns false if the cancel flag was
+// raised before the chunk finished, in which case the result is left empty.
+bool GenerateChunk(const ChunkRequest& request, ChunkResult& result, const std::atomic<bool>* cancel = nullptr);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CHUNK_GENERATOR_H_BEEN_INCLUDED
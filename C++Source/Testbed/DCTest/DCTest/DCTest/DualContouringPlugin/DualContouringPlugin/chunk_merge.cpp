@@ -0,0 +1,348 @@
+#include "chunk_merge.h"
+
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+// ----------------------------------------------------------------------------
+
+// Forsyth's scoring, with the constants from the original write-up
+static const int CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+// ----------------------------------------------------------------------------
+
+// A vertex as it's written to the mesh, copies are bitwise identical
+struct WeldKey
+{
+	float		values[6];
+
+	bool operator==(const WeldKey& other) const
+	{
+		return memcmp(values, other.values, sizeof(values)) == 0;
+	}
+};
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey& key) const
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(key.values);
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < sizeof(key.values); i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+		}
+
+		return (size_t)hash;
+	}
+};
+
+
+// ----------------------------------------------------------------------------
+
+void MergeChunkMeshes(const ChunkRequest* const* requests, const ChunkResult* const* results, const int count, ChunkResult& merged, const bool optimizeVertexCache)
+{
+	merged = ChunkResult();
+	merged.contents = ChunkContents_Empty;
+
+	// min corner first, so a shared face's vertices go to the chunk below it
+	std::vector<int> order(count);
+	for (int i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+
+	std::sort(begin(order), end(order), [&](const int a, const int b)
+	{
+		const glm::ivec3& p = requests[a]->position;
+		const glm::ivec3& q = requests[b]->position;
+		return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+	});
+
+	// every vertex of every member, welded copies sharing one entry
+	VertexData vertices;
+	IndexBuffer indices;
+	std::unordered_map<WeldKey, int, WeldKeyHash> welded;
+	std::vector<int> remap;
+
+	for (const int member : order)
+	{
+		const ChunkResult& result = *results[member];
+		if (result.contents == ChunkContents_Surface)
+		{
+			merged.contents = ChunkContents_Surface;
+		}
+		else if (merged.contents != ChunkContents_Surface && result.contents == ChunkContents_Solid)
+		{
+			merged.contents = ChunkContents_Solid;
+		}
+
+		const int numVertices = result.numVertices();
+		remap.assign(numVertices, -1);
+		for (int v = 0; v < numVertices; v++)
+		{
+			const float* vertex = &result.vertices[v * 6];
+			WeldKey key;
+			memcpy(key.values, vertex, sizeof(key.values));
+
+			const auto inserted = welded.emplace(key, (int)vertices.size() / 6);
+			remap[v] = inserted.first->second;
+			if (inserted.second)
+			{
+				vertices.insert(end(vertices), vertex, vertex + 6);
+			}
+		}
+
+		for (size_t i = 0; i + 2 < result.indices.size(); i += 3)
+		{
+			const int a = remap[result.indices[i]];
+			const int b = remap[result.indices[i + 1]];
+			const int c = remap[result.indices[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				indices.insert(end(indices), { a, b, c });
+			}
+		}
+	}
+
+	const int numVertices = (int)vertices.size() / 6;
+	if (optimizeVertexCache)
+	{
+		OptimizeVertexCache(indices, numVertices);
+	}
+
+	// vertices in the order the triangles first use them, unused ones dropped
+	std::vector<int> compacted(numVertices, -1);
+	merged.indices.reserve(indices.size());
+	for (const int index : indices)
+	{
+		int& vertex = compacted[index];
+		if (vertex < 0)
+		{
+			vertex = merged.numVertices();
+			merged.vertices.insert(end(merged.vertices), &vertices[index * 6], &vertices[index * 6] + 6);
+		}
+
+		merged.indices.push_back(vertex);
+	}
+
+	BuildUnityMeshLayout(merged);
+}
+
+// ----------------------------------------------------------------------------
+
+// The two halves of a vertex's score, tabulated since they're looked up for
+// every vertex in the cache after every triangle
+class VertexScores
+{
+public:
+
+	VertexScores()
+	{
+		for (int i = 0; i < CACHE_SIZE; i++)
+		{
+			// the last triangle's vertices score the same whatever their
+			// order, so a strip isn't favoured over a fan
+			const float scaler = 1.f / (CACHE_SIZE - 3);
+			cache_[i] = i < 3 ? LAST_TRIANGLE_SCORE : powf(1.f - (i - 3) * scaler, CACHE_DECAY_POWER);
+		}
+
+		// vertices with few triangles left are finished off first
+		valence_[0] = 0.f;
+		for (int i = 1; i < MAX_VALENCE; i++)
+		{
+			valence_[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+		}
+	}
+
+	float operator()(const int cachePosition, const int activeTriangles) const
+	{
+		if (activeTriangles == 0)
+		{
+			return -1.f;
+		}
+
+		const float valence = activeTriangles < MAX_VALENCE ? valence_[activeTriangles] :
+			VALENCE_BOOST_SCALE * powf((float)activeTriangles, -VALENCE_BOOST_POWER);
+		return (cachePosition >= 0 ? cache_[cachePosition] : 0.f) + valence;
+	}
+
+private:
+
+	static const int MAX_VALENCE = 32;
+
+	float			cache_[CACHE_SIZE];
+	float			valence_[MAX_VALENCE];
+};
+
+// ----------------------------------------------------------------------------
+
+void OptimizeVertexCache(IndexBuffer& indices, const int numVertices)
+{
+	const int numTriangles = (int)indices.size() / 3;
+	if (numTriangles == 0)
+	{
+		return;
+	}
+
+	// each vertex's triangles, the first active[v] of them not emitted yet
+	std::vector<int> offsets(numVertices + 1, 0);
+	for (int i = 0; i < numTriangles * 3; i++)
+	{
+		offsets[indices[i] + 1]++;
+	}
+	for (int v = 0; v < numVertices; v++)
+	{
+		offsets[v + 1] += offsets[v];
+	}
+
+	std::vector<int> active(numVertices, 0);
+	std::vector<int> triangles(numTriangles * 3);
+	for (int i = 0; i < numTriangles * 3; i++)
+	{
+		const int v = indices[i];
+		triangles[offsets[v] + active[v]++] = i / 3;
+	}
+
+	static const VertexScores VertexScore;
+
+	std::vector<int> cachePosition(numVertices, -1);
+	std::vector<float> vertexScore(numVertices);
+	for (int v = 0; v < numVertices; v++)
+	{
+		vertexScore[v] = VertexScore(-1, active[v]);
+	}
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<bool> emitted(numTriangles, false);
+	for (int t = 0; t < numTriangles; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	IndexBuffer output;
+	output.reserve(indices.size());
+
+	std::vector<int> cache;
+	std::vector<int> nextCache;
+	int best = -1;
+	int scanFrom = 0;
+
+	for (int n = 0; n < numTriangles; n++)
+	{
+		if (best < 0)
+		{
+			// nothing in the cache has triangles left, start a new island
+			// from the best triangle anywhere
+			float bestScore = -1.f;
+			for (int t = scanFrom; t < numTriangles; t++)
+			{
+				if (!emitted[t] && triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+
+			while (scanFrom < numTriangles && emitted[scanFrom])
+			{
+				scanFrom++;
+			}
+		}
+
+		const int* corners = &indices[best * 3];
+		output.insert(end(output), corners, corners + 3);
+		emitted[best] = true;
+
+		for (int i = 0; i < 3; i++)
+		{
+			const int v = corners[i];
+			int* list = &triangles[offsets[v]];
+			const int last = --active[v];
+			std::swap(*std::find(list, list + last + 1, best), list[last]);
+		}
+
+		// the triangle's vertices move to the front, the rest shuffle back
+		nextCache.assign(corners, corners + 3);
+		for (const int v : cache)
+		{
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+			{
+				nextCache.push_back(v);
+			}
+		}
+
+		for (size_t i = 0; i < nextCache.size(); i++)
+		{
+			const int v = nextCache[i];
+			cachePosition[v] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+			vertexScore[v] = VertexScore(cachePosition[v], active[v]);
+		}
+
+		best = -1;
+		float bestScore = -1.f;
+		for (const int v : nextCache)
+		{
+			for (int i = 0; i < active[v]; i++)
+			{
+				const int t = triangles[offsets[v] + i];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+
+		if (nextCache.size() > (size_t)CACHE_SIZE)
+		{
+			nextCache.resize(CACHE_SIZE);
+		}
+		cache.swap(nextCache);
+	}
+
+	indices.swap(output);
+}
+
+// ----------------------------------------------------------------------------
+
+float AverageCacheMissRatio(const IndexBuffer& indices, const int numVertices, const int cacheSize)
+{
+	if (indices.size() < 3)
+	{
+		return 0.f;
+	}
+
+	std::vector<bool> cached(numVertices, false);
+	std::deque<int> fifo;
+	int misses = 0;
+
+	for (const int v : indices)
+	{
+		if (cached[v])
+		{
+			continue;
+		}
+
+		misses++;
+		cached[v] = true;
+		fifo.push_back(v);
+		if ((int)fifo.size() > cacheSize)
+		{
+			cached[fifo.front()] = false;
+			fifo.pop_front();
+		}
+	}
+
+	return (float)misses / (float)(indices.size() / 3);
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,35 @@
+#ifndef		HAS_CHUNK_MERGE_H_BEEN_INCLUDED
+#define		HAS_CHUNK_MERGE_H_BEEN_INCLUDED
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+// Combines finished chunks (seams included) into one mesh so a block of far
+// chunks costs one draw call instead of one each. The members are left alone,
+// unmerging is just dropping the merged mesh and showing them again.
+//
+// Vertices are welded where chunks duplicate each other's: the neighbour
+// vertices a seam copies in and the border vertices of heightfield chunks.
+// Only exact copies (position and normal) are welded, and the one kept belongs
+// to the chunk on the min side of the shared face, the chunk whose interior
+// the seam above it copied from. Vertices no triangle uses
+// (e.g. a heightfield's seam voxel vertices) are dropped and the rest are
+// ordered by first use. optimizeVertexCache reorders the triangles for the
+// post-transform cache first (Forsyth's linear-speed algorithm), which pays
+// off as the merged mesh is drawn for many frames.
+//
+// The result has a single submesh and no cells or seam voxels.
+void MergeChunkMeshes(const ChunkRequest* const* requests, const ChunkResult* const* results, const int count, ChunkResult& merged, const bool optimizeVertexCache);
+
+// Reorders the triangles of an index buffer to reuse the post-transform
+// vertex cache, see MergeChunkMeshes
+void OptimizeVertexCache(IndexBuffer& indices, const int numVertices);
+
+// Average number of vertices transformed per triangle with a FIFO cache of the
+// given size, 0.5 is the best a regular grid can do and 3 the worst
+float AverageCacheMissRatio(const IndexBuffer& indices, const int numVertices, const int cacheSize);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CHUNK_MERGE_H_BEEN_INCLUDED
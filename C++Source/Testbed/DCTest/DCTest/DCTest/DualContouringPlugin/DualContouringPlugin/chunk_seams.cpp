@@ -0,0 +1,348 @@
+#include "chunk_seams.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <unordered_map>
+
+// ----------------------------------------------------------------------------
+
+// The voxels sharing an edge along each axis, as offsets subtracted from the
+// edge's start corner. Matches EDGE_NODE_OFFSETS in fast_dc.cpp so seam quads
+// wind the same way as the chunk's own.
+static const glm::ivec3 EDGE_VOXEL_OFFSETS[3][4] =
+{
+	{ glm::ivec3(0), glm::ivec3(0, 0, 1), glm::ivec3(0, 1, 0), glm::ivec3(0, 1, 1) },
+	{ glm::ivec3(0), glm::ivec3(1, 0, 0), glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 1) },
+	{ glm::ivec3(0), glm::ivec3(0, 1, 0), glm::ivec3(1, 0, 0), glm::ivec3(1, 1, 0) },
+};
+
+// ----------------------------------------------------------------------------
+
+static int FloorDiv(const int a, const int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// ----------------------------------------------------------------------------
+
+// 21 bits per axis, chunk coordinates stay well inside +/- 1M world units
+static uint64_t PackPosition(const glm::ivec3& p)
+{
+	const uint64_t MASK = 0x1fffff;
+	const int BIAS = 1 << 20;
+	return (((uint64_t)(p.x + BIAS) & MASK) << 42) |
+		(((uint64_t)(p.y + BIAS) & MASK) << 21) |
+		((uint64_t)(p.z + BIAS) & MASK);
+}
+
+// ----------------------------------------------------------------------------
+
+// Every voxel the seam can reach, grouped by size so the voxel containing a
+// point is found with one lookup per size, smallest first
+class SeamVoxelLookup
+{
+public:
+
+	void add(const SeamVoxel& voxel, const bool own)
+	{
+		auto iter = std::find(begin(sizes_), end(sizes_), voxel.size);
+		if (iter == end(sizes_))
+		{
+			// few distinct sizes, normally one or two
+			iter = sizes_.insert(std::upper_bound(begin(sizes_), end(sizes_), voxel.size), voxel.size);
+			bySize_.insert(begin(bySize_) + (iter - begin(sizes_)), std::unordered_map<uint64_t, int>());
+		}
+
+		auto& voxels = bySize_[iter - begin(sizes_)];
+		if (voxels.emplace(PackPosition(voxel.min), (int)slots_.size()).second)
+		{
+			Slot slot;
+			slot.voxel = &voxel;
+			slot.vertex = own ? voxel.vertex : -1;
+			slots_.push_back(slot);
+		}
+	}
+
+	int smallestSize() const
+	{
+		return sizes_.empty() ? 0 : sizes_.front();
+	}
+
+	// point is in half units, so voxel centres and edge midpoints are whole
+	int find(const glm::ivec3& point) const
+	{
+		for (size_t i = 0; i < sizes_.size(); i++)
+		{
+			const int size = sizes_[i];
+			const glm::ivec3 min(
+				FloorDiv(point.x, 2 * size) * size,
+				FloorDiv(point.y, 2 * size) * size,
+				FloorDiv(point.z, 2 * size) * size);
+
+			const auto iter = bySize_[i].find(PackPosition(min));
+			if (iter != end(bySize_[i]))
+			{
+				return iter->second;
+			}
+		}
+
+		return -1;
+	}
+
+	int size(const int slot) const
+	{
+		return slots_[slot].voxel->size;
+	}
+
+	// the chunk's own voxels already have a vertex, a neighbour's is copied
+	// into the seam the first time it's used
+	int vertex(const int slot, VertexData& vertices)
+	{
+		Slot& entry = slots_[slot];
+		if (entry.vertex < 0)
+		{
+			entry.vertex = (int)vertices.size() / 6;
+			vertices.push_back(entry.voxel->position.x);
+			vertices.push_back(entry.voxel->position.y);
+			vertices.push_back(entry.voxel->position.z);
+			vertices.push_back(entry.voxel->normal.x);
+			vertices.push_back(entry.voxel->normal.y);
+			vertices.push_back(entry.voxel->normal.z);
+		}
+
+		return entry.vertex;
+	}
+
+private:
+
+	struct Slot
+	{
+		const SeamVoxel*	voxel = nullptr;
+		int					vertex = -1;
+	};
+
+	std::vector<int>		sizes_;
+	std::vector<std::unordered_map<uint64_t, int>> bySize_;
+	std::vector<Slot>		slots_;
+};
+
+// ----------------------------------------------------------------------------
+
+// Each corner is shared by up to four seam edges, sampled once
+class SeamDensityCache
+{
+public:
+
+	explicit SeamDensityCache(const DensityField& density)
+		: density_(density)
+	{
+	}
+
+	float sample(const glm::ivec3& corner)
+	{
+		const uint64_t key = PackPosition(corner);
+		const auto iter = samples_.find(key);
+		if (iter != end(samples_))
+		{
+			return iter->second;
+		}
+
+		const float value = Density_Func(density_, glm::vec3(corner));
+		samples_.emplace(key, value);
+		return value;
+	}
+
+private:
+
+	const DensityField&	density_;
+	std::unordered_map<uint64_t, float> samples_;
+};
+
+// ----------------------------------------------------------------------------
+
+static bool Touches(const SeamVoxel& voxel, const glm::ivec3& min, const glm::ivec3& max)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (voxel.min[axis] + voxel.size < min[axis] || voxel.min[axis] >= max[axis])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+static void AddTriangle(IndexBuffer& indices, const int a, const int b, const int c)
+{
+	// quads next to a coarser voxel share vertices, drop the collapsed half
+	if (a == b || b == c || a == c)
+	{
+		return;
+	}
+
+	indices.push_back(a);
+	indices.push_back(b);
+	indices.push_back(c);
+}
+
+// ----------------------------------------------------------------------------
+
+void RemoveChunkSeam(ChunkResult& result)
+{
+	if (result.seamFirstIndex < 0)
+	{
+		return;
+	}
+
+	result.vertices.resize(result.seamFirstVertex * 6);
+	result.indices.resize(result.seamFirstIndex);
+	result.seamFirstVertex = -1;
+	result.seamFirstIndex = -1;
+
+	BuildUnityMeshLayout(result);
+}
+
+// ----------------------------------------------------------------------------
+
+bool BuildChunkSeam(const ChunkRequest& request, ChunkResult& result, const ChunkResult* const* neighbours, const int numNeighbours)
+{
+	if (result.seamVoxels.empty())
+	{
+		return false;
+	}
+
+	if (result.seamFirstIndex >= 0)
+	{
+		result.vertices.resize(result.seamFirstVertex * 6);
+		result.indices.resize(result.seamFirstIndex);
+	}
+
+	result.seamFirstVertex = result.numVertices();
+	result.seamFirstIndex = (int)result.indices.size();
+
+	const glm::ivec3 chunkMin = request.position - glm::ivec3(request.size / 2);
+	const glm::ivec3 chunkMax = chunkMin + glm::ivec3(request.size);
+
+	SeamVoxelLookup lookup;
+	for (const auto& voxel : result.seamVoxels)
+	{
+		lookup.add(voxel, true);
+	}
+
+	// only the voxels below the chunk's min faces (and along them) can be
+	// reached, anything overlapping the chunk itself is ignored
+	for (int i = 0; i < numNeighbours; i++)
+	{
+		if (!neighbours[i] || neighbours[i] == &result)
+		{
+			continue;
+		}
+
+		for (const auto& voxel : neighbours[i]->seamVoxels)
+		{
+			const bool inside = glm::all(glm::greaterThanEqual(voxel.min, chunkMin));
+			if (!inside && Touches(voxel, chunkMin, chunkMax))
+			{
+				lookup.add(voxel, false);
+			}
+		}
+	}
+
+	SeamDensityCache density(request.density);
+	const int stride = lookup.smallestSize();
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const int u = (axis + 1) % 3;
+		const int v = (axis + 2) % 3;
+
+		// the lines of edges along this axis which lie on a min face, i.e.
+		// with either of the other two coordinates on the chunk's min corner
+		std::vector<glm::ivec2> lines;
+		for (int a = chunkMin[u]; a < chunkMax[u]; a += stride)
+		{
+			lines.push_back(glm::ivec2(a, chunkMin[v]));
+		}
+		for (int b = chunkMin[v] + stride; b < chunkMax[v]; b += stride)
+		{
+			lines.push_back(glm::ivec2(chunkMin[u], b));
+		}
+
+		for (const auto& line : lines)
+		{
+			for (int c = chunkMin[axis]; c < chunkMax[axis]; c += stride)
+			{
+				glm::ivec3 corner;
+				corner[axis] = c;
+				corner[u] = line.x;
+				corner[v] = line.y;
+
+				// the centres of the four voxels around the edge's first stride
+				int slots[4];
+				int smallest = INT_MAX;
+				bool found = true;
+				for (int i = 0; i < 4 && found; i++)
+				{
+					glm::ivec3 point = corner * 2;
+					point[axis] += stride;
+					point[u] += EDGE_VOXEL_OFFSETS[axis][i][u] ? -stride : stride;
+					point[v] += EDGE_VOXEL_OFFSETS[axis][i][v] ? -stride : stride;
+
+					slots[i] = lookup.find(point);
+					found = slots[i] >= 0;
+					if (found)
+					{
+						smallest = std::min(smallest, lookup.size(slots[i]));
+					}
+				}
+
+				if (!found)
+				{
+					continue;
+				}
+
+				// contoured at the smallest voxel's size, once, from its start
+				if (smallest > stride && c - FloorDiv(c, smallest) * smallest != 0)
+				{
+					continue;
+				}
+
+				glm::ivec3 end = corner;
+				end[axis] += smallest;
+
+				const float pDensity = density.sample(corner);
+				const float qDensity = density.sample(end);
+				const bool zeroCrossing = (pDensity >= 0.f) != (qDensity >= 0.f);
+				if (!zeroCrossing)
+				{
+					continue;
+				}
+
+				int edgeVoxels[4];
+				for (int i = 0; i < 4; i++)
+				{
+					edgeVoxels[i] = lookup.vertex(slots[i], result.vertices);
+				}
+
+				if (pDensity >= 0.f)
+				{
+					AddTriangle(result.indices, edgeVoxels[0], edgeVoxels[1], edgeVoxels[3]);
+					AddTriangle(result.indices, edgeVoxels[0], edgeVoxels[3], edgeVoxels[2]);
+				}
+				else
+				{
+					AddTriangle(result.indices, edgeVoxels[0], edgeVoxels[3], edgeVoxels[1]);
+					AddTriangle(result.indices, edgeVoxels[0], edgeVoxels[2], edgeVoxels[3]);
+				}
+			}
+		}
+	}
+
+	BuildUnityMeshLayout(result);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,30 @@
+#ifndef		HAS_CHUNK_SEAMS_H_BEEN_INCLUDED
+#define		HAS_CHUNK_SEAMS_H_BEEN_INCLUDED
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+// A fast_dc chunk contours the edges inside it, the edges on its three min
+// faces need voxels from the neighbours on those sides and are left for the
+// seam. Each chunk owns the seam on its min faces so every edge is contoured
+// exactly once across the world.
+//
+// The seam is built from the neighbours' SeamVoxels, which works across LODs:
+// edges are walked on the finest lattice of the voxels involved and each one
+// is contoured at the size of the smallest voxel touching it (the minimal edge
+// rule), so a quad shared with a coarser voxel collapses to a triangle rather
+// than leaving a crack. Only the seam is replaced, a neighbour changing LOD
+// costs a rebuild of the boundary and the chunk's own mesh is left alone.
+//
+// neighbours may hold any chunks, those not touching the min faces are
+// ignored. Returns false (leaving the result alone) if the chunk has no seam
+// voxels, i.e. it wasn't built by the fast_dc pipeline.
+bool BuildChunkSeam(const ChunkRequest& request, ChunkResult& result, const ChunkResult* const* neighbours, const int numNeighbours);
+
+// Drops the seam, leaving the chunk's own mesh
+void RemoveChunkSeam(ChunkResult& result);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CHUNK_SEAMS_H_BEEN_INCLUDED
@@ -0,0 +1,268 @@
+#include "chunk_stages.h"
+
+#include <chrono>
+
+#include "chunk_archive.h"
+#include "mesh_cache.h"
+#include "octree.h"
+#include "fast_dc.h"
+#include "heightfield.h"
+
+// ----------------------------------------------------------------------------
+
+static bool IsCancelled(const ChunkStageState& chunk)
+{
+	return chunk.cancel && chunk.cancel->load();
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStageState::ChunkStageState(const ChunkRequest& request, const std::atomic<bool>* cancel)
+	: request(request)
+	, cancel(cancel)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStageState::~ChunkStageState()
+{
+	DestroyOctree(octree);
+}
+
+// ----------------------------------------------------------------------------
+
+// Whether the pipeline stages still have a mesh to build
+static bool NeedsMesh(const ChunkStageState& chunk)
+{
+	return chunk.source == ChunkSource_Generated && chunk.result.contents == ChunkContents_Surface;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr MeshCacheLoadStage(const ChunkStagePtr& chunk)
+{
+	if (chunk->cache && !IsCancelled(*chunk) && chunk->cache->load(chunk->request, chunk->result))
+	{
+		chunk->source = ChunkSource_MeshCache;
+	}
+
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr ArchiveLoadStage(const ChunkStagePtr& chunk)
+{
+	if (chunk->source != ChunkSource_Generated || IsCancelled(*chunk))
+	{
+		return chunk;
+	}
+
+	if (chunk->archive && chunk->archive->load(chunk->request, chunk->result))
+	{
+		chunk->source = ChunkSource_Archive;
+	}
+
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr BoundsStage(const ChunkStagePtr& chunk)
+{
+	if (!IsCancelled(*chunk) && chunk->source == ChunkSource_Generated)
+	{
+		chunk->result.contents = ClassifyChunk(chunk->request);
+	}
+
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr FastDCStage(const ChunkStagePtr& chunk)
+{
+	if (!NeedsMesh(*chunk))
+	{
+		return chunk;
+	}
+
+	const ChunkRequest& request = chunk->request;
+	if (!chunk->fastDC)
+	{
+		const int voxelSize = 1 << request.lod;
+		chunk->fastDC.reset(new FastDCGenerator(request.density, request.position.x, request.position.y, request.position.z, request.size / voxelSize, voxelSize, chunk->cancel));
+	}
+
+	// the generator is dropped once it has nothing left to run, finished or
+	// cancelled, which is what ends the chain of FastDCStage calls
+	if (!chunk->fastDC->runStage())
+	{
+		if (chunk->fastDC->stage() == FastDCGenerator::Stage_Done)
+		{
+			TakeFastDCMesh(*chunk->fastDC, chunk->result);
+		}
+
+		chunk->fastDC.reset();
+	}
+
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool FastDCRunning(const ChunkStagePtr& chunk)
+{
+	return chunk->fastDC != nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr BuildOctreeStage(const ChunkStagePtr& chunk)
+{
+	if (IsCancelled(*chunk) || !NeedsMesh(*chunk))
+	{
+		return chunk;
+	}
+
+	const ChunkRequest& request = chunk->request;
+	chunk->octree = BuildOctree(request.density, glm::ivec3(-request.size / 2) + request.position, request.size, request.octreeThreshold, 1 << request.lod);
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr ContourOctreeStage(const ChunkStagePtr& chunk)
+{
+	if (!IsCancelled(*chunk) && chunk->octree)
+	{
+		VertexBuffer verticies;
+		GenerateMeshFromOctree(chunk->octree, verticies, chunk->result.indices, chunk->result.vertices);
+	}
+
+	DestroyOctree(chunk->octree);
+	chunk->octree = nullptr;
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr HeightfieldStage(const ChunkStagePtr& chunk)
+{
+	if (IsCancelled(*chunk) || !NeedsMesh(*chunk))
+	{
+		return chunk;
+	}
+
+	GenerateHeightfieldMesh(chunk->request, chunk->result, chunk->cancel);
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr SimplifyStage(const ChunkStagePtr& chunk)
+{
+	if (!IsCancelled(*chunk) && NeedsMesh(*chunk))
+	{
+		SimplifyChunkMesh(chunk->request, chunk->result);
+	}
+
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr OutputStage(const ChunkStagePtr& chunk)
+{
+	chunk->fastDC.reset();
+	if (IsCancelled(*chunk))
+	{
+		chunk->result = ChunkResult();
+		chunk->completed = false;
+		return chunk;
+	}
+
+	// a loaded result is already laid out
+	if (chunk->source == ChunkSource_Generated)
+	{
+		BuildUnityMeshLayout(chunk->result);
+	}
+
+	chunk->completed = true;
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+ChunkStagePtr ArchiveStoreStage(const ChunkStagePtr& chunk)
+{
+	if (chunk->completed && chunk->source == ChunkSource_Generated && chunk->archive)
+	{
+		chunk->archive->store(chunk->request, chunk->result);
+	}
+
+	return chunk;
+}
+
+// ----------------------------------------------------------------------------
+
+// Adds the time the stage takes to the chunk's total
+template <typename F>
+static std::function<ChunkStagePtr(const ChunkStagePtr&)> Timed(F stage)
+{
+	return [stage](const ChunkStagePtr& chunk)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const ChunkStagePtr next = stage(chunk);
+		chunk->microseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		return next;
+	};
+}
+
+// ----------------------------------------------------------------------------
+
+StageTask<ChunkStagePtr> ScheduleChunkStages(JobSystem& executor, const ChunkStagePtr& chunk)
+{
+	// the bounds pass is cheap enough to run inline with the first stage
+	const auto boundsAnd = [](ChunkStagePtr (*stage)(const ChunkStagePtr&))
+	{
+		return Timed([stage](const ChunkStagePtr& chunk) { return stage(BoundsStage(chunk)); });
+	};
+
+	// as is the cache lookup ahead of the archive read
+	StageTask<ChunkStagePtr> task = RunStage(executor, [chunk]() { return Timed(ArchiveLoadStage)(MeshCacheLoadStage(chunk)); });
+	switch (chunk->request.pipeline)
+	{
+	case Pipeline_Octree:
+		task = task
+			.then(boundsAnd(BuildOctreeStage))
+			.then(Timed(ContourOctreeStage));
+		break;
+
+	case Pipeline_Heightfield:
+		task = task.then(boundsAnd(HeightfieldStage));
+		break;
+
+	default:
+	case Pipeline_FastDC:
+		task = task
+			.then(boundsAnd(FastDCStage))
+			.thenWhile(Timed(FastDCStage), FastDCRunning);
+		break;
+	}
+
+	return task
+		.then(Timed(SimplifyStage))
+		.then(Timed(OutputStage))
+		.then(Timed(ArchiveStoreStage));
+}
+
+// ----------------------------------------------------------------------------
+
+StageTask<ChunkStagePtr> ScheduleChunkStages(JobSystem& executor, const ChunkRequest& request, const std::atomic<bool>* cancel)
+{
+	return ScheduleChunkStages(executor, std::make_shared<ChunkStageState>(request, cancel));
+}
+
+// ----------------------------------------------------------------------------
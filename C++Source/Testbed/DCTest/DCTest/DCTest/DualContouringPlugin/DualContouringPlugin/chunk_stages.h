@@ -0,0 +1,104 @@
+#ifndef		HAS_CHUNK_STAGES_H_BEEN_INCLUDED
+#define		HAS_CHUNK_STAGES_H_BEEN_INCLUDED
+
+#include <atomic>
+#include <memory>
+
+#include "chunk_generator.h"
+#include "stage_task.h"
+
+class ChunkArchive;
+class FastDCGenerator;
+class MeshCache;
+class OctreeNode;
+
+// ----------------------------------------------------------------------------
+
+enum ChunkSource
+{
+	ChunkSource_Generated,
+	ChunkSource_MeshCache,
+	ChunkSource_Archive,
+};
+
+// ----------------------------------------------------------------------------
+
+// Everything one chunk carries from stage to stage. Each stage takes and
+// returns the same pointer so they chain directly with StageTask::then.
+struct ChunkStageState
+{
+	ChunkStageState(const ChunkRequest& request, const std::atomic<bool>* cancel);
+	~ChunkStageState();
+
+	ChunkRequest				request;
+	ChunkResult					result;
+	const std::atomic<bool>*	cancel = nullptr;
+
+	// optional, both are checked before the chunk is generated and a
+	// generated chunk is written to the archive
+	MeshCache*					cache = nullptr;
+	std::shared_ptr<ChunkArchive> archive;
+
+	// the pipeline stages only run for ChunkSource_Generated, a loaded result
+	// is passed straight along
+	ChunkSource					source = ChunkSource_Generated;
+
+	// false until OutputStage has run on an uncancelled chunk
+	bool						completed = false;
+
+	// spent inside the chunk's stages, not waiting between them
+	long long					microseconds = 0;
+
+	std::unique_ptr<FastDCGenerator> fastDC;
+	OctreeNode*					octree = nullptr;
+};
+
+typedef std::shared_ptr<ChunkStageState> ChunkStagePtr;
+
+// ----------------------------------------------------------------------------
+
+// Load the chunk from the mesh cache or the archive if it's there, the stages
+// after them then only pass the result along
+ChunkStagePtr MeshCacheLoadStage(const ChunkStagePtr& chunk);
+ChunkStagePtr ArchiveLoadStage(const ChunkStagePtr& chunk);
+
+// Classifies the chunk with ClassifyChunk, the pipeline stages below do
+// nothing for an empty or solid chunk
+ChunkStagePtr BoundsStage(const ChunkStagePtr& chunk);
+
+// fast_dc, one call per generator stage (density, hermite, QEF, contour),
+// chained with StageTask::thenWhile until the generator is finished
+ChunkStagePtr FastDCStage(const ChunkStagePtr& chunk);
+
+// octree pipeline
+ChunkStagePtr BuildOctreeStage(const ChunkStagePtr& chunk);
+ChunkStagePtr ContourOctreeStage(const ChunkStagePtr& chunk);
+
+// heightfield pipeline, the whole chunk in one stage
+ChunkStagePtr HeightfieldStage(const ChunkStagePtr& chunk);
+
+// SimplifyChunkMesh, only does anything for fast_dc chunks which ask for it
+ChunkStagePtr SimplifyStage(const ChunkStagePtr& chunk);
+
+// Builds the Unity layout and marks the chunk completed, or clears the result
+// if the chunk was cancelled along the way
+ChunkStagePtr OutputStage(const ChunkStagePtr& chunk);
+
+// Writes a completed chunk which was generated (not loaded) to the archive
+ChunkStagePtr ArchiveStoreStage(const ChunkStagePtr& chunk);
+
+// ----------------------------------------------------------------------------
+
+// Queues the chunk's whole pipeline as a chain of stages, from the cache and
+// archive lookups to the archive write. The stages of different chunks
+// interleave on the workers, e.g. one chunk's archive read runs alongside
+// the QEF pass of another, and the chains can be joined with WhenAll. This is
+// how JobSystem's workers generate every chunk they dequeue.
+StageTask<ChunkStagePtr> ScheduleChunkStages(JobSystem& executor, const ChunkStagePtr& chunk);
+
+// As above for a request on its own, cancel is optional and must outlive the chain
+StageTask<ChunkStagePtr> ScheduleChunkStages(JobSystem& executor, const ChunkRequest& request, const std::atomic<bool>* cancel = nullptr);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CHUNK_STAGES_H_BEEN_INCLUDED
@@ -0,0 +1,779 @@
+#include "clipmap.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <stdlib.h>
+
+#include "generator_context.h"
+
+// ----------------------------------------------------------------------------
+
+// 4 bits of LOD and 20 bits per axis, far more chunks than any ring holds
+static uint64_t ChunkKey(const int lod, const glm::ivec3& coord)
+{
+	const uint64_t MASK = 0xfffff;
+	const int BIAS = 1 << 19;
+	return ((uint64_t)lod << 60) |
+		(((uint64_t)(coord.x + BIAS) & MASK) << 40) |
+		(((uint64_t)(coord.y + BIAS) & MASK) << 20) |
+		((uint64_t)(coord.z + BIAS) & MASK);
+}
+
+// ----------------------------------------------------------------------------
+
+static bool InsideBox(const glm::ivec3& p, const glm::ivec3& min, const glm::ivec3& max)
+{
+	return p.x >= min.x && p.y >= min.y && p.z >= min.z &&
+		p.x < max.x && p.y < max.y && p.z < max.z;
+}
+
+// ----------------------------------------------------------------------------
+
+static int FloorDiv(const int a, const int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// ----------------------------------------------------------------------------
+
+bool IsValidClipmapParams(const ClipmapParams& params)
+{
+	if (params.numLods < 1 || params.numLods > 16)
+	{
+		return false;
+	}
+
+	if (params.chunkSize <= 0 || params.chunkSize > (INT_MAX >> params.numLods))
+	{
+		return false;
+	}
+
+	if (params.halfExtent <= 0 || params.verticalHalfExtent < 0)
+	{
+		return false;
+	}
+
+	ChunkRequest request;
+	request.size = params.chunkSize;
+	request.lod = 0;
+	request.pipeline = params.pipeline;
+	return IsValidChunkRequest(request);
+}
+
+// ----------------------------------------------------------------------------
+
+ClipmapManager::ClipmapManager(GeneratorContext& context, const ClipmapParams& params)
+	: context_(context)
+	, params_(params)
+	, viewer_(0.f)
+	, velocity_(0.f)
+	, look_(0.f)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+void ClipmapManager::setViewer(const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& look)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	viewer_ = position;
+	velocity_ = velocity;
+	look_ = look;
+
+	// an update already queued picks up the latest position when it runs
+	if (shutdown_ || updatePosted_)
+	{
+		return;
+	}
+
+	updatePosted_ = true;
+	const auto self = shared_from_this();
+	context_.jobs().post([self]() { self->update(); });
+}
+
+// ----------------------------------------------------------------------------
+
+// Each ring is anchored to the position's chunk of the next LOD up, so its
+// edges (and the hole left for the finer ring) line up with coarser chunks
+void ClipmapManager::ringBoxes(const glm::vec3& position, std::vector<glm::ivec3>& ringMin, std::vector<glm::ivec3>& ringMax) const
+{
+	const glm::ivec3 extent(params_.halfExtent, params_.verticalHalfExtent, params_.halfExtent);
+	ringMin.resize(params_.numLods);
+	ringMax.resize(params_.numLods);
+
+	for (int lod = 0; lod < params_.numLods; lod++)
+	{
+		const float parentSize = (float)(params_.chunkSize << (lod + 1));
+		const glm::ivec3 parent = glm::ivec3(glm::floor(position / parentSize));
+		ringMin[lod] = 2 * (parent - extent);
+		ringMax[lod] = 2 * (parent + extent + 1);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void ClipmapManager::ringChunks(const std::vector<glm::ivec3>& ringMin, const std::vector<glm::ivec3>& ringMax, std::vector<Chunk>& chunks) const
+{
+	for (int lod = 0; lod < (int)ringMin.size(); lod++)
+	{
+		const glm::ivec3 holeMin = lod > 0 ? ringMin[lod - 1] / 2 : glm::ivec3(0);
+		const glm::ivec3 holeMax = lod > 0 ? ringMax[lod - 1] / 2 : glm::ivec3(0);
+
+		for (int z = ringMin[lod].z; z < ringMax[lod].z; z++)
+		for (int y = ringMin[lod].y; y < ringMax[lod].y; y++)
+		for (int x = ringMin[lod].x; x < ringMax[lod].x; x++)
+		{
+			const glm::ivec3 coord(x, y, z);
+			if (InsideBox(coord, holeMin, holeMax))
+			{
+				continue;
+			}
+
+			Chunk chunk;
+			chunk.lod = lod;
+			chunk.coord = coord;
+			chunks.push_back(chunk);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. False for chunks entirely behind the plane through the
+// viewer facing the look direction.
+bool ClipmapManager::aheadOfViewer(const Chunk& chunk) const
+{
+	if (glm::dot(look_, look_) <= 0.f)
+	{
+		return true;
+	}
+
+	const int size = params_.chunkSize << chunk.lod;
+	const glm::vec3 centre(chunk.coord * size + glm::ivec3(size / 2));
+	const float radius = size * 0.866025f;
+	return glm::dot(centre - viewer_, glm::normalize(look_)) >= -radius;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+void ClipmapManager::submitChunks(std::vector<Chunk>& chunks, const bool speculative)
+{
+	if (chunks.empty())
+	{
+		return;
+	}
+
+	const DensityField density = context_.densityField();
+
+	std::vector<ChunkRequest> requests(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		const int size = params_.chunkSize << chunks[i].lod;
+		ChunkRequest& request = requests[i];
+		request.position = chunks[i].coord * size + glm::ivec3(size / 2);
+		request.size = size;
+		request.lod = chunks[i].lod;
+		request.pipeline = params_.pipeline;
+
+		if (params_.heightfieldLod > 0 && chunks[i].lod >= params_.heightfieldLod)
+		{
+			const glm::vec3 min(chunks[i].coord * size);
+			if (Density_IsHeightfield(density, min, min + glm::vec3((float)size)))
+			{
+				request.pipeline = Pipeline_Heightfield;
+			}
+		}
+	}
+
+	std::vector<int> ids(chunks.size());
+	context_.submit(requests.data(), (int)requests.size(), ids.data(), speculative);
+
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		const uint64_t key = ChunkKey(chunks[i].lod, chunks[i].coord);
+		chunks[i].job = ids[i];
+		if (speculative)
+		{
+			chunks[i].lastPredicted = EvictionCandidate::Clock::now();
+			prefetched_[key] = chunks[i];
+		}
+		else
+		{
+			chunks_[key] = chunks[i];
+			pending_.insert(key);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void ClipmapManager::update()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	updatePosted_ = false;
+	if (shutdown_)
+	{
+		return;
+	}
+
+	std::vector<glm::ivec3> ringMin, ringMax;
+	ringBoxes(viewer_, ringMin, ringMax);
+
+	// where the rings will be if the viewer keeps going, only whole ring
+	// moves matter so most velocity changes leave these alone as well
+	std::vector<glm::ivec3> predictedMin, predictedMax;
+	const glm::vec3 ahead = velocity_ * params_.prefetchSeconds;
+	if (params_.prefetchSeconds > 0.f && glm::dot(ahead, ahead) > 0.f)
+	{
+		ringBoxes(viewer_ + ahead, predictedMin, predictedMax);
+	}
+
+	if (!rediff_ && ringMin == ringMin_ && ringMax == ringMax_ &&
+		predictedMin == predictedMin_ && predictedMax == predictedMax_)
+	{
+		return;
+	}
+
+	rediff_ = false;
+	ringMin_ = ringMin;
+	ringMax_ = ringMax;
+	predictedMin_ = predictedMin;
+	predictedMax_ = predictedMax;
+
+	JobSystem& jobs = context_.jobs();
+
+	std::vector<Chunk> ring;
+	ringChunks(ringMin, ringMax, ring);
+
+	std::unordered_set<uint64_t> wanted;
+	std::vector<Chunk> added;
+	for (const Chunk& chunk : ring)
+	{
+		const uint64_t key = ChunkKey(chunk.lod, chunk.coord);
+		wanted.insert(key);
+		if (chunks_.find(key) != end(chunks_))
+		{
+			continue;
+		}
+
+		// the prediction came true, the job is often finished already
+		const auto prefetched = prefetched_.find(key);
+		if (prefetched != end(prefetched_))
+		{
+			jobs.setSpeculative(prefetched->second.job, false);
+			chunks_[key] = prefetched->second;
+			pending_.insert(key);
+			prefetched_.erase(prefetched);
+			prefetchHits_++;
+			continue;
+		}
+
+		added.push_back(chunk);
+	}
+
+	std::vector<Chunk> predicted;
+	ringChunks(predictedMin, predictedMax, predicted);
+
+	std::unordered_set<uint64_t> expected;
+	for (const Chunk& chunk : predicted)
+	{
+		const uint64_t key = ChunkKey(chunk.lod, chunk.coord);
+		if (wanted.find(key) == end(wanted))
+		{
+			expected.insert(key);
+		}
+	}
+
+	for (auto iter = begin(chunks_); iter != end(chunks_);)
+	{
+		if (wanted.find(iter->first) != end(wanted))
+		{
+			++iter;
+			continue;
+		}
+
+		const Chunk& chunk = iter->second;
+		if (chunk.loaded)
+		{
+			// the mesh stays valid until the caller has seen the unload
+			touchBlock(chunk);
+			events_.push_back(makeEvent(ClipmapEvent_Unload, chunk));
+			numLoaded_--;
+			markSeams(chunk);
+		}
+		else if (expected.find(iter->first) != end(expected))
+		{
+			// left the rings but the viewer is heading back, keep it queued
+			jobs.setSpeculative(chunk.job, true);
+			prefetched_[iter->first] = chunk;
+			prefetched_[iter->first].lastPredicted = EvictionCandidate::Clock::now();
+			pending_.erase(iter->first);
+		}
+		else
+		{
+			jobs.cancel(chunk.job);
+			jobs.release(chunk.job);
+			pending_.erase(iter->first);
+		}
+
+		iter = chunks_.erase(iter);
+	}
+
+	// the prediction moved on, whatever it no longer covers was a wrong guess
+	const auto now = EvictionCandidate::Clock::now();
+	for (auto iter = begin(prefetched_); iter != end(prefetched_);)
+	{
+		if (expected.find(iter->first) != end(expected))
+		{
+			iter->second.lastPredicted = now;
+			++iter;
+			continue;
+		}
+
+		jobs.cancel(iter->second.job);
+		jobs.release(iter->second.job);
+		prefetchMisses_++;
+		iter = prefetched_.erase(iter);
+	}
+
+	submitChunks(added, false);
+
+	std::vector<Chunk> speculative;
+	for (const Chunk& chunk : predicted)
+	{
+		const uint64_t key = ChunkKey(chunk.lod, chunk.coord);
+		if (expected.find(key) != end(expected) && prefetched_.find(key) == end(prefetched_) &&
+			chunks_.find(key) == end(chunks_) && aheadOfViewer(chunk))
+		{
+			speculative.push_back(chunk);
+		}
+	}
+
+	submitChunks(speculative, true);
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+void ClipmapManager::pollPending()
+{
+	JobSystem& jobs = context_.jobs();
+	for (auto iter = begin(pending_); iter != end(pending_);)
+	{
+		Chunk& chunk = chunks_[*iter];
+		const int status = jobs.poll(chunk.job);
+		if (status == JobStatus_Pending || status == JobStatus_Running)
+		{
+			++iter;
+			continue;
+		}
+
+		if (status == JobStatus_Done)
+		{
+			chunk.loaded = true;
+			numLoaded_++;
+			touchBlock(chunk);
+			events_.push_back(makeEvent(ClipmapEvent_Load, chunk));
+			undrainedLoads_.insert(chunk.job);
+			staleSeams_.insert(*iter);
+			markSeams(chunk);
+		}
+		else
+		{
+			// cancelled from outside (e.g. the viewer's cancelDistance), the
+			// next update queues it again if it's still in range
+			jobs.release(chunk.job);
+			chunks_.erase(*iter);
+			rediff_ = true;
+		}
+
+		iter = pending_.erase(iter);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. Finds the loaded chunks at the LODs next to lod whose
+// box [min, max) has max >= lo and min <= hi on every axis.
+void ClipmapManager::findChunks(const int lod, const glm::ivec3& lo, const glm::ivec3& hi, std::vector<const Chunk*>& found) const
+{
+	for (int l = std::max(0, lod - 1); l <= std::min(params_.numLods - 1, lod + 1); l++)
+	{
+		const int size = params_.chunkSize << l;
+		const glm::ivec3 first(FloorDiv(lo.x + size - 1, size) - 1, FloorDiv(lo.y + size - 1, size) - 1, FloorDiv(lo.z + size - 1, size) - 1);
+		const glm::ivec3 last(FloorDiv(hi.x, size), FloorDiv(hi.y, size), FloorDiv(hi.z, size));
+
+		for (int z = first.z; z <= last.z; z++)
+		for (int y = first.y; y <= last.y; y++)
+		for (int x = first.x; x <= last.x; x++)
+		{
+			const auto iter = chunks_.find(ChunkKey(l, glm::ivec3(x, y, z)));
+			if (iter != end(chunks_) && iter->second.loaded)
+			{
+				found.push_back(&iter->second);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. A chunk's seam reaches into the chunks below its min
+// faces, so loading or unloading this chunk affects the ones above it.
+void ClipmapManager::markSeams(const Chunk& chunk)
+{
+	const int size = params_.chunkSize << chunk.lod;
+	const glm::ivec3 min = chunk.coord * size;
+
+	std::vector<const Chunk*> affected;
+	findChunks(chunk.lod, min + glm::ivec3(1), min + glm::ivec3(size), affected);
+	for (const Chunk* other : affected)
+	{
+		if (other != &chunk)
+		{
+			staleSeams_.insert(ChunkKey(other->lod, other->coord));
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+void ClipmapManager::buildSeams()
+{
+	JobSystem& jobs = context_.jobs();
+	std::vector<const Chunk*> neighbours;
+	std::vector<int> neighbourJobs;
+
+	for (const uint64_t key : staleSeams_)
+	{
+		const auto iter = chunks_.find(key);
+		if (iter == end(chunks_) || !iter->second.loaded)
+		{
+			continue;
+		}
+
+		const Chunk& chunk = iter->second;
+		const int size = params_.chunkSize << chunk.lod;
+		const glm::ivec3 min = chunk.coord * size;
+
+		neighbours.clear();
+		neighbourJobs.clear();
+		findChunks(chunk.lod, min, min + glm::ivec3(size - 1), neighbours);
+		for (const Chunk* neighbour : neighbours)
+		{
+			if (neighbour != &chunk)
+			{
+				neighbourJobs.push_back(neighbour->job);
+			}
+		}
+
+		// a chunk whose load is still queued is read with its seam anyway
+		if (jobs.buildSeam(chunk.job, neighbourJobs.data(), (int)neighbourJobs.size()) &&
+			undrainedLoads_.find(chunk.job) == end(undrainedLoads_))
+		{
+			touchBlock(chunk);
+			events_.push_back(makeEvent(ClipmapEvent_Seam, chunk));
+		}
+	}
+
+	staleSeams_.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. The chunk is about to load, unload or change its seam,
+// so the block it's in is unmerged ahead of that event and merged again later.
+void ClipmapManager::touchBlock(const Chunk& chunk)
+{
+	if (params_.mergeLod <= 0 || chunk.lod < params_.mergeLod)
+	{
+		return;
+	}
+
+	const int blockChunks = std::max(2, params_.mergeBlock);
+	Block block;
+	block.lod = chunk.lod;
+	block.coord = glm::ivec3(FloorDiv(chunk.coord.x, blockChunks), FloorDiv(chunk.coord.y, blockChunks), FloorDiv(chunk.coord.z, blockChunks));
+
+	const uint64_t key = ChunkKey(block.lod, block.coord);
+	const auto merged = merged_.find(key);
+	if (merged != end(merged_))
+	{
+		events_.push_back(makeEvent(ClipmapEvent_Unmerge, merged->second));
+		merged_.erase(merged);
+	}
+
+	dirtyBlocks_[key] = block;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_, after buildSeams. A block is merged once every chunk
+// of it in the rings has loaded and no chunk next to it is still generating,
+// since that chunk loading would change the block's seams straight away.
+void ClipmapManager::mergeBlocks()
+{
+	JobSystem& jobs = context_.jobs();
+	const int blockChunks = std::max(2, params_.mergeBlock);
+	std::vector<int> members;
+
+	for (auto iter = begin(dirtyBlocks_); iter != end(dirtyBlocks_);)
+	{
+		Block& block = iter->second;
+		const glm::ivec3 first = block.coord * blockChunks;
+
+		members.clear();
+		bool ready = true;
+		for (int z = 0; z < blockChunks && ready; z++)
+		for (int y = 0; y < blockChunks && ready; y++)
+		for (int x = 0; x < blockChunks && ready; x++)
+		{
+			const auto chunk = chunks_.find(ChunkKey(block.lod, first + glm::ivec3(x, y, z)));
+			if (chunk != end(chunks_))
+			{
+				ready = chunk->second.loaded;
+				members.push_back(chunk->second.job);
+			}
+		}
+
+		const int size = params_.chunkSize << block.lod;
+		const glm::ivec3 blockMin = first * size - glm::ivec3(1);
+		const glm::ivec3 blockMax = (first + glm::ivec3(blockChunks)) * size + glm::ivec3(1);
+		for (auto pending = begin(pending_); pending != end(pending_) && ready; ++pending)
+		{
+			const Chunk& chunk = chunks_[*pending];
+			const int chunkSize = params_.chunkSize << chunk.lod;
+			const glm::ivec3 chunkMin = chunk.coord * chunkSize;
+			ready = std::abs(chunk.lod - block.lod) > 1 ||
+				glm::any(glm::greaterThan(chunkMin, blockMax)) ||
+				glm::any(glm::lessThan(chunkMin + glm::ivec3(chunkSize), blockMin));
+		}
+
+		if (!ready)
+		{
+			++iter;
+			continue;
+		}
+
+		// a lone chunk is already a single draw
+		if (members.size() > 1)
+		{
+			block.job = jobs.merge(members.data(), (int)members.size(), true);
+			if (block.job != 0)
+			{
+				merged_[iter->first] = block;
+				events_.push_back(makeEvent(ClipmapEvent_Merge, block));
+			}
+		}
+
+		iter = dirtyBlocks_.erase(iter);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+ClipmapEvent ClipmapManager::makeEvent(const ClipmapEventType type, const Chunk& chunk) const
+{
+	const int size = params_.chunkSize << chunk.lod;
+	const glm::ivec3 position = chunk.coord * size + glm::ivec3(size / 2);
+
+	ClipmapEvent event;
+	event.type = type;
+	event.job = chunk.job;
+	event.lod = chunk.lod;
+	event.position[0] = position.x;
+	event.position[1] = position.y;
+	event.position[2] = position.z;
+	event.size = size;
+	return event;
+}
+
+// ----------------------------------------------------------------------------
+
+ClipmapEvent ClipmapManager::makeEvent(const ClipmapEventType type, const Block& block) const
+{
+	const int size = (params_.chunkSize << block.lod) * std::max(2, params_.mergeBlock);
+	const glm::ivec3 position = block.coord * size + glm::ivec3(size / 2);
+
+	ClipmapEvent event;
+	event.type = type;
+	event.job = block.job;
+	event.lod = block.lod;
+	event.position[0] = position.x;
+	event.position[1] = position.y;
+	event.position[2] = position.z;
+	event.size = size;
+	return event;
+}
+
+// ----------------------------------------------------------------------------
+
+int ClipmapManager::drainEvents(ClipmapEvent* events, int maxEvents)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (shutdown_)
+	{
+		return 0;
+	}
+
+	pollPending();
+	buildSeams();
+	mergeBlocks();
+
+	int count = 0;
+	while (count < maxEvents && !events_.empty())
+	{
+		const ClipmapEvent event = events_.front();
+		events_.pop_front();
+
+		if (event.type == ClipmapEvent_Load)
+		{
+			undrainedLoads_.erase(event.job);
+		}
+		else if (event.type == ClipmapEvent_Unload || event.type == ClipmapEvent_Unmerge)
+		{
+			context_.jobs().release(event.job);
+		}
+
+		events[count++] = event;
+	}
+
+	if (rediff_ && !updatePosted_)
+	{
+		updatePosted_ = true;
+		const auto self = shared_from_this();
+		context_.jobs().post([self]() { self->update(); });
+	}
+
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+
+int ClipmapManager::numChunks() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (int)chunks_.size();
+}
+
+// ----------------------------------------------------------------------------
+
+int ClipmapManager::numLoaded() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return numLoaded_;
+}
+
+// ----------------------------------------------------------------------------
+
+ClipmapPrefetchStats ClipmapManager::prefetchStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	ClipmapPrefetchStats stats;
+	stats.hits = prefetchHits_;
+	stats.misses = prefetchMisses_;
+	stats.numPrefetched = (int)prefetched_.size();
+	return stats;
+}
+
+// ----------------------------------------------------------------------------
+
+void ClipmapManager::shutdown()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	shutdown_ = true;
+
+	JobSystem& jobs = context_.jobs();
+	for (const auto& pair : chunks_)
+	{
+		jobs.cancel(pair.second.job);
+		jobs.release(pair.second.job);
+	}
+
+	for (const auto& pair : prefetched_)
+	{
+		jobs.cancel(pair.second.job);
+		jobs.release(pair.second.job);
+	}
+
+	for (const auto& pair : merged_)
+	{
+		jobs.release(pair.second.job);
+	}
+
+	// retired chunks and blocks whose unload was never drained still hold their job
+	for (const auto& event : events_)
+	{
+		if (event.type == ClipmapEvent_Unload || event.type == ClipmapEvent_Unmerge)
+		{
+			jobs.release(event.job);
+		}
+	}
+
+	chunks_.clear();
+	pending_.clear();
+	prefetched_.clear();
+	events_.clear();
+	staleSeams_.clear();
+	undrainedLoads_.clear();
+	merged_.clear();
+	dirtyBlocks_.clear();
+	numLoaded_ = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ClipmapManager::evictionCandidate(EvictionCandidate& candidate)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	JobSystem& jobs = context_.jobs();
+	const auto now = EvictionCandidate::Clock::now();
+	bool found = false;
+	float lowest = 0.f;
+
+	// chunks still generating aren't holding anything worth evicting yet
+	for (const auto& pair : prefetched_)
+	{
+		EvictionCandidate entry;
+		if (!jobs.footprint(pair.second.job, entry.bytes, entry.cost))
+		{
+			continue;
+		}
+
+		entry.id = pair.first;
+		entry.lastUsed = pair.second.lastPredicted;
+
+		const float score = MemoryGovernor::evictionScore(entry, now);
+		if (!found || score < lowest)
+		{
+			candidate = entry;
+			lowest = score;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+// ----------------------------------------------------------------------------
+
+void ClipmapManager::evict(const uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	const auto iter = prefetched_.find(id);
+	if (iter == end(prefetched_))
+	{
+		return;
+	}
+
+	// queued again if the prediction still covers it when the rings next move
+	context_.jobs().release(iter->second.job);
+	prefetched_.erase(iter);
+}
+
+// ----------------------------------------------------------------------------
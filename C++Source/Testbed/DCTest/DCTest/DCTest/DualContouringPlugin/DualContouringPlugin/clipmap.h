@@ -0,0 +1,223 @@
+#ifndef		HAS_CLIPMAP_H_BEEN_INCLUDED
+#define		HAS_CLIPMAP_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "chunk_generator.h"
+#include "memory_governor.h"
+
+class GeneratorContext;
+
+// ----------------------------------------------------------------------------
+
+// Shared with the managed side (DualContouringDLL.ClipmapParams)
+struct ClipmapParams
+{
+	// LOD 0 chunk extent in world units, chunks at LOD L are chunkSize << L
+	// wide with the same number of voxels
+	int				chunkSize = 32;
+	int				numLods = 4;
+
+	// each LOD covers 2 * (2 * halfExtent + 1) chunks along x/z and
+	// 2 * (2 * verticalHalfExtent + 1) along y, less the part the finer LOD covers
+	int				halfExtent = 2;
+	int				verticalHalfExtent = 1;
+
+	int				pipeline = Pipeline_FastDC;
+
+	// how far ahead the viewer's motion is extrapolated to prefetch the rings
+	// it's heading into, in seconds. 0 turns prefetching off.
+	float			prefetchSeconds = 0.f;
+
+	// chunks at this LOD and beyond use Pipeline_Heightfield wherever the
+	// volume has no overhangs (see Density_IsHeightfield), 0 never does
+	int				heightfieldLod = 0;
+
+	// at this LOD and beyond, each block of mergeBlock chunks a side is merged
+	// into a single mesh once all its chunks have loaded, see ClipmapEvent_Merge.
+	// 0 never merges, blocks smaller than 2 are taken as 2.
+	int				mergeLod = 0;
+	int				mergeBlock = 2;
+};
+
+// At most 16 LODs since chunk keys hold the LOD in 4 bits, the coarsest
+// ring's parent chunk (chunkSize << numLods) has to fit an int, rings need
+// at least one chunk either side of the viewer and the LOD 0 chunks have to
+// be valid requests for the pipeline (see IsValidChunkRequest)
+bool IsValidClipmapParams(const ClipmapParams& params);
+
+// ----------------------------------------------------------------------------
+
+// Shared with the managed side (DualContouringDLL.ClipmapPrefetchStats)
+struct ClipmapPrefetchStats
+{
+	long long		hits;			// prefetched chunks the rings went on to need
+	long long		misses;			// cancelled when the prediction moved elsewhere
+	int				numPrefetched;	// speculative chunks currently held
+};
+
+// ----------------------------------------------------------------------------
+
+enum ClipmapEventType
+{
+	ClipmapEvent_Load = 0,
+	ClipmapEvent_Unload = 1,
+	ClipmapEvent_Seam = 2,
+	ClipmapEvent_Merge = 3,
+	ClipmapEvent_Unmerge = 4,
+};
+
+// Shared with the managed side (DualContouringDLL.ClipmapEvent). The job's mesh
+// can be read as soon as the load event is seen and stays valid until the
+// chunk's unload event has been drained, the clipmap releases the job then.
+// fast_dc chunks carry a seam closing the cracks with their neighbours, a seam
+// event means a neighbour came or went and the mesh should be read again.
+//
+// Merge and unmerge events describe a block of chunks (position and size are
+// the block's) whose meshes were merged into the event's job. On a merge the
+// caller draws that mesh instead of the block's chunks of the event's LOD, on
+// an unmerge it draws the chunks again; the merged job is valid until the
+// unmerge has been drained. A block is unmerged before any event for one of
+// its chunks, so the chunks' own events are handled as usual.
+struct ClipmapEvent
+{
+	int				type;
+	int				job;
+	int				lod;
+	int				position[3];	// chunk centre, as in ChunkRequest
+	int				size;
+};
+
+// ----------------------------------------------------------------------------
+
+// Keeps nested rings of chunks around the viewer, one ring per LOD, each ring
+// snapped to the next LOD's chunk grid so the finer ring exactly fills the
+// hole in the coarser one. Moving the viewer posts an update to the job
+// system which diffs the rings, queues the chunks that came into range and
+// retires the ones which left. Callers only move the viewer and drain events.
+//
+// Prefetched chunks which have finished are offered to the MemoryGovernor,
+// the rings' own chunks belong to the caller until their unload is drained.
+class ClipmapManager : public std::enable_shared_from_this<ClipmapManager>, public MemoryConsumer
+{
+public:
+
+	ClipmapManager(GeneratorContext& context, const ClipmapParams& params);
+
+	// Cheap to call every frame, the rings only change when the viewer
+	// crosses a chunk boundary of the next LOD up.
+	//
+	// With prefetchSeconds set, the chunks of the rings around where the
+	// velocity puts the viewer that many seconds from now are queued as
+	// speculative jobs, behind every chunk the current rings need. Those
+	// entirely behind the look direction are skipped, they're only needed if
+	// the viewer turns round. A prefetched chunk moves into the rings (often
+	// already generated) once the viewer gets there and is cancelled as soon
+	// as the prediction no longer covers it. A zero velocity or look turns
+	// the respective part off.
+	void setViewer(const glm::vec3& position, const glm::vec3& velocity = glm::vec3(0.f), const glm::vec3& look = glm::vec3(0.f));
+
+	// Chunks which finished loading or left the rings since the last call, in
+	// the order it happened. Call from one thread.
+	int drainEvents(ClipmapEvent* events, int maxEvents);
+
+	// numChunks doesn't include prefetched chunks until the rings take them
+	int numChunks() const;
+	int numLoaded() const;
+	ClipmapPrefetchStats prefetchStats() const;
+
+	// Releases every chunk without unload events, the manager does nothing
+	// afterwards. Called by the context before the job system goes away.
+	void shutdown();
+
+	// MemoryConsumer, ids are chunk keys
+	bool evictionCandidate(EvictionCandidate& candidate) override;
+	void evict(const uint64_t id) override;
+
+private:
+
+	ClipmapManager(const ClipmapManager&) = delete;
+	ClipmapManager& operator=(const ClipmapManager&) = delete;
+
+	struct Chunk
+	{
+		int				job = 0;
+		int				lod = 0;
+		glm::ivec3		coord;			// in chunks of this LOD
+		bool			loaded = false;
+
+		// prefetched chunks only, the last update the prediction covered it
+		EvictionCandidate::Clock::time_point lastPredicted;
+	};
+
+	struct Block
+	{
+		int				job = 0;		// the merged mesh, 0 until merged
+		int				lod = 0;
+		glm::ivec3		coord;			// in blocks of this LOD
+	};
+
+	void update();
+	void ringBoxes(const glm::vec3& position, std::vector<glm::ivec3>& ringMin, std::vector<glm::ivec3>& ringMax) const;
+	void ringChunks(const std::vector<glm::ivec3>& ringMin, const std::vector<glm::ivec3>& ringMax, std::vector<Chunk>& chunks) const;
+	bool aheadOfViewer(const Chunk& chunk) const;
+	void submitChunks(std::vector<Chunk>& chunks, const bool speculative);
+	void pollPending();
+	void buildSeams();
+	void findChunks(const int lod, const glm::ivec3& lo, const glm::ivec3& hi, std::vector<const Chunk*>& found) const;
+	void markSeams(const Chunk& chunk);
+	void touchBlock(const Chunk& chunk);
+	void mergeBlocks();
+	ClipmapEvent makeEvent(const ClipmapEventType type, const Chunk& chunk) const;
+	ClipmapEvent makeEvent(const ClipmapEventType type, const Block& block) const;
+
+	GeneratorContext&				context_;
+	const ClipmapParams				params_;
+
+	mutable std::mutex				mutex_;
+	glm::vec3						viewer_;
+	glm::vec3						velocity_;
+	glm::vec3						look_;
+	bool							updatePosted_ = false;
+	bool							rediff_ = true;
+	bool							shutdown_ = false;
+
+	// the box each LOD covered at the last update, in chunks of that LOD
+	std::vector<glm::ivec3>			ringMin_;
+	std::vector<glm::ivec3>			ringMax_;
+
+	// the same for the predicted position, empty when not prefetching
+	std::vector<glm::ivec3>			predictedMin_;
+	std::vector<glm::ivec3>			predictedMax_;
+
+	std::unordered_map<uint64_t, Chunk> chunks_;
+	std::unordered_set<uint64_t>	pending_;
+
+	// speculative jobs for chunks on the predicted path, not in chunks_
+	std::unordered_map<uint64_t, Chunk> prefetched_;
+	long long						prefetchHits_ = 0;
+	long long						prefetchMisses_ = 0;
+	std::deque<ClipmapEvent>		events_;
+
+	// loaded chunks whose seam is out of date, rebuilt on the next drain
+	std::unordered_set<uint64_t>	staleSeams_;
+	std::unordered_set<int>			undrainedLoads_;
+	int								numLoaded_ = 0;
+
+	// merged blocks, and blocks whose chunks changed since they were last
+	// merged (or which have never been), retried on every drain
+	std::unordered_map<uint64_t, Block> merged_;
+	std::unordered_map<uint64_t, Block> dirtyBlocks_;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CLIPMAP_H_BEEN_INCLUDED
@@ -0,0 +1,86 @@
+#include "completion_queue.h"
+
+#include <stdint.h>
+
+// ----------------------------------------------------------------------------
+
+CompletionQueue::CompletionQueue(int capacity)
+{
+	size_t size = 2;
+	while (size < (size_t)capacity)
+	{
+		size <<= 1;
+	}
+
+	cells_.reset(new Cell[size]);
+	mask_ = size - 1;
+
+	// a cell is free for the producer at position p when sequence == p, and
+	// holds an entry for the consumer at position p when sequence == p + 1
+	for (size_t i = 0; i < size; i++)
+	{
+		cells_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool CompletionQueue::push(const CompletedJob& job)
+{
+	size_t position = enqueuePos_.load(std::memory_order_relaxed);
+	Cell* cell = nullptr;
+
+	for (;;)
+	{
+		cell = &cells_[position & mask_];
+		const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+		if (difference == 0)
+		{
+			if (enqueuePos_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// the consumer hasn't freed this cell yet, the queue is full
+			overflowed_.store(true);
+			return false;
+		}
+		else
+		{
+			position = enqueuePos_.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->job = job;
+	cell->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool CompletionQueue::peek(CompletedJob& job) const
+{
+	const Cell& cell = cells_[dequeuePos_ & mask_];
+	if (cell.sequence.load(std::memory_order_acquire) != dequeuePos_ + 1)
+	{
+		return false;
+	}
+
+	job = cell.job;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void CompletionQueue::pop()
+{
+	Cell& cell = cells_[dequeuePos_ & mask_];
+	cell.sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+	dequeuePos_++;
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+#ifndef		HAS_COMPLETION_QUEUE_H_BEEN_INCLUDED
+#define		HAS_COMPLETION_QUEUE_H_BEEN_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+
+// ----------------------------------------------------------------------------
+
+// Shared with the managed side (DualContouringDLL.CompletedJob)
+struct CompletedJob
+{
+	int		job;
+	int		status;		// JobStatus_Done, JobStatus_Cancelled or JobStatus_Failed
+	int		bytes;		// size of the vertex + index data, 0 if cancelled
+	int		contents;	// ChunkContents, an empty or solid chunk has no mesh to upload
+};
+
+// ----------------------------------------------------------------------------
+
+// Bounded lock-free queue of finished jobs, any number of threads push and a
+// single thread (the one driving the frame) consumes. Based on Dmitry Vyukov's
+// bounded MPMC queue with the consumer side simplified. Producers never wait:
+// when the queue is full the entry is dropped and the overflow flag is raised
+// so the consumer knows to fall back to polling its outstanding jobs.
+class CompletionQueue
+{
+public:
+
+	// capacity is rounded up to a power of two
+	explicit CompletionQueue(int capacity);
+
+	bool push(const CompletedJob& job);
+
+	// Consumer only, look at the oldest entry without removing it
+	bool peek(CompletedJob& job) const;
+	void pop();
+
+	// Returns and clears the overflow flag
+	bool overflowed() { return overflowed_.exchange(false); }
+
+private:
+
+	CompletionQueue(const CompletionQueue&) = delete;
+	CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+	struct Cell
+	{
+		std::atomic<size_t>	sequence;
+		CompletedJob		job;
+	};
+
+	std::unique_ptr<Cell[]>		cells_;
+	size_t						mask_ = 0;
+
+	// padded onto separate cache lines, producers and the consumer touch one
+	// each. Padding rather than alignas as the queue lives on the heap.
+	char						padding0_[64];
+	std::atomic<size_t>			enqueuePos_ { 0 };
+	char						padding1_[64];
+	size_t						dequeuePos_ = 0;
+	char						padding2_[64];
+	std::atomic<bool>			overflowed_ { false };
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_COMPLETION_QUEUE_H_BEEN_INCLUDED
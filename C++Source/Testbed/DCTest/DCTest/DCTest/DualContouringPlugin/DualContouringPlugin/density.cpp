@@ -1,11 +1,26 @@
 
 #include "density.h"
+#include "sparse_volume.h"
+#include "sign_dag.h"
 
 #include "glm/ext.hpp"
+#include <float.h>
+#include <string.h>
 using namespace glm;
 
 // ----------------------------------------------------------------------------
 
+static const float NOISE_SCALE = 1.f / 128.f;
+
+// glm::simplex stays inside [-1, 1], its gradient has been measured at just
+// under 7.4 and is rounded up to cover anything the measurement missed
+static const float SIMPLEX_MAX_SLOPE = 8.f;
+
+// Density_Range splits the footprint into this many columns per side
+static const int RANGE_COLUMNS = 4;
+
+// ----------------------------------------------------------------------------
+
 float Sphere(const vec3& worldPosition, const vec3& origin, float radius)
 {
 	return length(worldPosition - origin) - radius;
@@ -32,8 +47,7 @@ float FractalNoise(
 	const float persistence,
 	const vec2& position)
 {
-	const float SCALE = 1.f / 128.f;
-	vec2 p = position * SCALE;
+	vec2 p = position * NOISE_SCALE;
 	float noise = 0.f;
 
 	float amplitude = 1.f;
@@ -52,16 +66,268 @@ float FractalNoise(
 
 // ----------------------------------------------------------------------------
 
-float Density_Func(const vec3& worldPosition)
+float Density_Func(const DensityParams& params, const vec3& worldPosition)
 {
-	const float MAX_HEIGHT = 20.f;
-	const float noise = FractalNoise(4, 0.5343f, 2.2324f, 0.68324f, vec2(worldPosition.x, worldPosition.z));
-	const float noiseScale = 0.0f;
-	const float terrain = worldPosition.y - (MAX_HEIGHT * noise*noiseScale);
+	const float noise = FractalNoise(params.noiseOctaves, params.noiseFrequency, params.noiseLacunarity, params.noisePersistence, vec2(worldPosition.x, worldPosition.z));
+	const float terrain = worldPosition.y - (params.maxHeight * noise * params.noiseScale);
+
+	if (params.sphereRadius <= 0.f)
+	{
+		return terrain;
+	}
 
 	const float cube = Cuboid(worldPosition, vec3(-4., 10.f, -4.f), vec3(12.f));
-	const float sphere = Sphere(worldPosition, vec3(0.f, 0.f, 0.f), 6.f);
+	const float sphere = Sphere(worldPosition, params.sphereOrigin, params.sphereRadius);
 	//return sphere;
 	return min(terrain, sphere);
 	return max(-cube, min(sphere, terrain));
-}
\ No newline at end of file
+}
+
+// ----------------------------------------------------------------------------
+
+float Density_Func(const DensityField& field, const vec3& worldPosition)
+{
+	float density;
+	if (field.edits && field.edits->sample(worldPosition, density))
+	{
+		return density;
+	}
+
+	return Density_Func(field.params, worldPosition);
+}
+
+// ----------------------------------------------------------------------------
+
+// Bounds of FractalNoise over a disc, from one simplex sample per octave at its
+// centre. An octave which could swing through its whole range across the disc
+// is bounded by its amplitude alone and not sampled at all.
+static void FractalNoiseRange(const DensityParams& params, const vec2& centre, const float radius, float& noiseMin, float& noiseMax)
+{
+	vec2 p = centre * NOISE_SCALE;
+	float r = radius * NOISE_SCALE;
+	float amplitude = 1.f;
+	float low = 0.f;
+	float high = 0.f;
+
+	p *= params.noiseFrequency;
+	r *= abs(params.noiseFrequency);
+
+	for (int i = 0; i < params.noiseOctaves; i++)
+	{
+		float octaveMin = -1.f;
+		float octaveMax = 1.f;
+
+		const float change = SIMPLEX_MAX_SLOPE * r;
+		if (change < 2.f)
+		{
+			const float value = simplex(p);
+			octaveMin = max(value - change, -1.f);
+			octaveMax = min(value + change, 1.f);
+		}
+
+		// a negative persistence flips every other octave
+		low += min(octaveMin * amplitude, octaveMax * amplitude);
+		high += max(octaveMin * amplitude, octaveMax * amplitude);
+
+		p *= params.noiseLacunarity;
+		r *= abs(params.noiseLacunarity);
+		amplitude *= params.noisePersistence;
+	}
+
+	noiseMin = 0.5f + (0.5f * low);
+	noiseMax = 0.5f + (0.5f * high);
+}
+
+// ----------------------------------------------------------------------------
+
+static DensityRange SphereRange(const vec3& boxMin, const vec3& boxMax, const vec3& origin, float radius)
+{
+	const vec3 nearest = max(max(boxMin - origin, origin - boxMax), vec3(0.f));
+	const vec3 furthest = max(abs(boxMin - origin), abs(boxMax - origin));
+
+	DensityRange range;
+	range.min = length(nearest) - radius;
+	range.max = length(furthest) - radius;
+	return range;
+}
+
+// ----------------------------------------------------------------------------
+
+DensityRange Density_Range(const DensityParams& params, const vec3& boxMin, const vec3& boxMax)
+{
+	const float heightScale = params.maxHeight * params.noiseScale;
+	const vec2 footprintMin(boxMin.x, boxMin.z);
+	const vec2 columnSize = (vec2(boxMax.x, boxMax.z) - footprintMin) / (float)RANGE_COLUMNS;
+	const float columnRadius = 0.5f * length(columnSize);
+
+	DensityRange range;
+	range.min = FLT_MAX;
+	range.max = -FLT_MAX;
+
+	for (int i = 0; i < RANGE_COLUMNS; i++)
+	for (int j = 0; j < RANGE_COLUMNS; j++)
+	{
+		const vec2 columnMin = footprintMin + (columnSize * vec2(i, j));
+
+		float noiseMin, noiseMax;
+		FractalNoiseRange(params, columnMin + (columnSize * 0.5f), columnRadius, noiseMin, noiseMax);
+
+		const float heightMin = min(heightScale * noiseMin, heightScale * noiseMax);
+		const float heightMax = max(heightScale * noiseMin, heightScale * noiseMax);
+
+		DensityRange column;
+		column.min = boxMin.y - heightMax;
+		column.max = boxMax.y - heightMin;
+
+		if (params.sphereRadius > 0.f)
+		{
+			const vec3 columnBoxMin(columnMin.x, boxMin.y, columnMin.y);
+			const vec3 columnBoxMax(columnMin.x + columnSize.x, boxMax.y, columnMin.y + columnSize.y);
+			const DensityRange sphere = SphereRange(columnBoxMin, columnBoxMax, params.sphereOrigin, params.sphereRadius);
+
+			// the union, as Density_Func takes the min of the two
+			column.min = min(column.min, sphere.min);
+			column.max = min(column.max, sphere.max);
+		}
+
+		range.min = min(range.min, column.min);
+		range.max = max(range.max, column.max);
+	}
+
+	// Density_Func's own rounding, relative to the magnitudes involved
+	const float extent = max(max(abs(boxMin.x), abs(boxMax.x)), max(max(abs(boxMin.y), abs(boxMax.y)), max(abs(boxMin.z), abs(boxMax.z))));
+	const float epsilon = 1e-4f * (1.f + abs(heightScale) + extent + max(params.sphereRadius, 0.f));
+	range.min -= epsilon;
+	range.max += epsilon;
+	return range;
+}
+
+// ----------------------------------------------------------------------------
+
+// The voxels whose stored values a sample inside the box can interpolate
+static void EditedVoxels(const vec3& boxMin, const vec3& boxMax, ivec3& min, ivec3& max)
+{
+	min = ivec3(floor(boxMin));
+	max = ivec3(floor(boxMax)) + ivec3(1);
+}
+
+// ----------------------------------------------------------------------------
+
+DensityRange Density_Range(const DensityField& field, const vec3& boxMin, const vec3& boxMax)
+{
+	if (!field.edits)
+	{
+		return Density_Range(field.params, boxMin, boxMax);
+	}
+
+	ivec3 min, max;
+	EditedVoxels(boxMin, boxMax, min, max);
+
+	DensityRange range;
+	bool covered = false;
+	if (!field.edits->range(min, max, range, covered))
+	{
+		return Density_Range(field.params, boxMin, boxMax);
+	}
+
+	if (!covered)
+	{
+		const DensityRange procedural = Density_Range(field.params, boxMin, boxMax);
+		range.min = glm::min(range.min, procedural.min);
+		range.max = glm::max(range.max, procedural.max);
+	}
+
+	return range;
+}
+
+// ----------------------------------------------------------------------------
+
+float Density_Height(const DensityParams& params, const vec2& column)
+{
+	const float noise = FractalNoise(params.noiseOctaves, params.noiseFrequency, params.noiseLacunarity, params.noisePersistence, column);
+	return params.maxHeight * noise * params.noiseScale;
+}
+
+// ----------------------------------------------------------------------------
+
+bool Density_IsHeightfield(const DensityParams& params, const vec3& boxMin, const vec3& boxMax)
+{
+	if (params.sphereRadius <= 0.f)
+	{
+		return true;
+	}
+
+	// the union only differs from the terrain where the sphere is inside
+	const DensityRange sphere = SphereRange(boxMin, boxMax, params.sphereOrigin, params.sphereRadius);
+	return sphere.min > 1e-4f * (1.f + params.sphereRadius);
+}
+
+// ----------------------------------------------------------------------------
+
+bool Density_IsHeightfield(const DensityField& field, const vec3& boxMin, const vec3& boxMax)
+{
+	if (!Density_IsHeightfield(field.params, boxMin, boxMax))
+	{
+		return false;
+	}
+
+	ivec3 min, max;
+	EditedVoxels(boxMin, boxMax, min, max);
+
+	DensityRange range;
+	bool covered = false;
+	return !field.edits || !field.edits->range(min, max, range, covered);
+}
+
+// ----------------------------------------------------------------------------
+
+const SignDag* Density_BakedSigns(const DensityField& field, const ivec3& min, const ivec3& max)
+{
+	if (!field.signs || !field.signs->contains(min, max) || !field.signs->matches(field.params))
+	{
+		return nullptr;
+	}
+
+	if (field.edits)
+	{
+		ivec3 editMin, editMax;
+		EditedVoxels(vec3(min), vec3(max), editMin, editMax);
+
+		DensityRange range;
+		bool covered = false;
+		if (field.edits->range(editMin, editMax, range, covered))
+		{
+			return nullptr;
+		}
+	}
+
+	return field.signs.get();
+}
+
+// ----------------------------------------------------------------------------
+
+bool GetDensityPreset(const char* name, DensityParams& params)
+{
+	DensityParams preset;
+	if (strcmp(name, "hills") == 0)
+	{
+		preset.noiseScale = 1.f;
+		preset.sphereRadius = 0.f;
+	}
+	else if (strcmp(name, "mountains") == 0)
+	{
+		preset.maxHeight = 96.f;
+		preset.noiseScale = 1.f;
+		preset.noiseOctaves = 6;
+		preset.sphereRadius = 0.f;
+	}
+	else if (strcmp(name, "default") != 0)
+	{
+		return false;
+	}
+
+	params = preset;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
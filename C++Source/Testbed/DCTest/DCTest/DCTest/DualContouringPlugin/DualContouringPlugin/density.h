@@ -1,8 +1,88 @@
 #ifndef		HAS_DENSITY_H_BEEN_INCLUDED
 #define		HAS_DENSITY_H_BEEN_INCLUDED
 
-#include "glm\glm.hpp"
+#include <memory>
 
-float Density_Func(const glm::vec3& worldPosition);
+#include "glm/glm.hpp"
 
-#endif	//	HAS_DENSITY_H_BEEN_INCLUDED
\ No newline at end of file
+class SparseVolume;
+class SignDag;
+
+// ----------------------------------------------------------------------------
+
+// Everything Density_Func depends on. Plain floats only, the layout is shared
+// with DualContouringDLL.DensityParams on the managed side.
+struct DensityParams
+{
+	// terrain height field, worldPosition.y - maxHeight * noise * noiseScale
+	float		maxHeight = 20.f;
+	float		noiseScale = 0.f;
+	int			noiseOctaves = 4;
+	float		noiseFrequency = 0.5343f;
+	float		noiseLacunarity = 2.2324f;
+	float		noisePersistence = 0.68324f;
+
+	// a radius <= 0 leaves just the terrain
+	glm::vec3	sphereOrigin = glm::vec3(0.f);
+	float		sphereRadius = 6.f;
+};
+
+// What the meshers sample: the procedural density plus the edits made to it,
+// which are stored near the surface and take over wherever they've been made
+// (see sparse_volume.h). Converts from DensityParams for an unedited world.
+// A static world can carry the corner signs baked from its params as well
+// (see sign_dag.h), which the meshers read in place of sampling.
+struct DensityField
+{
+	DensityField() = default;
+	DensityField(const DensityParams& params) : params(params) {}
+
+	DensityParams		params;
+	std::shared_ptr<const SparseVolume> edits;		// null until the first edit
+	std::shared_ptr<const SignDag> signs;			// null unless baked
+};
+
+// ----------------------------------------------------------------------------
+
+float Density_Func(const DensityParams& params, const glm::vec3& worldPosition);
+float Density_Func(const DensityField& field, const glm::vec3& worldPosition);
+
+// Conservative bounds on Density_Func over an axis aligned box, from a handful
+// of noise samples rather than the whole volume. The terrain height is bounded
+// per column of the box's xz footprint using one sample per octave at the
+// column centre and the noise's slope and amplitude limits, then combined with
+// the sphere's distance bounds. min >= 0 means every point in the box is
+// outside the surface and max < 0 that every point is inside.
+struct DensityRange
+{
+	float		min;
+	float		max;
+};
+
+DensityRange Density_Range(const DensityParams& params, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+// The edits' stored bounds where they cover the box, combined with the
+// procedural bounds wherever they don't
+DensityRange Density_Range(const DensityField& field, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+// The height of the terrain term's surface over a column, where it crosses zero
+float Density_Height(const DensityParams& params, const glm::vec2& column);
+
+// True when the surface inside the box is the terrain alone, i.e. the sphere
+// doesn't reach into it, so there are no overhangs and the surface is
+// Density_Height at every column. Conservative like Density_Range.
+bool Density_IsHeightfield(const DensityParams& params, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+// False wherever the box has been edited as well, Density_Height doesn't see edits
+bool Density_IsHeightfield(const DensityField& field, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+// The baked signs if they hold every corner from min to max (inclusive, world
+// units) and still agree with the field there: baked from these params, and
+// none of the corners edited since. Null otherwise, sample instead.
+const SignDag* Density_BakedSigns(const DensityField& field, const glm::ivec3& min, const glm::ivec3& max);
+
+// Named configurations for the offline tools: "default", "hills" and "mountains".
+// Returns false (and leaves params alone) for an unknown name.
+bool GetDensityPreset(const char* name, DensityParams& params);
+
+#endif	//	HAS_DENSITY_H_BEEN_INCLUDED
@@ -10,7 +10,9 @@
 
 #include "glm/glm.hpp"
 #include <stdint.h>
+#include <vector>
 #include "density.h"
+#include "sign_dag.h"
 
 // ----------------------------------------------------------------------------
 
@@ -44,6 +46,7 @@ using VoxelIndexMap = std::unordered_map<uint32_t, int>;
 
 // ----------------------------------------------------------------------------
 
+using glm::ivec3;
 using glm::ivec4;
 using glm::vec4;
 using glm::vec3;
@@ -52,7 +55,7 @@ using glm::vec2;
 #ifdef _MSC_VER
 #define ALIGN16 __declspec(align(16))
 #else
-#define ALIGN16 __attribute__((aligned(16))
+#define ALIGN16 __attribute__((aligned(16)))
 #endif
 
 // ----------------------------------------------------------------------------
@@ -136,9 +139,9 @@ float sdSuperprim(vec3 p, vec4 s, vec2 r)
 
 // ----------------------------------------------------------------------------
 
-float Density(const vec4& p)
+float Density(const DensityField& params, const vec4& p)
 {
-	return Density_Func(vec3(p));
+	return Density_Func(params, vec3(p));
 }
 
 // ----------------------------------------------------------------------------
@@ -168,7 +171,7 @@ uint32_t EncodeAxisUniqueID(const int axis, const int x, const int y, const int
 
 // ----------------------------------------------------------------------------
 
-float FindIntersection(const vec4& p0, const vec4& p1)
+float FindIntersection(const DensityField& density, const vec4& p0, const vec4& p1)
 {
 	const int FIND_EDGE_INFO_STEPS = 16;
 	const float FIND_EDGE_INFO_INCREMENT = 1.f / FIND_EDGE_INFO_STEPS;
@@ -179,7 +182,7 @@ float FindIntersection(const vec4& p0, const vec4& p1)
 	for (int i = 0; i < FIND_EDGE_INFO_STEPS; i++)
 	{
 		const vec4 p = glm::mix(p0, p1, currentT);
-		const float	d = glm::abs(Density(p));
+		const float	d = glm::abs(Density(density, p));
 		if (d < minValue)
 		{
 			t = currentT;
@@ -194,107 +197,257 @@ float FindIntersection(const vec4& p0, const vec4& p1)
 
 // ----------------------------------------------------------------------------
 
-static void FindActiveVoxels(
-	VoxelIDSet& activeVoxels,
-	EdgeInfoMap& activeEdges,
-	int worldX, int worldY, int worldZ, const int voxelGridSize, VertexData& cellData)
+void FindEdgeHermite(const DensityField& density, const vec4& p0, const vec4& p1, vec4& position, vec4& normal)
 {
-	printf("FindActiveVoxels ");
-	const float gridOffset = voxelGridSize / 2.0f;
+	const float t = FindIntersection(density, p0, p1);
+	position = vec4(glm::mix(glm::vec3(p0), glm::vec3(p1), t), 1.f);
+
+	const float H = 0.001f;
+	normal = glm::normalize(vec4(
+		Density(density, position + vec4(H, 0.f, 0.f, 0.f)) - Density(density, position - vec4(H, 0.f, 0.f, 0.f)),
+		Density(density, position + vec4(0.f, H, 0.f, 0.f)) - Density(density, position - vec4(0.f, H, 0.f, 0.f)),
+		Density(density, position + vec4(0.f, 0.f, H, 0.f)) - Density(density, position - vec4(0.f, 0.f, H, 0.f)),
+		0.f));
+}
+
+// ----------------------------------------------------------------------------
+
+vec4 SolveVoxelVertex(const vec4* positions, const vec4* normals, const int count, vec4& normal)
+{
+	// the solver wants aligned input
+	ALIGN16 vec4 p[12];
+	ALIGN16 vec4 n[12];
+	for (int i = 0; i < count; i++)
+	{
+		p[i] = positions[i];
+		n[i] = normals[i];
+	}
+
+	ALIGN16 vec4 vertex;
+	qef_solve_from_points_4d(&p[0].x, &n[0].x, count, &vertex.x);
+
+	normal = vec4(0.f);
+	for (int i = 0; i < count; i++)
+	{
+		normal += n[i];
+	}
+	if (count != 0)
+	{
+		normal *= (1.f / (float)count);
+	}
+
+	return vertex;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool IsCancelled(const std::atomic<bool>* cancel)
+{
+	return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+struct FastDCGenerator::State
+{
+	DensityField		density;
+	ivec4				world;
+	int					cellSize = 0;
+	int					voxelSize = 1;
+	const std::atomic<bool>* cancel = nullptr;
+
+	Stage				stage = Stage_Density;
+	int					cursor = 0;		// progress through the current stage
+
+	// (cellSize + 1)^3 samples, every voxel corner in the chunk
+	std::vector<float>	densities;
+
+	VoxelIDSet			activeVoxels;
+	EdgeInfoMap			activeEdges;
+	VoxelIndexMap		vertexIndices;
+
+	VoxelIDSet::const_iterator	nextVoxel;
+	EdgeInfoMap::const_iterator	nextEdge;
+
+	MeshBuffer*			buffer = nullptr;
+	VertexData			cells;
+	std::vector<SeamVoxel> seamVoxels;
+
+	vec4 cornerPosition(int x, int y, int z) const
+	{
+		const float gridOffset = cellSize / 2.0f;
+		return vec4(
+			(x - gridOffset) * voxelSize + world.x,
+			(y - gridOffset) * voxelSize + world.y,
+			(z - gridOffset) * voxelSize + world.z, 1.f);
+	}
+
+	float sample(int x, int y, int z) const
+	{
+		const int size = cellSize + 1;
+		return densities[(x * size + y) * size + z];
+	}
+};
+
+// ----------------------------------------------------------------------------
+
+// Everything below checks the clock after a small batch of work, the batch
+// sizes keep the overshoot past the deadline to a few microseconds
+static bool PastDeadline(const FastDCGenerator::Clock::time_point& deadline)
+{
+	return deadline != FastDCGenerator::Clock::time_point::max() && FastDCGenerator::Clock::now() >= deadline;
+}
+
+// ----------------------------------------------------------------------------
+
+// Samples the density at every voxel corner, one column of z per unit of work
+static bool SampleDensity(FastDCGenerator::State& state, const FastDCGenerator::Clock::time_point& deadline)
+{
+	const int size = state.cellSize + 1;
+	if (state.densities.empty())
+	{
+		state.densities.resize(size * size * size);
+
+		// only the signs are used, baked ones stand in for the whole lattice
+		// when the corners fall on it
+		const int extent = state.cellSize * state.voxelSize;
+		if (extent % 2 == 0)
+		{
+			const ivec3 min = ivec3(state.world) - ivec3(extent / 2);
+			const SignDag* signs = Density_BakedSigns(state.density, min, min + ivec3(extent));
+			if (signs)
+			{
+				signs->fill(min, state.voxelSize, size, state.densities.data());
+				state.cursor = size * size;
+			}
+		}
+	}
+
+	for (; state.cursor < size * size; state.cursor++)
+	{
+		if (IsCancelled(state.cancel) || PastDeadline(deadline))
+		{
+			return false;
+		}
+
+		const int x = state.cursor / size;
+		const int y = state.cursor % size;
+		float* column = &state.densities[state.cursor * size];
+		for (int z = 0; z < size; z++)
+		{
+			column[z] = Density(state.density, state.cornerPosition(x, y, z));
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Finds the zero crossing and normal on every edge with a sign change, and the
+// voxels which share those edges. Edges on the chunk's max faces are included
+// so the voxels there solve against all 12 of their edges, the same vertex a
+// neighbouring chunk would see when building the seam between them.
+static bool FindActiveVoxels(FastDCGenerator::State& state, const FastDCGenerator::Clock::time_point& deadline)
+{
+	const int voxelGridSize = state.cellSize;
+	const int cornerGridSize = voxelGridSize + 1;
+	const DensityField& density = state.density;
+
+	for (; state.cursor < cornerGridSize * cornerGridSize; state.cursor++)
+	{
+		if (IsCancelled(state.cancel) || PastDeadline(deadline))
+		{
+			return false;
+		}
 
-	for (int x = 0; x < voxelGridSize; x++)
-		for (int y = 0; y < voxelGridSize; y++)
-			for (int z = 0; z < voxelGridSize; z++)
+		const int x = state.cursor / cornerGridSize;
+		const int y = state.cursor % cornerGridSize;
+		for (int z = 0; z < cornerGridSize; z++)
+		{
+			const ivec4 idxPos(x, y, z, 0);
+			const vec4 p = state.cornerPosition(x, y, z);
+			const float pDensity = state.sample(x, y, z);
+
+			for (int axis = 0; axis < 3; axis++)
 			{
-				printf("\nindex[%d,%d,%d] \n", x, y, z);
-				const ivec4 idxPos(x, y, z, 0);
-				const vec4 p = vec4(x - gridOffset + worldX, y - gridOffset + worldY, z - gridOffset + worldZ, 1.f);
-				
-				//printf("    pos[%f,%f,%f]\n", p.x, p.y, p.z);
-				/*cellData.push_back(p.x);
-				cellData.push_back(p.y);
-				cellData.push_back(p.z);*/
-
-				for (int axis = 0; axis < 3; axis++)
+				// the edge would leave the chunk
+				if (idxPos[axis] == voxelGridSize)
+				{
+					continue;
+				}
+
+				const ivec4 qIdx = idxPos + ivec4(AXIS_OFFSET[axis]);
+				const vec4 q = p + (AXIS_OFFSET[axis] * (float)state.voxelSize);
+				const float qDensity = state.sample(qIdx.x, qIdx.y, qIdx.z);
+
+				const bool zeroCrossing = (pDensity >= 0.f) != (qDensity >= 0.f);
+				if (!zeroCrossing)
 				{
-					//printf(" axis[%d]", axis);
-					const vec4 q = p + AXIS_OFFSET[axis]; //
+					continue;
+				}
 
-					const float pDensity = Density(p);
-					const float qDensity = Density(q);
+				EdgeInfo info;
+				FindEdgeHermite(density, p, q, info.pos, info.normal);
+				info.winding = pDensity >= 0.f;
 
-					const bool zeroCrossing =
-						pDensity >= 0.f && qDensity < 0.f ||
-						pDensity < 0.f && qDensity >= 0.f;
-					//printf(" - zeroCrossing[%d]", zeroCrossing);
-					if (!zeroCrossing)
+				const auto code = EncodeAxisUniqueID(axis, x, y, z);
+				state.activeEdges[code] = info;
+
+				const auto edgeNodes = EDGE_NODE_OFFSETS[axis];
+				for (int i = 0; i < 4; i++)
+				{
+					const auto nodeIdxPos = idxPos - edgeNodes[i];
+					if (nodeIdxPos.x < 0 || nodeIdxPos.y < 0 || nodeIdxPos.z < 0 ||
+						nodeIdxPos.x == voxelGridSize || nodeIdxPos.y == voxelGridSize || nodeIdxPos.z == voxelGridSize)
 					{
 						continue;
 					}
 
-					const float t = FindIntersection(p, q);
-					const vec4 pos = vec4(glm::mix(glm::vec3(p), glm::vec3(q), t), 1.f);
-					/*cellData.push_back(pos.x);
-					cellData.push_back(pos.y);
-					cellData.push_back(pos.z);*/
-
-					const float H = 0.001f;
-					const auto normal = glm::normalize(vec4(
-						Density(pos + vec4(H, 0.f, 0.f, 0.f)) - Density(pos - vec4(H, 0.f, 0.f, 0.f)),
-						Density(pos + vec4(0.f, H, 0.f, 0.f)) - Density(pos - vec4(0.f, H, 0.f, 0.f)),
-						Density(pos + vec4(0.f, 0.f, H, 0.f)) - Density(pos - vec4(0.f, 0.f, H, 0.f)),
-						0.f));
-
-					EdgeInfo info;
-					info.pos = pos;
-					info.normal = normal;
-					info.winding = pDensity >= 0.f;
-
-					const auto code = EncodeAxisUniqueID(axis, x, y, z);
-					activeEdges[code] = info;
-
-					const auto edgeNodes = EDGE_NODE_OFFSETS[axis];
-					for (int i = 0; i < 4; i++)
-					{
-						const auto nodeIdxPos = idxPos - edgeNodes[i];
-						const auto nodeID = EncodeVoxelUniqueID(nodeIdxPos);
-						
-						printf("\n------- \nedge offset[%d,%d,%d]", (int)edgeNodes[i].x, (int)edgeNodes[i].y, (int)edgeNodes[i].z);
-						printf("idxPos[%d,%d,%d]", (int)idxPos.x, (int)idxPos.y, (int)idxPos.z);
-						printf("nodeIdxPos[%d, %d, %d]\n", (int)nodeIdxPos.x, (int)nodeIdxPos.y, (int)nodeIdxPos.z);
-						printf(" - vuID[%d]\n", nodeID);
-						vec4 decoded = DecodeVoxelUniqueID(nodeID);
-						printf("decoded p [%d, %d, %d]\n", (int)decoded.x, (int)decoded.y, (int)decoded.z);
-
-						if (nodeIdxPos.x < 0 || nodeIdxPos.y < 0 || nodeIdxPos.z < 0) {
-							printf("outside bounds, ignoring....\n");
-							continue;
-						}
-						activeVoxels.insert(nodeID);
-					}
-					printf("\n");
+					state.activeVoxels.insert(EncodeVoxelUniqueID(nodeIdxPos));
 				}
 			}
-	printf("... DONE\n");
+		}
+	}
+
+	// the samples aren't needed past this point
+	std::vector<float>().swap(state.densities);
+	return true;
 }
 
 // ----------------------------------------------------------------------------
 
-static void GenerateVertexData(
-	const VoxelIDSet& voxels,
-	const EdgeInfoMap& edges,
-	VoxelIndexMap& vertexIndices,
-	MeshBuffer* buffer,
-	float& debugVal, VertexData& cellData)
+// Solves the QEF for each active voxel
+static bool GenerateVertexData(FastDCGenerator::State& state, const FastDCGenerator::Clock::time_point& deadline)
 {
-	printf("GenerateVertexData");
-	MeshVertex* vert = &buffer->vertices[0];
+	const int BATCH_SIZE = 32;
 
-	int idxCounter = 0;
-	for (const auto& voxelID : voxels)
+	// a step can run out of time before the first voxel, the stage then
+	// starts over on the next step with the buffer already allocated
+	MeshBuffer* buffer = state.buffer;
+	if (state.cursor == 0)
 	{
-		ALIGN16 vec4 p[12];
-		ALIGN16 vec4 n[12];
+		if (!buffer->vertices)
+		{
+			buffer->vertices = (MeshVertex*)malloc(state.activeVoxels.size() * sizeof(MeshVertex));
+		}
+		buffer->numVertices = 0;
+		state.nextVoxel = state.activeVoxels.begin();
+	}
+
+	const EdgeInfoMap& edges = state.activeEdges;
+	for (; state.nextVoxel != state.activeVoxels.end(); ++state.nextVoxel)
+	{
+		if (state.cursor++ % BATCH_SIZE == 0 && (IsCancelled(state.cancel) || PastDeadline(deadline)))
+		{
+			state.cursor--;
+			return false;
+		}
+
+		const uint32_t voxelID = *state.nextVoxel;
+
+		vec4 p[12];
+		vec4 n[12];
 
 		int idx = 0;
 		for (int i = 0; i < 12; i++)
@@ -305,66 +458,77 @@ static void GenerateVertexData(
 			if (iter != end(edges))
 			{
 				const auto& info = iter->second;
-				const vec4 pos = info.pos;
-				const vec4 normal = info.normal;
-
-				p[idx] = pos;
-				n[idx] = normal;
+				p[idx] = info.pos;
+				n[idx] = info.normal;
 				idx++;
 			}
 		}
 
-		ALIGN16 vec4 nodePos;
-		qef_solve_from_points_4d(&p[0].x, &n[0].x, idx, &nodePos.x);
-		vec4 vid = DecodeVoxelUniqueID(voxelID);
-		printf("\n - QEF Solved Pos for cell[%d, %d, %d] - [%f, %f, %f] idx: %d", (int)vid.x, (int)vid.y, (int)vid.z, nodePos.x, nodePos.y, nodePos.z, idx);
-		cellData.push_back(nodePos.x);
-		cellData.push_back(nodePos.y);
-		cellData.push_back(nodePos.z);
 		vec4 nodeNormal;
-		for (int i = 0; i < idx; i++)
-		{
-			nodeNormal += n[i];
-		}
-		if (idx != 0) {
-			nodeNormal *= (1.f / (float)idx); //this where we are getting normal set to infinity?  
-		}
+		const vec4 nodePos = SolveVoxelVertex(p, n, idx, nodeNormal);
+		state.cells.push_back(nodePos.x);
+		state.cells.push_back(nodePos.y);
+		state.cells.push_back(nodePos.z);
 
-		if (idx > 1) {
-			vertexIndices[voxelID] = idxCounter++;
+		if (idx > 1)
+		{
+			state.vertexIndices[voxelID] = buffer->numVertices;
 
-			buffer->numVertices++;
+			MeshVertex* vert = &buffer->vertices[buffer->numVertices++];
 			vert->xyz = nodePos;
-
-			//should we snap position so it's never outside this voxel?
-			//I guess?
-
-
 			vert->normal = nodeNormal;
-			vert++;
+
+			const ivec4 idxPos = DecodeVoxelUniqueID(voxelID);
+			const int last = state.cellSize - 1;
+			if (idxPos.x == 0 || idxPos.y == 0 || idxPos.z == 0 ||
+				idxPos.x == last || idxPos.y == last || idxPos.z == last)
+			{
+				const vec4 corner = state.cornerPosition(idxPos.x, idxPos.y, idxPos.z);
+
+				SeamVoxel seamVoxel;
+				seamVoxel.min = glm::ivec3(glm::floor(vec3(corner) + 0.5f));
+				seamVoxel.size = state.voxelSize;
+				seamVoxel.position = vec3(nodePos);
+				seamVoxel.normal = vec3(nodeNormal);
+				seamVoxel.vertex = buffer->numVertices - 1;
+				state.seamVoxels.push_back(seamVoxel);
+			}
 		}
 	}
-	printf("... DONE\n");
 
+	return true;
 }
 
 // ----------------------------------------------------------------------------
 
-static void GenerateTriangles(
-	const EdgeInfoMap& edges,
-	const VoxelIndexMap& vertexIndices,
-	MeshBuffer* buffer)
+// Emits a quad for every active edge whose four voxels all have a vertex
+static bool GenerateTriangles(FastDCGenerator::State& state, const FastDCGenerator::Clock::time_point& deadline)
 {
-	printf("GenerateTriangles");
-	MeshTriangle* tri = &buffer->triangles[0];
+	const int BATCH_SIZE = 256;
+
+	MeshBuffer* buffer = state.buffer;
+	if (state.cursor == 0)
+	{
+		if (!buffer->triangles)
+		{
+			buffer->triangles = (MeshTriangle*)malloc(2 * state.activeEdges.size() * sizeof(MeshTriangle));
+		}
+		buffer->numTriangles = 0;
+		state.nextEdge = state.activeEdges.begin();
+	}
 
-	for (const auto& pair : edges)
+	const VoxelIndexMap& vertexIndices = state.vertexIndices;
+	for (; state.nextEdge != state.activeEdges.end(); ++state.nextEdge)
 	{
-		const auto& edge = pair.first;
-		const auto& info = pair.second;
+		if (state.cursor++ % BATCH_SIZE == 0 && (IsCancelled(state.cancel) || PastDeadline(deadline)))
+		{
+			state.cursor--;
+			return false;
+		}
+
+		const auto& edge = state.nextEdge->first;
+		const auto& info = state.nextEdge->second;
 
-		const ivec4 basePos = DecodeVoxelUniqueID(edge);
-		printf("voxelId[%d,%d,%d]\n", (int)basePos.x, (int)basePos.y, (int)basePos.z);
 		const int axis = (edge >> 30) & 0xff;
 
 		const int nodeID = edge & ~0xc0000000;
@@ -394,6 +558,7 @@ static void GenerateTriangles(
 			continue;
 		}
 
+		MeshTriangle* tri = &buffer->triangles[buffer->numTriangles];
 		if (info.winding)
 		{
 			tri->indices_[0] = edgeVoxels[0];
@@ -404,7 +569,6 @@ static void GenerateTriangles(
 			tri->indices_[0] = edgeVoxels[0];
 			tri->indices_[1] = edgeVoxels[3];
 			tri->indices_[2] = edgeVoxels[2];
-			tri++;
 		}
 		else
 		{
@@ -416,35 +580,163 @@ static void GenerateTriangles(
 			tri->indices_[0] = edgeVoxels[0];
 			tri->indices_[1] = edgeVoxels[2];
 			tri->indices_[2] = edgeVoxels[3];
-			tri++;
 		}
 
 		buffer->numTriangles += 2;
 	}
-	printf("..DONE\n");
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+FastDCGenerator::FastDCGenerator(const DensityField& density, int x, int y, int z, int cellSize, int voxelSize, const std::atomic<bool>* cancel)
+	: state_(new State)
+{
+	state_->density = density;
+	state_->world = ivec4(x, y, z, 0);
+	state_->cellSize = cellSize;
+	state_->voxelSize = voxelSize;
+	state_->cancel = cancel;
+}
+
+// ----------------------------------------------------------------------------
+
+FastDCGenerator::~FastDCGenerator()
+{
+	if (state_->buffer)
+	{
+		free(state_->buffer->vertices);
+		free(state_->buffer->triangles);
+		delete state_->buffer;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+FastDCGenerator::Stage FastDCGenerator::stage() const
+{
+	return state_->stage;
+}
+
+// ----------------------------------------------------------------------------
+
+bool FastDCGenerator::step(const Clock::time_point& deadline)
+{
+	return run(deadline, false);
+}
+
+// ----------------------------------------------------------------------------
+
+bool FastDCGenerator::runStage()
+{
+	return !run(Clock::time_point::max(), true);
+}
+
+// ----------------------------------------------------------------------------
+
+bool FastDCGenerator::run(const Clock::time_point& deadline, const bool singleStage)
+{
+	State& state = *state_;
+	while (state.stage != Stage_Done && state.stage != Stage_Cancelled)
+	{
+		if (IsCancelled(state.cancel))
+		{
+			state.stage = Stage_Cancelled;
+			break;
+		}
+
+		bool finished = false;
+		switch (state.stage)
+		{
+		case Stage_Density:
+			finished = SampleDensity(state, deadline);
+			break;
+
+		case Stage_Hermite:
+			finished = FindActiveVoxels(state, deadline);
+			break;
+
+		case Stage_QEF:
+			if (!state.buffer)
+			{
+				state.buffer = new MeshBuffer;
+				state.buffer->triangles = nullptr;
+				state.buffer->numTriangles = 0;
+			}
+			finished = GenerateVertexData(state, deadline);
+			break;
+
+		case Stage_Contour:
+			finished = GenerateTriangles(state, deadline);
+			break;
+
+		default:
+			break;
+		}
+
+		if (!finished)
+		{
+			// out of time, or cancelled which is picked up on the next pass
+			if (!IsCancelled(state.cancel))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		state.stage = (Stage)(state.stage + 1);
+		state.cursor = 0;
+
+		if (singleStage)
+		{
+			return state.stage == Stage_Done;
+		}
+	}
+
+	return true;
 }
 
 // ----------------------------------------------------------------------------
 
-MeshBuffer* GenerateMesh(int x, int y, int z, int cellSize, float& debugVal, VertexData& cellData)
+MeshBuffer* FastDCGenerator::takeMesh()
 {
-	VoxelIDSet activeVoxels;
-	EdgeInfoMap activeEdges;
+	if (state_->stage != Stage_Done)
+	{
+		return nullptr;
+	}
 
-	FindActiveVoxels(activeVoxels, activeEdges, x, y, z, cellSize, cellData);
+	MeshBuffer* buffer = state_->buffer;
+	state_->buffer = nullptr;
+	return buffer;
+}
 
-	MeshBuffer* buffer = new MeshBuffer;
-	buffer->vertices = (MeshVertex*)malloc(activeVoxels.size() * sizeof(MeshVertex));
-	buffer->numVertices = 0;
+// ----------------------------------------------------------------------------
 
-	VoxelIndexMap vertexIndices;
-	GenerateVertexData(activeVoxels, activeEdges, vertexIndices, buffer, debugVal, cellData);
+VertexData& FastDCGenerator::cells()
+{
+	return state_->cells;
+}
+
+// ----------------------------------------------------------------------------
 
-	buffer->triangles = (MeshTriangle*)malloc(2 * activeEdges.size() * sizeof(MeshTriangle));
-	buffer->numTriangles = 0;
-	GenerateTriangles(activeEdges, vertexIndices, buffer);
+std::vector<SeamVoxel>& FastDCGenerator::seamVoxels()
+{
+	return state_->seamVoxels;
+}
 
-	printf("mesh verts/tris: %d %d\n", buffer->numVertices, buffer->numTriangles);
+// ----------------------------------------------------------------------------
+
+MeshBuffer* GenerateMesh(const DensityField& density, int x, int y, int z, int cellSize, int voxelSize, float& debugVal, VertexData& cellData, const std::atomic<bool>* cancel)
+{
+	FastDCGenerator generator(density, x, y, z, cellSize, voxelSize, cancel);
+	generator.step(FastDCGenerator::Clock::time_point::max());
+
+	MeshBuffer* buffer = generator.takeMesh();
+	if (buffer)
+	{
+		cellData.insert(end(cellData), begin(generator.cells()), end(generator.cells()));
+	}
 
 	return buffer;
 }
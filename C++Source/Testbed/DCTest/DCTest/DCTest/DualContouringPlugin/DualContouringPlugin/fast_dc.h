@@ -2,6 +2,12 @@
 #define		HAS_DC_H_BEEN_INCLUDED
 
 #include	"ng_mesh_simplify.h"
+#include	"density.h"
+
+#include	<atomic>
+#include	<chrono>
+#include	<memory>
+#include	<vector>
 
 struct SuperPrimitiveConfig
 {
@@ -19,6 +25,77 @@ struct SuperPrimitiveConfig
 };
 
 SuperPrimitiveConfig ConfigForShape(const SuperPrimitiveConfig::Type& type);
-MeshBuffer* GenerateMesh(int x, int y, int z, int cellSize, float& dVal, VertexData& cellData);
+
+// A voxel on one of the chunk's faces which has a vertex, kept after the mesh
+// is built so the seams with neighbouring chunks can be contoured later
+struct SeamVoxel
+{
+	glm::ivec3	min;			// world position of the voxel's min corner
+	int			size;			// voxel extent in world units
+	glm::vec3	position;
+	glm::vec3	normal;
+	int			vertex;			// index of the vertex in the chunk's mesh
+};
+
+// The zero crossing on the edge from p0 to p1 (which must straddle the surface)
+// and the surface normal there, the Hermite data fast_dc contours
+void FindEdgeHermite(const DensityField& density, const glm::vec4& p0, const glm::vec4& p1, glm::vec4& position, glm::vec4& normal);
+
+// Solves the QEF of a voxel's edge intersections (at most 12) for its vertex,
+// normal is set to the intersections' average normal
+glm::vec4 SolveVoxelVertex(const glm::vec4* positions, const glm::vec4* normals, const int count, glm::vec4& normal);
+
+// cellSize is the number of voxels along each axis, each voxelSize units wide.
+// Returns nullptr if the cancel flag is raised while the mesh is being generated
+MeshBuffer* GenerateMesh(const DensityField& density, int x, int y, int z, int cellSize, int voxelSize, float& dVal, VertexData& cellData, const std::atomic<bool>* cancel = nullptr);
+
+// Resumable version of GenerateMesh, each call to step() does as much work as
+// fits before the deadline and picks up where the last call stopped. The
+// density is sampled once per voxel corner up front, the QEF and contouring
+// stages check the clock every few dozen voxels/edges.
+class FastDCGenerator
+{
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	enum Stage
+	{
+		Stage_Density,
+		Stage_Hermite,
+		Stage_QEF,
+		Stage_Contour,
+		Stage_Done,
+		Stage_Cancelled,
+	};
+
+	struct State;
+
+	FastDCGenerator(const DensityField& density, int x, int y, int z, int cellSize, int voxelSize, const std::atomic<bool>* cancel = nullptr);
+	~FastDCGenerator();
+
+	// Returns true once the mesh is finished or the cancel flag was seen
+	bool step(const Clock::time_point& deadline);
+
+	// Runs the current stage to completion, for callers which schedule each
+	// stage as its own task. Returns false once there's nothing left to run.
+	bool runStage();
+
+	Stage stage() const;
+
+	// Ownership of the buffer passes to the caller, null unless Stage_Done
+	MeshBuffer* takeMesh();
+	VertexData& cells();
+	std::vector<SeamVoxel>& seamVoxels();
+
+private:
+
+	FastDCGenerator(const FastDCGenerator&) = delete;
+	FastDCGenerator& operator=(const FastDCGenerator&) = delete;
+
+	bool run(const Clock::time_point& deadline, const bool singleStage);
+
+	std::unique_ptr<State> state_;
+};
 
 #endif //	HAS_DC_H_BEEN_INCLUDED
\ No newline at end of file
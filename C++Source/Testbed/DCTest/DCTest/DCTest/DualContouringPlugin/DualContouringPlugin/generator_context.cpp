@@ -0,0 +1,262 @@
+#include "generator_context.h"
+
+#include <chrono>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+
+// Enough for a few rings of chunks at the default sizes, SetMeshCacheCapacity changes it
+static const long long DEFAULT_MESH_CACHE_BYTES = 64 * 1024 * 1024;
+
+// ----------------------------------------------------------------------------
+
+GeneratorContext::GeneratorContext(int numThreads)
+	: meshCache_(&memory_)
+	, jobs_(new JobSystem(numThreads, &stats_, &memory_, &meshCache_))
+{
+	meshCache_.setCapacity(DEFAULT_MESH_CACHE_BYTES);
+	memory_.addConsumer(&meshCache_);
+}
+
+// ----------------------------------------------------------------------------
+
+GeneratorContext::~GeneratorContext()
+{
+	disableClipmap();
+
+	// join the workers while the stats and memory they write to are still alive
+	jobs_.reset();
+
+	memory_.removeConsumer(&meshCache_);
+}
+
+// ----------------------------------------------------------------------------
+
+DensityParams GeneratorContext::density() const
+{
+	std::lock_guard<std::mutex> lock(densityMutex_);
+	return density_;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorContext::setDensity(const DensityParams& density)
+{
+	std::lock_guard<std::mutex> lock(densityMutex_);
+	density_ = density;
+}
+
+// ----------------------------------------------------------------------------
+
+DensityField GeneratorContext::densityField() const
+{
+	std::lock_guard<std::mutex> lock(densityMutex_);
+
+	DensityField field(density_);
+	field.edits = edits_;
+	field.signs = signs_;
+	return field;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorContext::editDensity(const DensityEdit& edit)
+{
+	std::lock_guard<std::mutex> editLock(editMutex_);
+	const DensityField field = densityField();
+
+	std::shared_ptr<SparseVolume> edited = field.edits ? std::make_shared<SparseVolume>(*field.edits) : std::make_shared<SparseVolume>();
+	glm::ivec3 min, max;
+	edited->apply(field.params, edit, min, max);
+
+	{
+		std::lock_guard<std::mutex> lock(densityMutex_);
+		edits_ = edited;
+	}
+
+	meshCache_.invalidate(min, max);
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorContext::clearDensityEdits()
+{
+	std::lock_guard<std::mutex> editLock(editMutex_);
+	std::lock_guard<std::mutex> lock(densityMutex_);
+	edits_.reset();
+}
+
+// ----------------------------------------------------------------------------
+
+DensityEditStats GeneratorContext::densityEditStats() const
+{
+	const DensityField field = densityField();
+	return field.edits ? field.edits->stats() : DensityEditStats();
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorContext::loadSignDag(const std::string& path)
+{
+	std::shared_ptr<const SignDag> signs = SignDag::load(path);
+	if (!signs)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(densityMutex_);
+	signs_ = signs;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorContext::unloadSignDag()
+{
+	std::lock_guard<std::mutex> lock(densityMutex_);
+	signs_.reset();
+}
+
+// ----------------------------------------------------------------------------
+
+SignDagStats GeneratorContext::signDagStats() const
+{
+	const DensityField field = densityField();
+	return field.signs ? field.signs->stats() : SignDagStats();
+}
+
+// ----------------------------------------------------------------------------
+
+int GeneratorContext::submit(ChunkRequest request)
+{
+	request.density = densityField();
+	return jobs_->submit(request);
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorContext::submit(const ChunkRequest* requests, const int count, int* ids, const bool speculative)
+{
+	const DensityField field = densityField();
+
+	std::vector<ChunkRequest> stamped(requests, requests + count);
+	for (auto& request : stamped)
+	{
+		request.density = field;
+	}
+
+	jobs_->submit(stamped.data(), count, ids, speculative);
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorContext::generate(ChunkRequest request, ChunkResult& result)
+{
+	if (!IsValidChunkRequest(request))
+	{
+		return false;
+	}
+
+	request.density = densityField();
+
+	if (meshCache_.load(request, result))
+	{
+		stats_.chunksFromCache++;
+		return true;
+	}
+
+	const uint64_t cacheEpoch = meshCache_.epoch();
+	const auto archive = this->archive();
+	if (archive && archive->load(request, result))
+	{
+		stats_.chunksFromArchive++;
+		return true;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	const bool completed = GenerateChunk(request, result);
+	const long long microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	if (completed)
+	{
+		meshCache_.store(request, result, microseconds, cacheEpoch);
+		if (archive)
+		{
+			archive->store(request, result);
+		}
+	}
+
+	stats_.record(completed, result, microseconds);
+	return completed;
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorContext::enableClipmap(const ClipmapParams& params)
+{
+	if (!IsValidClipmapParams(params))
+	{
+		return false;
+	}
+
+	disableClipmap();
+	clipmap_ = std::make_shared<ClipmapManager>(*this, params);
+	memory_.addConsumer(clipmap_.get());
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorContext::disableClipmap()
+{
+	if (clipmap_)
+	{
+		// first, an eviction in progress may still be calling into it
+		memory_.removeConsumer(clipmap_.get());
+		clipmap_->shutdown();
+		clipmap_.reset();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorContext::openArchive(const std::string& path)
+{
+	closeArchive();
+
+	std::shared_ptr<ChunkArchive> archive = ChunkArchive::open(path);
+	if (!archive)
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(archiveMutex_);
+		archive_ = archive;
+	}
+
+	jobs_->setArchive(archive);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// The file is closed (and its index written) once the last running job using
+// it has finished
+void GeneratorContext::closeArchive()
+{
+	jobs_->setArchive(nullptr);
+
+	std::lock_guard<std::mutex> lock(archiveMutex_);
+	archive_.reset();
+}
+
+// ----------------------------------------------------------------------------
+
+std::shared_ptr<ChunkArchive> GeneratorContext::archive() const
+{
+	std::lock_guard<std::mutex> lock(archiveMutex_);
+	return archive_;
+}
+
+// ----------------------------------------------------------------------------
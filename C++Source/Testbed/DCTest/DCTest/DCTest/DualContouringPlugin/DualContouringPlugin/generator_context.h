@@ -0,0 +1,115 @@
+#ifndef		HAS_GENERATOR_CONTEXT_H_BEEN_INCLUDED
+#define		HAS_GENERATOR_CONTEXT_H_BEEN_INCLUDED
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "chunk_generator.h"
+#include "density.h"
+#include "job_system.h"
+#include "clipmap.h"
+#include "chunk_archive.h"
+#include "memory_governor.h"
+#include "mesh_cache.h"
+#include "sparse_volume.h"
+#include "sign_dag.h"
+
+// ----------------------------------------------------------------------------
+
+// Everything a world needs to generate chunks: the worker threads, the density
+// configuration and the running statistics. Nothing in the pipeline is global
+// so any number of contexts can be live at once, e.g. the game world and an
+// editor preview, without sharing queues or settings.
+class GeneratorContext
+{
+public:
+
+	explicit GeneratorContext(int numThreads = 0);
+	~GeneratorContext();
+
+	DensityParams density() const;
+	void setDensity(const DensityParams& density);
+
+	// The density and a snapshot of the edits made to it, what requests are
+	// stamped with
+	DensityField densityField() const;
+
+	// Stamps the edit onto a copy of the edits so far (sampling the current
+	// density where there aren't any) and publishes it for chunks queued from
+	// then on. Cached meshes in the region it changed are dropped, chunks which
+	// are already loaded have to be requested again to see it.
+	void editDensity(const DensityEdit& edit);
+	void clearDensityEdits();
+	DensityEditStats densityEditStats() const;
+
+	// Corner signs baked offline (see region_bake --sign-dag) for the meshers
+	// to read instead of sampling. Only used where they were baked from the
+	// current density and haven't been edited since, the meshes come out the
+	// same either way. False (and nothing changes) if the file can't be read.
+	bool loadSignDag(const std::string& path);
+	void unloadSignDag();
+	SignDagStats signDagStats() const;
+
+	// Stamp the context's density onto the request(s) before queuing them
+	int submit(ChunkRequest request);
+	void submit(const ChunkRequest* requests, const int count, int* ids, const bool speculative = false);
+
+	// Runs the request on the calling thread, returns false without generating
+	// anything for a request IsValidChunkRequest rejects
+	bool generate(ChunkRequest request, ChunkResult& result);
+
+	// At most one clipmap per context, enabling again replaces it and drops
+	// every chunk the old one held. Null until enabled. Returns false and
+	// leaves the current clipmap alone if IsValidClipmapParams rejects params.
+	bool enableClipmap(const ClipmapParams& params);
+	void disableClipmap();
+	ClipmapManager* clipmap() { return clipmap_.get(); }
+
+	// Chunks generated by this context are looked up in (and written through
+	// to) the archive while one is open. Opening again closes the previous one.
+	bool openArchive(const std::string& path);
+	void closeArchive();
+	std::shared_ptr<ChunkArchive> archive() const;
+
+	JobSystem& jobs() { return *jobs_; }
+	const GeneratorStats& stats() const { return stats_; }
+
+	// Everything the context holds natively is counted here, see setBudget
+	MemoryGovernor& memory() { return memory_; }
+
+	// Finished chunks kept for when they're asked for again, consulted before
+	// the archive and any generation
+	MeshCache& meshCache() { return meshCache_; }
+
+private:
+
+	GeneratorContext(const GeneratorContext&) = delete;
+	GeneratorContext& operator=(const GeneratorContext&) = delete;
+
+	// declared before jobs_ so the workers never outlive them
+	GeneratorStats					stats_;
+	MemoryGovernor					memory_;
+	MeshCache						meshCache_;
+
+	mutable std::mutex				densityMutex_;
+	DensityParams					density_;
+	std::shared_ptr<const SparseVolume> edits_;
+	std::shared_ptr<const SignDag>	signs_;
+
+	// held for the whole of an edit, which samples outside densityMutex_
+	std::mutex						editMutex_;
+
+	std::unique_ptr<JobSystem>		jobs_;
+
+	// shared with the job system, running jobs hold a reference until they finish
+	mutable std::mutex				archiveMutex_;
+	std::shared_ptr<ChunkArchive>	archive_;
+
+	// posted updates hold a reference too, see ClipmapManager::shutdown
+	std::shared_ptr<ClipmapManager>	clipmap_;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_GENERATOR_CONTEXT_H_BEEN_INCLUDED
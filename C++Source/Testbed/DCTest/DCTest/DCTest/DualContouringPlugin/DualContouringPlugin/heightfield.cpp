@@ -0,0 +1,375 @@
+#include "heightfield.h"
+
+#include <algorithm>
+#include <vector>
+
+using glm::ivec2;
+using glm::ivec3;
+using glm::vec2;
+using glm::vec3;
+
+// ----------------------------------------------------------------------------
+
+// RTIN keeps a triangle whole while its height error stays under this
+// fraction of a voxel, about the error of contouring the voxels in 3D
+static const float MAX_ERROR_VOXELS = 0.25f;
+
+// How far the skirts hang below the footprint's edges, in voxels. A neighbour
+// one LOD coarser can be off by a couple of its own (twice as wide) voxels.
+static const float SKIRT_DEPTH_VOXELS = 4.f;
+
+// ----------------------------------------------------------------------------
+
+static bool IsCancelled(const std::atomic<bool>* cancel)
+{
+	return cancel && cancel->load();
+}
+
+// ----------------------------------------------------------------------------
+
+static bool IsPowerOfTwo(const int n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+// ----------------------------------------------------------------------------
+
+// The terrain height at every voxel corner of the chunk's footprint, plus a
+// ring of corners outside it for the normals' central differences
+class HeightGrid
+{
+public:
+
+	HeightGrid(const ChunkRequest& request)
+		: cells_(request.size >> request.lod)
+		, voxelSize_(1 << request.lod)
+		, min_(request.position - ivec3(request.size / 2))
+		, stride_(cells_ + 3)
+	{
+	}
+
+	bool sample(const DensityParams& density, const std::atomic<bool>* cancel)
+	{
+		heights_.resize(stride_ * stride_);
+		for (int j = 0; j < stride_; j++)
+		{
+			if (IsCancelled(cancel))
+			{
+				return false;
+			}
+
+			for (int i = 0; i < stride_; i++)
+			{
+				heights_[j * stride_ + i] = Density_Height(density, vec2(min_.x + (i - 1) * voxelSize_, min_.z + (j - 1) * voxelSize_));
+			}
+		}
+
+		return true;
+	}
+
+	int cells() const { return cells_; }
+	int voxelSize() const { return voxelSize_; }
+	const ivec3& min() const { return min_; }
+
+	// i, j from -1 to cells + 1
+	float height(const int i, const int j) const
+	{
+		return heights_[(j + 1) * stride_ + (i + 1)];
+	}
+
+	vec3 position(const int i, const int j) const
+	{
+		return vec3((float)(min_.x + i * voxelSize_), height(i, j), (float)(min_.z + j * voxelSize_));
+	}
+
+	// The gradient of Density_Func's terrain term, y - height
+	vec3 normal(const int i, const int j) const
+	{
+		const float dx = (height(i + 1, j) - height(i - 1, j)) / (2.f * voxelSize_);
+		const float dz = (height(i, j + 1) - height(i, j - 1)) / (2.f * voxelSize_);
+		return glm::normalize(vec3(-dx, 1.f, -dz));
+	}
+
+private:
+
+	const int			cells_;
+	const int			voxelSize_;
+	const ivec3			min_;
+	const int			stride_;
+	std::vector<float>	heights_;
+};
+
+// ----------------------------------------------------------------------------
+
+// The error of every RTIN triangle, stored at the midpoint of its long edge
+// and including its children's (Martini, https://github.com/mapbox/martini)
+static void ComputeErrors(const HeightGrid& grid, std::vector<float>& errors)
+{
+	const int tileSize = grid.cells();
+	const int gridSize = tileSize + 1;
+	errors.assign(gridSize * gridSize, 0.f);
+
+	const int numSmallestTriangles = tileSize * tileSize;
+	const int numTriangles = numSmallestTriangles * 2 - 2;
+	const int lastLevelIndex = numTriangles - numSmallestTriangles;
+
+	// smallest triangles first, the position of each follows from its index
+	// in the implicit binary tree
+	for (int i = numTriangles - 1; i >= 0; i--)
+	{
+		int id = i + 2;
+		int ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+		if (id & 1)
+		{
+			bx = by = cx = tileSize;
+		}
+		else
+		{
+			ax = ay = cy = tileSize;
+		}
+
+		while ((id >>= 1) > 1)
+		{
+			const int mx = (ax + bx) >> 1;
+			const int my = (ay + by) >> 1;
+
+			if (id & 1)
+			{
+				bx = ax; by = ay;
+				ax = cx; ay = cy;
+			}
+			else
+			{
+				ax = bx; ay = by;
+				bx = cx; by = cy;
+			}
+
+			cx = mx; cy = my;
+		}
+
+		const float interpolated = 0.5f * (grid.height(ax, ay) + grid.height(bx, by));
+		const int mx = (ax + bx) >> 1;
+		const int my = (ay + by) >> 1;
+		const float middleError = std::abs(interpolated - grid.height(mx, my));
+
+		float& error = errors[my * gridSize + mx];
+		if (i >= lastLevelIndex)
+		{
+			error = middleError;
+		}
+		else
+		{
+			const float left = errors[((ay + cy) >> 1) * gridSize + ((ax + cx) >> 1)];
+			const float right = errors[((by + cy) >> 1) * gridSize + ((bx + cx) >> 1)];
+			error = std::max(std::max(error, middleError), std::max(left, right));
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static void SplitTriangle(const std::vector<float>& errors, const int gridSize, const float maxError,
+	const ivec2& a, const ivec2& b, const ivec2& c, std::vector<ivec2>& triangles)
+{
+	const ivec2 m = (a + b) / 2;
+	if (std::abs(a.x - c.x) + std::abs(a.y - c.y) > 1 && errors[m.y * gridSize + m.x] > maxError)
+	{
+		SplitTriangle(errors, gridSize, maxError, c, a, m, triangles);
+		SplitTriangle(errors, gridSize, maxError, b, c, m, triangles);
+		return;
+	}
+
+	triangles.push_back(a);
+	triangles.push_back(b);
+	triangles.push_back(c);
+}
+
+// ----------------------------------------------------------------------------
+
+// Corner coordinates, three per triangle in no particular winding
+static void Triangulate(const HeightGrid& grid, std::vector<ivec2>& triangles)
+{
+	const int n = grid.cells();
+	if (!IsPowerOfTwo(n))
+	{
+		for (int j = 0; j < n; j++)
+		for (int i = 0; i < n; i++)
+		{
+			const ivec2 corners[4] = { ivec2(i, j), ivec2(i + 1, j), ivec2(i + 1, j + 1), ivec2(i, j + 1) };
+			triangles.insert(end(triangles), { corners[0], corners[1], corners[2], corners[0], corners[2], corners[3] });
+		}
+		return;
+	}
+
+	std::vector<float> errors;
+	ComputeErrors(grid, errors);
+
+	const float maxError = MAX_ERROR_VOXELS * grid.voxelSize();
+	SplitTriangle(errors, n + 1, maxError, ivec2(0, 0), ivec2(n, n), ivec2(n, 0), triangles);
+	SplitTriangle(errors, n + 1, maxError, ivec2(n, n), ivec2(0, 0), ivec2(0, n), triangles);
+}
+
+// ----------------------------------------------------------------------------
+
+static void PushVertex(VertexData& vertices, const vec3& position, const vec3& normal)
+{
+	vertices.insert(end(vertices), { position.x, position.y, position.z, normal.x, normal.y, normal.z });
+}
+
+// ----------------------------------------------------------------------------
+
+// Which of the footprint's sides the edge lies along, -1 if none. Sides are
+// numbered -x, +x, -z, +z.
+static int BorderSide(const ivec2& a, const ivec2& b, const int n)
+{
+	if (a.x == b.x && (a.x == 0 || a.x == n))
+	{
+		return a.x == 0 ? 0 : 1;
+	}
+
+	if (a.y == b.y && (a.y == 0 || a.y == n))
+	{
+		return a.y == 0 ? 2 : 3;
+	}
+
+	return -1;
+}
+
+// ----------------------------------------------------------------------------
+
+// The voxels on the chunk's faces which the terrain passes through, as
+// BuildChunkSeam expects them from a fast_dc chunk. Each gets a vertex at the
+// surface over its column's centre, which the chunk's own triangles don't use.
+static void AddSeamVoxels(const HeightGrid& grid, const int minY, ChunkResult& result)
+{
+	const int n = grid.cells();
+	const int voxelSize = grid.voxelSize();
+
+	for (int j = 0; j < n; j++)
+	for (int i = 0; i < n; i++)
+	{
+		const bool side = i == 0 || j == 0 || i == n - 1 || j == n - 1;
+
+		const float corners[4] = { grid.height(i, j), grid.height(i + 1, j), grid.height(i, j + 1), grid.height(i + 1, j + 1) };
+		const float low = std::min(std::min(corners[0], corners[1]), std::min(corners[2], corners[3]));
+		const float high = std::max(std::max(corners[0], corners[1]), std::max(corners[2], corners[3]));
+		const float centre = 0.25f * (corners[0] + corners[1] + corners[2] + corners[3]);
+
+		const int first = std::max((int)std::floor((low - minY) / voxelSize), 0);
+		const int last = std::min((int)std::floor((high - minY) / voxelSize), n - 1);
+		for (int k = first; k <= last; k++)
+		{
+			if (!side && k != 0 && k != n - 1)
+			{
+				continue;
+			}
+
+			const float bottom = (float)(minY + k * voxelSize);
+
+			SeamVoxel voxel;
+			voxel.min = ivec3(grid.min().x + i * voxelSize, minY + k * voxelSize, grid.min().z + j * voxelSize);
+			voxel.size = voxelSize;
+			voxel.position = vec3(voxel.min.x + 0.5f * voxelSize, glm::clamp(centre, bottom, bottom + voxelSize), voxel.min.z + 0.5f * voxelSize);
+			voxel.normal = glm::normalize(grid.normal(i, j) + grid.normal(i + 1, j) + grid.normal(i, j + 1) + grid.normal(i + 1, j + 1));
+			voxel.vertex = result.numVertices();
+			PushVertex(result.vertices, voxel.position, voxel.normal);
+			result.seamVoxels.push_back(voxel);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool GenerateHeightfieldMesh(const ChunkRequest& request, ChunkResult& result, const std::atomic<bool>* cancel)
+{
+	HeightGrid grid(request);
+	if (grid.cells() <= 0 || !grid.sample(request.density.params, cancel))
+	{
+		return false;
+	}
+
+	std::vector<ivec2> triangles;
+	Triangulate(grid, triangles);
+
+	const int n = grid.cells();
+	const float minY = (float)grid.min().y;
+	const float maxY = minY + (float)request.size;
+	const float skirtDepth = SKIRT_DEPTH_VOXELS * grid.voxelSize();
+
+	// grid corner -> vertex, only the corners the chunk's triangles use
+	std::vector<int> vertexIndex((n + 1) * (n + 1), -1);
+	auto vertex = [&](const ivec2& corner)
+	{
+		int& index = vertexIndex[corner.y * (n + 1) + corner.x];
+		if (index < 0)
+		{
+			index = result.numVertices();
+			PushVertex(result.vertices, grid.position(corner.x, corner.y), grid.normal(corner.x, corner.y));
+		}
+		return index;
+	};
+
+	std::vector<ivec2> skirtEdges;
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		ivec2 a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+
+		// stacked chunks share the triangulation, each takes the triangles
+		// centred in its y range
+		const float centre = (grid.height(a.x, a.y) + grid.height(b.x, b.y) + grid.height(c.x, c.y)) / 3.f;
+		if (centre < minY || centre >= maxY)
+		{
+			continue;
+		}
+
+		// facing up, the other pipelines wind their faces outwards too
+		if ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) > 0)
+		{
+			std::swap(b, c);
+		}
+
+		result.indices.insert(end(result.indices), { vertex(a), vertex(b), vertex(c) });
+
+		const ivec2 edges[3][2] = { { a, b }, { b, c }, { c, a } };
+		for (const auto& edge : edges)
+		{
+			if (BorderSide(edge[0], edge[1], n) >= 0)
+			{
+				skirtEdges.push_back(edge[0]);
+				skirtEdges.push_back(edge[1]);
+			}
+		}
+	}
+
+	// a quad below each border edge, facing out of the chunk, which is the
+	// border edge walked backwards as the triangles above it face up
+	for (size_t e = 0; e < skirtEdges.size(); e += 2)
+	{
+		const int top0 = vertex(skirtEdges[e]);
+		const int top1 = vertex(skirtEdges[e + 1]);
+
+		const int bottom0 = result.numVertices();
+		PushVertex(result.vertices, grid.position(skirtEdges[e].x, skirtEdges[e].y) - vec3(0.f, skirtDepth, 0.f), grid.normal(skirtEdges[e].x, skirtEdges[e].y));
+		const int bottom1 = result.numVertices();
+		PushVertex(result.vertices, grid.position(skirtEdges[e + 1].x, skirtEdges[e + 1].y) - vec3(0.f, skirtDepth, 0.f), grid.normal(skirtEdges[e + 1].x, skirtEdges[e + 1].y));
+
+		result.indices.insert(end(result.indices), { top1, top0, bottom0, top1, bottom0, bottom1 });
+	}
+
+	AddSeamVoxels(grid, grid.min().y, result);
+
+	return !IsCancelled(cancel);
+}
+
+// ----------------------------------------------------------------------------
+
+size_t EstimateHeightfieldBytes(const ChunkRequest& request)
+{
+	const size_t corners = (size_t)((request.size >> request.lod) + 3);
+
+	// heights, RTIN errors and vertex indices, then up to two triangles a cell
+	return corners * corners * (2 * sizeof(float) + sizeof(int)) +
+		corners * corners * 2 * 3 * sizeof(ivec2);
+}
+
+// ----------------------------------------------------------------------------
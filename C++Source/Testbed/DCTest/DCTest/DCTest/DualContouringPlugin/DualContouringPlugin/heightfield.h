@@ -0,0 +1,32 @@
+#ifndef		HAS_HEIGHTFIELD_H_BEEN_INCLUDED
+#define		HAS_HEIGHTFIELD_H_BEEN_INCLUDED
+
+#include <atomic>
+#include <stddef.h>
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+// Far-field pipeline for chunks where the volume is a plain heightfield (see
+// Density_IsHeightfield), i.e. horizon terrain with no overhangs. Only the 2D
+// terrain height is sampled, once per voxel corner of the chunk's footprint
+// instead of once per voxel corner of its volume, and the grid is simplified
+// with a right-triangulated irregular network (RTIN) to within a fraction of
+// a voxel. Chunks whose voxel count isn't a power of two keep the full grid.
+//
+// Chunks stacked in y share the footprint and so the triangulation, each keeps
+// the triangles whose centre falls in its y range. Skirts hang from the
+// footprint's edges to hide cracks against coarser or differently simplified
+// neighbours, and the voxels on the chunk's faces are emitted as SeamVoxels so
+// fast_dc neighbours stitch their seams against the heightfield too.
+//
+// Returns false (leaving the result empty) if the cancel flag was raised.
+bool GenerateHeightfieldMesh(const ChunkRequest& request, ChunkResult& result, const std::atomic<bool>* cancel = nullptr);
+
+// The height samples and triangulation, see EstimateGenerationBytes
+size_t EstimateHeightfieldBytes(const ChunkRequest& request);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_HEIGHTFIELD_H_BEEN_INCLUDED
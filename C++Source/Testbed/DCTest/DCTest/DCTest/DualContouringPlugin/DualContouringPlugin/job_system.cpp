@@ -0,0 +1,1005 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "chunk_archive.h"
+#include "chunk_merge.h"
+#include "chunk_seams.h"
+#include "chunk_stages.h"
+#include "mesh_cache.h"
+
+// ----------------------------------------------------------------------------
+
+// std heaps keep the largest element at the front, so the job which should run
+// last compares as the smallest
+static bool RunsLater(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b)
+{
+	if (a->speculative != b->speculative)
+	{
+		return a->speculative;
+	}
+
+	if (a->priority != b->priority)
+	{
+		return a->priority > b->priority;
+	}
+
+	return a->sequence > b->sequence;
+}
+
+// ----------------------------------------------------------------------------
+
+// Distance from the viewer to the nearest point of the chunk, chunks are
+// centred on their position in both pipelines
+static float DistanceToChunk(const glm::vec3& viewer, const ChunkRequest& request)
+{
+	const glm::vec3 centre(request.position);
+	const glm::vec3 outside = glm::abs(viewer - centre) - glm::vec3(request.size * 0.5f);
+	return glm::length(glm::max(outside, glm::vec3(0.f)));
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorStats::record(const bool completed, const ChunkResult& result, const long long microseconds)
+{
+	if (completed)
+	{
+		chunksGenerated++;
+		if (result.contents != ChunkContents_Surface)
+		{
+			chunksRejected++;
+		}
+
+		verticesGenerated += result.numVertices();
+		trianglesGenerated += (long long)result.indices.size() / 3;
+	}
+	else
+	{
+		chunksCancelled++;
+	}
+
+	generationMicroseconds += microseconds;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorStats::copyTo(ContextStats& stats) const
+{
+	stats.chunksGenerated = chunksGenerated.load();
+	stats.chunksCancelled = chunksCancelled.load();
+	stats.verticesGenerated = verticesGenerated.load();
+	stats.trianglesGenerated = trianglesGenerated.load();
+	stats.generationMicroseconds = generationMicroseconds.load();
+	stats.chunksFromArchive = chunksFromArchive.load();
+	stats.chunksRejected = chunksRejected.load();
+	stats.chunksFromCache = chunksFromCache.load();
+}
+
+// ----------------------------------------------------------------------------
+
+JobSystem::JobSystem(int numThreads, GeneratorStats* stats, MemoryGovernor* memory, MeshCache* cache)
+	: stats_(stats)
+	, memory_(memory)
+	, cache_(cache)
+{
+	if (numThreads == 0)
+	{
+		// leave a core free for the main thread
+		numThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+	}
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		workers_.emplace_back(&JobSystem::workerLoop, this);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		shutdown_ = true;
+
+		for (auto& job : queue_)
+		{
+			job->status = JobStatus_Cancelled;
+		}
+		queue_.clear();
+		posted_.clear();
+
+		for (auto& pair : jobs_)
+		{
+			pair.second->cancel = true;
+		}
+	}
+
+	queueCondition_.notify_all();
+	finishedCondition_.notify_all();
+
+	for (auto& worker : workers_)
+	{
+		worker.join();
+	}
+
+	if (memory_)
+	{
+		// chains dropped with posted_ never got to remove theirs
+		memory_->add(Memory_Generation, -slicedWorkingBytes_ - stagedWorkingBytes_.load());
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto& pair : jobs_)
+		{
+			account(*pair.second, 0);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int JobSystem::submit(const ChunkRequest& request)
+{
+	int id = 0;
+	submit(&request, 1, &id);
+	return id;
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::submit(const ChunkRequest* requests, const int count, int* ids, const bool speculative)
+{
+	// the cache is checked before the jobs are visible to the workers, so a
+	// hit never races a worker picking the same job up
+	std::vector<std::shared_ptr<Job>> jobs(count);
+	std::vector<bool> cached(count, false);
+	std::vector<bool> failed(count, false);
+	for (int i = 0; i < count; i++)
+	{
+		jobs[i] = std::make_shared<Job>();
+		jobs[i]->request = requests[i];
+		jobs[i]->speculative = speculative;
+
+		if (!IsValidChunkRequest(requests[i]))
+		{
+			failed[i] = true;
+		}
+		else if (cache_)
+		{
+			jobs[i]->cacheEpoch = cache_->epoch();
+			cached[i] = cache_->load(requests[i], jobs[i]->result);
+		}
+	}
+
+	int numQueued = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (int i = 0; i < count; i++)
+		{
+			if (shutdown_)
+			{
+				ids[i] = 0;
+				cached[i] = false;
+				failed[i] = false;
+				continue;
+			}
+
+			auto& job = jobs[i];
+			job->id = nextID_++;
+			if (nextID_ <= 0)
+			{
+				nextID_ = 1;
+			}
+
+			jobs_[job->id] = job;
+			ids[i] = job->id;
+
+			if (failed[i])
+			{
+				job->status = JobStatus_Failed;
+			}
+			else if (cached[i])
+			{
+				job->status = JobStatus_Done;
+				account(*job, heldBytes(*job));
+			}
+			else
+			{
+				enqueue(job);
+				numQueued++;
+			}
+		}
+	}
+
+	// no enforce() here, the clipmap submits while holding its lock
+	for (int i = 0; i < count; i++)
+	{
+		if (cached[i] && stats_)
+		{
+			stats_->chunksFromCache++;
+		}
+
+		if (cached[i] || failed[i])
+		{
+			publish(*jobs[i]);
+		}
+	}
+
+	if (numQueued > 0)
+	{
+		queueCondition_.notify_all();
+	}
+
+	if (numQueued < count)
+	{
+		finishedCondition_.notify_all();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+float JobSystem::rank(const ChunkRequest& request) const
+{
+	float distance = DistanceToChunk(viewer_.position, request);
+
+	const glm::vec3 centre(request.position);
+	const float radius = request.size * 0.866025f;
+	for (int i = 0; i < viewer_.numFrustumPlanes; i++)
+	{
+		const glm::vec4& plane = viewer_.frustumPlanes[i];
+		if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius)
+		{
+			distance *= viewer_.outsideFrustumScale;
+			break;
+		}
+	}
+
+	// measured in voxels of the chunk's own LOD, so each ring of coarser chunks
+	// is interleaved with the finer rings inside it instead of waiting behind them
+	return distance / (float)(1 << request.lod);
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+void JobSystem::enqueue(const std::shared_ptr<Job>& job)
+{
+	job->sequence = nextSequence_++;
+	job->priority = rank(job->request);
+
+	queue_.push_back(job);
+	std::push_heap(begin(queue_), end(queue_), RunsLater);
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_, returns true if the job was still waiting to run
+bool JobSystem::removeQueued(const std::shared_ptr<Job>& job)
+{
+	const auto queued = std::find(begin(queue_), end(queue_), job);
+	if (queued == end(queue_))
+	{
+		return false;
+	}
+
+	queue_.erase(queued);
+	std::make_heap(begin(queue_), end(queue_), RunsLater);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+std::shared_ptr<Job> JobSystem::find(int id) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	const auto iter = jobs_.find(id);
+	return iter != end(jobs_) ? iter->second : nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+int JobSystem::poll(int id) const
+{
+	const auto job = find(id);
+	return job ? job->status.load() : JobStatus_Invalid;
+}
+
+// ----------------------------------------------------------------------------
+
+int JobSystem::wait(int id, int timeoutMs)
+{
+	const auto job = find(id);
+	if (!job)
+	{
+		return JobStatus_Invalid;
+	}
+
+	const auto finished = [&]()
+	{
+		const int status = job->status.load();
+		return shutdown_ || (status != JobStatus_Pending && status != JobStatus_Running);
+	};
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (timeoutMs < 0)
+	{
+		finishedCondition_.wait(lock, finished);
+	}
+	else
+	{
+		finishedCondition_.wait_for(lock, std::chrono::milliseconds(timeoutMs), finished);
+	}
+
+	return job->status.load();
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::cancel(int id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	const auto iter = jobs_.find(id);
+	if (iter == end(jobs_))
+	{
+		return;
+	}
+
+	const auto& job = iter->second;
+	job->cancel = true;
+
+	if (removeQueued(job))
+	{
+		job->status = JobStatus_Cancelled;
+		publish(*job);
+		finishedCondition_.notify_all();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::setSpeculative(int id, bool speculative)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	const auto iter = jobs_.find(id);
+	if (iter == end(jobs_) || iter->second->speculative == speculative)
+	{
+		return;
+	}
+
+	const auto& job = iter->second;
+	job->speculative = speculative;
+	account(*job, job->accountedBytes);
+
+	if (std::find(begin(queue_), end(queue_), job) != end(queue_))
+	{
+		std::make_heap(begin(queue_), end(queue_), RunsLater);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+const ChunkResult* JobSystem::result(int id) const
+{
+	const auto job = find(id);
+	if (!job || job->status.load() != JobStatus_Done)
+	{
+		return nullptr;
+	}
+
+	return &job->result;
+}
+
+// ----------------------------------------------------------------------------
+
+bool JobSystem::footprint(int id, long long& bytes, long long& microseconds) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	const auto iter = jobs_.find(id);
+	if (iter == end(jobs_) || iter->second->status.load() != JobStatus_Done)
+	{
+		return false;
+	}
+
+	bytes = iter->second->accountedBytes;
+	microseconds = iter->second->microseconds;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::release(int id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	const auto iter = jobs_.find(id);
+	if (iter == end(jobs_))
+	{
+		return;
+	}
+
+	// a running job keeps its own reference and is freed when the worker drops it
+	const auto job = iter->second;
+	job->cancel = true;
+	jobs_.erase(iter);
+
+	removeQueued(job);
+	account(*job, 0);
+}
+
+// ----------------------------------------------------------------------------
+
+bool JobSystem::buildSeam(int id, const int* neighbours, int numNeighbours)
+{
+	const auto job = find(id);
+	if (!job || job->status.load() != JobStatus_Done)
+	{
+		return false;
+	}
+
+	// the references keep the neighbours alive if they're released meanwhile
+	std::vector<std::shared_ptr<Job>> neighbourJobs;
+	std::vector<const ChunkResult*> results;
+	for (int i = 0; i < numNeighbours; i++)
+	{
+		const auto neighbour = find(neighbours[i]);
+		if (neighbour && neighbour != job && neighbour->status.load() == JobStatus_Done)
+		{
+			neighbourJobs.push_back(neighbour);
+			results.push_back(&neighbour->result);
+		}
+	}
+
+	if (!BuildChunkSeam(job->request, job->result, results.data(), (int)results.size()))
+	{
+		return false;
+	}
+
+	// not enforced here, the clipmap builds seams holding the lock its
+	// evictions take. The next job to finish catches up.
+	std::lock_guard<std::mutex> lock(mutex_);
+	account(*job, heldBytes(*job));
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+int JobSystem::merge(const int* ids, int numIDs, bool optimizeVertexCache)
+{
+	std::vector<std::shared_ptr<Job>> members;
+	std::vector<const ChunkRequest*> requests;
+	std::vector<const ChunkResult*> results;
+	for (int i = 0; i < numIDs; i++)
+	{
+		const auto member = find(ids[i]);
+		if (member && member->status.load() == JobStatus_Done)
+		{
+			members.push_back(member);
+			requests.push_back(&member->request);
+			results.push_back(&member->result);
+		}
+	}
+
+	if (members.empty())
+	{
+		return 0;
+	}
+
+	// the request describes the box the members cover, at their LOD
+	glm::ivec3 min = requests[0]->position - glm::ivec3(requests[0]->size / 2);
+	glm::ivec3 max = min + glm::ivec3(requests[0]->size);
+	for (const ChunkRequest* request : requests)
+	{
+		const glm::ivec3 memberMin = request->position - glm::ivec3(request->size / 2);
+		min = glm::min(min, memberMin);
+		max = glm::max(max, memberMin + glm::ivec3(request->size));
+	}
+
+	const glm::ivec3 extent = max - min;
+	auto job = std::make_shared<Job>();
+	job->request = *requests[0];
+	job->request.size = glm::max(extent.x, glm::max(extent.y, extent.z));
+	job->request.position = min + glm::ivec3(job->request.size / 2);
+
+	const auto start = std::chrono::steady_clock::now();
+	MergeChunkMeshes(requests.data(), results.data(), (int)members.size(), job->result, optimizeVertexCache);
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	job->microseconds = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (shutdown_)
+		{
+			return 0;
+		}
+
+		job->id = nextID_++;
+		if (nextID_ <= 0)
+		{
+			nextID_ = 1;
+		}
+
+		jobs_[job->id] = job;
+		job->status = JobStatus_Done;
+		account(*job, heldBytes(*job));
+	}
+
+	publish(*job);
+	finishedCondition_.notify_all();
+	return job->id;
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::setViewer(const ViewerParams& viewer)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	viewer_ = viewer;
+	viewerChanged_ = true;
+
+	if (viewer.cancelDistance <= 0.f)
+	{
+		return;
+	}
+
+	bool cancelledQueued = false;
+	for (auto& pair : jobs_)
+	{
+		const auto& job = pair.second;
+		const int status = job->status.load();
+		if (status != JobStatus_Pending && status != JobStatus_Running)
+		{
+			continue;
+		}
+
+		if (DistanceToChunk(viewer.position, job->request) > viewer.cancelDistance)
+		{
+			// running jobs notice the flag at their next check and finish as cancelled
+			job->cancel = true;
+			if (status == JobStatus_Pending)
+			{
+				job->status = JobStatus_Cancelled;
+				publish(*job);
+				cancelledQueued = true;
+			}
+		}
+	}
+
+	if (cancelledQueued)
+	{
+		const auto cancelled = [](const std::shared_ptr<Job>& job) { return job->status.load() == JobStatus_Cancelled; };
+		queue_.erase(std::remove_if(begin(queue_), end(queue_), cancelled), end(queue_));
+		std::make_heap(begin(queue_), end(queue_), RunsLater);
+		finishedCondition_.notify_all();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+ViewerParams JobSystem::viewer() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return viewer_;
+}
+
+// ----------------------------------------------------------------------------
+
+int JobSystem::numPending() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (int)queue_.size();
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::publish(const Job& job)
+{
+	CompletedJob completed;
+	completed.job = job.id;
+	completed.status = job.status.load();
+	completed.bytes = completed.status == JobStatus_Done ?
+		(int)(job.result.vertices.size() * sizeof(float) + job.result.indices.size() * sizeof(int)) : 0;
+	completed.contents = job.result.contents;
+
+	// a full queue raises the overflow flag, there's nothing else to do here
+	completed_.push(completed);
+}
+
+// ----------------------------------------------------------------------------
+
+int JobSystem::drainCompleted(CompletedJob* jobs, int maxJobs, int maxBytes, bool& overflowed)
+{
+	overflowed = completed_.overflowed();
+
+	int count = 0;
+	int bytes = 0;
+	CompletedJob completed;
+	while (count < maxJobs && completed_.peek(completed))
+	{
+		if (count > 0 && maxBytes > 0 && bytes + completed.bytes > maxBytes)
+		{
+			break;
+		}
+
+		completed_.pop();
+		jobs[count++] = completed;
+		bytes += completed.bytes;
+	}
+
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::post(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (shutdown_)
+		{
+			return;
+		}
+
+		posted_.push_back(std::move(task));
+	}
+
+	queueCondition_.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_ and have checked the queue isn't empty
+std::shared_ptr<Job> JobSystem::dequeue()
+{
+	if (viewerChanged_)
+	{
+		for (auto& queued : queue_)
+		{
+			queued->priority = rank(queued->request);
+		}
+
+		std::make_heap(begin(queue_), end(queue_), RunsLater);
+		viewerChanged_ = false;
+	}
+
+	std::pop_heap(begin(queue_), end(queue_), RunsLater);
+	const auto job = queue_.back();
+	queue_.pop_back();
+	job->status = JobStatus_Running;
+
+	return job;
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::setArchive(const std::shared_ptr<ChunkArchive>& archive)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	archive_ = archive;
+}
+
+// ----------------------------------------------------------------------------
+
+// Finishes the job straight away if its chunk is in the archive
+bool JobSystem::loadArchived(Job& job, ChunkArchive* archive)
+{
+	if (!archive || job.cancel.load() || !archive->load(job.request, job.result))
+	{
+		return false;
+	}
+
+	if (stats_)
+	{
+		stats_->chunksFromArchive++;
+	}
+
+	finishLoaded(job);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// As finish, for a result which was loaded rather than generated
+void JobSystem::finishLoaded(Job& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job.status = JobStatus_Done;
+		account(job, heldBytes(job));
+
+		// released while it was loading, nobody is left to drain the id
+		if (isHeld(job))
+		{
+			publish(job);
+		}
+	}
+
+	finishedCondition_.notify_all();
+
+	if (memory_)
+	{
+		memory_->enforce();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. False once the job has been released, it may still be
+// finishing on a worker (or in runFor) then.
+bool JobSystem::isHeld(const Job& job) const
+{
+	const auto iter = jobs_.find(job.id);
+	return iter != end(jobs_) && iter->second.get() == &job;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. What the job's result holds, only a finished job which
+// hasn't been released counts.
+long long JobSystem::heldBytes(const Job& job) const
+{
+	return isHeld(job) && job.status.load() == JobStatus_Done ? (long long)job.result.memoryBytes() : 0;
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. Moves the job's entry in the memory governor to bytes,
+// in the category its speculative flag picks.
+void JobSystem::account(Job& job, const long long bytes)
+{
+	if (!memory_)
+	{
+		return;
+	}
+
+	const MemoryCategory category = job.speculative ? Memory_Prefetch : Memory_JobResults;
+
+	memory_->add(job.accountedCategory, -job.accountedBytes);
+	memory_->add(category, bytes);
+	job.accountedBytes = bytes;
+	job.accountedCategory = category;
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::finish(Job& job, const bool completed, const long long microseconds)
+{
+	if (stats_)
+	{
+		stats_->record(completed, job.result, microseconds);
+	}
+
+	// before the job is done, the caller may start building its seam then
+	if (completed && cache_)
+	{
+		cache_->store(job.request, job.result, microseconds, job.cacheEpoch);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job.status = completed ? JobStatus_Done : JobStatus_Cancelled;
+		job.microseconds = microseconds;
+		account(job, heldBytes(job));
+
+		// under the lock so a release can't slip in between, a job released
+		// while it ran isn't published since its id belongs to nobody now
+		if (isHeld(job))
+		{
+			publish(job);
+		}
+	}
+
+	finishedCondition_.notify_all();
+
+	// outside the lock, evicting calls back into the job system
+	if (memory_)
+	{
+		memory_->enforce();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void JobSystem::workerLoop()
+{
+	for (;;)
+	{
+		std::shared_ptr<Job> job;
+		std::function<void()> task;
+		std::shared_ptr<ChunkArchive> archive;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			queueCondition_.wait(lock, [&]() { return shutdown_ || !posted_.empty() || !queue_.empty(); });
+
+			if (shutdown_)
+			{
+				return;
+			}
+
+			if (!posted_.empty())
+			{
+				task = std::move(posted_.front());
+				posted_.pop_front();
+			}
+			else
+			{
+				job = dequeue();
+				archive = archive_;
+			}
+		}
+
+		if (task)
+		{
+			task();
+			continue;
+		}
+
+		runStages(job, archive);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Starts the job's chain of stages (see chunk_stages.h) and returns, the
+// stages are posted back to the workers so they interleave with other chunks'
+void JobSystem::runStages(const std::shared_ptr<Job>& job, const std::shared_ptr<ChunkArchive>& archive)
+{
+	const long long workingBytes = memory_ ? (long long)EstimateGenerationBytes(job->request) : 0;
+	if (memory_)
+	{
+		stagedWorkingBytes_ += workingBytes;
+		memory_->add(Memory_Generation, workingBytes);
+	}
+
+	// the cache was checked at submit too, this catches a duplicate request
+	// which finished while the job was queued
+	const ChunkStagePtr chunk = std::make_shared<ChunkStageState>(job->request, &job->cancel);
+	chunk->cache = cache_;
+	chunk->archive = archive;
+
+	ScheduleChunkStages(*this, chunk).then([this, job, workingBytes](const ChunkStagePtr& chunk)
+	{
+		if (memory_)
+		{
+			stagedWorkingBytes_ -= workingBytes;
+			memory_->add(Memory_Generation, -workingBytes);
+		}
+
+		job->result = std::move(chunk->result);
+		if (chunk->completed && chunk->source != ChunkSource_Generated)
+		{
+			if (stats_ && chunk->source == ChunkSource_Archive)
+			{
+				stats_->chunksFromArchive++;
+			}
+			else if (stats_)
+			{
+				stats_->chunksFromCache++;
+			}
+
+			finishLoaded(*job);
+		}
+		else
+		{
+			finish(*job, chunk->completed, chunk->microseconds);
+		}
+
+		return chunk;
+	});
+}
+
+// ----------------------------------------------------------------------------
+
+int JobSystem::runFor(int microseconds)
+{
+	typedef ChunkGenerationTask::Clock Clock;
+	const auto deadline = Clock::now() + std::chrono::microseconds(microseconds);
+
+	int numFinished = 0;
+	while (microseconds > 0)
+	{
+		if (!sliced_)
+		{
+			std::function<void()> task;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (shutdown_ || (posted_.empty() && queue_.empty()))
+				{
+					break;
+				}
+
+				if (!posted_.empty())
+				{
+					task = std::move(posted_.front());
+					posted_.pop_front();
+				}
+			}
+
+			// posted work can't be split up, it's only started while there's time left
+			if (task)
+			{
+				task();
+				if (Clock::now() >= deadline)
+				{
+					break;
+				}
+				continue;
+			}
+
+			std::shared_ptr<Job> job;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (shutdown_ || queue_.empty())
+				{
+					break;
+				}
+
+				job = dequeue();
+				slicedArchive_ = archive_;
+			}
+
+			if (loadArchived(*job, slicedArchive_.get()))
+			{
+				slicedArchive_.reset();
+				numFinished++;
+				if (Clock::now() >= deadline)
+				{
+					break;
+				}
+				continue;
+			}
+
+			sliced_ = job;
+			slicedTask_.reset(new ChunkGenerationTask(sliced_->request, sliced_->result, &sliced_->cancel));
+			slicedMicroseconds_ = 0;
+
+			if (memory_)
+			{
+				slicedWorkingBytes_ = (long long)EstimateGenerationBytes(sliced_->request);
+				memory_->add(Memory_Generation, slicedWorkingBytes_);
+			}
+		}
+
+		const auto start = Clock::now();
+		const bool finished = slicedTask_->step(deadline);
+		slicedMicroseconds_ += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+		if (!finished)
+		{
+			break;
+		}
+
+		if (slicedTask_->completed() && slicedArchive_)
+		{
+			slicedArchive_->store(sliced_->request, sliced_->result);
+		}
+
+		if (memory_)
+		{
+			memory_->add(Memory_Generation, -slicedWorkingBytes_);
+			slicedWorkingBytes_ = 0;
+		}
+
+		finish(*sliced_, slicedTask_->completed(), slicedMicroseconds_);
+		slicedTask_.reset();
+		slicedArchive_.reset();
+		sliced_.reset();
+		numFinished++;
+
+		if (Clock::now() >= deadline)
+		{
+			break;
+		}
+	}
+
+	return numFinished;
+}
+
+// ----------------------------------------------------------------------------
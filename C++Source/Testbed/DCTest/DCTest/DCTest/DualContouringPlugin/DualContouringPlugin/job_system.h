@@ -0,0 +1,275 @@
+#ifndef		HAS_JOB_SYSTEM_H_BEEN_INCLUDED
+#define		HAS_JOB_SYSTEM_H_BEEN_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk_generator.h"
+#include "completion_queue.h"
+#include "memory_governor.h"
+
+class ChunkArchive;
+class MeshCache;
+
+// ----------------------------------------------------------------------------
+
+// Values are shared with the managed side (DualContouringDLL.JobStatus)
+enum JobStatus
+{
+	JobStatus_Invalid = -1,
+	JobStatus_Pending = 0,
+	JobStatus_Running = 1,
+	JobStatus_Done = 2,
+	JobStatus_Cancelled = 3,
+	JobStatus_Failed = 4,		// the request was invalid, see IsValidChunkRequest
+};
+
+// ----------------------------------------------------------------------------
+
+// Plain copy of GeneratorStats, shared with the managed side (DualContouringDLL.ContextStats)
+struct ContextStats
+{
+	long long	chunksGenerated;
+	long long	chunksCancelled;
+	long long	verticesGenerated;
+	long long	trianglesGenerated;
+	long long	generationMicroseconds;
+	long long	chunksFromArchive;
+	long long	chunksRejected;
+	long long	chunksFromCache;
+};
+
+// Updated by the workers (and synchronous calls) as chunks complete
+struct GeneratorStats
+{
+	std::atomic<long long>	chunksGenerated { 0 };
+	std::atomic<long long>	chunksCancelled { 0 };
+	std::atomic<long long>	verticesGenerated { 0 };
+	std::atomic<long long>	trianglesGenerated { 0 };
+	std::atomic<long long>	generationMicroseconds { 0 };
+
+	// served by the chunk archive instead of being generated, not counted above
+	std::atomic<long long>	chunksFromArchive { 0 };
+
+	// found empty or solid by the bounds pass without sampling the volume,
+	// also counted in chunksGenerated
+	std::atomic<long long>	chunksRejected { 0 };
+
+	// found in the mesh cache when submitted, counted in neither of the above
+	std::atomic<long long>	chunksFromCache { 0 };
+
+	void record(const bool completed, const ChunkResult& result, const long long microseconds);
+	void copyTo(ContextStats& stats) const;
+};
+
+// ----------------------------------------------------------------------------
+
+// Where the caller is looking from, updated as often as the camera moves.
+// Shared with the managed side (DualContouringDLL.ViewerParams).
+struct ViewerParams
+{
+	glm::vec3		position = glm::vec3(0.f);
+
+	// plane normals point into the frustum, as GeometryUtility.CalculateFrustumPlanes
+	// returns them, i.e. a point p is inside when dot(xyz, p) + w >= 0
+	glm::vec4		frustumPlanes[6];
+	int				numFrustumPlanes = 0;
+
+	// distance multiplier for chunks entirely outside the frustum
+	float			outsideFrustumScale = 4.f;
+
+	// chunks further away than this are cancelled, 0 keeps everything
+	float			cancelDistance = 0.f;
+};
+
+// ----------------------------------------------------------------------------
+
+struct Job
+{
+	int					id = 0;
+	ChunkRequest		request;
+	ChunkResult			result;
+	std::atomic<int>	status { JobStatus_Pending };
+	std::atomic<bool>	cancel { false };
+
+	// scheduling key, lower runs first, ties go to the earliest submitted.
+	// Speculative jobs run after every other queued job whatever their
+	// priority. All three are guarded by the job system's mutex.
+	float				priority = 0.f;
+	long long			sequence = 0;
+	bool				speculative = false;
+
+	// what the result is counted as in the MemoryGovernor, also guarded by
+	// the mutex, and how long it took to generate (0 if it came from the archive)
+	long long			accountedBytes = 0;
+	MemoryCategory		accountedCategory = Memory_JobResults;
+	long long			microseconds = 0;
+
+	// the mesh cache's epoch when the job was submitted, see MeshCache::store
+	uint64_t			cacheEpoch = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+// Owns a fixed set of worker threads which start the most important pending
+// chunk first, ranked by distance to the viewer (see setViewer). Each chunk
+// runs as a chain of stages (see chunk_stages.h), a started chunk's stages run
+// ahead of chunks still queued and interleave with other chunks'. Jobs are
+// addressed by an integer handle so they can cross the P/Invoke boundary,
+// handle 0 is never issued.
+class JobSystem
+{
+public:
+
+	// stats, memory and cache are optional and must outlive the job system.
+	// numThreads 0 picks one worker per spare core, a negative count starts no
+	// workers at all and jobs only make progress through runFor. Finished
+	// results and chunks being generated are counted in memory, and its
+	// budget is enforced whenever a job finishes. Chunks found in the cache
+	// are done as soon as they're submitted, generated chunks are stored in it.
+	explicit JobSystem(int numThreads = 0, GeneratorStats* stats = nullptr, MemoryGovernor* memory = nullptr, MeshCache* cache = nullptr);
+	~JobSystem();
+
+	// A request IsValidChunkRequest rejects isn't queued, its job finishes
+	// straight away as JobStatus_Failed with an empty result
+	int submit(const ChunkRequest& request);
+
+	// Queues every request under a single lock and wakes all the workers,
+	// the handle for requests[i] is written to ids[i]. Speculative jobs (e.g.
+	// the clipmap's prefetch) wait behind everything else in the queue.
+	void submit(const ChunkRequest* requests, const int count, int* ids, const bool speculative = false);
+
+	// Moves a queued job in or out of the speculative tier, e.g. once a
+	// prefetched chunk turns out to be needed. A job which has already
+	// started is left alone.
+	void setSpeculative(int id, bool speculative);
+
+	int poll(int id) const;
+
+	// Blocks until the job has finished or been cancelled, a negative timeout
+	// waits forever. Returns the job status at the point of return. Without
+	// workers nothing finishes the job while this waits, see runFor.
+	int wait(int id, int timeoutMs);
+
+	// Pending jobs are dropped before they start, running jobs stop at the
+	// next point the pipeline checks the cancel flag.
+	void cancel(int id);
+
+	// Only valid once the job is done, and until it is released
+	const ChunkResult* result(int id) const;
+
+	// The memory a finished job's result holds and what it cost to generate,
+	// for MemoryGovernor consumers. False unless the job is done.
+	bool footprint(int id, long long& bytes, long long& microseconds) const;
+
+	void release(int id);
+
+	// Rebuilds the seam of a finished fast_dc job against the given finished
+	// neighbours (see chunk_seams.h). The job's mesh changes in place, so call
+	// from the thread which reads the meshes. Returns false if the job isn't
+	// done or has no seam voxels.
+	bool buildSeam(int id, const int* neighbours, int numNeighbours);
+
+	// Merges finished jobs' meshes into a new finished job (see chunk_merge.h)
+	// which is published like any other and released on its own, the members
+	// are left as they were. Members which aren't done are skipped, returns 0
+	// if none are. Call from the thread which reads the meshes, as buildSeam.
+	int merge(const int* ids, int numIDs, bool optimizeVertexCache);
+
+	// Pending jobs are re-ranked lazily, the next worker to dequeue rebuilds
+	// the heap once, so calling this every frame is cheap. Jobs beyond the
+	// viewer's cancelDistance are cancelled straight away.
+	void setViewer(const ViewerParams& viewer);
+	ViewerParams viewer() const;
+
+	int numPending() const;
+
+	// Every job which finishes or is cancelled (other than by release) is
+	// published to a lock-free queue. Call from one thread only, normally once
+	// per frame: returns up to maxJobs entries, stopping early once maxBytes of
+	// mesh data has been returned (0 = no byte limit, at least one entry is
+	// always returned when available). overflowed is set if entries were lost
+	// because the queue filled up, the caller should then poll its jobs.
+	int drainCompleted(CompletedJob* jobs, int maxJobs, int maxBytes, bool& overflowed);
+
+	// Runs an arbitrary piece of work on the workers (or in runFor), ahead of
+	// any queued chunks since posted work is normally the next stage of a
+	// chunk which has already started, see stage_task.h. Work still queued
+	// when the job system is destroyed is dropped without running.
+	void post(std::function<void()> task);
+
+	// Generates pending jobs on the calling thread until the budget is spent,
+	// for callers which want to bound the time spent per frame instead of (or
+	// as well as) running workers. A chunk which doesn't fit is picked up where
+	// it stopped on the next call. Call from one thread only. Returns the
+	// number of jobs which finished or were cancelled during the call.
+	int runFor(int microseconds);
+
+	int numThreads() const { return (int)workers_.size(); }
+
+	// Jobs which start after this check the archive first and store what they
+	// generate, null turns it off. Jobs already running keep the one they had.
+	void setArchive(const std::shared_ptr<ChunkArchive>& archive);
+
+private:
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	std::shared_ptr<Job> find(int id) const;
+	void enqueue(const std::shared_ptr<Job>& job);
+	bool removeQueued(const std::shared_ptr<Job>& job);
+	float rank(const ChunkRequest& request) const;
+	std::shared_ptr<Job> dequeue();
+	bool loadArchived(Job& job, ChunkArchive* archive);
+	void finishLoaded(Job& job);
+	bool isHeld(const Job& job) const;
+	long long heldBytes(const Job& job) const;
+	void account(Job& job, const long long bytes);
+	void finish(Job& job, const bool completed, const long long microseconds);
+	void publish(const Job& job);
+	void workerLoop();
+	void runStages(const std::shared_ptr<Job>& job, const std::shared_ptr<ChunkArchive>& archive);
+
+	std::vector<std::thread>		workers_;
+	std::vector<std::shared_ptr<Job>> queue_;	// binary heap, see enqueue
+	std::deque<std::function<void()>> posted_;
+	std::unordered_map<int, std::shared_ptr<Job>> jobs_;
+
+	mutable std::mutex				mutex_;
+	std::condition_variable			queueCondition_;
+	mutable std::condition_variable	finishedCondition_;
+
+	// the job runFor is part way through, the task writes into its result
+	std::shared_ptr<Job>			sliced_;
+	std::unique_ptr<ChunkGenerationTask> slicedTask_;
+	std::shared_ptr<ChunkArchive>	slicedArchive_;
+	long long						slicedMicroseconds_ = 0;
+	long long						slicedWorkingBytes_ = 0;
+
+	// working memory of the chunks whose stages are on the workers
+	std::atomic<long long>			stagedWorkingBytes_ { 0 };
+
+	CompletionQueue					completed_ { 4096 };
+	GeneratorStats*					stats_ = nullptr;
+	MemoryGovernor*					memory_ = nullptr;
+	MeshCache*						cache_ = nullptr;
+	std::shared_ptr<ChunkArchive>	archive_;
+	ViewerParams					viewer_;
+	bool							viewerChanged_ = false;
+
+	int								nextID_ = 1;
+	long long						nextSequence_ = 0;
+	bool							shutdown_ = false;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_JOB_SYSTEM_H_BEEN_INCLUDED
@@ -0,0 +1,152 @@
+#include "memory_governor.h"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+
+// An entry unused for this long is worth half as much as one used just now
+static const float RECENCY_SECONDS = 10.f;
+
+// ----------------------------------------------------------------------------
+
+float MemoryGovernor::evictionScore(const EvictionCandidate& candidate, const EvictionCandidate::Clock::time_point& now)
+{
+	const float age = std::chrono::duration<float>(now - candidate.lastUsed).count();
+	const float bytes = (float)std::max(candidate.bytes, 1LL);
+	return (float)(candidate.cost + 1) / (bytes * (1.f + std::max(age, 0.f) / RECENCY_SECONDS));
+}
+
+// ----------------------------------------------------------------------------
+
+MemoryGovernor::MemoryGovernor()
+{
+	for (auto& bytes : bytes_)
+	{
+		bytes = 0;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void MemoryGovernor::setBudget(const long long bytes)
+{
+	budget_ = std::max(bytes, 0LL);
+	enforce();
+}
+
+// ----------------------------------------------------------------------------
+
+void MemoryGovernor::add(const MemoryCategory category, const long long bytes)
+{
+	bytes_[category] += bytes;
+}
+
+// ----------------------------------------------------------------------------
+
+long long MemoryGovernor::total() const
+{
+	long long total = 0;
+	for (const auto& bytes : bytes_)
+	{
+		total += bytes.load();
+	}
+
+	return total;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MemoryGovernor::overBudget() const
+{
+	const long long budget = budget_.load();
+	return budget > 0 && total() > budget;
+}
+
+// ----------------------------------------------------------------------------
+
+void MemoryGovernor::addConsumer(MemoryConsumer* consumer)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	consumers_.push_back(consumer);
+}
+
+// ----------------------------------------------------------------------------
+
+void MemoryGovernor::removeConsumer(MemoryConsumer* consumer)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	consumers_.erase(std::remove(begin(consumers_), end(consumers_), consumer), end(consumers_));
+}
+
+// ----------------------------------------------------------------------------
+
+void MemoryGovernor::enforce()
+{
+	if (!overBudget())
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+	if (!lock.owns_lock())
+	{
+		return;
+	}
+
+	MemoryConsumer* previous = nullptr;
+	uint64_t previousID = 0;
+
+	while (overBudget())
+	{
+		const auto now = EvictionCandidate::Clock::now();
+
+		MemoryConsumer* victim = nullptr;
+		EvictionCandidate best;
+		float bestScore = 0.f;
+		for (MemoryConsumer* consumer : consumers_)
+		{
+			EvictionCandidate candidate;
+			if (!consumer->evictionCandidate(candidate))
+			{
+				continue;
+			}
+
+			const float score = evictionScore(candidate, now);
+			if (!victim || score < bestScore)
+			{
+				victim = consumer;
+				best = candidate;
+				bestScore = score;
+			}
+		}
+
+		// nothing left to evict, or a consumer which didn't let go last time
+		if (!victim || (victim == previous && best.id == previousID))
+		{
+			break;
+		}
+
+		victim->evict(best.id);
+		evictions_++;
+		evictedBytes_ += best.bytes;
+
+		previous = victim;
+		previousID = best.id;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void MemoryGovernor::usage(MemoryUsage& usage) const
+{
+	usage.budget = budget_.load();
+	usage.jobResults = bytes_[Memory_JobResults].load();
+	usage.prefetch = bytes_[Memory_Prefetch].load();
+	usage.generation = bytes_[Memory_Generation].load();
+	usage.meshCache = bytes_[Memory_MeshCache].load();
+	usage.total = usage.jobResults + usage.prefetch + usage.generation + usage.meshCache;
+	usage.evictions = evictions_.load();
+	usage.evictedBytes = evictedBytes_.load();
+}
+
+// ----------------------------------------------------------------------------
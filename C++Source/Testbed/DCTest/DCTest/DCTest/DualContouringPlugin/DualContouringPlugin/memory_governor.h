@@ -0,0 +1,128 @@
+#ifndef		HAS_MEMORY_GOVERNOR_H_BEEN_INCLUDED
+#define		HAS_MEMORY_GOVERNOR_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+
+enum MemoryCategory
+{
+	Memory_JobResults,		// finished meshes the caller hasn't released yet
+	Memory_Prefetch,		// finished speculative jobs nobody has asked for yet
+	Memory_Generation,		// lattices, octrees and mesh buffers of chunks being generated
+	Memory_MeshCache,		// finished meshes kept for chunks which come back, see MeshCache
+
+	Memory_CategoryCount
+};
+
+// Shared with the managed side (DualContouringDLL.MemoryUsage)
+struct MemoryUsage
+{
+	long long	budget;			// 0 when there is no budget
+	long long	total;
+	long long	jobResults;
+	long long	prefetch;
+	long long	generation;
+	long long	meshCache;
+	long long	evictions;
+	long long	evictedBytes;
+};
+
+// ----------------------------------------------------------------------------
+
+// One entry a cache is prepared to give up
+struct EvictionCandidate
+{
+	typedef std::chrono::steady_clock Clock;
+
+	uint64_t			id = 0;			// meaning is up to the consumer
+	long long			bytes = 0;
+	long long			cost = 0;		// microseconds to generate it again
+	Clock::time_point	lastUsed;
+};
+
+// A cache whose entries can be dropped and regenerated on demand. The entry's
+// bytes are expected to be reported back through MemoryGovernor::add by the
+// time evict returns. Both are called with the governor's lock held, so a
+// consumer mustn't call into the governor (other than add) while holding a
+// lock these take.
+class MemoryConsumer
+{
+public:
+
+	// The entry the consumer would miss least, false if it has nothing to give
+	virtual bool evictionCandidate(EvictionCandidate& candidate) = 0;
+	virtual void evict(const uint64_t id) = 0;
+
+protected:
+
+	~MemoryConsumer() {}
+};
+
+// ----------------------------------------------------------------------------
+
+// Tracks the bytes held natively, by category, and keeps the total under a
+// caller-set budget by evicting from the registered consumers. Not everything
+// counted can be evicted (a job's mesh belongs to the caller until it's
+// released), the evictable caches make room for the rest.
+//
+// Eviction compares the consumers' candidates by the cost of regenerating an
+// entry per byte it frees, discounted by how long ago it was last used, and
+// drops the cheapest until the total is back under budget.
+//
+// add() only touches atomics and is safe anywhere, enforce() runs at points
+// where the caller holds no locks (the job system calls it after a chunk
+// finishes) and does nothing while under budget.
+class MemoryGovernor
+{
+public:
+
+	MemoryGovernor();
+
+	// 0 removes the budget, a lower budget evicts straight away
+	void setBudget(const long long bytes);
+	long long budget() const { return budget_.load(); }
+
+	// bytes may be negative to return memory
+	void add(const MemoryCategory category, const long long bytes);
+	long long total() const;
+
+	void addConsumer(MemoryConsumer* consumer);
+
+	// Waits out an eviction in progress, the consumer is never called afterwards
+	void removeConsumer(MemoryConsumer* consumer);
+
+	// Evicts until the total is under budget or nothing more can be evicted.
+	// Returns straight away if another thread is already evicting.
+	void enforce();
+
+	void usage(MemoryUsage& usage) const;
+
+	// Regeneration cost per byte freed, discounted by age. Lowest goes first,
+	// consumers use it to pick their own candidate.
+	static float evictionScore(const EvictionCandidate& candidate, const EvictionCandidate::Clock::time_point& now);
+
+private:
+
+	MemoryGovernor(const MemoryGovernor&) = delete;
+	MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+	bool overBudget() const;
+
+	std::atomic<long long>			bytes_[Memory_CategoryCount];
+	std::atomic<long long>			budget_ { 0 };
+	std::atomic<long long>			evictions_ { 0 };
+	std::atomic<long long>			evictedBytes_ { 0 };
+
+	std::mutex						mutex_;
+	std::vector<MemoryConsumer*>	consumers_;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_MEMORY_GOVERNOR_H_BEEN_INCLUDED
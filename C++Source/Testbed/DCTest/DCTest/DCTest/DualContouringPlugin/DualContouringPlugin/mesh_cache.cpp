@@ -0,0 +1,244 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <iterator>
+
+// ----------------------------------------------------------------------------
+
+MeshCache::MeshCache(MemoryGovernor* memory)
+	: memory_(memory)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+MeshCache::~MeshCache()
+{
+	clear();
+}
+
+// ----------------------------------------------------------------------------
+
+void MeshCache::setCapacity(const long long bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	capacity_ = std::max(bytes, 0LL);
+	trim(capacity_);
+}
+
+// ----------------------------------------------------------------------------
+
+long long MeshCache::capacity() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return capacity_;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MeshCache::load(const ChunkRequest& request, ChunkResult& result)
+{
+	const ChunkArchiveKey key = MakeChunkArchiveKey(request);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		const auto iter = index_.find(key);
+		if (iter == end(index_))
+		{
+			return false;
+		}
+
+		entries_.splice(begin(entries_), entries_, iter->second);
+
+		Entry& entry = *iter->second;
+		entry.lastUsed = EvictionCandidate::Clock::now();
+
+		const float* vertices = reinterpret_cast<const float*>(entry.data.get());
+		const int* indices = reinterpret_cast<const int*>(vertices + entry.numVertexFloats);
+		const float* cells = reinterpret_cast<const float*>(indices + entry.numIndices);
+		const SeamVoxel* seamVoxels = reinterpret_cast<const SeamVoxel*>(cells + entry.numCellFloats);
+
+		result.vertices.assign(vertices, vertices + entry.numVertexFloats);
+		result.indices.assign(indices, indices + entry.numIndices);
+		result.cells.assign(cells, cells + entry.numCellFloats);
+		result.seamVoxels.assign(seamVoxels, seamVoxels + entry.numSeamVoxels);
+		result.contents = entry.contents;
+	}
+
+	BuildUnityMeshLayout(result);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void MeshCache::store(const ChunkRequest& request, const ChunkResult& result, const long long microseconds, const uint64_t epoch)
+{
+	if (capacity() == 0)
+	{
+		return;
+	}
+
+	// only the chunk's own mesh, the seam depends on the neighbours
+	Entry entry;
+	entry.key = MakeChunkArchiveKey(request);
+	entry.contents = result.contents;
+	entry.numVertexFloats = (uint32_t)(result.seamFirstVertex >= 0 ? result.seamFirstVertex * 6 : result.vertices.size());
+	entry.numIndices = (uint32_t)(result.seamFirstIndex >= 0 ? result.seamFirstIndex : result.indices.size());
+	entry.numCellFloats = (uint32_t)result.cells.size();
+	entry.numSeamVoxels = (uint32_t)result.seamVoxels.size();
+	entry.cost = microseconds;
+	entry.lastUsed = EvictionCandidate::Clock::now();
+
+	// copied outside the lock
+	const size_t size = (entry.numVertexFloats + entry.numIndices + entry.numCellFloats) * 4 +
+		entry.numSeamVoxels * sizeof(SeamVoxel);
+	entry.data.reset(new uint8_t[size]);
+	entry.bytes = (long long)(size + sizeof(Entry));
+
+	// std::copy rather than memcpy, the vectors are often empty and their
+	// data() is null then
+	float* vertices = reinterpret_cast<float*>(entry.data.get());
+	int* indices = reinterpret_cast<int*>(std::copy(begin(result.vertices), begin(result.vertices) + entry.numVertexFloats, vertices));
+	float* cells = reinterpret_cast<float*>(std::copy(begin(result.indices), begin(result.indices) + entry.numIndices, indices));
+	SeamVoxel* seamVoxels = reinterpret_cast<SeamVoxel*>(std::copy(begin(result.cells), end(result.cells), cells));
+	std::copy(begin(result.seamVoxels), end(result.seamVoxels), seamVoxels);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (epoch != epoch_.load() || entry.bytes > capacity_)
+	{
+		return;
+	}
+
+	const auto existing = index_.find(entry.key);
+	if (existing != end(index_))
+	{
+		remove(existing->second);
+	}
+
+	entry.id = nextID_++;
+	bytes_ += entry.bytes;
+	if (memory_)
+	{
+		memory_->add(Memory_MeshCache, entry.bytes);
+	}
+
+	entries_.push_front(std::move(entry));
+	index_[entries_.front().key] = begin(entries_);
+
+	trim(capacity_);
+}
+
+// ----------------------------------------------------------------------------
+
+void MeshCache::invalidate(const glm::ivec3& min, const glm::ivec3& max)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	epoch_++;
+
+	for (auto iter = begin(entries_); iter != end(entries_); )
+	{
+		const ChunkArchiveKey& key = iter->key;
+		const glm::ivec3 chunkMin = glm::ivec3(key.x, key.y, key.z) - glm::ivec3(key.size / 2 + (1 << key.lod));
+		const glm::ivec3 chunkMax = chunkMin + glm::ivec3(key.size + 2 * (1 << key.lod));
+
+		const auto next = std::next(iter);
+		if (glm::all(glm::lessThanEqual(chunkMin, max)) && glm::all(glm::lessThanEqual(min, chunkMax)))
+		{
+			remove(iter);
+		}
+		iter = next;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void MeshCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	epoch_++;
+	trim(0);
+}
+
+// ----------------------------------------------------------------------------
+
+int MeshCache::numChunks() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (int)entries_.size();
+}
+
+// ----------------------------------------------------------------------------
+
+long long MeshCache::bytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return bytes_;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MeshCache::evictionCandidate(EvictionCandidate& candidate)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (entries_.empty())
+	{
+		return false;
+	}
+
+	// LRU rather than the lowest score in the cache, scoring every entry
+	// on every eviction would cost more than the regeneration it saves
+	const Entry& entry = entries_.back();
+	candidate.id = entry.id;
+	candidate.bytes = entry.bytes;
+	candidate.cost = entry.cost;
+	candidate.lastUsed = entry.lastUsed;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void MeshCache::evict(const uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// normally still the last entry, unless a load touched it since
+	for (auto iter = entries_.rbegin(); iter != entries_.rend(); ++iter)
+	{
+		if (iter->id == id)
+		{
+			remove(std::next(iter).base());
+			return;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_
+void MeshCache::remove(EntryList::iterator iter)
+{
+	bytes_ -= iter->bytes;
+	if (memory_)
+	{
+		memory_->add(Memory_MeshCache, -iter->bytes);
+	}
+
+	index_.erase(iter->key);
+	entries_.erase(iter);
+}
+
+// ----------------------------------------------------------------------------
+
+// Callers hold mutex_. Drops the least recently used entries until the cache
+// holds at most capacity bytes.
+void MeshCache::trim(const long long capacity)
+{
+	while (!entries_.empty() && bytes_ > capacity)
+	{
+		remove(std::prev(end(entries_)));
+	}
+}
+
+// ----------------------------------------------------------------------------
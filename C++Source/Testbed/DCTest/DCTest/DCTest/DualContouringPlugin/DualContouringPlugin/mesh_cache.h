@@ -0,0 +1,102 @@
+#ifndef		HAS_MESH_CACHE_H_BEEN_INCLUDED
+#define		HAS_MESH_CACHE_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "glm/glm.hpp"
+#include "chunk_generator.h"
+#include "chunk_archive.h"
+#include "memory_governor.h"
+
+// ----------------------------------------------------------------------------
+
+// Finished chunks kept in memory so a chunk which unloads and comes straight
+// back (the viewer pacing along a ring boundary) is copied out in microseconds
+// instead of regenerated. Entries are keyed like the archive (position, size,
+// LOD, pipeline and a hash of the density and pipeline settings) and hold the
+// chunk's own mesh, cells and seam voxels in a single allocation; the Unity
+// layout and the seam are rebuilt on the way out, as for an archive hit.
+//
+// The cache is bounded by a byte capacity, least recently used first out, and
+// is a MemoryConsumer so the governor can shrink it further. Edits to the
+// volume call invalidate() on the region they touch. A chunk which started
+// generating before an invalidation isn't stored when it finishes, see epoch().
+// All members are safe to call from any thread.
+class MeshCache : public MemoryConsumer
+{
+public:
+
+	explicit MeshCache(MemoryGovernor* memory = nullptr);
+	~MeshCache();
+
+	// 0 turns the cache off and frees everything in it
+	void setCapacity(const long long bytes);
+	long long capacity() const;
+
+	bool load(const ChunkRequest& request, ChunkResult& result);
+
+	// microseconds is what the chunk cost to generate, the governor weighs it
+	// against the bytes held. Ignored if the cache has been invalidated since
+	// epoch was read.
+	void store(const ChunkRequest& request, const ChunkResult& result, const long long microseconds, const uint64_t epoch);
+
+	// Read before starting work whose result will be stored
+	uint64_t epoch() const { return epoch_.load(); }
+
+	// Drops every chunk whose volume (with a voxel's margin, the normals
+	// sample across the chunk's faces) overlaps the box
+	void invalidate(const glm::ivec3& min, const glm::ivec3& max);
+	void clear();
+
+	int numChunks() const;
+	long long bytes() const;
+
+	// MemoryConsumer, the least recently used entry
+	bool evictionCandidate(EvictionCandidate& candidate) override;
+	void evict(const uint64_t id) override;
+
+private:
+
+	struct Entry
+	{
+		ChunkArchiveKey		key;
+		uint64_t			id = 0;
+		int					contents = ChunkContents_Surface;
+		uint32_t			numVertexFloats = 0;
+		uint32_t			numIndices = 0;
+		uint32_t			numCellFloats = 0;
+		uint32_t			numSeamVoxels = 0;
+		std::unique_ptr<uint8_t[]> data;
+		long long			bytes = 0;
+		long long			cost = 0;
+		EvictionCandidate::Clock::time_point lastUsed;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	void remove(EntryList::iterator iter);
+	void trim(const long long capacity);
+
+	MemoryGovernor*					memory_ = nullptr;
+	std::atomic<uint64_t>			epoch_ { 0 };
+
+	mutable std::mutex				mutex_;
+	EntryList						entries_;	// most recently used first
+	std::unordered_map<ChunkArchiveKey, EntryList::iterator, ChunkArchiveKeyHash> index_;
+	long long						capacity_ = 0;
+	long long						bytes_ = 0;
+	uint64_t						nextID_ = 1;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_MESH_CACHE_H_BEEN_INCLUDED
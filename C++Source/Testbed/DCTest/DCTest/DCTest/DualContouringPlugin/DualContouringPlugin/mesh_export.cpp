@@ -0,0 +1,534 @@
+#include "mesh_export.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+
+// large stdio buffers so the writes reach the disk in big blocks
+static const size_t WRITE_BUFFER_SIZE = 4 << 20;
+
+// ----------------------------------------------------------------------------
+
+static FILE* OpenForWriting(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file)
+	{
+		setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+	}
+
+	return file;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool EndsWith(const std::string& text, const char* suffix)
+{
+	const size_t length = strlen(suffix);
+	if (text.size() < length)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < length; i++)
+	{
+		if (tolower(text[text.size() - length + i]) != suffix[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+MeshExportFormat MeshExportFormatFromPath(const char* path)
+{
+	const std::string name = path;
+	if (EndsWith(name, ".ply"))
+	{
+		return Export_PLY;
+	}
+	else if (EndsWith(name, ".obj"))
+	{
+		return Export_OBJ;
+	}
+	else if (EndsWith(name, ".gltf"))
+	{
+		return Export_GLTF;
+	}
+	else if (EndsWith(name, ".glb"))
+	{
+		return Export_GLB;
+	}
+
+	return Export_Unknown;
+}
+
+// ----------------------------------------------------------------------------
+
+// The vertex and face counts are written as fixed width placeholders and
+// patched in place by finish()
+class PLYExporter : public MeshExporter
+{
+public:
+
+	explicit PLYExporter(FILE* file)
+		: file_(file)
+	{
+		fprintf(file_, "ply\nformat binary_little_endian 1.0\n");
+		fprintf(file_, "element vertex ");
+		vertexCountOffset_ = ftell(file_);
+		fprintf(file_, "%010d\n", 0);
+		fprintf(file_, "property float x\nproperty float y\nproperty float z\n");
+		fprintf(file_, "property float nx\nproperty float ny\nproperty float nz\n");
+		fprintf(file_, "element face ");
+		faceCountOffset_ = ftell(file_);
+		fprintf(file_, "%010d\n", 0);
+		fprintf(file_, "property list uchar int vertex_indices\nend_header\n");
+	}
+
+	~PLYExporter()
+	{
+		// abandoned before finish(), the faces written so far are dropped
+		if (faces_)
+		{
+			fclose(faces_);
+		}
+
+		if (file_)
+		{
+			fclose(file_);
+		}
+	}
+
+	bool add(const ChunkResult& chunk) override
+	{
+		if (fwrite(chunk.vertices.data(), sizeof(float), chunk.vertices.size(), file_) != chunk.vertices.size())
+		{
+			return false;
+		}
+
+		// faces can't be written until every vertex is, so they go to a
+		// second file and are appended when finishing
+		if (!faces_)
+		{
+			faces_ = tmpfile();
+			if (!faces_)
+			{
+				return false;
+			}
+			setvbuf(faces_, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+		}
+
+		const int numFaces = (int)chunk.indices.size() / 3;
+		faceBuffer_.resize(numFaces * FACE_SIZE);
+		for (int i = 0; i < numFaces; i++)
+		{
+			char* face = &faceBuffer_[i * FACE_SIZE];
+			face[0] = 3;
+			for (int j = 0; j < 3; j++)
+			{
+				const int32_t index = chunk.indices[i * 3 + j] + numVertices_;
+				memcpy(face + 1 + j * sizeof(int32_t), &index, sizeof(int32_t));
+			}
+		}
+
+		numVertices_ += chunk.numVertices();
+		numFaces_ += numFaces;
+		return fwrite(faceBuffer_.data(), 1, faceBuffer_.size(), faces_) == faceBuffer_.size();
+	}
+
+	bool finish() override
+	{
+		bool ok = true;
+		if (faces_)
+		{
+			rewind(faces_);
+
+			std::vector<char> block(WRITE_BUFFER_SIZE);
+			size_t read = 0;
+			while ((read = fread(block.data(), 1, block.size(), faces_)) > 0)
+			{
+				ok = ok && fwrite(block.data(), 1, read, file_) == read;
+			}
+
+			fclose(faces_);
+			faces_ = nullptr;
+		}
+
+		ok = ok && fseek(file_, vertexCountOffset_, SEEK_SET) == 0 && fprintf(file_, "%010d", numVertices_) == 10;
+		ok = ok && fseek(file_, faceCountOffset_, SEEK_SET) == 0 && fprintf(file_, "%010d", numFaces_) == 10;
+
+		ok = (fclose(file_) == 0) && ok;
+		file_ = nullptr;
+		return ok;
+	}
+
+private:
+
+	static const int FACE_SIZE = 1 + 3 * sizeof(int32_t);
+
+	FILE*				file_ = nullptr;
+	FILE*				faces_ = nullptr;
+	std::vector<char>	faceBuffer_;
+
+	long				vertexCountOffset_ = 0;
+	long				faceCountOffset_ = 0;
+	int					numVertices_ = 0;
+	int					numFaces_ = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+class OBJExporter : public MeshExporter
+{
+public:
+
+	explicit OBJExporter(FILE* file)
+		: file_(file)
+	{
+	}
+
+	~OBJExporter()
+	{
+		if (file_)
+		{
+			fclose(file_);
+		}
+	}
+
+	bool add(const ChunkResult& chunk) override
+	{
+		// formatted into one block per chunk, one fwrite rather than one fprintf per line
+		text_.clear();
+		append("o chunk%d\n", numChunks_++);
+
+		const int numVertices = chunk.numVertices();
+		for (int i = 0; i < numVertices; i++)
+		{
+			const float* v = &chunk.vertices[i * 6];
+			append("v %.6g %.6g %.6g\n", v[0], v[1], v[2]);
+		}
+
+		for (int i = 0; i < numVertices; i++)
+		{
+			const float* v = &chunk.vertices[i * 6];
+			append("vn %.6g %.6g %.6g\n", v[3], v[4], v[5]);
+		}
+
+		// OBJ indices are 1 based and global to the file
+		for (size_t i = 0; i + 2 < chunk.indices.size(); i += 3)
+		{
+			const int a = chunk.indices[i + 0] + vertexBase_;
+			const int b = chunk.indices[i + 1] + vertexBase_;
+			const int c = chunk.indices[i + 2] + vertexBase_;
+			append("f %d//%d %d//%d %d//%d\n", a, a, b, b, c, c);
+		}
+
+		vertexBase_ += numVertices;
+		return fwrite(text_.data(), 1, text_.size(), file_) == text_.size();
+	}
+
+	bool finish() override
+	{
+		const bool ok = fclose(file_) == 0;
+		file_ = nullptr;
+		return ok;
+	}
+
+private:
+
+	template <typename... Args>
+	void append(const char* format, Args... args)
+	{
+		char line[128];
+		const int length = snprintf(line, sizeof(line), format, args...);
+		text_.append(line, length);
+	}
+
+	FILE*			file_ = nullptr;
+	std::string		text_;
+	int				numChunks_ = 0;
+	int				vertexBase_ = 1;
+};
+
+// ----------------------------------------------------------------------------
+
+// The binary buffer is streamed to disk as chunks arrive, only the per-chunk
+// accessor details are kept for the JSON written at the end. For .glb the
+// buffer goes to a temporary file first and is copied in after the JSON.
+class GLTFExporter : public MeshExporter
+{
+public:
+
+	GLTFExporter(const std::string& path, bool binary, FILE* file, FILE* buffer)
+		: path_(path)
+		, binary_(binary)
+		, file_(file)
+		, buffer_(buffer)
+	{
+	}
+
+	~GLTFExporter()
+	{
+		if (buffer_)
+		{
+			fclose(buffer_);
+		}
+
+		if (file_)
+		{
+			fclose(file_);
+		}
+	}
+
+	bool add(const ChunkResult& chunk) override
+	{
+		// accessors can't have a count of 0
+		if (chunk.numVertices() == 0 || chunk.indices.empty())
+		{
+			return true;
+		}
+
+		GLTFChunk info;
+		info.vertexOffset = bufferSize_;
+		info.vertexCount = chunk.numVertices();
+		info.indexCount = (int)chunk.indices.size();
+		info.shortIndices = !chunk.indices16.empty();
+		info.bounds = chunk.bounds;
+
+		const size_t vertexBytes = chunk.vertices.size() * sizeof(float);
+		bool ok = fwrite(chunk.vertices.data(), 1, vertexBytes, buffer_) == vertexBytes;
+		bufferSize_ += vertexBytes;
+
+		info.indexOffset = bufferSize_;
+		if (info.shortIndices)
+		{
+			info.indexBytes = chunk.indices16.size() * sizeof(uint16_t);
+			ok = ok && fwrite(chunk.indices16.data(), 1, info.indexBytes, buffer_) == info.indexBytes;
+		}
+		else
+		{
+			info.indexBytes = chunk.indices.size() * sizeof(uint32_t);
+			ok = ok && fwrite(chunk.indices.data(), 1, info.indexBytes, buffer_) == info.indexBytes;
+		}
+		bufferSize_ += info.indexBytes;
+
+		// keep the next chunk's floats 4 byte aligned
+		ok = ok && pad(buffer_, bufferSize_, 0);
+
+		chunks_.push_back(info);
+		return ok;
+	}
+
+	bool finish() override
+	{
+		const std::string json = buildJSON();
+
+		bool ok = true;
+		if (binary_)
+		{
+			ok = writeGLB(json);
+		}
+		else
+		{
+			ok = fwrite(json.data(), 1, json.size(), file_) == json.size();
+			ok = (fclose(buffer_) == 0) && ok;
+			buffer_ = nullptr;
+		}
+
+		ok = (fclose(file_) == 0) && ok;
+		file_ = nullptr;
+		return ok;
+	}
+
+private:
+
+	struct GLTFChunk
+	{
+		size_t		vertexOffset;
+		int			vertexCount;
+		size_t		indexOffset;
+		size_t		indexBytes;
+		int			indexCount;
+		bool		shortIndices;
+		MeshBounds	bounds;
+	};
+
+	static bool pad(FILE* file, size_t& size, char value)
+	{
+		while (size % 4 != 0)
+		{
+			if (fputc(value, file) == EOF)
+			{
+				return false;
+			}
+			size++;
+		}
+
+		return true;
+	}
+
+	template <typename... Args>
+	static void append(std::string& text, const char* format, Args... args)
+	{
+		char buffer[512];
+		const int length = snprintf(buffer, sizeof(buffer), format, args...);
+		text.append(buffer, length);
+	}
+
+	std::string bufferURI() const
+	{
+		const size_t slash = path_.find_last_of("/\\");
+		return (slash == std::string::npos ? path_ : path_.substr(slash + 1)) + ".bin";
+	}
+
+	std::string buildJSON() const
+	{
+		const int numChunks = (int)chunks_.size();
+
+		std::string json;
+		append(json, "{\"asset\":{\"version\":\"2.0\",\"generator\":\"DualContouringPlugin\"},\"scene\":0,\"scenes\":[{\"nodes\":[");
+		for (int i = 0; i < numChunks; i++)
+		{
+			append(json, "%s%d", i ? "," : "", i);
+		}
+
+		json += "]}],\"nodes\":[";
+		for (int i = 0; i < numChunks; i++)
+		{
+			append(json, "%s{\"mesh\":%d}", i ? "," : "", i);
+		}
+
+		// per chunk: accessor 3i = POSITION, 3i+1 = NORMAL, 3i+2 = indices,
+		// bufferView 2i = interleaved vertices, 2i+1 = indices
+		json += "],\"meshes\":[";
+		for (int i = 0; i < numChunks; i++)
+		{
+			append(json, "%s{\"primitives\":[{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d},\"indices\":%d}]}",
+				i ? "," : "", i * 3, i * 3 + 1, i * 3 + 2);
+		}
+
+		json += "],\"accessors\":[";
+		for (int i = 0; i < numChunks; i++)
+		{
+			const GLTFChunk& chunk = chunks_[i];
+			append(json, "%s{\"bufferView\":%d,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]}",
+				i ? "," : "", i * 2, chunk.vertexCount,
+				chunk.bounds.min.x, chunk.bounds.min.y, chunk.bounds.min.z,
+				chunk.bounds.max.x, chunk.bounds.max.y, chunk.bounds.max.z);
+			append(json, ",{\"bufferView\":%d,\"byteOffset\":12,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"}",
+				i * 2, chunk.vertexCount);
+			append(json, ",{\"bufferView\":%d,\"componentType\":%d,\"count\":%d,\"type\":\"SCALAR\"}",
+				i * 2 + 1, chunk.shortIndices ? 5123 : 5125, chunk.indexCount);
+		}
+
+		json += "],\"bufferViews\":[";
+		for (int i = 0; i < numChunks; i++)
+		{
+			const GLTFChunk& chunk = chunks_[i];
+			append(json, "%s{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"byteStride\":24,\"target\":34962}",
+				i ? "," : "", (unsigned long long)chunk.vertexOffset, (unsigned long long)(chunk.vertexCount * 6 * sizeof(float)));
+			append(json, ",{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":34963}",
+				(unsigned long long)chunk.indexOffset, (unsigned long long)chunk.indexBytes);
+		}
+
+		json += "],\"buffers\":[{";
+		if (!binary_)
+		{
+			append(json, "\"uri\":\"%s\",", bufferURI().c_str());
+		}
+		append(json, "\"byteLength\":%llu}]}", (unsigned long long)bufferSize_);
+
+		return json;
+	}
+
+	bool writeGLB(std::string json)
+	{
+		size_t jsonSize = json.size();
+		while (jsonSize % 4 != 0)
+		{
+			json += ' ';
+			jsonSize++;
+		}
+
+		const uint32_t JSON_CHUNK = 0x4e4f534a;
+		const uint32_t BIN_CHUNK = 0x004e4942;
+
+		uint32_t header[3] = { 0x46546c67, 2, (uint32_t)(12 + 8 + jsonSize + 8 + bufferSize_) };
+		uint32_t jsonHeader[2] = { (uint32_t)jsonSize, JSON_CHUNK };
+		uint32_t binHeader[2] = { (uint32_t)bufferSize_, BIN_CHUNK };
+
+		bool ok = fwrite(header, sizeof(header), 1, file_) == 1;
+		ok = ok && fwrite(jsonHeader, sizeof(jsonHeader), 1, file_) == 1;
+		ok = ok && fwrite(json.data(), 1, jsonSize, file_) == jsonSize;
+		ok = ok && fwrite(binHeader, sizeof(binHeader), 1, file_) == 1;
+
+		rewind(buffer_);
+		std::vector<char> block(WRITE_BUFFER_SIZE);
+		size_t read = 0;
+		while (ok && (read = fread(block.data(), 1, block.size(), buffer_)) > 0)
+		{
+			ok = fwrite(block.data(), 1, read, file_) == read;
+		}
+
+		fclose(buffer_);
+		buffer_ = nullptr;
+		return ok;
+	}
+
+	std::string				path_;
+	bool					binary_ = false;
+	FILE*					file_ = nullptr;
+	FILE*					buffer_ = nullptr;
+	size_t					bufferSize_ = 0;
+	std::vector<GLTFChunk>	chunks_;
+};
+
+// ----------------------------------------------------------------------------
+
+std::unique_ptr<MeshExporter> CreateMeshExporter(const char* path, MeshExportFormat format)
+{
+	FILE* file = OpenForWriting(path);
+	if (!file)
+	{
+		return nullptr;
+	}
+
+	switch (format)
+	{
+	case Export_PLY:
+		return std::unique_ptr<MeshExporter>(new PLYExporter(file));
+
+	case Export_OBJ:
+		return std::unique_ptr<MeshExporter>(new OBJExporter(file));
+
+	case Export_GLTF:
+	case Export_GLB:
+	{
+		FILE* buffer = format == Export_GLB ? tmpfile() : OpenForWriting(std::string(path) + ".bin");
+		if (!buffer)
+		{
+			fclose(file);
+			return nullptr;
+		}
+
+		setvbuf(buffer, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+		return std::unique_ptr<MeshExporter>(new GLTFExporter(path, format == Export_GLB, file, buffer));
+	}
+
+	default:
+		fclose(file);
+		return nullptr;
+	}
+}
+
+// ----------------------------------------------------------------------------
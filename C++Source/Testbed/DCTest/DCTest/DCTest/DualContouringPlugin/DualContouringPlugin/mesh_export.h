@@ -0,0 +1,48 @@
+#ifndef		HAS_MESH_EXPORT_H_BEEN_INCLUDED
+#define		HAS_MESH_EXPORT_H_BEEN_INCLUDED
+
+#include <memory>
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+enum MeshExportFormat
+{
+	Export_Unknown = -1,
+	Export_PLY,			// binary little endian
+	Export_OBJ,
+	Export_GLTF,		// .gltf + .bin alongside it
+	Export_GLB,
+};
+
+// ----------------------------------------------------------------------------
+
+// Writes chunks to a single file as they are produced. Only the chunk being
+// added is touched, so a whole region can be exported without holding it in
+// memory. Each chunk becomes its own object (OBJ) or mesh node (glTF), PLY
+// merges everything into one vertex/face list. Positions are written as the
+// pipeline produced them, no handedness conversion is applied.
+class MeshExporter
+{
+public:
+
+	virtual ~MeshExporter() {}
+
+	virtual bool add(const ChunkResult& chunk) = 0;
+
+	// Writes anything which depends on the totals (headers, glTF JSON) and
+	// closes the file, the exporter can't be used afterwards
+	virtual bool finish() = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+MeshExportFormat MeshExportFormatFromPath(const char* path);
+
+// Returns null if the file can't be created
+std::unique_ptr<MeshExporter> CreateMeshExporter(const char* path, MeshExportFormat format);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_MESH_EXPORT_H_BEEN_INCLUDED
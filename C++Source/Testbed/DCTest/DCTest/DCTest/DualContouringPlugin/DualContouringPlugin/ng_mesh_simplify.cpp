@@ -8,6 +8,7 @@
 #include	"qef_simd.h"
 
 #include	<stdint.h>
+#include	<stdio.h>
 #include	<algorithm>
 #include	<random>
 
@@ -230,7 +231,6 @@ static void BuildCandidateEdges(
 			edges.push_back(edge);
 		}
 	}
-	printf("Edges count: %d\n", edges.size());
 }
 
 // ----------------------------------------------------------------------------
@@ -269,7 +269,6 @@ static int FindValidCollapses(
 
 	for (int i : randomEdges)
 	{
-		printf("random edge[%d]\n", i);
 		const Edge& edge = edges[i];
 		const auto& vMin = vertices[edge.min_];
 		const auto& vMax = vertices[edge.max_];
@@ -278,73 +277,61 @@ static int FindValidCollapses(
 		const float cosAngle = vec4_dot(vMin.normal, vMax.normal);
 		if (cosAngle < options.minAngleCosine)
 		{
-			printf("1\n");
 			continue;
 		}
 
 		vec4 delta;
 		vec4_sub(delta, vMax.xyz, vMin.xyz);
-		printf("max xyz[%f,%f,%f] min [%f,%f,%f]\n", vMax.xyz[0], vMax.xyz[1], vMax.xyz[2], vMin.xyz[0], vMin.xyz[1], vMin.xyz[2]);
 		const float edgeSize = vec4_length2(delta);
-		printf("edgeSize [%f] max [%f]\n", edgeSize, options.maxEdgeSize);
 
 		if (edgeSize >(options.maxEdgeSize * options.maxEdgeSize))
 		{	
-			printf("2");
 			continue;
 		}
 
-		printf("2.1");
 		const int degree = vertexTriangleCounts[edge.min_] + vertexTriangleCounts[edge.max_];
-		printf("2.2");
 		if (degree > COLLAPSE_MAX_DEGREE)
 		{
-			printf("3\n");
 			continue;
 		}
-		printf("3.1");
-		__declspec(align(16)) float pos[4];
-		MeshVertex data[2] = { vMin, vMax };
-		printf("3.2");
+
+		// the QEF solver loads the positions and normals with aligned SSE loads
+		alignas(16) float pos[4];
+		alignas(16) MeshVertex data[2] = { vMin, vMax };
 		float error = qef_solve_from_points_4d_interleaved(&data[0].xyz[0], sizeof(MeshVertex) / sizeof(float), 2, pos);
 		if (error > 0.f)
 		{
-			printf("4\n");
 			error = 1.f / error;
 		}
 
-		printf("4.1");
 		// avoid vertices becoming a 'hub' for lots of edges by penalising collapses
 		// which will lead to a vertex with degree > 10
 		const int penalty = max(0, degree - 10);
 		error += penalty * (options.maxError * 0.1f);
-		printf("4.2");
 		if (error > options.maxError)
 		{
-			printf("5\n");
 			continue;
 		}
-		printf("5.1");
+
 		collapseValid.push_back(i);
 
 		vec4_add(collapseNormal[i], vMin.normal, vMax.normal);
 		vec4_scale(collapseNormal[i], 0.5f);
 
 		vec4_set(collapsePosition[i], vec4(pos[0], pos[1], pos[2], 1.f));
-		printf("5.2");
+
 		if (error < minEdgeCost[edge.min_])
 		{
 			minEdgeCost[edge.min_] = error;
 			collapseEdgeID[edge.min_] = i;
 		}
-		printf("5.3");
+
 		if (error < minEdgeCost[edge.max_])
 		{
 			minEdgeCost[edge.max_] = error;
 			collapseEdgeID[edge.max_] = i;
 		}
 
-		printf("complete");
 		validCollapses++;
 	}
 
@@ -370,22 +357,14 @@ static void CollapseEdges(
 		countCandidates++;
 
 		const Edge& edge = edges[i];
-		printf("collapseEdge id[%d,%d] - ", edge.min_, edge.max_);
 
-		if (collapseEdgeID[edge.min_] == i && collapseEdgeID[edge.max_] == i) //this is never happening!
+		if (collapseEdgeID[edge.min_] == i && collapseEdgeID[edge.max_] == i)
 		{
-			printf(" --- success");
-			/*debugVal = edge.min_;
-			debugVal2 = edge.max_;*/
 			countCollapsed++;
 
 			collapseTarget[edge.max_] = edge.min_;
 			vec4_set(vertices[edge.min_].xyz, collapsePositions[i]);
 			vec4_set(vertices[edge.min_].normal, collapseNormal[i]);
-
-		}
-		else {
-			printf(" --- fail");
 		}
 	}
 }
@@ -475,7 +454,9 @@ static void RemoveEdges(
 static void CompactVertices(
 	LinearBuffer<MeshVertex>& vertices,
 	MeshBuffer* meshBuffer,
-	IndexBuffer& indicies)
+	IndexBuffer& indicies,
+	const LinearBuffer<int>& mergedInto,
+	IndexBuffer* vertexRemap)
 {
 	LinearBuffer<bool> vertexUsed(vertices.size());
 	vertexUsed.resize(vertices.size(), false);
@@ -516,6 +497,15 @@ static void CompactVertices(
 		}
 	}
 
+	if (vertexRemap)
+	{
+		vertexRemap->resize(vertices.size());
+		for (int i = 0; i < vertices.size(); i++)
+		{
+			(*vertexRemap)[i] = remappedVertexIndices[mergedInto[i]];
+		}
+	}
+
 	vertices.swap(compactVertices);
 }
 
@@ -527,10 +517,9 @@ void ngMeshSimplifier(
 	const MeshSimplificationOptions& options,
 	VertexData& vertexData,
 	IndexBuffer& indicies,
-	float& debugVal, float& debugVal2)
+	float& debugVal, float& debugVal2,
+	IndexBuffer* vertexRemap)
 {
-	printf("\n");
-
 	if (mesh->numTriangles < 100 || mesh->numVertices < 100)
 	{
 		return;
@@ -566,6 +555,13 @@ void ngMeshSimplifier(
 	LinearBuffer<int> vertexTriangleCounts(vertices.size());
 	vertexTriangleCounts.resize(vertices.size(), 0);
 
+	// the vertex each input vertex ended up collapsed into
+	LinearBuffer<int> mergedInto(vertices.size());
+	for (int i = 0; i < vertices.size(); i++)
+	{
+		mergedInto.push_back(i);
+	}
+
 	{
 		for (int j = 0; j < triangles.size(); j++)
 		{
@@ -580,9 +576,8 @@ void ngMeshSimplifier(
 
 	const int targetTriangleCount = triangles.size() * options.targetPercentage;
 	int iterations = 0;
-	while (triangles.size() > targetTriangleCount && iterations++ < options.maxIterations)
+	while (triangles.size() > targetTriangleCount && iterations++ < options.maxIterations && edges.size() > 0)
 	{
-		printf("simplify iterations: %d\n", iterations);
 		collapseEdgeID.resize(vertices.size(), -1);
 		collapseTarget.resize(vertices.size(), -1);
 
@@ -591,7 +586,6 @@ void ngMeshSimplifier(
 		const int countValidCollapse = FindValidCollapses(options, edges, vertices, triangles, vertexTriangleCounts, collapseValid, collapseEdgeID, collapsePosition, collapseNormal);
 		if (countValidCollapse == 0)
 		{	
-			printf("no valid collapses\n");
 			break; //no point in continuing because there will never be any more validcollapses
 		}
 
@@ -599,6 +593,14 @@ void ngMeshSimplifier(
 
 		RemoveTriangles(vertices, collapseTarget, triangles, triBuffer, vertexTriangleCounts);
 		RemoveEdges(collapseTarget, edges, edgeBuffer);
+
+		for (int& v : mergedInto)
+		{
+			if (collapseTarget[v] != -1)
+			{
+				v = collapseTarget[v];
+			}
+		}
 	}
 
 	mesh->numTriangles = 0;
@@ -610,7 +612,7 @@ void ngMeshSimplifier(
 		mesh->numTriangles++;
 	}
 
-	CompactVertices(vertices, mesh, indicies);
+	CompactVertices(vertices, mesh, indicies, mergedInto, vertexRemap);
 
 	mesh->numVertices = vertices.size();
 	for (int i = 0; i < vertices.size(); i++)
@@ -625,8 +627,8 @@ void ngMeshSimplifier(
 		vertexData.push_back(vertices[i].xyz[1]);
 		vertexData.push_back(vertices[i].xyz[2]);
 
-		vertexData.push_back(mesh->vertices[i].normal[0]); //these are returning Infinity for everything except the first set of normals.
-		vertexData.push_back(mesh->vertices[i].normal[1]); //whaaaaaaaat
+		vertexData.push_back(mesh->vertices[i].normal[0]);
+		vertexData.push_back(mesh->vertices[i].normal[1]);
 		vertexData.push_back(mesh->vertices[i].normal[2]);
 	}
 }
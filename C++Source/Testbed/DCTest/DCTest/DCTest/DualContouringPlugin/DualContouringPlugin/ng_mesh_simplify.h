@@ -83,14 +83,18 @@ public:
 
 // ----------------------------------------------------------------------------
 
-// The MeshBuffer instance will be edited in place
+// The MeshBuffer instance will be edited in place. Meshes with fewer than 100
+// triangles or vertices are left alone and nothing is written to vertexData or
+// indicies. vertexRemap (optional) receives the simplified index of every input
+// vertex, following it into the vertex it was collapsed into.
 void ngMeshSimplifier(
 	MeshBuffer* mesh,
 	const vec4& worldSpaceOffset,
 	const MeshSimplificationOptions& options,
 	VertexData& vertexData,
 	IndexBuffer& indicies,
-	float& debugVal, float& debugVal2);
+	float& debugVal, float& debugVal2,
+	IndexBuffer* vertexRemap = nullptr);
 
 // ----------------------------------------------------------------------------
 
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include	"octree.h"
 #include	"density.h"
+#include	"sign_dag.h"
 
 // ----------------------------------------------------------------------------
 
@@ -473,7 +474,7 @@ void ContourCellProc(OctreeNode* node, IndexBuffer& indexBuffer)
 
 // ----------------------------------------------------------------------------
 
-vec3 ApproximateZeroCrossingPosition(const vec3& p0, const vec3& p1)
+vec3 ApproximateZeroCrossingPosition(const DensityField& density, const vec3& p0, const vec3& p1)
 {
 	// approximate the zero crossing by finding the min value along the edge
 	float minValue = 100000.f;
@@ -484,10 +485,10 @@ vec3 ApproximateZeroCrossingPosition(const vec3& p0, const vec3& p1)
 	while (currentT <= 1.f)
 	{
 		const vec3 p = p0 + ((p1 - p0) * currentT);
-		const float density = glm::abs(Density_Func(p));
-		if (density < minValue)
+		const float d = glm::abs(Density_Func(density, p));
+		if (d < minValue)
 		{
-			minValue = density;
+			minValue = d;
 			t = currentT;
 		}
 
@@ -499,31 +500,34 @@ vec3 ApproximateZeroCrossingPosition(const vec3& p0, const vec3& p1)
 
 // ----------------------------------------------------------------------------
 
-vec3 CalculateSurfaceNormal(const vec3& p)
+vec3 CalculateSurfaceNormal(const DensityField& density, const vec3& p)
 {
 	const float H = 0.001f;
-	const float dx = Density_Func(p + vec3(H, 0.f, 0.f)) - Density_Func(p - vec3(H, 0.f, 0.f));
-	const float dy = Density_Func(p + vec3(0.f, H, 0.f)) - Density_Func(p - vec3(0.f, H, 0.f));
-	const float dz = Density_Func(p + vec3(0.f, 0.f, H)) - Density_Func(p - vec3(0.f, 0.f, H));
+	const float dx = Density_Func(density, p + vec3(H, 0.f, 0.f)) - Density_Func(density, p - vec3(H, 0.f, 0.f));
+	const float dy = Density_Func(density, p + vec3(0.f, H, 0.f)) - Density_Func(density, p - vec3(0.f, H, 0.f));
+	const float dz = Density_Func(density, p + vec3(0.f, 0.f, H)) - Density_Func(density, p - vec3(0.f, 0.f, H));
 
 	return glm::normalize(vec3(dx, dy, dz));
 }
 
 // ----------------------------------------------------------------------------
 
-OctreeNode* ConstructLeaf(OctreeNode* leaf)
+// signs are the baked corner signs over the whole octree, null to sample them
+OctreeNode* ConstructLeaf(const DensityField& params, const SignDag* signs, OctreeNode* leaf, const int leafSize)
 {
-	if (!leaf || leaf->size != 1)
+	if (!leaf || leaf->size != leafSize)
 	{
+		// the chunk isn't a power of two leaves across, see IsValidChunkRequest
+		delete leaf;
 		return nullptr;
 	}
 
 	int corners = 0;
 	for (int i = 0; i < 8; i++)
 	{
-		const ivec3 cornerPos = leaf->min + CHILD_MIN_OFFSETS[i];
-		const float density = Density_Func(vec3(cornerPos));
-		const int material = density < 0.f ? MATERIAL_SOLID : MATERIAL_AIR;
+		const ivec3 cornerPos = leaf->min + (CHILD_MIN_OFFSETS[i] * leafSize);
+		const bool solid = signs ? signs->inside(cornerPos) : Density_Func(params, vec3(cornerPos)) < 0.f;
+		const int material = solid ? MATERIAL_SOLID : MATERIAL_AIR;
 		corners |= (material << i);
 	}
 
@@ -555,10 +559,10 @@ OctreeNode* ConstructLeaf(OctreeNode* leaf)
 			continue;
 		}
 
-		const vec3 p1 = vec3(leaf->min + CHILD_MIN_OFFSETS[c1]);
-		const vec3 p2 = vec3(leaf->min + CHILD_MIN_OFFSETS[c2]);
-		const vec3 p = ApproximateZeroCrossingPosition(p1, p2);
-		const vec3 n = CalculateSurfaceNormal(p);
+		const vec3 p1 = vec3(leaf->min + (CHILD_MIN_OFFSETS[c1] * leafSize));
+		const vec3 p2 = vec3(leaf->min + (CHILD_MIN_OFFSETS[c2] * leafSize));
+		const vec3 p = ApproximateZeroCrossingPosition(params, p1, p2);
+		const vec3 n = CalculateSurfaceNormal(params, p);
 		qef.add(p.x, p.y, p.z, n.x, n.y, n.z);
 
 		averageNormal += n;
@@ -594,51 +598,136 @@ OctreeNode* ConstructLeaf(OctreeNode* leaf)
 
 // -------------------------------------------------------------------------------
 
-OctreeNode* ConstructOctreeNodes(OctreeNode* node)
+static bool IsCancelled(const std::atomic<bool>* cancel)
 {
-	if (!node)
+	return cancel && cancel->load();
+}
+
+// ----------------------------------------------------------------------------
+
+static bool PastDeadline(const OctreeBuilder::Clock::time_point& deadline)
+{
+	return deadline != OctreeBuilder::Clock::time_point::max() && OctreeBuilder::Clock::now() >= deadline;
+}
+
+// -------------------------------------------------------------------------------
+
+OctreeBuilder::OctreeBuilder(const DensityField& density, const ivec3& min, const int size, const int leafSize, const std::atomic<bool>* cancel)
+	: density_(density)
+	, leafSize_(leafSize)
+	, cancel_(cancel)
+{
+	signs_ = Density_BakedSigns(density_, min, min + ivec3(size));
+
+	OctreeNode* root = new OctreeNode;
+	root->min = min;
+	root->size = size;
+	root->type = Node_Internal;
+	visit(root, &root_);
+}
+
+// -------------------------------------------------------------------------------
+
+OctreeBuilder::~OctreeBuilder()
+{
+	DestroyOctree(root_);
+}
+
+// -------------------------------------------------------------------------------
+
+// A leaf is constructed straight away, an internal node is left on the stack
+// for its children to be visited. *slot is null if the node was deleted.
+void OctreeBuilder::visit(OctreeNode* node, OctreeNode** slot)
+{
+	if (node->size <= leafSize_)
 	{
-		return nullptr;
+		*slot = ConstructLeaf(density_, signs_, node, leafSize_);
+		return;
 	}
 
-	if (node->size == 1)
+	// every leaf below would be all air or all solid, skip visiting them
+	if (signs_ && signs_->classify(node->min, node->min + ivec3(node->size)) != CornerSigns_Mixed)
 	{
-		return ConstructLeaf(node);
+		delete node;
+		*slot = nullptr;
+		return;
 	}
 
-	const int childSize = node->size / 2;
-	bool hasChildren = false;
+	*slot = node;
+	stack_.push_back({ node, slot, 0 });
+}
 
-	for (int i = 0; i < 8; i++)
+// -------------------------------------------------------------------------------
+
+bool OctreeBuilder::step(const Clock::time_point& deadline)
+{
+	while (!stack_.empty())
 	{
+		// a leaf on the surface samples the density ~100 times, which is tens
+		// of microseconds with the noise presets, so check before every node
+		if (IsCancelled(cancel_) || PastDeadline(deadline))
+		{
+			return IsCancelled(cancel_);
+		}
+
+		PendingNode& pending = stack_.back();
+		OctreeNode* node = pending.node;
+		if (pending.nextChild == 8)
+		{
+			bool hasChildren = false;
+			for (int i = 0; i < 8; i++)
+			{
+				hasChildren |= (node->children[i] != nullptr);
+			}
+
+			if (!hasChildren)
+			{
+				*pending.slot = nullptr;
+				delete node;
+			}
+
+			stack_.pop_back();
+			continue;
+		}
+
+		const int i = pending.nextChild++;
+		const int childSize = node->size / 2;
+
 		OctreeNode* child = new OctreeNode;
 		child->size = childSize;
 		child->min = node->min + (CHILD_MIN_OFFSETS[i] * childSize);
 		child->type = Node_Internal;
 
-		node->children[i] = ConstructOctreeNodes(child);
-		hasChildren |= (node->children[i] != nullptr);
+		// may grow the stack, pending isn't used after this
+		visit(child, &node->children[i]);
 	}
 
-	if (!hasChildren)
+	return true;
+}
+
+// -------------------------------------------------------------------------------
+
+OctreeNode* OctreeBuilder::takeRoot()
+{
+	if (!stack_.empty())
 	{
-		delete node;
 		return nullptr;
 	}
 
-	return node;
+	OctreeNode* root = root_;
+	root_ = nullptr;
+	return root;
 }
 
 // -------------------------------------------------------------------------------
 
-OctreeNode* BuildOctree(const ivec3& min, const int size, const float threshold)
+OctreeNode* BuildOctree(const DensityField& density, const ivec3& min, const int size, const float threshold, const int leafSize)
 {
-	OctreeNode* root = new OctreeNode;
-	root->min = min;
-	root->size = size;
-	root->type = Node_Internal;
+	OctreeBuilder builder(density, min, size, leafSize);
+	builder.step(OctreeBuilder::Clock::time_point::max());
 
-	ConstructOctreeNodes(root);
+	// null when no leaf holds the surface
+	OctreeNode* root = builder.takeRoot();
 	//root = SimplifyOctree(root, threshold);
 
 	return root;
@@ -25,6 +25,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "qef.h"
 #include "mesh.h"
+#include "density.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
 
 #include "glm/glm.hpp"
 using glm::vec3;
@@ -104,8 +109,56 @@ public:
 
 // ----------------------------------------------------------------------------
 
-OctreeNode* BuildOctree(const ivec3& min, const int size, const float threshold);
+// leafSize is the edge length of the smallest voxels, 1 << lod
+OctreeNode* BuildOctree(const DensityField& density, const ivec3& min, const int size, const float threshold, const int leafSize = 1);
 void DestroyOctree(OctreeNode* node);
+
+// Resumable version of BuildOctree, each call to step() constructs nodes until
+// the deadline passes and picks up where the last call stopped. The internal
+// nodes whose children are still to be visited are kept on an explicit stack,
+// the clock is checked before each node.
+class OctreeBuilder
+{
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	OctreeBuilder(const DensityField& density, const ivec3& min, const int size, const int leafSize = 1, const std::atomic<bool>* cancel = nullptr);
+	~OctreeBuilder();
+
+	// Returns true once the tree is built or the cancel flag was seen
+	bool step(const Clock::time_point& deadline);
+
+	// Ownership of the tree passes to the caller. Null when no leaf holds the
+	// surface, or the tree isn't finished.
+	OctreeNode* takeRoot();
+
+private:
+
+	OctreeBuilder(const OctreeBuilder&) = delete;
+	OctreeBuilder& operator=(const OctreeBuilder&) = delete;
+
+	struct PendingNode
+	{
+		OctreeNode*		node;
+		OctreeNode**	slot;		// the parent's pointer to node
+		int				nextChild;
+	};
+
+	void visit(OctreeNode* node, OctreeNode** slot);
+
+	DensityField				density_;
+	const SignDag*				signs_ = nullptr;
+	int							leafSize_ = 1;
+	const std::atomic<bool>*	cancel_ = nullptr;
+
+	OctreeNode*					root_ = nullptr;
+	std::vector<PendingNode>	stack_;
+};
+
+// Collapses subtrees whose leaves' QEFs solve to within threshold into single
+// pseudo leaves. Not called by BuildOctree or the chunk pipeline yet.
+OctreeNode* SimplifyOctree(OctreeNode* node, float threshold);
 void GenerateMeshFromOctree(OctreeNode* node, VertexBuffer& vertexBuffer, IndexBuffer& indexBuffer, VertexData& vertexData);
 
 // ----------------------------------------------------------------------------
@@ -39,6 +39,7 @@
 //	float error = qef_solve_from_points_3d(&positions[0].x, &normals[0].x, 2, &solvedPos.x);
 //
 
+#include	<stdio.h>
 #include	<xmmintrin.h>
 #include	<immintrin.h>
 
@@ -78,6 +79,14 @@ float qef_solve_from_points_3d(
 
 #ifdef QEF_INCLUDE_IMPL
 
+// One float of an __m128, MSVC names the lanes through a union member while
+// GCC and Clang subscript the vector type directly
+#ifdef _MSC_VER
+#define QEF_LANE(v, i) (v).m128_f32[i]
+#else
+#define QEF_LANE(v, i) (v)[i]
+#endif
+
 union Mat4x4
 {
 	float	m[4][4];
@@ -151,21 +160,21 @@ static void givens_coeffs_sym(__m128& c_result, __m128& s_result, const Mat4x4&
 {
 	__m128 simd_pp = _mm_set_ps(
 		0.f,
-		vtav.row[a].m128_f32[a],
-		vtav.row[a].m128_f32[a],
-		vtav.row[a].m128_f32[a]);
+		QEF_LANE(vtav.row[a], a),
+		QEF_LANE(vtav.row[a], a),
+		QEF_LANE(vtav.row[a], a));
 
 	__m128 simd_pq = _mm_set_ps(
 		0.f,
-		vtav.row[a].m128_f32[b],
-		vtav.row[a].m128_f32[b],
-		vtav.row[a].m128_f32[b]);
+		QEF_LANE(vtav.row[a], b),
+		QEF_LANE(vtav.row[a], b),
+		QEF_LANE(vtav.row[a], b));
 
 	__m128 simd_qq = _mm_set_ps(
 		0.f,
-		vtav.row[b].m128_f32[b],
-		vtav.row[b].m128_f32[b],
-		vtav.row[b].m128_f32[b]);
+		QEF_LANE(vtav.row[b], b),
+		QEF_LANE(vtav.row[b], b),
+		QEF_LANE(vtav.row[b], b));
 
 	static const __m128 zeros = _mm_set1_ps(0.f);
 	static const __m128 ones = _mm_set1_ps(1.f);
@@ -216,21 +225,21 @@ static void rotateq_xy(Mat4x4& vtav, const __m128& c, const __m128& s, const int
 {
 	__m128 u = _mm_set_ps(
 		0.f,
-		vtav.row[a].m128_f32[a],
-		vtav.row[a].m128_f32[a],
-		vtav.row[a].m128_f32[a]);
+		QEF_LANE(vtav.row[a], a),
+		QEF_LANE(vtav.row[a], a),
+		QEF_LANE(vtav.row[a], a));
 
 	__m128 v = _mm_set_ps(
 		0.f,
-		vtav.row[b].m128_f32[b],
-		vtav.row[b].m128_f32[b],
-		vtav.row[b].m128_f32[b]);
+		QEF_LANE(vtav.row[b], b),
+		QEF_LANE(vtav.row[b], b),
+		QEF_LANE(vtav.row[b], b));
 
 	__m128 A = _mm_set_ps(
 		0.f,
-		vtav.row[a].m128_f32[b],
-		vtav.row[a].m128_f32[b],
-		vtav.row[a].m128_f32[b]);
+		QEF_LANE(vtav.row[a], b),
+		QEF_LANE(vtav.row[a], b),
+		QEF_LANE(vtav.row[a], b));
 
 	static const __m128 twos = _mm_set1_ps(2.f);
 
@@ -255,8 +264,8 @@ static void rotateq_xy(Mat4x4& vtav, const __m128& c, const __m128& s, const int
 	__m128 y = _mm_add_ps(y1, y2);
 
 
-	vtav.row[a].m128_f32[a] = x.m128_f32[0];
-	vtav.row[b].m128_f32[b] = y.m128_f32[0];
+	QEF_LANE(vtav.row[a], a) = QEF_LANE(x, 0);
+	QEF_LANE(vtav.row[b], b) = QEF_LANE(y, 0);
 }
 
 // ----------------------------------------------------------------------------
@@ -264,16 +273,16 @@ static void rotateq_xy(Mat4x4& vtav, const __m128& c, const __m128& s, const int
 static void rotate_xy(Mat4x4& vtav, Mat4x4& v, float c, float s, const int& a, const int& b)
 {
 	__m128 simd_u = _mm_set_ps(
-		vtav.row[0].m128_f32[3 - b],
-		v.row[2].m128_f32[a],
-		v.row[1].m128_f32[a],
-		v.row[0].m128_f32[a]);
+		QEF_LANE(vtav.row[0], 3 - b),
+		QEF_LANE(v.row[2], a),
+		QEF_LANE(v.row[1], a),
+		QEF_LANE(v.row[0], a));
 
 	__m128 simd_v = _mm_set_ps(
-		vtav.row[1 - a].m128_f32[2],
-		v.row[2].m128_f32[b],
-		v.row[1].m128_f32[b],
-		v.row[0].m128_f32[b]);
+		QEF_LANE(vtav.row[1 - a], 2),
+		QEF_LANE(v.row[2], b),
+		QEF_LANE(v.row[1], b),
+		QEF_LANE(v.row[0], b));
 
 	__m128 simd_c = _mm_load1_ps(&c);
 	__m128 simd_s = _mm_load1_ps(&s);
@@ -286,17 +295,17 @@ static void rotate_xy(Mat4x4& vtav, Mat4x4& v, float c, float s, const int& a, c
 	__m128 y1 = _mm_mul_ps(simd_c, simd_v);
 	__m128 y = _mm_add_ps(y0, y1);
 
-	v.row[0].m128_f32[a] = x.m128_f32[0];
-	v.row[1].m128_f32[a] = x.m128_f32[1];
-	v.row[2].m128_f32[a] = x.m128_f32[2];
-	vtav.row[0].m128_f32[3 - b] = x.m128_f32[3];
+	QEF_LANE(v.row[0], a) = QEF_LANE(x, 0);
+	QEF_LANE(v.row[1], a) = QEF_LANE(x, 1);
+	QEF_LANE(v.row[2], a) = QEF_LANE(x, 2);
+	QEF_LANE(vtav.row[0], 3 - b) = QEF_LANE(x, 3);
 
-	v.row[0].m128_f32[b] = y.m128_f32[0];
-	v.row[1].m128_f32[b] = y.m128_f32[1];
-	v.row[2].m128_f32[b] = y.m128_f32[2];
-	vtav.row[1 - a].m128_f32[2] = y.m128_f32[3];
+	QEF_LANE(v.row[0], b) = QEF_LANE(y, 0);
+	QEF_LANE(v.row[1], b) = QEF_LANE(y, 1);
+	QEF_LANE(v.row[2], b) = QEF_LANE(y, 2);
+	QEF_LANE(vtav.row[1 - a], 2) = QEF_LANE(y, 3);
 
-	vtav.row[a].m128_f32[b] = 0.f;
+	QEF_LANE(vtav.row[a], b) = 0.f;
 }
 
 // ----------------------------------------------------------------------------
@@ -309,36 +318,36 @@ static __m128 svd_solve_sym(Mat4x4& v, const Mat4x4& a)
 	{
 		__m128 c, s;
 
-		if (vtav.row[0].m128_f32[1] != 0.f)
+		if (QEF_LANE(vtav.row[0], 1) != 0.f)
 		{
 			givens_coeffs_sym(c, s, vtav, 0, 1);
 			rotateq_xy(vtav, c, s, 0, 1);
-			rotate_xy(vtav, v, c.m128_f32[1], s.m128_f32[1], 0, 1);
-			vtav.row[0].m128_f32[1] = 0.f;
+			rotate_xy(vtav, v, QEF_LANE(c, 1), QEF_LANE(s, 1), 0, 1);
+			QEF_LANE(vtav.row[0], 1) = 0.f;
 		}
 
-		if (vtav.row[0].m128_f32[2] != 0.f)
+		if (QEF_LANE(vtav.row[0], 2) != 0.f)
 		{
 			givens_coeffs_sym(c, s, vtav, 0, 2);
 			rotateq_xy(vtav, c, s, 0, 2);
-			rotate_xy(vtav, v, c.m128_f32[1], s.m128_f32[1], 0, 2);
-			vtav.row[0].m128_f32[2] = 0.f;
+			rotate_xy(vtav, v, QEF_LANE(c, 1), QEF_LANE(s, 1), 0, 2);
+			QEF_LANE(vtav.row[0], 2) = 0.f;
 		}
 
-		if (vtav.row[1].m128_f32[2] != 0.f)
+		if (QEF_LANE(vtav.row[1], 2) != 0.f)
 		{
 			givens_coeffs_sym(c, s, vtav, 1, 2);
 			rotateq_xy(vtav, c, s, 1, 2);
-			rotate_xy(vtav, v, c.m128_f32[2], s.m128_f32[2], 1, 2);
-			vtav.row[1].m128_f32[2] = 0.f;
+			rotate_xy(vtav, v, QEF_LANE(c, 2), QEF_LANE(s, 2), 1, 2);
+			QEF_LANE(vtav.row[1], 2) = 0.f;
 		}
 	}
 
 	return _mm_set_ps(
 		0.f,
-		vtav.row[2].m128_f32[2],
-		vtav.row[1].m128_f32[1],
-		vtav.row[0].m128_f32[0]);
+		QEF_LANE(vtav.row[2], 2),
+		QEF_LANE(vtav.row[1], 1),
+		QEF_LANE(vtav.row[0], 0));
 }
 
 // ----------------------------------------------------------------------------
@@ -368,20 +377,20 @@ static void svd_pseudoinverse(Mat4x4& o, const __m128& sigma, const Mat4x4& v)
 	m.row[2] = _mm_mul_ps(v.row[2], invdet);
 	m.row[3] = _mm_set1_ps(0.f);
 
-	o.row[0].m128_f32[0] = vec4_dot(m.row[0], v.row[0]);
-	o.row[0].m128_f32[1] = vec4_dot(m.row[1], v.row[0]);
-	o.row[0].m128_f32[2] = vec4_dot(m.row[2], v.row[0]);
-	o.row[0].m128_f32[3] = 0.f;
+	QEF_LANE(o.row[0], 0) = vec4_dot(m.row[0], v.row[0]);
+	QEF_LANE(o.row[0], 1) = vec4_dot(m.row[1], v.row[0]);
+	QEF_LANE(o.row[0], 2) = vec4_dot(m.row[2], v.row[0]);
+	QEF_LANE(o.row[0], 3) = 0.f;
 
-	o.row[1].m128_f32[0] = vec4_dot(m.row[0], v.row[1]);
-	o.row[1].m128_f32[1] = vec4_dot(m.row[1], v.row[1]);
-	o.row[1].m128_f32[2] = vec4_dot(m.row[2], v.row[1]);
-	o.row[1].m128_f32[3] = 0.f;
+	QEF_LANE(o.row[1], 0) = vec4_dot(m.row[0], v.row[1]);
+	QEF_LANE(o.row[1], 1) = vec4_dot(m.row[1], v.row[1]);
+	QEF_LANE(o.row[1], 2) = vec4_dot(m.row[2], v.row[1]);
+	QEF_LANE(o.row[1], 3) = 0.f;
 
-	o.row[2].m128_f32[0] = vec4_dot(m.row[0], v.row[2]);
-	o.row[2].m128_f32[1] = vec4_dot(m.row[1], v.row[2]);
-	o.row[2].m128_f32[2] = vec4_dot(m.row[2], v.row[2]);
-	o.row[2].m128_f32[3] = 0.f;
+	QEF_LANE(o.row[2], 0) = vec4_dot(m.row[0], v.row[2]);
+	QEF_LANE(o.row[2], 1) = vec4_dot(m.row[1], v.row[2]);
+	QEF_LANE(o.row[2], 2) = vec4_dot(m.row[2], v.row[2]);
+	QEF_LANE(o.row[2], 3) = 0.f;
 
 	o.row[3] = m.row[3];
 }
@@ -447,7 +456,7 @@ float qef_simd_solve(
 	const __m128& pointaccum,
 	__m128& x)
 {
-	const __m128 masspoint = _mm_div_ps(pointaccum, _mm_set1_ps(pointaccum.m128_f32[3]));
+	const __m128 masspoint = _mm_div_ps(pointaccum, _mm_set1_ps(QEF_LANE(pointaccum, 3)));
 
 	__m128 p = vec4_mul_m4x4(masspoint, ATA);
 	p = _mm_sub_ps(ATb, p);
@@ -482,7 +491,7 @@ float qef_solve_from_points(
 		qef_simd_add(positions[i], normals[i], ATA, ATb, pointaccum);
 	}
 
-	__declspec(align(16)) float x[4];
+	alignas(16) float x[4];
 	_mm_store_ps(x, ATb);
 	_mm_set_ps(0.f, x[2], x[1], x[0]);
 
@@ -525,28 +534,23 @@ float qef_solve_from_points_4d_interleaved(
 	const int count,
 	float* solved_position)
 {
-	printf("\nqef1");
 	if (count < 2 || count > QEF_MAX_INPUT_COUNT)
 	{
 		solved_position[0] = solved_position[1] = solved_position[2] = solved_position[3] = 0.f;
 		return 0.f;
 	}
-	printf("qef2");
+
 	__m128 p[QEF_MAX_INPUT_COUNT];
 	__m128 n[QEF_MAX_INPUT_COUNT];
-	printf("qef2.1 count: %d", count);
 	for (int i = 0; i < count; i++)
 	{
-		printf("itr: %d", i);
 		p[i] = _mm_load_ps(&data[(i * stride) + 0]);
 		n[i] = _mm_load_ps(&data[(i * stride) + 4]);
-		printf("itr done");
 	}
-	printf("qef3");
+
 	__m128 solved;
 	const float error = qef_solve_from_points(p, n, count, &solved);
 	_mm_store_ps(solved_position, solved);
-	printf("qef4");
 	return error;
 }
 
@@ -577,9 +581,9 @@ float qef_solve_from_points_3d(
 	__m128 solved;
 	const float error = qef_solve_from_points(p, n, count, &solved);
 
-	solved_position[0] = solved.m128_f32[0];
-	solved_position[1] = solved.m128_f32[1];
-	solved_position[2] = solved.m128_f32[2];
+	solved_position[0] = QEF_LANE(solved, 0);
+	solved_position[1] = QEF_LANE(solved, 1);
+	solved_position[2] = QEF_LANE(solved, 2);
 	return error;
 }
 
@@ -0,0 +1,611 @@
+#include "sign_dag.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+
+using glm::ivec3;
+using glm::vec3;
+
+// ----------------------------------------------------------------------------
+
+// References: the two constants, or an index into the leaves (top bit set) or
+// nodes (offset past the constants)
+static const uint32_t REF_OUTSIDE = 0;
+static const uint32_t REF_INSIDE = 1;
+static const uint32_t REF_FIRST_NODE = 2;
+static const uint32_t REF_LEAF = 0x80000000u;
+
+static const int LEAF_SIZE = 1 << SIGN_DAG_LEAF_LOG2;
+static const uint64_t LEAF_ALL_INSIDE = ~0ULL;
+
+// deep enough for any cube whose corners an int can address
+static const int MAX_LEVELS = 30;
+
+struct SignDagFileHeader
+{
+	uint32_t		magic;
+	uint32_t		version;
+	uint64_t		paramsHash;
+	int32_t			origin[3];
+	int32_t			levels;
+	uint32_t		root;
+	uint32_t		numNodes;
+	uint32_t		numLeaves;
+	uint32_t		reserved;
+};
+
+// ----------------------------------------------------------------------------
+
+static bool IsLeaf(const uint32_t ref)
+{
+	return (ref & REF_LEAF) != 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static int LeafBit(const ivec3& local)
+{
+	return (((local.x & (LEAF_SIZE - 1)) * LEAF_SIZE) + (local.y & (LEAF_SIZE - 1))) * LEAF_SIZE + (local.z & (LEAF_SIZE - 1));
+}
+
+// ----------------------------------------------------------------------------
+
+static ivec3 ChildOffset(const int child)
+{
+	return ivec3((child >> 2) & 1, (child >> 1) & 1, child & 1);
+}
+
+// ----------------------------------------------------------------------------
+
+static int FloorDiv(const int a, const int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// ----------------------------------------------------------------------------
+
+static uint64_t HashDensityParams(const DensityParams& density)
+{
+	// plain 4 byte fields, no padding
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&density);
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < sizeof(density); i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+// ----------------------------------------------------------------------------
+
+// The nodes and leaves of one or more subtrees, each stored once however many
+// times it appears. Children are always added before their parents.
+class SignDagBuilder
+{
+public:
+
+	SignDagBuilder(const DensityParams& density, const std::atomic<bool>* cancel)
+		: density_(density)
+		, cancel_(cancel)
+	{
+	}
+
+	// the subtree of 2^level corners per side from min (world position)
+	uint32_t build(const ivec3& min, const int level)
+	{
+		if (cancel_ && cancel_->load(std::memory_order_relaxed))
+		{
+			return REF_OUTSIDE;
+		}
+
+		const int side = 1 << level;
+		const DensityRange range = Density_Range(density_, vec3(min), vec3(min + ivec3(side - 1)));
+		if (range.min >= 0.f)
+		{
+			return REF_OUTSIDE;
+		}
+
+		if (range.max < 0.f)
+		{
+			return REF_INSIDE;
+		}
+
+		if (level == SIGN_DAG_LEAF_LOG2)
+		{
+			uint64_t bits = 0;
+			for (int x = 0; x < LEAF_SIZE; x++)
+			for (int y = 0; y < LEAF_SIZE; y++)
+			for (int z = 0; z < LEAF_SIZE; z++)
+			{
+				const ivec3 local(x, y, z);
+				if (Density_Func(density_, vec3(min + local)) < 0.f)
+				{
+					bits |= 1ULL << LeafBit(local);
+				}
+			}
+
+			return addLeaf(bits);
+		}
+
+		uint32_t refs[8];
+		for (int i = 0; i < 8; i++)
+		{
+			refs[i] = build(min + ChildOffset(i) * (side / 2), level - 1);
+		}
+
+		return addNode(refs);
+	}
+
+	uint32_t addLeaf(const uint64_t bits)
+	{
+		if (bits == 0 || bits == LEAF_ALL_INSIDE)
+		{
+			return bits == 0 ? REF_OUTSIDE : REF_INSIDE;
+		}
+
+		const auto inserted = leafIndex_.emplace(bits, (uint32_t)leaves.size());
+		if (inserted.second)
+		{
+			leaves.push_back(bits);
+		}
+
+		return REF_LEAF | inserted.first->second;
+	}
+
+	uint32_t addNode(const uint32_t* refs)
+	{
+		if (refs[0] < REF_FIRST_NODE && std::all_of(refs + 1, refs + 8, [&](const uint32_t ref) { return ref == refs[0]; }))
+		{
+			return refs[0];
+		}
+
+		NodeKey key;
+		memcpy(key.refs, refs, sizeof(key.refs));
+
+		const auto inserted = nodeIndex_.emplace(key, (uint32_t)(nodes.size() / 8));
+		if (inserted.second)
+		{
+			nodes.insert(end(nodes), refs, refs + 8);
+		}
+
+		return REF_FIRST_NODE + inserted.first->second;
+	}
+
+	// Adds everything another builder holds, returns where its references
+	// went in this one (see translate)
+	void merge(const SignDagBuilder& other, std::vector<uint32_t>& leafMap, std::vector<uint32_t>& nodeMap)
+	{
+		leafMap.resize(other.leaves.size());
+		for (size_t i = 0; i < other.leaves.size(); i++)
+		{
+			leafMap[i] = addLeaf(other.leaves[i]);
+		}
+
+		nodeMap.resize(other.nodes.size() / 8);
+		for (size_t i = 0; i < nodeMap.size(); i++)
+		{
+			uint32_t refs[8];
+			for (int j = 0; j < 8; j++)
+			{
+				refs[j] = translate(other.nodes[i * 8 + j], leafMap, nodeMap);
+			}
+
+			nodeMap[i] = addNode(refs);
+		}
+	}
+
+	static uint32_t translate(const uint32_t ref, const std::vector<uint32_t>& leafMap, const std::vector<uint32_t>& nodeMap)
+	{
+		if (ref < REF_FIRST_NODE)
+		{
+			return ref;
+		}
+
+		return IsLeaf(ref) ? leafMap[ref & ~REF_LEAF] : nodeMap[ref - REF_FIRST_NODE];
+	}
+
+	std::vector<uint32_t>	nodes;
+	std::vector<uint64_t>	leaves;
+
+private:
+
+	struct NodeKey
+	{
+		uint32_t	refs[8];
+
+		bool operator==(const NodeKey& other) const { return memcmp(refs, other.refs, sizeof(refs)) == 0; }
+	};
+
+	struct NodeKeyHash
+	{
+		size_t operator()(const NodeKey& key) const
+		{
+			uint64_t hash = 0xcbf29ce484222325ULL;
+			for (const uint32_t ref : key.refs)
+			{
+				hash = (hash ^ ref) * 0x100000001b3ULL;
+			}
+
+			return (size_t)(hash ^ (hash >> 32));
+		}
+	};
+
+	const DensityParams&	density_;
+	const std::atomic<bool>* cancel_;
+
+	std::unordered_map<uint64_t, uint32_t> leafIndex_;
+	std::unordered_map<NodeKey, uint32_t, NodeKeyHash> nodeIndex_;
+};
+
+// ----------------------------------------------------------------------------
+
+std::shared_ptr<SignDag> SignDag::build(const DensityParams& density, const ivec3& origin, const int size, const int numThreads, const std::atomic<bool>* cancel)
+{
+	int levels = SIGN_DAG_LEAF_LOG2;
+	while ((1 << levels) < size && levels < MAX_LEVELS)
+	{
+		levels++;
+	}
+
+	// the top few levels are split into subtrees for the workers, a few each
+	// so one busy subtree (all surface) doesn't hold the rest up
+	int splitLevels = 0;
+	while (splitLevels < levels - SIGN_DAG_LEAF_LOG2 && (1 << (3 * splitLevels)) < 4 * std::max(1, numThreads))
+	{
+		splitLevels++;
+	}
+
+	const int numSubtrees = 1 << (3 * splitLevels);
+	const int subtreeLevel = levels - splitLevels;
+	const int subtreesPerSide = 1 << splitLevels;
+
+	const int numWorkers = std::max(1, std::min(numThreads, numSubtrees));
+	std::vector<std::unique_ptr<SignDagBuilder>> builders;
+	for (int i = 0; i < numWorkers; i++)
+	{
+		builders.emplace_back(new SignDagBuilder(density, cancel));
+	}
+
+	std::vector<int> subtreeWorker(numSubtrees);
+	std::vector<uint32_t> subtreeRefs(numSubtrees);
+	std::atomic<int> next(0);
+
+	const auto work = [&](const int worker)
+	{
+		for (int i = next++; i < numSubtrees; i = next++)
+		{
+			const ivec3 coord(i / (subtreesPerSide * subtreesPerSide), (i / subtreesPerSide) % subtreesPerSide, i % subtreesPerSide);
+			subtreeWorker[i] = worker;
+			subtreeRefs[i] = builders[worker]->build(origin + coord * (1 << subtreeLevel), subtreeLevel);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numWorkers; i++)
+	{
+		threads.emplace_back(work, i);
+	}
+
+	work(0);
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	if (cancel && cancel->load())
+	{
+		return nullptr;
+	}
+
+	// the first worker's builder becomes the DAG's, the others are merged in
+	// so subtrees found by different workers are still only stored once
+	SignDagBuilder& dag = *builders[0];
+	std::vector<std::vector<uint32_t>> leafMaps(numWorkers), nodeMaps(numWorkers);
+	for (int i = 1; i < numWorkers; i++)
+	{
+		dag.merge(*builders[i], leafMaps[i], nodeMaps[i]);
+		builders[i].reset();
+	}
+
+	for (int i = 0; i < numSubtrees; i++)
+	{
+		if (subtreeWorker[i] != 0)
+		{
+			subtreeRefs[i] = SignDagBuilder::translate(subtreeRefs[i], leafMaps[subtreeWorker[i]], nodeMaps[subtreeWorker[i]]);
+		}
+	}
+
+	// and the split levels on top, bottom up
+	std::vector<uint32_t> level = subtreeRefs;
+	for (int side = subtreesPerSide; side > 1; side /= 2)
+	{
+		const int half = side / 2;
+		std::vector<uint32_t> parents(half * half * half);
+		for (int x = 0; x < half; x++)
+		for (int y = 0; y < half; y++)
+		for (int z = 0; z < half; z++)
+		{
+			uint32_t refs[8];
+			for (int i = 0; i < 8; i++)
+			{
+				const ivec3 child = ivec3(x, y, z) * 2 + ChildOffset(i);
+				refs[i] = level[(child.x * side + child.y) * side + child.z];
+			}
+
+			parents[(x * half + y) * half + z] = dag.addNode(refs);
+		}
+
+		level.swap(parents);
+	}
+
+	std::shared_ptr<SignDag> result(new SignDag);
+	result->origin_ = origin;
+	result->levels_ = levels;
+	result->paramsHash_ = HashDensityParams(density);
+	result->root_ = level[0];
+	result->nodes_.swap(dag.nodes);
+	result->leaves_.swap(dag.leaves);
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+std::shared_ptr<SignDag> SignDag::load(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return nullptr;
+	}
+
+	std::shared_ptr<SignDag> result(new SignDag);
+	SignDagFileHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == SIGN_DAG_FILE_MAGIC && header.version == SIGN_DAG_FILE_VERSION &&
+		header.levels >= SIGN_DAG_LEAF_LOG2 && header.levels <= MAX_LEVELS;
+
+	// the counts come from the file, a damaged one mustn't get a huge
+	// allocation before the reads fail
+	if (ok)
+	{
+		const long start = ftell(file);
+		ok = start >= 0 && fseek(file, 0, SEEK_END) == 0;
+
+		const long end = ok ? ftell(file) : -1;
+		const uint64_t needed = (uint64_t)header.numNodes * 8 * sizeof(uint32_t) + (uint64_t)header.numLeaves * sizeof(uint64_t);
+		ok = end >= start && needed <= (uint64_t)(end - start) && fseek(file, start, SEEK_SET) == 0;
+	}
+
+	if (ok)
+	{
+		result->nodes_.resize((size_t)header.numNodes * 8);
+		result->leaves_.resize(header.numLeaves);
+		ok = (result->nodes_.empty() || fread(result->nodes_.data(), sizeof(uint32_t), result->nodes_.size(), file) == result->nodes_.size()) &&
+			(result->leaves_.empty() || fread(result->leaves_.data(), sizeof(uint64_t), result->leaves_.size(), file) == result->leaves_.size());
+	}
+
+	fclose(file);
+
+	// every reference has to land somewhere, the queries don't check
+	const auto valid = [&](const uint32_t ref)
+	{
+		return ref < REF_FIRST_NODE || (IsLeaf(ref) ? (ref & ~REF_LEAF) < header.numLeaves : ref - REF_FIRST_NODE < header.numNodes);
+	};
+
+	if (!ok || !valid(header.root) || !std::all_of(begin(result->nodes_), end(result->nodes_), valid))
+	{
+		return nullptr;
+	}
+
+	result->origin_ = ivec3(header.origin[0], header.origin[1], header.origin[2]);
+	result->levels_ = header.levels;
+	result->paramsHash_ = header.paramsHash;
+	result->root_ = header.root;
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+bool SignDag::save(const std::string& path) const
+{
+	// written next to the destination and renamed, a reader never sees half a file
+	const std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	SignDagFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SIGN_DAG_FILE_MAGIC;
+	header.version = SIGN_DAG_FILE_VERSION;
+	header.paramsHash = paramsHash_;
+	header.origin[0] = origin_.x;
+	header.origin[1] = origin_.y;
+	header.origin[2] = origin_.z;
+	header.levels = levels_;
+	header.root = root_;
+	header.numNodes = (uint32_t)(nodes_.size() / 8);
+	header.numLeaves = (uint32_t)leaves_.size();
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(nodes_.empty() || fwrite(nodes_.data(), sizeof(uint32_t), nodes_.size(), file) == nodes_.size()) &&
+		(leaves_.empty() || fwrite(leaves_.data(), sizeof(uint64_t), leaves_.size(), file) == leaves_.size());
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	remove(path.c_str());
+#endif
+	return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// ----------------------------------------------------------------------------
+
+bool SignDag::matches(const DensityParams& density) const
+{
+	return paramsHash_ == HashDensityParams(density);
+}
+
+// ----------------------------------------------------------------------------
+
+bool SignDag::contains(const ivec3& min, const ivec3& max) const
+{
+	const ivec3 end = origin_ + ivec3(size());
+	return glm::all(glm::greaterThanEqual(min, origin_)) && glm::all(glm::lessThan(max, end));
+}
+
+// ----------------------------------------------------------------------------
+
+bool SignDag::inside(const ivec3& corner) const
+{
+	const ivec3 local = corner - origin_;
+	uint32_t ref = root_;
+	int level = levels_;
+
+	while (ref >= REF_FIRST_NODE && !IsLeaf(ref))
+	{
+		level--;
+		const int child = (((local.x >> level) & 1) << 2) | (((local.y >> level) & 1) << 1) | ((local.z >> level) & 1);
+		ref = nodes_[(ref - REF_FIRST_NODE) * 8 + child];
+	}
+
+	if (IsLeaf(ref))
+	{
+		return ((leaves_[ref & ~REF_LEAF] >> LeafBit(local)) & 1) != 0;
+	}
+
+	return ref == REF_INSIDE;
+}
+
+// ----------------------------------------------------------------------------
+
+CornerSigns SignDag::classify(const ivec3& min, const ivec3& max) const
+{
+	return classify(root_, ivec3(0), levels_, min - origin_, max - origin_);
+}
+
+// ----------------------------------------------------------------------------
+
+CornerSigns SignDag::classify(const uint32_t ref, const ivec3& nodeMin, const int level, const ivec3& min, const ivec3& max) const
+{
+	if (ref < REF_FIRST_NODE)
+	{
+		return ref == REF_INSIDE ? CornerSigns_Inside : CornerSigns_Outside;
+	}
+
+	const ivec3 lo = glm::max(min, nodeMin);
+	const ivec3 hi = glm::min(max, nodeMin + ivec3((1 << level) - 1));
+
+	if (IsLeaf(ref))
+	{
+		uint64_t mask = 0;
+		for (int x = lo.x; x <= hi.x; x++)
+		for (int y = lo.y; y <= hi.y; y++)
+		for (int z = lo.z; z <= hi.z; z++)
+		{
+			mask |= 1ULL << LeafBit(ivec3(x, y, z));
+		}
+
+		const uint64_t bits = leaves_[ref & ~REF_LEAF] & mask;
+		return bits == 0 ? CornerSigns_Outside : (bits == mask ? CornerSigns_Inside : CornerSigns_Mixed);
+	}
+
+	const int half = 1 << (level - 1);
+	int found = -1;
+	for (int i = 0; i < 8; i++)
+	{
+		const ivec3 childMin = nodeMin + ChildOffset(i) * half;
+		if (glm::any(glm::greaterThan(childMin, hi)) || glm::any(glm::lessThan(childMin + ivec3(half - 1), lo)))
+		{
+			continue;
+		}
+
+		const CornerSigns signs = classify(nodes_[(ref - REF_FIRST_NODE) * 8 + i], childMin, level - 1, lo, hi);
+		if (signs == CornerSigns_Mixed || (found >= 0 && signs != found))
+		{
+			return CornerSigns_Mixed;
+		}
+
+		found = signs;
+	}
+
+	return (CornerSigns)found;
+}
+
+// ----------------------------------------------------------------------------
+
+void SignDag::fill(const ivec3& origin, const int stride, const int count, float* lattice) const
+{
+	fill(root_, ivec3(0), levels_, origin - origin_, stride, count, lattice);
+}
+
+// ----------------------------------------------------------------------------
+
+void SignDag::fill(const uint32_t ref, const ivec3& nodeMin, const int level, const ivec3& origin, const int stride, const int count, float* lattice) const
+{
+	// the lattice corners inside this node
+	const ivec3 nodeMax = nodeMin + ivec3((1 << level) - 1);
+	ivec3 lo, hi;
+	for (int i = 0; i < 3; i++)
+	{
+		lo[i] = std::max(-FloorDiv(origin[i] - nodeMin[i], stride), 0);
+		hi[i] = std::min(FloorDiv(nodeMax[i] - origin[i], stride), count - 1);
+		if (lo[i] > hi[i])
+		{
+			return;
+		}
+	}
+
+	if (ref < REF_FIRST_NODE || IsLeaf(ref))
+	{
+		const float uniform = ref == REF_INSIDE ? -1.f : 1.f;
+		const uint64_t bits = IsLeaf(ref) ? leaves_[ref & ~REF_LEAF] : 0;
+
+		for (int x = lo.x; x <= hi.x; x++)
+		for (int y = lo.y; y <= hi.y; y++)
+		{
+			float* column = lattice + ((size_t)x * count + y) * count;
+			for (int z = lo.z; z <= hi.z; z++)
+			{
+				column[z] = IsLeaf(ref) ? (((bits >> LeafBit(origin + ivec3(x, y, z) * stride)) & 1) ? -1.f : 1.f) : uniform;
+			}
+		}
+
+		return;
+	}
+
+	const int half = 1 << (level - 1);
+	for (int i = 0; i < 8; i++)
+	{
+		fill(nodes_[(ref - REF_FIRST_NODE) * 8 + i], nodeMin + ChildOffset(i) * half, level - 1, origin, stride, count, lattice);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+SignDagStats SignDag::stats() const
+{
+	SignDagStats stats;
+	stats.size = size();
+	stats.numNodes = (int)(nodes_.size() / 8);
+	stats.numLeaves = (int)leaves_.size();
+	stats.bytes = (long long)(nodes_.size() * sizeof(uint32_t) + leaves_.size() * sizeof(uint64_t));
+
+	const double rawBytes = (double)size() * size() * size() / 8.0;
+	stats.compression = (float)(rawBytes / std::max(1LL, stats.bytes));
+	return stats;
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,116 @@
+#ifndef		HAS_SIGN_DAG_H_BEEN_INCLUDED
+#define		HAS_SIGN_DAG_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "density.h"
+
+// ----------------------------------------------------------------------------
+
+#define SIGN_DAG_FILE_MAGIC		0x47414453	// 'SDAG'
+#define SIGN_DAG_FILE_VERSION	1
+
+// Leaves are 4^3 corners, one bit each, so a leaf is a single uint64_t
+#define SIGN_DAG_LEAF_LOG2		2
+
+// ----------------------------------------------------------------------------
+
+// What the corners of a box hold
+enum CornerSigns
+{
+	CornerSigns_Outside,		// every corner >= 0, air
+	CornerSigns_Inside,			// every corner < 0, solid
+	CornerSigns_Mixed,
+};
+
+// Shared with DualContouringDLL.SignDagStats
+struct SignDagStats
+{
+	int			size = 0;				// corners along each side, 0 when there's no DAG
+	int			numNodes = 0;
+	int			numLeaves = 0;
+	float		compression = 0.f;		// one bit per corner over bytes()
+	long long	bytes = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+// The sign of every lattice corner (world units, the finest LOD's corners) of
+// a cube baked once for a static world, as a sparse voxel DAG: an octree whose
+// all-air and all-solid subtrees are a single reference and whose identical
+// subtrees are stored once, however many places they appear. The sign is the
+// material ConstructLeaf derives for a corner, density < 0 is solid.
+//
+// The meshers read it in place of sampling the density wherever it covers a
+// chunk, see Density_BakedSigns: chunks whose corners are all one sign are
+// rejected exactly, fast_dc's lattice is filled from it and the octree skips
+// uniform nodes. Only the edges which cross the surface still sample the
+// density, for their Hermite data, so the meshes don't change.
+//
+// Immutable once built or loaded, safe to query from any thread.
+class SignDag
+{
+public:
+
+	// size is a power of two, at least 1 << SIGN_DAG_LEAF_LOG2. Subtrees which
+	// Density_Range proves uniform aren't sampled, so the work follows the
+	// surface. The top of the tree is split over numThreads. Null if cancel
+	// is raised.
+	static std::shared_ptr<SignDag> build(const DensityParams& density, const glm::ivec3& origin, const int size,
+		const int numThreads = 1, const std::atomic<bool>* cancel = nullptr);
+
+	// Null if the file is missing, truncated or from another version
+	static std::shared_ptr<SignDag> load(const std::string& path);
+	bool save(const std::string& path) const;
+
+	// Whether it was baked from this density
+	bool matches(const DensityParams& density) const;
+
+	// Whether every corner from min to max (inclusive) is in the cube
+	bool contains(const glm::ivec3& min, const glm::ivec3& max) const;
+
+	const glm::ivec3& origin() const { return origin_; }
+	int size() const { return 1 << levels_; }
+
+	// Corners must be inside the cube, see contains
+	bool inside(const glm::ivec3& corner) const;
+	CornerSigns classify(const glm::ivec3& min, const glm::ivec3& max) const;
+
+	// count^3 corners from origin, stride apart, x major: -1 inside and +1
+	// outside, which is all the meshers use the samples for
+	void fill(const glm::ivec3& origin, const int stride, const int count, float* lattice) const;
+
+	SignDagStats stats() const;
+
+private:
+
+	SignDag() = default;
+	SignDag(const SignDag&) = delete;
+	SignDag& operator=(const SignDag&) = delete;
+
+	friend class SignDagBuilder;
+
+	CornerSigns classify(const uint32_t ref, const glm::ivec3& nodeMin, const int level, const glm::ivec3& min, const glm::ivec3& max) const;
+	void fill(const uint32_t ref, const glm::ivec3& nodeMin, const int level, const glm::ivec3& origin, const int stride, const int count, float* lattice) const;
+
+	glm::ivec3				origin_ = glm::ivec3(0);
+	int						levels_ = SIGN_DAG_LEAF_LOG2;
+	uint64_t				paramsHash_ = 0;
+
+	// a reference is all outside, all inside, a leaf or a node (see sign_dag.cpp)
+	uint32_t				root_ = 0;
+
+	// eight child references per node, in octant order (x, y, z from the high bit)
+	std::vector<uint32_t>	nodes_;
+	std::vector<uint64_t>	leaves_;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_SIGN_DAG_H_BEEN_INCLUDED
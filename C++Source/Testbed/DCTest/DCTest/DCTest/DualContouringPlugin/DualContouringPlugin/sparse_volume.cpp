@@ -0,0 +1,509 @@
+#include "sparse_volume.h"
+
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+using glm::ivec3;
+using glm::vec3;
+
+// ----------------------------------------------------------------------------
+
+static const int LEAF_SIZE = 1 << SPARSE_VOLUME_LEAF_LOG2;
+static const int LEAF_MASK = LEAF_SIZE - 1;
+static const int LEAF_VOXELS = LEAF_SIZE * LEAF_SIZE * LEAF_SIZE;
+static const int NODE_SIZE = 1 << SPARSE_VOLUME_NODE_LOG2;
+static const int NODE_MASK = NODE_SIZE - 1;
+static const int NODE_SLOTS = NODE_SIZE * NODE_SIZE * NODE_SIZE;
+
+// int8 steps across the band
+static const float QUANTIZE_STEPS = 127.f;
+
+static std::atomic<uint64_t> g_nextVersion(1);
+
+// ----------------------------------------------------------------------------
+
+static uint64_t HashBytes(uint64_t hash, const void* data, const size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+// ----------------------------------------------------------------------------
+
+static uint64_t PackNodeCoord(const ivec3& coord)
+{
+	return ((uint64_t)(coord.x & 0x1fffff) << 42) | ((uint64_t)(coord.y & 0x1fffff) << 21) | (uint64_t)(coord.z & 0x1fffff);
+}
+
+// ----------------------------------------------------------------------------
+
+static int SlotIndex(const ivec3& leafCoord)
+{
+	return (((leafCoord.x & NODE_MASK) * NODE_SIZE) + (leafCoord.y & NODE_MASK)) * NODE_SIZE + (leafCoord.z & NODE_MASK);
+}
+
+// ----------------------------------------------------------------------------
+
+static int VoxelIndex(const ivec3& voxel)
+{
+	return (((voxel.x & LEAF_MASK) * LEAF_SIZE) + (voxel.y & LEAF_MASK)) * LEAF_SIZE + (voxel.z & LEAF_MASK);
+}
+
+// ----------------------------------------------------------------------------
+
+static int8_t Quantize(const float density)
+{
+	const float clamped = glm::clamp(density, -SPARSE_VOLUME_BAND, SPARSE_VOLUME_BAND);
+	int q = (int)roundf(clamped * (QUANTIZE_STEPS / SPARSE_VOLUME_BAND));
+
+	// keep the sign, a voxel rounded to zero would flip to outside
+	if (q == 0 && density < 0.f)
+	{
+		q = -1;
+	}
+
+	return (int8_t)q;
+}
+
+// ----------------------------------------------------------------------------
+
+static float Dequantize(const int8_t q)
+{
+	return q * (SPARSE_VOLUME_BAND / QUANTIZE_STEPS);
+}
+
+// ----------------------------------------------------------------------------
+
+static float EditDistance(const DensityEdit& edit, const vec3& p)
+{
+	if (edit.shape == DensityEditShape_Box)
+	{
+		const vec3 d = glm::abs(p - edit.centre) - glm::abs(edit.size);
+		return glm::min(glm::max(d.x, glm::max(d.y, d.z)), 0.f) + glm::length(glm::max(d, vec3(0.f)));
+	}
+
+	return glm::length(p - edit.centre) - edit.size.x;
+}
+
+// ----------------------------------------------------------------------------
+
+SparseVolume::SparseVolume()
+	: version_(g_nextVersion++)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+SparseVolume::SparseVolume(const SparseVolume& other)
+	: nodes_(other.nodes_)
+	, version_(g_nextVersion++)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+// Calls f(leafCoord, slot, leaf) for every stored slot over the voxels of the
+// box, returns whether they all were
+template <typename F>
+bool SparseVolume::forEachSlot(const ivec3& min, const ivec3& max, F&& f) const
+{
+	const ivec3 leafMin = min >> SPARSE_VOLUME_LEAF_LOG2;
+	const ivec3 leafMax = max >> SPARSE_VOLUME_LEAF_LOG2;
+	const ivec3 nodeMin = leafMin >> SPARSE_VOLUME_NODE_LOG2;
+	const ivec3 nodeMax = leafMax >> SPARSE_VOLUME_NODE_LOG2;
+	bool covered = true;
+
+	for (int nx = nodeMin.x; nx <= nodeMax.x; nx++)
+	for (int ny = nodeMin.y; ny <= nodeMax.y; ny++)
+	for (int nz = nodeMin.z; nz <= nodeMax.z; nz++)
+	{
+		const ivec3 nodeCoord(nx, ny, nz);
+		const auto iter = nodes_.find(PackNodeCoord(nodeCoord));
+		if (iter == end(nodes_))
+		{
+			covered = false;
+			continue;
+		}
+
+		const Node& node = *iter->second;
+		const ivec3 lo = glm::max(leafMin, nodeCoord * NODE_SIZE);
+		const ivec3 hi = glm::min(leafMax, nodeCoord * NODE_SIZE + ivec3(NODE_MASK));
+
+		for (int x = lo.x; x <= hi.x; x++)
+		for (int y = lo.y; y <= hi.y; y++)
+		for (int z = lo.z; z <= hi.z; z++)
+		{
+			const ivec3 leafCoord(x, y, z);
+			const int slot = SlotIndex(leafCoord);
+			if (node.slots[slot] == Slot_Empty)
+			{
+				covered = false;
+				continue;
+			}
+
+			f(leafCoord, node.slots[slot], node.leaves[slot].get());
+		}
+	}
+
+	return covered;
+}
+
+// ----------------------------------------------------------------------------
+
+void SparseVolume::expand(const Node* node, const int slot, const ivec3& leafMin, const DensityParams& density, float* values) const
+{
+	const Slot state = node ? node->slots[slot] : Slot_Empty;
+	if (state == Slot_Leaf)
+	{
+		const Leaf& leaf = *node->leaves[slot];
+		for (int i = 0; i < LEAF_VOXELS; i++)
+		{
+			values[i] = Dequantize(leaf.values[i]);
+		}
+
+		return;
+	}
+
+	float uniform = state == Slot_Inside ? -SPARSE_VOLUME_BAND : SPARSE_VOLUME_BAND;
+	if (state == Slot_Empty)
+	{
+		// nothing stored, the procedural density unless it's beyond the band
+		// over the whole leaf
+		const DensityRange range = Density_Range(density, vec3(leafMin), vec3(leafMin + ivec3(LEAF_MASK)));
+		if (range.max <= -SPARSE_VOLUME_BAND)
+		{
+			uniform = -SPARSE_VOLUME_BAND;
+		}
+		else if (range.min < SPARSE_VOLUME_BAND)
+		{
+			int i = 0;
+			for (int x = 0; x < LEAF_SIZE; x++)
+			for (int y = 0; y < LEAF_SIZE; y++)
+			for (int z = 0; z < LEAF_SIZE; z++)
+			{
+				values[i++] = Density_Func(density, vec3(leafMin + ivec3(x, y, z)));
+			}
+
+			return;
+		}
+	}
+
+	std::fill(values, values + LEAF_VOXELS, uniform);
+}
+
+// ----------------------------------------------------------------------------
+
+void SparseVolume::apply(const DensityParams& density, const DensityEdit& edit, ivec3& min, ivec3& max)
+{
+	const vec3 extent = edit.shape == DensityEditShape_Box ? glm::abs(edit.size) : vec3(glm::abs(edit.size.x));
+
+	// outside the shape's bounds plus the band the edit can't change anything
+	min = ivec3(glm::floor(edit.centre - extent)) - ivec3((int)ceilf(SPARSE_VOLUME_BAND));
+	max = ivec3(glm::ceil(edit.centre + extent)) + ivec3((int)ceilf(SPARSE_VOLUME_BAND));
+
+	// one voxel more so every interpolated sample which could see a change is
+	// stored whole, the leaves are the ones covering that
+	const ivec3 leafMin = (min - ivec3(1)) >> SPARSE_VOLUME_LEAF_LOG2;
+	const ivec3 leafMax = (max + ivec3(1)) >> SPARSE_VOLUME_LEAF_LOG2;
+
+	std::unordered_map<uint64_t, std::shared_ptr<Node>> copies;
+	float values[LEAF_VOXELS];
+
+	for (int x = leafMin.x; x <= leafMax.x; x++)
+	for (int y = leafMin.y; y <= leafMax.y; y++)
+	for (int z = leafMin.z; z <= leafMax.z; z++)
+	{
+		const ivec3 leafCoord(x, y, z);
+		const uint64_t key = PackNodeCoord(leafCoord >> SPARSE_VOLUME_NODE_LOG2);
+
+		// nodes are shared with older snapshots, every node the edit reaches
+		// is copied once
+		std::shared_ptr<Node>& node = copies[key];
+		if (!node)
+		{
+			const auto iter = nodes_.find(key);
+			node = std::make_shared<Node>();
+			if (iter != end(nodes_))
+			{
+				*node = *iter->second;
+			}
+			else
+			{
+				std::fill(node->slots, node->slots + NODE_SLOTS, Slot_Empty);
+			}
+		}
+
+		const int slot = SlotIndex(leafCoord);
+		const ivec3 voxelMin = leafCoord * LEAF_SIZE;
+		expand(node.get(), slot, voxelMin, density, values);
+
+		Leaf leaf;
+		memset(leaf.active, 0, sizeof(leaf.active));
+		leaf.min = FLT_MAX;
+		leaf.max = -FLT_MAX;
+
+		int i = 0;
+		int numActive = 0;
+		int numInside = 0;
+		for (int vx = 0; vx < LEAF_SIZE; vx++)
+		for (int vy = 0; vy < LEAF_SIZE; vy++)
+		for (int vz = 0; vz < LEAF_SIZE; vz++, i++)
+		{
+			const float d = EditDistance(edit, vec3(voxelMin + ivec3(vx, vy, vz)));
+			const float combined = edit.operation == DensityEditOperation_Subtract ? glm::max(values[i], -d) : glm::min(values[i], d);
+
+			const int8_t q = Quantize(combined);
+			leaf.values[i] = q;
+			leaf.min = glm::min(leaf.min, Dequantize(q));
+			leaf.max = glm::max(leaf.max, Dequantize(q));
+
+			if (q > -(int)QUANTIZE_STEPS && q < (int)QUANTIZE_STEPS)
+			{
+				leaf.active[i / 64] |= 1ULL << (i % 64);
+				numActive++;
+			}
+
+			numInside += q < 0 ? 1 : 0;
+		}
+
+		// all of it beyond the band on one side, only the sign is worth keeping
+		if (numActive == 0 && (numInside == 0 || numInside == LEAF_VOXELS))
+		{
+			node->slots[slot] = numInside == 0 ? Slot_Outside : Slot_Inside;
+			node->leaves[slot].reset();
+			continue;
+		}
+
+		leaf.hash = HashBytes(0xcbf29ce484222325ULL, leaf.values, sizeof(leaf.values));
+		node->slots[slot] = Slot_Leaf;
+		node->leaves[slot] = std::make_shared<const Leaf>(leaf);
+	}
+
+	for (auto& copy : copies)
+	{
+		nodes_[copy.first] = std::move(copy.second);
+	}
+
+	version_ = g_nextVersion++;
+}
+
+// ----------------------------------------------------------------------------
+
+bool SparseVolume::sample(const vec3& position, float& density) const
+{
+	// one per thread, so the workers' lookups mostly stay in the leaf they
+	// were in last time
+	static thread_local SparseVolumeAccessor accessor;
+	return accessor.sample(*this, position, density);
+}
+
+// ----------------------------------------------------------------------------
+
+bool SparseVolume::range(const ivec3& min, const ivec3& max, DensityRange& range, bool& covered) const
+{
+	range.min = FLT_MAX;
+	range.max = -FLT_MAX;
+	if (nodes_.empty())
+	{
+		covered = false;
+		return false;
+	}
+
+	bool stored = false;
+	covered = forEachSlot(min, max, [&](const ivec3&, const Slot slot, const Leaf* leaf)
+	{
+		const float lo = slot == Slot_Leaf ? leaf->min : (slot == Slot_Inside ? -SPARSE_VOLUME_BAND : SPARSE_VOLUME_BAND);
+		const float hi = slot == Slot_Leaf ? leaf->max : lo;
+		range.min = glm::min(range.min, lo);
+		range.max = glm::max(range.max, hi);
+		stored = true;
+	});
+
+	return stored;
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t SparseVolume::hash(const ivec3& min, const ivec3& max) const
+{
+	if (nodes_.empty())
+	{
+		return 0;
+	}
+
+	uint64_t hash = 0;
+	forEachSlot(min, max, [&](const ivec3& leafCoord, const Slot slot, const Leaf* leaf)
+	{
+		if (hash == 0)
+		{
+			hash = 0xcbf29ce484222325ULL;
+		}
+
+		const uint8_t state = slot;
+		hash = HashBytes(hash, &leafCoord, sizeof(leafCoord));
+		hash = HashBytes(hash, &state, sizeof(state));
+		if (leaf)
+		{
+			hash = HashBytes(hash, &leaf->hash, sizeof(leaf->hash));
+		}
+	});
+
+	return hash;
+}
+
+// ----------------------------------------------------------------------------
+
+DensityEditStats SparseVolume::stats() const
+{
+	DensityEditStats stats;
+	for (const auto& entry : nodes_)
+	{
+		const Node& node = *entry.second;
+		stats.numNodes++;
+
+		for (int i = 0; i < NODE_SLOTS; i++)
+		{
+			if (node.slots[i] == Slot_Leaf)
+			{
+				stats.numLeaves++;
+				for (const uint64_t bits : node.leaves[i]->active)
+				{
+					for (uint64_t b = bits; b; b &= b - 1)
+					{
+						stats.numActiveVoxels++;
+					}
+				}
+			}
+			else if (node.slots[i] != Slot_Empty)
+			{
+				stats.numTiles++;
+			}
+		}
+	}
+
+	stats.bytes = (long long)stats.numNodes * sizeof(Node) + (long long)stats.numLeaves * sizeof(Leaf);
+	return stats;
+}
+
+// ----------------------------------------------------------------------------
+
+const SparseVolume::Leaf* SparseVolumeAccessor::leaf(const SparseVolume& volume, const ivec3& leafCoord, SparseVolume::Slot& slot)
+{
+	if (version_ != volume.version_)
+	{
+		// a different volume, or this one since it changed
+		version_ = volume.version_;
+		node_ = nullptr;
+		nodeCoord_ = ivec3(INT_MAX);
+		leafCoord_ = ivec3(INT_MAX);
+	}
+
+	if (leafCoord != leafCoord_)
+	{
+		const ivec3 nodeCoord = leafCoord >> SPARSE_VOLUME_NODE_LOG2;
+		if (nodeCoord != nodeCoord_)
+		{
+			const auto iter = volume.nodes_.find(PackNodeCoord(nodeCoord));
+			node_ = iter != end(volume.nodes_) ? iter->second.get() : nullptr;
+			nodeCoord_ = nodeCoord;
+		}
+
+		const int index = SlotIndex(leafCoord);
+		leafSlot_ = node_ ? node_->slots[index] : SparseVolume::Slot_Empty;
+		leaf_ = node_ ? node_->leaves[index].get() : nullptr;
+		leafCoord_ = leafCoord;
+	}
+
+	slot = leafSlot_;
+	return leaf_;
+}
+
+// ----------------------------------------------------------------------------
+
+bool SparseVolumeAccessor::value(const SparseVolume& volume, const ivec3& voxel, float& density)
+{
+	SparseVolume::Slot slot;
+	const SparseVolume::Leaf* leaf = this->leaf(volume, voxel >> SPARSE_VOLUME_LEAF_LOG2, slot);
+
+	switch (slot)
+	{
+	case SparseVolume::Slot_Outside:
+		density = SPARSE_VOLUME_BAND;
+		return true;
+
+	case SparseVolume::Slot_Inside:
+		density = -SPARSE_VOLUME_BAND;
+		return true;
+
+	case SparseVolume::Slot_Leaf:
+		density = Dequantize(leaf->values[VoxelIndex(voxel)]);
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool SparseVolumeAccessor::sample(const SparseVolume& volume, const vec3& position, float& density)
+{
+	const vec3 corner = glm::floor(position);
+	const vec3 t = position - corner;
+	const ivec3 voxel(corner);
+	const ivec3 local = voxel & ivec3(LEAF_MASK);
+	float c[8];
+
+	if (local.x < LEAF_MASK && local.y < LEAF_MASK && local.z < LEAF_MASK)
+	{
+		// all eight corners in the same leaf (or tile), the common case
+		SparseVolume::Slot slot;
+		const SparseVolume::Leaf* leaf = this->leaf(volume, voxel >> SPARSE_VOLUME_LEAF_LOG2, slot);
+		if (slot != SparseVolume::Slot_Leaf)
+		{
+			density = slot == SparseVolume::Slot_Inside ? -SPARSE_VOLUME_BAND : SPARSE_VOLUME_BAND;
+			return slot != SparseVolume::Slot_Empty;
+		}
+
+		const int8_t* v = leaf->values + VoxelIndex(voxel);
+		const int dx = LEAF_SIZE * LEAF_SIZE;
+		const int dy = LEAF_SIZE;
+		c[0] = Dequantize(v[0]);
+		c[1] = Dequantize(v[1]);
+		c[2] = Dequantize(v[dy]);
+		c[3] = Dequantize(v[dy + 1]);
+		c[4] = Dequantize(v[dx]);
+		c[5] = Dequantize(v[dx + 1]);
+		c[6] = Dequantize(v[dx + dy]);
+		c[7] = Dequantize(v[dx + dy + 1]);
+	}
+	else
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			if (!value(volume, voxel + ivec3((i >> 2) & 1, (i >> 1) & 1, i & 1), c[i]))
+			{
+				return false;
+			}
+		}
+	}
+
+	// c is indexed x, y, z from the high bit down
+	const float c00 = glm::mix(c[0], c[1], t.z);
+	const float c01 = glm::mix(c[2], c[3], t.z);
+	const float c10 = glm::mix(c[4], c[5], t.z);
+	const float c11 = glm::mix(c[6], c[7], t.z);
+	density = glm::mix(glm::mix(c00, c01, t.y), glm::mix(c10, c11, t.y), t.x);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
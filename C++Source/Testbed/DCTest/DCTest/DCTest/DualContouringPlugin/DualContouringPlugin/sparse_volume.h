@@ -0,0 +1,171 @@
+#ifndef		HAS_SPARSE_VOLUME_H_BEEN_INCLUDED
+#define		HAS_SPARSE_VOLUME_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include "glm/glm.hpp"
+#include "density.h"
+
+// ----------------------------------------------------------------------------
+
+// Leaves are 8^3 voxels and internal nodes 16^3 leaves (128^3 voxels), the
+// voxels are one world unit wide like the finest LOD's
+#define SPARSE_VOLUME_LEAF_LOG2		3
+#define SPARSE_VOLUME_NODE_LOG2		4
+
+// Densities within this distance of the surface (world units) are stored,
+// anything further out is clamped to it and only its sign is kept
+#define SPARSE_VOLUME_BAND			4.f
+
+// ----------------------------------------------------------------------------
+
+// Values are shared with the managed side (DualContouringDLL.DensityEditShape etc)
+enum DensityEditShape
+{
+	DensityEditShape_Sphere = 0,		// radius is size.x
+	DensityEditShape_Box = 1,			// size is the half extents
+};
+
+enum DensityEditOperation
+{
+	DensityEditOperation_Add = 0,		// union with the shape
+	DensityEditOperation_Subtract = 1,	// carve the shape out
+};
+
+// Shared with DualContouringDLL.DensityEdit
+struct DensityEdit
+{
+	int			shape = DensityEditShape_Sphere;
+	int			operation = DensityEditOperation_Add;
+	glm::vec3	centre = glm::vec3(0.f);
+	glm::vec3	size = glm::vec3(1.f);
+};
+
+// Shared with DualContouringDLL.DensityEditStats
+struct DensityEditStats
+{
+	int			numNodes = 0;
+	int			numLeaves = 0;
+	int			numTiles = 0;			// leaf slots collapsed to all inside or all outside
+	int			numActiveVoxels = 0;	// voxels within SPARSE_VOLUME_BAND of the surface
+	long long	bytes = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+// The density of an edited world near its surface, VDB style: a hash of
+// internal nodes, each a dense grid of slots which are either a leaf of
+// quantized samples, a tile wholly inside or outside the surface, or empty.
+// Empty slots (and everywhere without a node) fall through to the procedural
+// density, so memory grows with the edited surface rather than the volume.
+//
+// An edit samples the current density over the leaves it reaches (and a leaf
+// either side, so interpolation never straddles edited and procedural data),
+// combines the shape with it and stores the result, so the edit list never
+// has to be replayed.
+//
+// Volumes are copied on write: copying one shares every node and apply() only
+// copies the nodes and leaves it changes. The generator context publishes
+// each edited copy as a new snapshot, chunks already queued keep sampling the
+// one they were stamped with. A volume must not change while it's sampled.
+class SparseVolume
+{
+public:
+
+	SparseVolume();
+	SparseVolume(const SparseVolume& other);
+
+	// Stamps the edit onto the volume, sampling density where the volume has
+	// nothing yet. min and max are set to the box of voxels which changed.
+	void apply(const DensityParams& density, const DensityEdit& edit, glm::ivec3& min, glm::ivec3& max);
+
+	// Trilinear density at a world position, false if any of the voxels around
+	// it isn't stored (the procedural density applies). Each thread keeps a
+	// SparseVolumeAccessor so neighbouring lookups skip the hash and the node.
+	bool sample(const glm::vec3& position, float& density) const;
+
+	// The stored densities' bounds over the voxels of a box, false if nothing
+	// in it is stored. covered is set when every voxel is, i.e. the procedural
+	// density isn't needed anywhere in the box.
+	bool range(const glm::ivec3& min, const glm::ivec3& max, DensityRange& range, bool& covered) const;
+
+	// Identifies what's stored over the box, the same for two volumes which
+	// hold the same data there and 0 when nothing in the box is stored
+	uint64_t hash(const glm::ivec3& min, const glm::ivec3& max) const;
+
+	bool empty() const { return nodes_.empty(); }
+	DensityEditStats stats() const;
+
+private:
+
+	friend class SparseVolumeAccessor;
+
+	SparseVolume& operator=(const SparseVolume&) = delete;
+
+	enum Slot : uint8_t
+	{
+		Slot_Empty,
+		Slot_Outside,
+		Slot_Inside,
+		Slot_Leaf,
+	};
+
+	struct Leaf
+	{
+		int8_t		values[1 << (3 * SPARSE_VOLUME_LEAF_LOG2)];
+		uint64_t	active[(1 << (3 * SPARSE_VOLUME_LEAF_LOG2)) / 64];
+		float		min;
+		float		max;
+		uint64_t	hash;
+	};
+
+	struct Node
+	{
+		Slot		slots[1 << (3 * SPARSE_VOLUME_NODE_LOG2)];
+		std::shared_ptr<const Leaf> leaves[1 << (3 * SPARSE_VOLUME_NODE_LOG2)];
+	};
+
+	template <typename F>
+	bool forEachSlot(const glm::ivec3& min, const glm::ivec3& max, F&& f) const;
+
+	// the voxel values a slot holds, whatever it is
+	void expand(const Node* node, const int slot, const glm::ivec3& leafMin, const DensityParams& density, float* values) const;
+
+	std::unordered_map<uint64_t, std::shared_ptr<const Node>> nodes_;
+
+	// unique to this volume's contents, accessors compare it before trusting
+	// the node and leaf they cached
+	uint64_t		version_ = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+// Remembers the node and leaf of the last lookup. Not thread safe, each
+// thread sampling a volume needs its own.
+class SparseVolumeAccessor
+{
+public:
+
+	// the quantized density of one voxel, false where the volume holds nothing
+	bool value(const SparseVolume& volume, const glm::ivec3& voxel, float& density);
+
+	bool sample(const SparseVolume& volume, const glm::vec3& position, float& density);
+
+private:
+
+	const SparseVolume::Leaf* leaf(const SparseVolume& volume, const glm::ivec3& leafCoord, SparseVolume::Slot& slot);
+
+	uint64_t		version_ = 0;
+	glm::ivec3		nodeCoord_;
+	const SparseVolume::Node* node_ = nullptr;
+	glm::ivec3		leafCoord_;
+	SparseVolume::Slot leafSlot_ = SparseVolume::Slot_Empty;
+	const SparseVolume::Leaf* leaf_ = nullptr;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_SPARSE_VOLUME_H_BEEN_INCLUDED
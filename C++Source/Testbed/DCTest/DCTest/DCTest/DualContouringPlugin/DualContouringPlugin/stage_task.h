@@ -0,0 +1,232 @@
+#ifndef		HAS_STAGE_TASK_H_BEEN_INCLUDED
+#define		HAS_STAGE_TASK_H_BEEN_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "job_system.h"
+
+// ----------------------------------------------------------------------------
+
+// A value produced by work running on a JobSystem's workers. Pipelines are
+// built by chaining stages with then(), each stage is posted to the job system
+// as soon as its input is ready, so stages of different chunks interleave on
+// the workers without anyone writing a state machine by hand. Stages must
+// return a default constructible value (a pointer or small struct carrying
+// the chunk's state along) and must not
+// block on another StageTask from a worker, chain with then()/WhenAll instead.
+template <typename T>
+class StageTask
+{
+public:
+
+	StageTask() {}
+
+	bool valid() const { return (bool)state_; }
+
+	bool ready() const
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		return state_->ready;
+	}
+
+	// Blocks the calling thread until the value is ready, only for threads
+	// which aren't job system workers
+	const T& wait() const
+	{
+		std::unique_lock<std::mutex> lock(state_->mutex);
+		state_->condition.wait(lock, [this]() { return state_->ready; });
+		return state_->value;
+	}
+
+	// Posts fn(value) to the job system once this task is ready
+	template <typename F>
+	auto then(F fn) const -> StageTask<typename std::decay<decltype(fn(std::declval<const T&>()))>::type>;
+
+	// Posts fn(value) to the job system for as long as more(value) holds, each
+	// call as its own job on the previous call's result, for stages which run
+	// an unknown number of times. fn must return a T.
+	template <typename F, typename P>
+	StageTask<T> thenWhile(F fn, P more) const;
+
+private:
+
+	template <typename> friend class StageTask;
+	template <typename F> friend auto RunStage(JobSystem& executor, F fn) -> StageTask<typename std::decay<decltype(fn())>::type>;
+	template <typename U> friend StageTask<std::vector<U>> WhenAll(JobSystem& executor, const std::vector<StageTask<U>>& tasks);
+
+	struct State
+	{
+		explicit State(JobSystem& executor) : executor(executor) {}
+
+		JobSystem&			executor;
+		std::mutex			mutex;
+		std::condition_variable	condition;
+		bool				ready = false;
+		T					value;
+		std::vector<std::function<void()>> continuations;
+
+		void complete(T result)
+		{
+			std::vector<std::function<void()>> pending;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				value = std::move(result);
+				ready = true;
+				pending.swap(continuations);
+			}
+
+			condition.notify_all();
+			for (auto& continuation : pending)
+			{
+				continuation();
+			}
+		}
+
+		// Runs straight away (on the caller's thread) if already complete
+		void onReady(std::function<void()> continuation)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!ready)
+				{
+					continuations.push_back(std::move(continuation));
+					return;
+				}
+			}
+
+			continuation();
+		}
+	};
+
+	explicit StageTask(JobSystem& executor)
+		: state_(std::make_shared<State>(executor))
+	{
+	}
+
+	template <typename F, typename P>
+	static void postWhile(const std::shared_ptr<State>& target, T value, F fn, P more);
+
+	std::shared_ptr<State> state_;
+};
+
+// ----------------------------------------------------------------------------
+
+// Posts fn() to the job system, the returned task holds its result
+template <typename F>
+auto RunStage(JobSystem& executor, F fn) -> StageTask<typename std::decay<decltype(fn())>::type>
+{
+	typedef typename std::decay<decltype(fn())>::type Result;
+
+	StageTask<Result> task(executor);
+	const auto target = task.state_;
+	executor.post([target, fn]() { target->complete(fn()); });
+
+	return task;
+}
+
+// ----------------------------------------------------------------------------
+
+template <typename T>
+template <typename F>
+auto StageTask<T>::then(F fn) const -> StageTask<typename std::decay<decltype(fn(std::declval<const T&>()))>::type>
+{
+	typedef typename std::decay<decltype(fn(std::declval<const T&>()))>::type Result;
+
+	StageTask<Result> next(state_->executor);
+	const auto source = state_;
+	const auto target = next.state_;
+	source->onReady([source, target, fn]()
+	{
+		source->executor.post([source, target, fn]() { target->complete(fn(source->value)); });
+	});
+
+	return next;
+}
+
+// ----------------------------------------------------------------------------
+
+template <typename T>
+template <typename F, typename P>
+StageTask<T> StageTask<T>::thenWhile(F fn, P more) const
+{
+	StageTask<T> next(state_->executor);
+	const auto source = state_;
+	const auto target = next.state_;
+	source->onReady([source, target, fn, more]() { postWhile(target, source->value, fn, more); });
+
+	return next;
+}
+
+// ----------------------------------------------------------------------------
+
+template <typename T>
+template <typename F, typename P>
+void StageTask<T>::postWhile(const std::shared_ptr<State>& target, T value, F fn, P more)
+{
+	if (!more(value))
+	{
+		target->complete(std::move(value));
+		return;
+	}
+
+	target->executor.post([target, value, fn, more]()
+	{
+		postWhile(target, fn(value), fn, more);
+	});
+}
+
+// ----------------------------------------------------------------------------
+
+// Ready once every task is, values are in the same order as the tasks. Used to
+// fan out work (e.g. a chunk's neighbours) and join on the results.
+template <typename T>
+StageTask<std::vector<T>> WhenAll(JobSystem& executor, const std::vector<StageTask<T>>& tasks)
+{
+	StageTask<std::vector<T>> joined(executor);
+	if (tasks.empty())
+	{
+		joined.state_->complete(std::vector<T>());
+		return joined;
+	}
+
+	const auto target = joined.state_;
+	const auto remaining = std::make_shared<std::atomic<int>>((int)tasks.size());
+	const auto sources = std::make_shared<std::vector<std::shared_ptr<typename StageTask<T>::State>>>();
+	for (const auto& task : tasks)
+	{
+		sources->push_back(task.state_);
+	}
+
+	for (const auto& source : *sources)
+	{
+		source->onReady([target, remaining, sources]()
+		{
+			if (--(*remaining) != 0)
+			{
+				return;
+			}
+
+			std::vector<T> values;
+			values.reserve(sources->size());
+			for (const auto& s : *sources)
+			{
+				values.push_back(s->value);
+			}
+
+			target->complete(std::move(values));
+		});
+	}
+
+	return joined;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_STAGE_TASK_H_BEEN_INCLUDED
@@ -0,0 +1,223 @@
+#include "call_recorder.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "DualContouringPlugin.h"
+#include "test.h"
+
+// ----------------------------------------------------------------------------
+
+struct Recorded
+{
+	int			call;
+	uint32_t	context;
+};
+
+// ----------------------------------------------------------------------------
+
+static ChunkDesc MakeDesc(const int x)
+{
+	ChunkDesc desc;
+	desc.x = x;
+	desc.y = 0;
+	desc.z = 0;
+	desc.size = 16;
+	desc.lod = 0;
+	desc.pipeline = Pipeline_FastDC;
+	desc.octreeThreshold = 1.f;
+	desc.targetPolygonPercent = 1.f;
+	desc.maxSimplifyIterations = 0;
+	desc.edgeFraction = 0.125f;
+	desc.maxEdgeSize = 0.5f;
+	desc.maxError = 1.f;
+	desc.minAngleCosine = 0.8f;
+	return desc;
+}
+
+// ----------------------------------------------------------------------------
+
+// A session across two contexts is read back call for call: the contexts are
+// numbered in order of creation (a new one after a destroy gets a new
+// number even at the same address), the arguments and results come back as
+// they were passed, and GenerateChunkBatch's own SubmitChunkBatch isn't
+// recorded a second time
+static void TestRecordAndRead(const std::string& path)
+{
+	GeneratorContext* unrecorded = CreateContext(1);
+
+	CHECK(StartRecording(path.c_str()) == 1);
+
+	GeneratorContext* first = CreateContext(2);
+	GeneratorContext* second = CreateContext(1);
+
+	const ChunkDesc descs[2] = { MakeDesc(0), MakeDesc(16) };
+	int jobs[2] = {};
+	SubmitChunkBatch(first, descs, 2, jobs);
+
+	ChunkMeshDesc mesh;
+	CHECK(GenerateChunkBatch(second, descs, 1, &mesh) == 1);
+
+	CHECK(WaitForJob(first, jobs[0], -1) == JobStatus_Done);
+	CHECK(WaitForJob(first, jobs[1], -1) == JobStatus_Done);
+
+	CompletedJob completed[4];
+	int overflowed = 0;
+	CHECK(DrainCompletedJobs(first, completed, 4, 0, &overflowed) == 2);
+
+	// numbered on its first recorded call
+	CHECK(GetPendingJobCount(unrecorded) == 0);
+
+	DestroyContext(second);
+	DestroyContext(first);
+	GeneratorContext* third = CreateContext(1);
+
+	StopRecording();
+	DestroyContext(third);
+	DestroyContext(unrecorded);
+
+	TraceReader reader;
+	std::string error;
+	CHECK(reader.open(path.c_str(), error));
+
+	const Recorded expected[] =
+	{
+		{ Call_CreateContext, 1 },
+		{ Call_CreateContext, 2 },
+		{ Call_SubmitChunkBatch, 1 },
+		{ Call_GenerateChunkBatch, 2 },
+		{ Call_WaitForJob, 1 },
+		{ Call_WaitForJob, 1 },
+		{ Call_DrainCompletedJobs, 1 },
+		{ Call_GetPendingJobCount, 3 },
+		{ Call_DestroyContext, 2 },
+		{ Call_DestroyContext, 1 },
+		{ Call_CreateContext, 4 },
+	};
+
+	std::vector<Recorded> recorded;
+	TraceRecordHeader record;
+	while (reader.next(record))
+	{
+		recorded.push_back(Recorded { record.call, record.context });
+		CHECK(record.start >= 0 && record.duration >= 0);
+
+		switch (record.call)
+		{
+		case Call_CreateContext:
+			CHECK(reader.read<int>() == (recorded.size() == 1 ? 2 : 1));
+			break;
+
+		case Call_SubmitChunkBatch:
+		{
+			const std::vector<ChunkDesc> chunks = reader.readArray<ChunkDesc>();
+			const std::vector<int> ids = reader.readArray<int>();
+			CHECK(chunks.size() == 2 && chunks[1].x == 16 && chunks[1].size == 16);
+			CHECK(ids.size() == 2 && ids[0] == jobs[0] && ids[1] == jobs[1]);
+			break;
+		}
+
+		case Call_GenerateChunkBatch:
+		{
+			const std::vector<ChunkDesc> chunks = reader.readArray<ChunkDesc>();
+			const std::vector<int> ids = reader.readArray<int>();
+			CHECK(chunks.size() == 1 && ids.size() == 1 && ids[0] == mesh.job);
+			break;
+		}
+
+		case Call_WaitForJob:
+		{
+			const int job = reader.read<int>();
+			CHECK(job == jobs[0] || job == jobs[1]);
+			CHECK(reader.read<int>() == -1);
+			CHECK(reader.read<int>() == JobStatus_Done);
+			break;
+		}
+
+		case Call_DrainCompletedJobs:
+		{
+			CHECK(reader.read<int>() == 4);
+			CHECK(reader.read<int>() == 0);
+			const std::vector<CompletedJob> drained = reader.readArray<CompletedJob>();
+			CHECK(drained.size() == 2 && drained[0].status == JobStatus_Done);
+			CHECK(reader.read<int>() == 0);
+			break;
+		}
+		}
+
+		CHECK(!reader.payloadError());
+	}
+
+	const size_t count = sizeof(expected) / sizeof(expected[0]);
+	CHECK(recorded.size() == count);
+	for (size_t i = 0; i < count && i < recorded.size(); i++)
+	{
+		CHECK(recorded[i].call == expected[i].call);
+		CHECK(recorded[i].context == expected[i].context);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// A trace recorded by a build whose structs differ can't be replayed
+static void TestLayoutMismatch(const std::string& path)
+{
+	std::vector<char> bytes;
+	FILE* file = fopen(path.c_str(), "rb");
+	CHECK(file != nullptr);
+	if (!file)
+	{
+		return;
+	}
+
+	char buffer[4096];
+	for (size_t count; (count = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+	{
+		bytes.insert(bytes.end(), buffer, buffer + count);
+	}
+	fclose(file);
+	CHECK(bytes.size() >= sizeof(TraceHeader));
+
+	const std::string changed = "call_recorder_test_changed.trace";
+	const auto write = [&](const TraceHeader& header)
+	{
+		std::vector<char> copy = bytes;
+		memcpy(copy.data(), &header, sizeof(header));
+		FILE* file = fopen(changed.c_str(), "wb");
+		fwrite(copy.data(), 1, copy.size(), file);
+		fclose(file);
+	};
+
+	TraceHeader header = CurrentTraceHeader();
+	header.chunkDescSize += 4;
+	write(header);
+
+	std::string error;
+	TraceReader layout;
+	CHECK(!layout.open(changed.c_str(), error));
+	CHECK(error.find("layouts") != std::string::npos);
+
+	header = CurrentTraceHeader();
+	header.version++;
+	write(header);
+
+	TraceReader version;
+	CHECK(!version.open(changed.c_str(), error));
+	CHECK(error.find("version") != std::string::npos);
+
+	remove(changed.c_str());
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	const std::string path = "call_recorder_test.trace";
+	TestRecordAndRead(path);
+	TestLayoutMismatch(path);
+	remove(path.c_str());
+
+	return TestResult("call_recorder");
+}
@@ -0,0 +1,236 @@
+#include "chunk_archive.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+static long FileSize(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return -1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+// ----------------------------------------------------------------------------
+
+// Copies the first size bytes of the file, as if the process died part way
+// through writing the rest
+static bool CopyPrefix(const std::string& from, const std::string& to, const long size)
+{
+	std::vector<char> bytes(size);
+	FILE* file = fopen(from.c_str(), "rb");
+	const bool read = file && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	if (file)
+	{
+		fclose(file);
+	}
+
+	file = read ? fopen(to.c_str(), "wb") : nullptr;
+	const bool written = file && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	if (file)
+	{
+		fclose(file);
+	}
+
+	return written;
+}
+
+// ----------------------------------------------------------------------------
+
+static ChunkRequest MakeChunk(const int x, ChunkResult& result)
+{
+	const ChunkRequest request = MakeRequest(glm::ivec3(x, 0, 0), 16, Pipeline_FastDC);
+	GenerateChunk(request, result);
+	return request;
+}
+
+// ----------------------------------------------------------------------------
+
+// Stored chunks load back identical, from the same archive and after it has
+// been closed and opened again
+static void TestRoundTrip()
+{
+	const std::string path = "chunk_archive_test.archive";
+	remove(path.c_str());
+
+	ChunkResult results[2];
+	const ChunkRequest requests[2] = { MakeChunk(0, results[0]), MakeChunk(16, results[1]) };
+	CHECK(results[0].numVertices() > 0 && results[1].numVertices() > 0);
+
+	{
+		const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(path);
+		CHECK(archive != nullptr);
+
+		ChunkResult loaded;
+		CHECK(!archive->load(requests[0], loaded));
+
+		CHECK(archive->store(requests[0], results[0]));
+		CHECK(archive->store(requests[1], results[1]));
+		CHECK(archive->numChunks() == 2);
+
+		CHECK(archive->load(requests[0], loaded));
+		CHECK(SameMesh(results[0], loaded));
+		CHECK(loaded.seamVoxels.size() == results[0].seamVoxels.size());
+		CHECK(!loaded.subMeshes.empty());
+
+		// another density is another chunk
+		ChunkRequest otherDensity = requests[0];
+		otherDensity.density.params.maxHeight += 1.f;
+		CHECK(!archive->load(otherDensity, loaded));
+
+		// empty and solid chunks aren't stored
+		ChunkResult empty;
+		empty.contents = ChunkContents_Empty;
+		CHECK(!archive->store(otherDensity, empty));
+	}
+
+	const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(path);
+	CHECK(archive != nullptr && archive->numChunks() == 2);
+
+	for (int i = 0; i < 2; i++)
+	{
+		ChunkResult loaded;
+		CHECK(archive && archive->load(requests[i], loaded));
+		CHECK(SameMesh(results[i], loaded));
+	}
+
+	remove(path.c_str());
+}
+
+// ----------------------------------------------------------------------------
+
+// An archive the process died with (no index, the last record cut short)
+// opens with every complete record and drops the rest
+static void TestTruncatedAppend()
+{
+	const std::string path = "chunk_archive_test.archive";
+	const std::string crashed = "chunk_archive_test_crashed.archive";
+	remove(path.c_str());
+	remove(crashed.c_str());
+
+	ChunkResult results[4];
+	ChunkRequest requests[4];
+	for (int i = 0; i < 4; i++)
+	{
+		requests[i] = MakeChunk(i * 16, results[i]);
+	}
+
+	// closed cleanly with two chunks, then two more appended over the index
+	{
+		const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(path);
+		CHECK(archive->store(requests[0], results[0]));
+		CHECK(archive->store(requests[1], results[1]));
+	}
+
+	{
+		const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(path);
+		CHECK(archive->store(requests[2], results[2]));
+		const long thirdEnd = FileSize(path);
+		CHECK(archive->store(requests[3], results[3]));
+		const long fourthEnd = FileSize(path);
+		CHECK(thirdEnd > 0 && fourthEnd > thirdEnd);
+
+		// taken while the archive is still open, so the header says the
+		// index is stale
+		CHECK(CopyPrefix(path, crashed, thirdEnd + (fourthEnd - thirdEnd) / 2));
+	}
+
+	{
+		const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(crashed);
+		CHECK(archive != nullptr && archive->numChunks() == 3);
+
+		ChunkResult loaded;
+		for (int i = 0; i < 3; i++)
+		{
+			CHECK(archive && archive->load(requests[i], loaded));
+			CHECK(SameMesh(results[i], loaded));
+		}
+		CHECK(archive && !archive->load(requests[3], loaded));
+
+		// the partial record is overwritten by the next one
+		CHECK(archive && archive->store(requests[3], results[3]));
+		CHECK(archive && archive->deadBytes() == 0);
+	}
+
+	// and closing writes the index again
+	const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(crashed);
+	CHECK(archive != nullptr && archive->numChunks() == 4);
+
+	ChunkResult loaded;
+	CHECK(archive && archive->load(requests[3], loaded));
+	CHECK(SameMesh(results[3], loaded));
+
+	remove(path.c_str());
+	remove(crashed.c_str());
+}
+
+// ----------------------------------------------------------------------------
+
+// A chunk stored over and over leaves dead records behind, an archive which
+// is mostly dead is compacted as it opens and keeps only the latest record
+// of each chunk
+static void TestCompactOnOpen()
+{
+	const std::string path = "chunk_archive_test.archive";
+	remove(path.c_str());
+
+	ChunkResult other, result;
+	const ChunkRequest otherRequest = MakeChunk(16, other);
+	const ChunkRequest request = MakeChunk(0, result);
+
+	int version = 0;
+	{
+		const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(path);
+		CHECK(archive->store(otherRequest, other));
+
+		// each store marks the mesh so the latest can be told apart, past
+		// the 16MB of dead records open() needs before it compacts
+		while (archive->deadBytes() <= (16 << 20))
+		{
+			result.vertices[0] = (float)++version;
+			CHECK(archive->store(request, result));
+		}
+
+		CHECK(archive->numChunks() == 2);
+		CHECK(archive->deadBytes() > archive->liveBytes());
+	}
+
+	const long before = FileSize(path);
+	const std::unique_ptr<ChunkArchive> archive = ChunkArchive::open(path);
+	CHECK(archive != nullptr && archive->numChunks() == 2);
+	CHECK(archive && archive->deadBytes() == 0);
+	CHECK(FileSize(path) < before / 16);
+
+	ChunkResult loaded;
+	CHECK(archive && archive->load(request, loaded));
+	CHECK(!loaded.vertices.empty() && loaded.vertices[0] == (float)version);
+	CHECK(SameMesh(result, loaded));
+
+	CHECK(archive && archive->load(otherRequest, loaded));
+	CHECK(SameMesh(other, loaded));
+
+	remove(path.c_str());
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestRoundTrip();
+	TestTruncatedAppend();
+	TestCompactOnOpen();
+	return TestResult("chunk_archive");
+}
@@ -0,0 +1,76 @@
+#include "chunk_generator.h"
+#include "fast_dc.h"
+
+#include "test.h"
+
+// ----------------------------------------------------------------------------
+
+// Meshes the chunk with fast_dc directly, without the bounds pass which
+// GenerateChunk would skip the chunk on
+static int CountTriangles(const ChunkRequest& request)
+{
+	const int voxelSize = 1 << request.lod;
+	FastDCGenerator generator(request.density, request.position.x, request.position.y, request.position.z, request.size / voxelSize, voxelSize);
+	generator.step(FastDCGenerator::Clock::time_point::max());
+
+	ChunkResult result;
+	TakeFastDCMesh(generator, result);
+	return (int)result.indices.size() / 3;
+}
+
+// ----------------------------------------------------------------------------
+
+// Density_Range must stay conservative: every chunk ClassifyChunk rules out as
+// empty or solid really has no surface, for each preset and at every lod.
+// Both kinds have to turn up for the sweep to mean anything.
+static void TestClassifiedChunksHaveNoMesh()
+{
+	const char* presets[] = { "default", "hills", "mountains" };
+	const int size = 32;
+
+	for (const char* preset : presets)
+	{
+		for (int lod = 0; lod <= 2; lod++)
+		{
+			int empty = 0, solid = 0, surface = 0;
+
+			for (int y = -4; y <= 4; y++)
+			for (int z = -1; z <= 1; z++)
+			for (int x = -1; x <= 1; x++)
+			{
+				ChunkRequest request;
+				request.position = glm::ivec3(x, y, z) * size;
+				request.size = size;
+				request.lod = lod;
+				CHECK(GetDensityPreset(preset, request.density.params));
+
+				switch (ClassifyChunk(request))
+				{
+				case ChunkContents_Empty:
+					empty++;
+					CHECK(CountTriangles(request) == 0);
+					break;
+
+				case ChunkContents_Solid:
+					solid++;
+					CHECK(CountTriangles(request) == 0);
+					break;
+
+				default:
+					surface++;
+					break;
+				}
+			}
+
+			CHECK(empty > 0 && solid > 0 && surface > 0);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestClassifiedChunksHaveNoMesh();
+	return TestResult("chunk_classify");
+}
@@ -0,0 +1,149 @@
+#include "chunk_generator.h"
+#include "fast_dc.h"
+
+#include <malloc.h>
+
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+// Generating a chunk over many short steps gives the same mesh as one call,
+// for the pipelines which split their work up
+static void TestTimeSliced()
+{
+	const int pipelines[] = { Pipeline_FastDC, Pipeline_Octree, Pipeline_Heightfield };
+	for (const int pipeline : pipelines)
+	{
+		const ChunkRequest request = MakeRequest(glm::ivec3(16, 0, 16), 32, pipeline);
+
+		ChunkResult whole;
+		CHECK(GenerateChunk(request, whole));
+		CHECK(whole.numVertices() > 0);
+
+		ChunkResult sliced;
+		ChunkGenerationTask task(request, sliced);
+
+		int steps = 1;
+		while (!task.step(ChunkGenerationTask::Clock::now() + std::chrono::microseconds(50)))
+		{
+			steps++;
+			CHECK(steps < 1000000);
+		}
+
+		CHECK(task.completed());
+		CHECK(SameMesh(whole, sliced));
+		CHECK(!sliced.subMeshes.empty());
+
+		if (pipeline != Pipeline_Heightfield)
+		{
+			CHECK(steps > 1);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Bytes currently allocated from the heap, 0 where glibc can't tell us
+static size_t HeapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	return mallinfo2().uordblks;
+#else
+	return 0;
+#endif
+}
+
+// Steps which run out of time before doing anything, at the start of every
+// fast_dc stage, don't change the mesh or allocate its buffers again
+static void TestExpiredDeadline()
+{
+	const ChunkRequest request = MakeRequest(glm::ivec3(16, 0, 16), 32, Pipeline_FastDC);
+	const FastDCGenerator::Clock::time_point expired = FastDCGenerator::Clock::now() - std::chrono::seconds(1);
+
+	float debugVal = 0.f;
+	VertexData cells;
+	MeshBuffer* whole = GenerateMesh(request.density, 16, 0, 16, 32, 1, debugVal, cells);
+	CHECK(whole && whole->numTriangles > 0);
+
+	const size_t heapBefore = HeapInUse();
+	{
+		FastDCGenerator generator(request.density, 16, 0, 16, 32, 1);
+		while (generator.stage() != FastDCGenerator::Stage_Done)
+		{
+			const FastDCGenerator::Stage stage = generator.stage();
+			for (int i = 0; i < 3; i++)
+			{
+				CHECK(!generator.step(expired));
+				CHECK(generator.stage() == stage);
+			}
+
+			generator.runStage();
+		}
+
+		MeshBuffer* sliced = generator.takeMesh();
+		CHECK(sliced != nullptr);
+		if (sliced)
+		{
+			CHECK(sliced->numVertices == whole->numVertices);
+			CHECK(sliced->numTriangles == whole->numTriangles);
+			free(sliced->vertices);
+			free(sliced->triangles);
+			delete sliced;
+		}
+	}
+	CHECK(HeapInUse() == heapBefore);
+
+	free(whole->vertices);
+	free(whole->triangles);
+	delete whole;
+}
+
+// ----------------------------------------------------------------------------
+
+// A raised cancel flag stops the chunk and leaves the result empty
+static void TestCancel()
+{
+	const ChunkRequest request = MakeRequest(glm::ivec3(16, 0, 16), 32, Pipeline_Octree);
+
+	std::atomic<bool> cancel(false);
+	ChunkResult result;
+	ChunkGenerationTask task(request, result, &cancel);
+	CHECK(!task.step(ChunkGenerationTask::Clock::now()));
+
+	cancel = true;
+	CHECK(task.step(ChunkGenerationTask::Clock::time_point::max()));
+	CHECK(!task.completed());
+	CHECK(result.vertices.empty() && result.indices.empty());
+
+	ChunkResult whole;
+	CHECK(!GenerateChunk(request, whole, &cancel));
+	CHECK(whole.vertices.empty());
+}
+
+// ----------------------------------------------------------------------------
+
+// A chunk a single voxel across has vertices but no triangles, simplifying it
+// leaves the mesh alone rather than copying from an empty index buffer
+static void TestSimplifyWithoutTriangles()
+{
+	ChunkRequest request = MakeRequest(glm::ivec3(0), 32, Pipeline_FastDC);
+	request.lod = 5;
+	request.simplify.targetPercentage = 0.5f;
+
+	ChunkResult result;
+	CHECK(GenerateChunk(request, result));
+	CHECK(result.numVertices() > 0 && result.indices.empty());
+
+	CHECK(!SimplifyChunkMesh(request, result));
+	CHECK(result.numVertices() > 0 && result.indices.empty());
+}
+
+int main()
+{
+	TestTimeSliced();
+	TestExpiredDeadline();
+	TestCancel();
+	TestSimplifyWithoutTriangles();
+	return TestResult("chunk_generation");
+}
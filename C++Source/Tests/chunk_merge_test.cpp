@@ -0,0 +1,169 @@
+#include "chunk_merge.h"
+
+#include <algorithm>
+#include <array>
+#include <set>
+#include <vector>
+
+#include "chunk_seams.h"
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+typedef std::array<float, 6> Vertex;
+typedef std::array<Vertex, 3> Triangle;
+
+static Vertex GetVertex(const ChunkResult& result, const int index)
+{
+	Vertex vertex;
+	std::copy(&result.vertices[index * 6], &result.vertices[index * 6] + 6, vertex.begin());
+	return vertex;
+}
+
+// ----------------------------------------------------------------------------
+
+// Rotated to start at its smallest vertex, which keeps the winding
+static Triangle Normalise(Triangle triangle)
+{
+	std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+	return triangle;
+}
+
+// ----------------------------------------------------------------------------
+
+// The triangles of the meshes by their vertices' values, so meshes indexing
+// the same triangles differently compare equal
+static std::multiset<Triangle> Triangles(const std::vector<const ChunkResult*>& results)
+{
+	std::multiset<Triangle> triangles;
+	for (const ChunkResult* result : results)
+	{
+		for (size_t i = 0; i + 2 < result->indices.size(); i += 3)
+		{
+			const Triangle triangle =
+			{{
+				GetVertex(*result, result->indices[i]),
+				GetVertex(*result, result->indices[i + 1]),
+				GetVertex(*result, result->indices[i + 2]),
+			}};
+			triangles.insert(Normalise(triangle));
+		}
+	}
+
+	return triangles;
+}
+
+// ----------------------------------------------------------------------------
+
+// Two fast_dc chunks side by side, the seam on the max one copies vertices
+// from the min one. Merged, the copies are welded and every triangle is kept
+// as it was, with the vertex cache optimisation or without.
+static void TestMergeChunks()
+{
+	ChunkRequest requests[2] =
+	{
+		MakeRequest(glm::ivec3(0), 16, Pipeline_FastDC),
+		MakeRequest(glm::ivec3(16, 0, 0), 16, Pipeline_FastDC),
+	};
+
+	ChunkResult results[2];
+	CHECK(GenerateChunk(requests[0], results[0]));
+	CHECK(GenerateChunk(requests[1], results[1]));
+
+	const ChunkResult* neighbours[] = { &results[0] };
+	CHECK(BuildChunkSeam(requests[1], results[1], neighbours, 1));
+	CHECK(results[1].seamFirstVertex < results[1].numVertices());
+
+	const std::vector<const ChunkResult*> members = { &results[0], &results[1] };
+	const std::multiset<Triangle> triangles = Triangles(members);
+
+	// the distinct vertices the members' triangles use
+	std::set<Vertex> used;
+	for (const Triangle& triangle : triangles)
+	{
+		used.insert(triangle.begin(), triangle.end());
+	}
+
+	const int numMemberVertices = results[0].numVertices() + results[1].numVertices();
+	CHECK((int)used.size() < numMemberVertices);
+
+	const ChunkRequest* requestPointers[] = { &requests[1], &requests[0] };
+	const ChunkResult* resultPointers[] = { &results[1], &results[0] };
+
+	ChunkResult merged[2];
+	for (int optimize = 0; optimize < 2; optimize++)
+	{
+		ChunkResult& result = merged[optimize];
+		MergeChunkMeshes(requestPointers, resultPointers, 2, result, optimize != 0);
+
+		CHECK(result.contents == ChunkContents_Surface);
+		CHECK(result.indices.size() == results[0].indices.size() + results[1].indices.size());
+		CHECK(Triangles({ &result }) == triangles);
+		CHECK(result.subMeshes.size() == 1);
+		CHECK(result.seamVoxels.empty() && result.cells.empty());
+
+		// every copy welded into one vertex
+		std::set<Vertex> vertices;
+		for (int v = 0; v < result.numVertices(); v++)
+		{
+			vertices.insert(GetVertex(result, v));
+		}
+		CHECK(vertices.size() == used.size());
+		CHECK(result.numVertices() == (int)used.size());
+	}
+
+	const int numVertices = merged[0].numVertices();
+	CHECK(AverageCacheMissRatio(merged[1].indices, numVertices, 32) <= AverageCacheMissRatio(merged[0].indices, numVertices, 32));
+}
+
+// ----------------------------------------------------------------------------
+
+// On a regular grid the reordering keeps every triangle, winding included,
+// and gets close to the 0.5 misses per triangle a grid allows
+static void TestOptimizeVertexCache()
+{
+	const int N = 32;
+	IndexBuffer indices;
+	for (int y = 0; y < N; y++)
+	{
+		for (int x = 0; x < N; x++)
+		{
+			const int v = y * (N + 1) + x;
+			indices.insert(end(indices), { v, v + 1, v + N + 2 });
+			indices.insert(end(indices), { v, v + N + 2, v + N + 1 });
+		}
+	}
+
+	const int numVertices = (N + 1) * (N + 1);
+	const auto triangleSet = [](const IndexBuffer& indices)
+	{
+		std::multiset<std::array<int, 3>> triangles;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			std::array<int, 3> triangle = {{ indices[i], indices[i + 1], indices[i + 2] }};
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.insert(triangle);
+		}
+		return triangles;
+	};
+
+	IndexBuffer optimized = indices;
+	OptimizeVertexCache(optimized, numVertices);
+	CHECK(optimized.size() == indices.size());
+	CHECK(triangleSet(optimized) == triangleSet(indices));
+
+	const float before = AverageCacheMissRatio(indices, numVertices, 32);
+	const float after = AverageCacheMissRatio(optimized, numVertices, 32);
+	CHECK(after < before);
+	CHECK(after < 0.8f);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestMergeChunks();
+	TestOptimizeVertexCache();
+	return TestResult("chunk_merge");
+}
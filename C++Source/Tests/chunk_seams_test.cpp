@@ -0,0 +1,129 @@
+#include "chunk_seams.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+typedef std::tuple<float, float, float> Position;
+typedef std::pair<Position, Position> Edge;
+
+// Counts the triangles on each edge of the chunks' meshes, seams included.
+// Vertices are matched by position since a seam copies its neighbours'
+// vertices into the chunk.
+static std::map<Edge, int> CountEdges(const std::vector<const ChunkResult*>& chunks)
+{
+	std::map<Edge, int> edges;
+	for (const ChunkResult* chunk : chunks)
+	{
+		const auto position = [chunk](const int index)
+		{
+			const float* v = &chunk->vertices[index * 6];
+			return Position(v[0], v[1], v[2]);
+		};
+
+		for (size_t i = 0; i + 2 < chunk->indices.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				const Position a = position(chunk->indices[i + e]);
+				const Position b = position(chunk->indices[i + (e + 1) % 3]);
+				if (a != b)
+				{
+					edges[Edge(std::min(a, b), std::max(a, b))]++;
+				}
+			}
+		}
+	}
+
+	return edges;
+}
+
+// ----------------------------------------------------------------------------
+
+// Edges used by a single triangle whose ends are both more than margin
+// inside the box, i.e. cracks rather than where the meshes stop
+static int CountCracks(const std::vector<const ChunkResult*>& chunks, const glm::vec3& min, const glm::vec3& max, const float margin)
+{
+	const auto inside = [&](const Position& p)
+	{
+		const glm::vec3 v(std::get<0>(p), std::get<1>(p), std::get<2>(p));
+		return glm::all(glm::greaterThan(v, min + margin)) && glm::all(glm::lessThan(v, max - margin));
+	};
+
+	int cracks = 0;
+	for (const auto& entry : CountEdges(chunks))
+	{
+		cracks += entry.second == 1 && inside(entry.first.first) && inside(entry.first.second);
+	}
+
+	return cracks;
+}
+
+// ----------------------------------------------------------------------------
+
+// Two chunks side by side along x at LODs N and N+1, in both orders. The one
+// on the max side owns the seam on the face they share, once it's built no
+// edge is left open there.
+static void TestSeamAcrossLods()
+{
+	const int SIZE = 32;
+	const int lods[][2] =
+	{
+		{ 0, 1 },
+		{ 1, 0 },
+		{ 1, 2 },
+	};
+
+	for (const auto& pair : lods)
+	{
+		ChunkRequest requests[2] =
+		{
+			MakeRequest(glm::ivec3(0), SIZE, Pipeline_FastDC),
+			MakeRequest(glm::ivec3(SIZE, 0, 0), SIZE, Pipeline_FastDC),
+		};
+
+		ChunkResult results[2];
+		for (int i = 0; i < 2; i++)
+		{
+			requests[i].lod = pair[i];
+			CHECK(GenerateChunk(requests[i], results[i]));
+			CHECK(!results[i].indices.empty());
+			CHECK(!results[i].seamVoxels.empty());
+		}
+
+		// the box the two chunks fill, open edges within a coarse voxel of its
+		// faces are where the surface leaves it
+		const glm::vec3 min(-SIZE / 2, -SIZE / 2, -SIZE / 2);
+		const glm::vec3 max(SIZE + SIZE / 2, SIZE / 2, SIZE / 2);
+		const float margin = (float)(1 << std::max(pair[0], pair[1])) + 0.5f;
+
+		const std::vector<const ChunkResult*> chunks = { &results[0], &results[1] };
+		CHECK(CountCracks(chunks, min, max, margin) > 0);
+
+		const int numIndices = (int)results[1].indices.size();
+		const ChunkResult* neighbours[] = { &results[0] };
+		CHECK(BuildChunkSeam(requests[1], results[1], neighbours, 1));
+		CHECK(results[1].seamFirstIndex == numIndices);
+		CHECK((int)results[1].indices.size() > numIndices);
+		CHECK(CountCracks(chunks, min, max, margin) == 0);
+
+		// and removing it opens them again
+		RemoveChunkSeam(results[1]);
+		CHECK((int)results[1].indices.size() == numIndices);
+		CHECK(CountCracks(chunks, min, max, margin) > 0);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestSeamAcrossLods();
+	return TestResult("chunk_seams");
+}
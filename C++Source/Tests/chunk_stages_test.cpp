@@ -0,0 +1,187 @@
+#include "chunk_stages.h"
+
+#include <cstdio>
+#include <string>
+
+#include "chunk_archive.h"
+#include "job_system.h"
+#include "mesh_cache.h"
+
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+// Every index and seam voxel refers to a vertex of the chunk's own mesh
+static bool ValidMesh(const ChunkResult& result)
+{
+	for (const int index : result.indices)
+	{
+		if (index < 0 || index >= result.numVertices())
+		{
+			return false;
+		}
+	}
+
+	for (const SeamVoxel& voxel : result.seamVoxels)
+	{
+		if (voxel.vertex >= result.numVertices())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// The stage chains on the job system agree with GenerateChunk, simplified or not
+static void TestStages()
+{
+	JobSystem jobs(1);
+
+	for (int simplify = 0; simplify < 2; simplify++)
+	{
+		const int pipelines[] = { Pipeline_FastDC, Pipeline_Octree };
+		for (const int pipeline : pipelines)
+		{
+			ChunkRequest request = MakeRequest(glm::ivec3(16, 0, 16), 32, pipeline);
+			if (simplify)
+			{
+				request.simplify.targetPercentage = 0.5f;
+				request.simplify.maxEdgeSize = 2.5f;
+			}
+
+			ChunkResult direct;
+			CHECK(GenerateChunk(request, direct));
+			CHECK(ValidMesh(direct));
+
+			const ChunkStagePtr chunk = ScheduleChunkStages(jobs, request).wait();
+			CHECK(chunk->completed);
+			CHECK(SameMesh(direct, chunk->result));
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Submits the request and waits for the workers to run its stages
+static bool GenerateOnJobSystem(JobSystem& jobs, const ChunkRequest& request, ChunkResult& result)
+{
+	const int id = jobs.submit(request);
+	const bool done = jobs.wait(id, -1) == JobStatus_Done;
+	if (done)
+	{
+		result = *jobs.result(id);
+	}
+
+	jobs.release(id);
+	return done;
+}
+
+// ----------------------------------------------------------------------------
+
+// The job system's workers run the stage chains, a generated chunk is written
+// to the archive and a later job loads it (or finds it in the cache) instead
+// of generating it again
+static void TestJobSystemStages()
+{
+	const std::string path = "chunk_stages_test.archive";
+	remove(path.c_str());
+
+	const ChunkRequest request = MakeRequest(glm::ivec3(16, 0, 16), 32, Pipeline_FastDC);
+	ChunkResult direct;
+	CHECK(GenerateChunk(request, direct));
+
+	{
+		GeneratorStats stats;
+		JobSystem jobs(2, &stats);
+		jobs.setArchive(std::shared_ptr<ChunkArchive>(ChunkArchive::open(path)));
+
+		ChunkResult generated;
+		CHECK(GenerateOnJobSystem(jobs, request, generated));
+		CHECK(SameMesh(direct, generated));
+		CHECK(stats.chunksGenerated == 1 && stats.chunksFromArchive == 0);
+
+		ChunkResult archived;
+		CHECK(GenerateOnJobSystem(jobs, request, archived));
+		CHECK(SameMesh(direct, archived));
+		CHECK(stats.chunksGenerated == 1 && stats.chunksFromArchive == 1);
+	}
+
+	{
+		// the cache is checked at submit, so the second job of a batch is the
+		// one which finds the first's mesh as its stages start
+		GeneratorStats stats;
+		MeshCache cache;
+		cache.setCapacity(16 << 20);
+		JobSystem jobs(1, &stats, nullptr, &cache);
+
+		const ChunkRequest requests[] = { request, request };
+		int ids[2];
+		jobs.submit(requests, 2, ids);
+		CHECK(jobs.wait(ids[0], -1) == JobStatus_Done && jobs.wait(ids[1], -1) == JobStatus_Done);
+		CHECK(SameMesh(direct, *jobs.result(ids[1])));
+		CHECK(stats.chunksGenerated == 1 && stats.chunksFromCache == 1);
+	}
+
+	remove(path.c_str());
+}
+
+// ----------------------------------------------------------------------------
+
+// thenWhile runs its stage until the condition fails, not at all if it
+// already has
+static void TestThenWhile()
+{
+	JobSystem jobs(2);
+
+	const auto increment = [](const int value) { return value + 1; };
+	const auto belowTen = [](const int value) { return value < 10; };
+
+	CHECK(RunStage(jobs, []() { return 3; }).thenWhile(increment, belowTen).wait() == 10);
+	CHECK(RunStage(jobs, []() { return 12; }).thenWhile(increment, belowTen).wait() == 12);
+}
+
+// ----------------------------------------------------------------------------
+
+// Simplification only applies to fast_dc chunks which ask for it
+static void TestSimplify()
+{
+	ChunkRequest request = MakeRequest(glm::ivec3(16, 0, 16), 32, Pipeline_FastDC);
+	request.simplify.targetPercentage = 1.f;
+	CHECK(!WantsSimplification(request.simplify));
+
+	ChunkResult full;
+	GenerateChunk(request, full);
+
+	request.simplify.targetPercentage = 0.5f;
+	request.simplify.maxEdgeSize = 2.5f;
+	CHECK(WantsSimplification(request.simplify));
+
+	ChunkResult simplified;
+	GenerateChunk(request, simplified);
+	CHECK(ValidMesh(simplified));
+	CHECK(simplified.indices.size() < full.indices.size());
+	CHECK(simplified.numVertices() < full.numVertices());
+	CHECK(simplified.seamVoxels.size() == full.seamVoxels.size());
+
+	// octree meshes are left alone
+	ChunkRequest octree = request;
+	octree.pipeline = Pipeline_Octree;
+	ChunkResult octreeResult;
+	GenerateChunk(octree, octreeResult);
+	CHECK(!SimplifyChunkMesh(octree, octreeResult));
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestStages();
+	TestJobSystemStages();
+	TestThenWhile();
+	TestSimplify();
+	return TestResult("chunk_stages");
+}
@@ -0,0 +1,363 @@
+#include "DualContouringPlugin.h"
+
+#include <math.h>
+#include <map>
+#include <set>
+#include <tuple>
+
+#include "test.h"
+
+// ----------------------------------------------------------------------------
+
+typedef std::tuple<int, int, int, int> ChunkKey;	// lod, centre
+
+static ChunkKey MakeKey(const ClipmapEvent& event)
+{
+	return ChunkKey(event.lod, event.position[0], event.position[1], event.position[2]);
+}
+
+// ----------------------------------------------------------------------------
+
+// Follows the load and unload events, as the managed side would
+struct ClipmapTracker
+{
+	std::map<ChunkKey, ClipmapEvent> loaded;
+	int numLoads = 0;
+	int numUnloads = 0;
+	int numReloads = 0;		// loads of a chunk which was already loaded
+	int numBadUnloads = 0;	// unloads of a chunk which wasn't
+
+	void reset()
+	{
+		numLoads = numUnloads = numReloads = numBadUnloads = 0;
+	}
+
+	// Runs the context's jobs until every chunk of the rings has loaded
+	bool settle(GeneratorContext* context)
+	{
+		for (int frame = 0; frame < 20000; frame++)
+		{
+			RunJobsFor(context, 2000);
+
+			ClipmapEvent events[64];
+			const int count = DrainClipmapEvents(context, events, 64);
+			for (int i = 0; i < count; i++)
+			{
+				const ChunkKey key = MakeKey(events[i]);
+				if (events[i].type == ClipmapEvent_Load)
+				{
+					numLoads++;
+					numReloads += loaded.count(key) != 0;
+					loaded[key] = events[i];
+				}
+				else if (events[i].type == ClipmapEvent_Unload)
+				{
+					numUnloads++;
+					numBadUnloads += loaded.erase(key) == 0;
+				}
+			}
+
+			int numLoaded = 0;
+			const int numChunks = GetClipmapChunkCount(context, &numLoaded);
+			if (count == 0 && numLoaded == numChunks && GetPendingJobCount(context) == 0)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+};
+
+// ----------------------------------------------------------------------------
+
+// Points around the viewer are each inside exactly one loaded chunk
+static void CheckCoverage(const ClipmapTracker& tracker, const glm::vec3& viewer, const int extent)
+{
+	int holes = 0, overlaps = 0;
+	for (int x = -extent; x < extent; x += 3)
+	for (int z = -extent; z < extent; z += 3)
+	{
+		const glm::vec3 point = viewer + glm::vec3(x + 0.5f, 0.5f, z + 0.5f);
+
+		int covering = 0;
+		for (const auto& entry : tracker.loaded)
+		{
+			const ClipmapEvent& chunk = entry.second;
+			const float half = chunk.size * 0.5f;
+			covering += fabsf(point.x - chunk.position[0]) < half &&
+				fabsf(point.y - chunk.position[1]) < half &&
+				fabsf(point.z - chunk.position[2]) < half;
+		}
+
+		holes += covering == 0;
+		overlaps += covering > 1;
+	}
+
+	CHECK(holes == 0);
+	CHECK(overlaps == 0);
+}
+
+// ----------------------------------------------------------------------------
+
+static ClipmapParams PrefetchParams()
+{
+	ClipmapParams params;
+	params.chunkSize = 16;
+	params.numLods = 2;
+	params.halfExtent = 1;
+	params.verticalHalfExtent = 0;
+	params.prefetchSeconds = 1.f;
+	return params;
+}
+
+// ----------------------------------------------------------------------------
+
+// Runs the clipmap update SetClipmapViewerMotion posted, a posted task is
+// always started however short the slice
+static void RunUpdate(GeneratorContext* context)
+{
+	RunJobsFor(context, 1);
+}
+
+// ----------------------------------------------------------------------------
+
+// Moving to where the viewer was predicted to go takes every prefetched
+// chunk into the rings as a hit, without loading any chunk twice
+static void TestPrefetchHits()
+{
+	const ClipmapParams params = PrefetchParams();
+	GeneratorContext* context = CreateContext(-1);
+	EnableClipmap(context, &params);
+
+	// a second ahead puts the viewer in the next LOD 1 parent chunk along x
+	SetClipmapViewerMotion(context, 0.f, 0.f, 0.f, 40.f, 0.f, 0.f, 1.f, 0.f, 0.f);
+	ClipmapTracker tracker;
+	CHECK(tracker.settle(context));
+
+	ClipmapPrefetchStats stats;
+	GetClipmapPrefetchStats(context, &stats);
+	const int numPrefetched = stats.numPrefetched;
+	CHECK(numPrefetched > 0);
+	CHECK(stats.hits == 0 && stats.misses == 0);
+
+	tracker.reset();
+	SetClipmapViewerMotion(context, 40.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f);
+	CHECK(tracker.settle(context));
+
+	GetClipmapPrefetchStats(context, &stats);
+	CHECK(stats.hits == numPrefetched);
+	CHECK(stats.misses == 0);
+	CHECK(stats.numPrefetched == 0);
+	CHECK(tracker.numReloads == 0 && tracker.numBadUnloads == 0);
+	CheckCoverage(tracker, glm::vec3(40.f, 0.f, 0.f), 40);
+
+	// the prefetched chunks were generated ahead of the move
+	ContextStats generated;
+	GetContextStats(context, &generated);
+	int numLoaded = 0;
+	CHECK(generated.chunksGenerated + generated.chunksFromCache == (long long)tracker.loaded.size() + tracker.numUnloads);
+	CHECK(GetClipmapChunkCount(context, &numLoaded) == (int)tracker.loaded.size());
+
+	DestroyContext(context);
+}
+
+// ----------------------------------------------------------------------------
+
+// Reversing direction cancels everything prefetched for the old heading as
+// misses, none of it turns into a hit, and prefetches the new heading instead
+static void TestPrefetchReversal()
+{
+	const ClipmapParams params = PrefetchParams();
+	GeneratorContext* context = CreateContext(-1);
+	EnableClipmap(context, &params);
+
+	SetClipmapViewerMotion(context, 0.f, 0.f, 0.f, 40.f, 0.f, 0.f, 1.f, 0.f, 0.f);
+	RunUpdate(context);
+
+	ClipmapPrefetchStats stats;
+	GetClipmapPrefetchStats(context, &stats);
+	const int numAhead = stats.numPrefetched;
+	CHECK(numAhead > 0);
+
+	// before any of them have run
+	const int numPending = GetPendingJobCount(context);
+	SetClipmapViewerMotion(context, 0.f, 0.f, 0.f, -40.f, 0.f, 0.f, -1.f, 0.f, 0.f);
+	RunUpdate(context);
+
+	GetClipmapPrefetchStats(context, &stats);
+	CHECK(stats.misses == numAhead);
+	CHECK(stats.hits == 0);
+	CHECK(stats.numPrefetched > 0);
+
+	// the cancelled jobs are gone from the queue, only the new heading's
+	// were added
+	CHECK(GetPendingJobCount(context) <= numPending - numAhead + stats.numPrefetched);
+
+	ClipmapTracker tracker;
+	CHECK(tracker.settle(context));
+	GetClipmapPrefetchStats(context, &stats);
+	CHECK(stats.misses == numAhead && stats.hits == 0);
+
+	DestroyContext(context);
+}
+
+// ----------------------------------------------------------------------------
+
+// Prefetched chunks rank behind every chunk the rings need, so nothing
+// speculative is generated until the rings have loaded
+static void TestPrefetchRanking()
+{
+	const ClipmapParams params = PrefetchParams();
+	GeneratorContext* context = CreateContext(-1);
+	EnableClipmap(context, &params);
+
+	SetClipmapViewerMotion(context, 0.f, 0.f, 0.f, 40.f, 0.f, 0.f, 1.f, 0.f, 0.f);
+	RunUpdate(context);
+
+	bool sawPartialRings = false;
+	bool ranSpeculative = false;
+	for (int frame = 0; frame < 20000 && GetPendingJobCount(context) > 0; frame++)
+	{
+		RunJobsFor(context, 500);
+
+		ClipmapEvent events[64];
+		while (DrainClipmapEvents(context, events, 64) == 64)
+		{
+		}
+
+		int numLoaded = 0;
+		const int numChunks = GetClipmapChunkCount(context, &numLoaded);
+		ContextStats stats;
+		GetContextStats(context, &stats);
+
+		const long long finished = stats.chunksGenerated + stats.chunksFromCache;
+		sawPartialRings = sawPartialRings || numLoaded < numChunks;
+		if (finished > numChunks)
+		{
+			ranSpeculative = true;
+			CHECK(numLoaded == numChunks);
+		}
+	}
+
+	CHECK(sawPartialRings);
+	CHECK(ranSpeculative);
+
+	DestroyContext(context);
+}
+
+// ----------------------------------------------------------------------------
+
+// Params the rings can't be built from are rejected and leave the current
+// clipmap running
+static void TestInvalidParams(const ClipmapParams& valid)
+{
+	GeneratorContext* context = CreateContext(-1);
+	CHECK(EnableClipmap(context, &valid) == 1);
+
+	ClipmapParams params[7] = { valid, valid, valid, valid, valid, valid, valid };
+	params[0].numLods = 0;
+	params[1].numLods = 17;
+	params[2].chunkSize = 0;
+	params[3].chunkSize = 1 << 28;		// 1 << 31 at the coarsest LOD's parent
+	params[4].halfExtent = 0;
+	params[5].pipeline = 7;
+	params[6].pipeline = Pipeline_Octree;
+	params[6].chunkSize = 24;			// not a power of two voxels across
+
+	for (const ClipmapParams& invalid : params)
+	{
+		CHECK(EnableClipmap(context, &invalid) == 0);
+		CHECK(context->clipmap() != nullptr);
+	}
+
+	DestroyContext(context);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	ClipmapParams params;
+	params.chunkSize = 16;
+	params.numLods = 3;
+	params.halfExtent = 1;
+	params.verticalHalfExtent = 0;
+
+	const glm::vec3 viewers[] =
+	{
+		glm::vec3(0.f),
+		glm::vec3(5.f, 0.f, 3.f),		// same rings
+		glm::vec3(40.f, 0.f, 0.f),		// across the LOD 0 and 1 boundaries
+		glm::vec3(200.f, 0.f, -130.f),	// nothing in common
+	};
+
+	// without workers, every job runs inside RunJobsFor
+	GeneratorContext* context = CreateContext(-1);
+	EnableClipmap(context, &params);
+
+	ClipmapTracker tracker;
+	for (const glm::vec3& viewer : viewers)
+	{
+		const std::map<ChunkKey, ClipmapEvent> before = tracker.loaded;
+		tracker.reset();
+
+		SetClipmapViewer(context, viewer.x, viewer.y, viewer.z);
+		CHECK(tracker.settle(context));
+
+		int numLoaded = 0;
+		CHECK(GetClipmapChunkCount(context, &numLoaded) == (int)tracker.loaded.size());
+		CHECK(tracker.numReloads == 0);
+		CHECK(tracker.numBadUnloads == 0);
+
+		// the events are exactly the difference between the old and new rings
+		int added = 0, removed = 0;
+		for (const auto& entry : tracker.loaded)
+		{
+			added += before.count(entry.first) == 0;
+		}
+
+		for (const auto& entry : before)
+		{
+			removed += tracker.loaded.count(entry.first) == 0;
+		}
+
+		CHECK(tracker.numLoads == added);
+		CHECK(tracker.numUnloads == removed);
+
+		// the same rings as a clipmap started at this position
+		GeneratorContext* fresh = CreateContext(-1);
+		EnableClipmap(fresh, &params);
+		SetClipmapViewer(fresh, viewer.x, viewer.y, viewer.z);
+
+		ClipmapTracker freshTracker;
+		CHECK(freshTracker.settle(fresh));
+		CHECK(freshTracker.loaded.size() == tracker.loaded.size());
+
+		int missing = 0;
+		for (const auto& entry : freshTracker.loaded)
+		{
+			missing += tracker.loaded.count(entry.first) == 0;
+		}
+
+		CHECK(missing == 0);
+		DestroyContext(fresh);
+
+		CheckCoverage(tracker, viewer, 40);
+	}
+
+	// staying within the rings is free
+	tracker.reset();
+	SetClipmapViewer(context, viewers[3].x + 1.f, viewers[3].y, viewers[3].z + 1.f);
+	CHECK(tracker.settle(context));
+	CHECK(tracker.numLoads == 0 && tracker.numUnloads == 0);
+
+	DisableClipmap(context);
+	DestroyContext(context);
+
+	TestInvalidParams(params);
+	TestPrefetchHits();
+	TestPrefetchReversal();
+	TestPrefetchRanking();
+	return TestResult("clipmap");
+}
@@ -0,0 +1,177 @@
+#include "completion_queue.h"
+#include "job_system.h"
+
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+// ----------------------------------------------------------------------------
+
+static CompletedJob MakeJob(const int id)
+{
+	CompletedJob job = {};
+	job.job = id;
+	job.status = 2;
+	job.bytes = id * 3;
+	return job;
+}
+
+// ----------------------------------------------------------------------------
+
+// Fills the queue until push fails, the overflow flag is raised once and the
+// entries come back out in order
+static void TestOverflow()
+{
+	CompletionQueue queue(5);
+	CHECK(!queue.overflowed());
+
+	int pushed = 0;
+	while (queue.push(MakeJob(pushed + 1)))
+	{
+		pushed++;
+		CHECK(pushed <= 8);
+	}
+
+	// 5 rounds up to 8
+	CHECK(pushed == 8);
+	CHECK(queue.overflowed());
+	CHECK(!queue.overflowed());
+
+	CompletedJob job;
+	for (int i = 0; i < pushed; i++)
+	{
+		CHECK(queue.peek(job));
+		CHECK(job.job == i + 1 && job.bytes == job.job * 3);
+		queue.pop();
+	}
+
+	CHECK(!queue.peek(job));
+
+	// the cells are reused once popped
+	CHECK(queue.push(MakeJob(100)));
+	CHECK(queue.peek(job) && job.job == 100);
+	queue.pop();
+	CHECK(!queue.overflowed());
+}
+
+// ----------------------------------------------------------------------------
+
+// Several producers racing one consumer, nothing is lost or seen twice
+static void TestProducers()
+{
+	const int numProducers = 4;
+	const int perProducer = 20000;
+
+	CompletionQueue queue(64);
+
+	std::vector<std::thread> producers;
+	for (int t = 0; t < numProducers; t++)
+	{
+		producers.emplace_back([&queue, t]()
+		{
+			for (int i = 0; i < perProducer; i++)
+			{
+				while (!queue.push(MakeJob(t * perProducer + i)))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	std::vector<int> seen(numProducers * perProducer, 0);
+	std::vector<int> lastFromProducer(numProducers, -1);
+	int received = 0;
+	bool ordered = true;
+	while (received < (int)seen.size())
+	{
+		CompletedJob job;
+		if (!queue.peek(job))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		queue.pop();
+		seen[job.job]++;
+		received++;
+
+		// each producer's entries arrive in the order it pushed them
+		const int producer = job.job / perProducer;
+		ordered = ordered && job.job > lastFromProducer[producer];
+		lastFromProducer[producer] = job.job;
+	}
+
+	for (auto& thread : producers)
+	{
+		thread.join();
+	}
+
+	int duplicates = 0;
+	for (const int count : seen)
+	{
+		duplicates += count != 1;
+	}
+
+	CHECK(duplicates == 0);
+	CHECK(ordered);
+
+	CompletedJob job;
+	CHECK(!queue.peek(job));
+}
+
+// ----------------------------------------------------------------------------
+
+// A job released while it's being generated is dropped, nothing for it is
+// published when it finishes
+static void TestReleaseWhileRunning()
+{
+	GeneratorStats stats;
+	JobSystem jobs(-1, &stats);
+	ChunkRequest request;
+	request.size = 128;
+	request.pipeline = Pipeline_Octree;
+	GetDensityPreset("hills", request.density.params);
+	const int id = jobs.submit(request);
+
+	// until the job has stopped, whether it got to finish or not
+	std::thread runner([&jobs, &stats]()
+	{
+		while (stats.chunksGenerated.load() + stats.chunksCancelled.load() == 0)
+		{
+			jobs.runFor(1000);
+		}
+	});
+
+	while (jobs.poll(id) == JobStatus_Pending)
+	{
+		std::this_thread::yield();
+	}
+
+	const bool releasedWhileRunning = jobs.poll(id) == JobStatus_Running;
+	jobs.release(id);
+	runner.join();
+
+	// the chunk takes far longer than the release, but don't fail on a
+	// scheduler stall which let it finish first
+	if (releasedWhileRunning)
+	{
+		CompletedJob completed[4];
+		bool overflowed = false;
+		CHECK(jobs.drainCompleted(completed, 4, 0, overflowed) == 0);
+	}
+
+	CHECK(jobs.poll(id) == JobStatus_Invalid);
+	CHECK(jobs.result(id) == nullptr);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestOverflow();
+	TestProducers();
+	TestReleaseWhileRunning();
+	return TestResult("completion_queue");
+}
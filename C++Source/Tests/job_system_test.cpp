@@ -0,0 +1,172 @@
+#include "DualContouringPlugin.h"
+#include "job_system.h"
+
+#include <thread>
+#include <vector>
+
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+static bool Finished(const JobSystem& jobs, const int id)
+{
+	const int status = jobs.poll(id);
+	return status != JobStatus_Pending && status != JobStatus_Running;
+}
+
+// ----------------------------------------------------------------------------
+
+// Without workers runFor does all the work, every job is published once
+static void TestRunFor()
+{
+	JobSystem jobs(-1);
+	CHECK(jobs.numThreads() == 0);
+
+	std::vector<int> ids;
+	for (int i = 0; i < 6; i++)
+	{
+		ids.push_back(jobs.submit(MakeRequest(glm::ivec3(i * 16, 0, 0), 16, i & 1)));
+	}
+
+	jobs.cancel(ids[5]);
+	CHECK(jobs.poll(ids[0]) == JobStatus_Pending);
+
+	// a chunk which didn't fit carries on in the next call
+	for (const int id : ids)
+	{
+		for (int i = 0; i < 10000 && !Finished(jobs, id); i++)
+		{
+			jobs.runFor(1000);
+		}
+
+		CHECK(Finished(jobs, id));
+	}
+
+	CompletedJob completed[16];
+	bool overflowed = false;
+	const int count = jobs.drainCompleted(completed, 16, 0, overflowed);
+	CHECK(count == 6);
+	CHECK(!overflowed);
+
+	std::vector<int> seen(ids.size(), 0);
+	for (int i = 0; i < count; i++)
+	{
+		for (size_t j = 0; j < ids.size(); j++)
+		{
+			if (completed[i].job == ids[j])
+			{
+				seen[j]++;
+				CHECK(completed[i].status == (j == 5 ? JobStatus_Cancelled : JobStatus_Done));
+			}
+		}
+	}
+
+	for (const int n : seen)
+	{
+		CHECK(n == 1);
+	}
+
+	CHECK(jobs.result(ids[0]) != nullptr);
+	CHECK(jobs.result(ids[5]) == nullptr);
+
+	for (const int id : ids)
+	{
+		jobs.release(id);
+	}
+
+	CHECK(jobs.poll(ids[0]) == JobStatus_Invalid);
+}
+
+// ----------------------------------------------------------------------------
+
+// The blocking batch call runs the jobs itself on a context without workers
+static void TestBatchWithoutWorkers()
+{
+	GeneratorContext* context = CreateContext(-1);
+
+	std::vector<ChunkDesc> descs;
+	for (int i = 0; i < 4; i++)
+	{
+		ChunkDesc desc = {};
+		desc.x = i * 16;
+		desc.size = 16;
+		desc.pipeline = i & 1;
+		desc.targetPolygonPercent = 1.f;
+		descs.push_back(desc);
+	}
+
+	std::vector<ChunkMeshDesc> meshes(descs.size());
+	CHECK(GenerateChunkBatch(context, descs.data(), (int)descs.size(), meshes.data()) == (int)descs.size());
+
+	std::vector<int> ids;
+	for (const ChunkMeshDesc& mesh : meshes)
+	{
+		CHECK(mesh.status == JobStatus_Done);
+		ids.push_back(mesh.job);
+	}
+
+	ReleaseJobs(context, ids.data(), (int)ids.size());
+	DestroyContext(context);
+}
+
+// ----------------------------------------------------------------------------
+
+// Descs the pipelines can't generate fail straight away instead of being queued
+static void TestInvalidRequests()
+{
+	GeneratorContext* context = CreateContext(-1);
+
+	const int sizes[] = { 16, 16, 16, 0, 48, 16 };
+	const int lods[] = { -1, 5, 0, 0, 2, 4 };
+	const int pipelines[] = { Pipeline_FastDC, Pipeline_FastDC, 7, Pipeline_Heightfield, Pipeline_Octree, Pipeline_Octree };
+	const int numDescs = 6;
+
+	std::vector<ChunkDesc> descs;
+	for (int i = 0; i < numDescs; i++)
+	{
+		ChunkDesc desc = {};
+		desc.size = sizes[i];
+		desc.lod = lods[i];
+		desc.pipeline = pipelines[i];
+		desc.targetPolygonPercent = 1.f;
+		descs.push_back(desc);
+	}
+
+	// the last is a single leaf, which is fine
+	std::vector<ChunkMeshDesc> meshes(descs.size());
+	CHECK(GenerateChunkBatch(context, descs.data(), numDescs, meshes.data()) == 1);
+
+	std::vector<int> ids;
+	for (int i = 0; i < numDescs; i++)
+	{
+		CHECK(meshes[i].status == (i == numDescs - 1 ? JobStatus_Done : JobStatus_Failed));
+		ids.push_back(meshes[i].job);
+	}
+
+	CompletedJob completed[16];
+	int overflowed = 0;
+	CHECK(DrainCompletedJobs(context, completed, 16, 0, &overflowed) == numDescs);
+	CHECK(completed[0].status == JobStatus_Failed && completed[0].bytes == 0);
+	CHECK(GetPendingJobCount(context) == 0);
+
+	ReleaseJobs(context, ids.data(), (int)ids.size());
+	DestroyContext(context);
+
+	// the octree pipeline alone frees the tree it couldn't contour
+	ChunkRequest octree = MakeRequest(glm::ivec3(0), 48, Pipeline_Octree);
+	octree.lod = 2;
+	ChunkResult result;
+	GenerateChunk(octree, result);
+	CHECK(result.indices.empty());
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestRunFor();
+	TestBatchWithoutWorkers();
+	TestInvalidRequests();
+	return TestResult("job_system");
+}
@@ -0,0 +1,199 @@
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "mesh_cache.h"
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+typedef EvictionCandidate::Clock Clock;
+
+// Offers its cheapest entry by MemoryGovernor::evictionScore and records the
+// order entries were evicted in, across every consumer sharing the log
+class TestConsumer : public MemoryConsumer
+{
+public:
+
+	TestConsumer(MemoryGovernor& governor, std::vector<uint64_t>& evicted)
+		: governor_(governor)
+		, evicted_(evicted)
+	{
+	}
+
+	void add(const uint64_t id, const long long bytes, const long long cost, const Clock::time_point& lastUsed)
+	{
+		EvictionCandidate entry;
+		entry.id = id;
+		entry.bytes = bytes;
+		entry.cost = cost;
+		entry.lastUsed = lastUsed;
+		entries_.push_back(entry);
+		governor_.add(Memory_Prefetch, bytes);
+	}
+
+	bool evictionCandidate(EvictionCandidate& candidate) override
+	{
+		const auto now = Clock::now();
+		const auto cheapest = std::min_element(begin(entries_), end(entries_), [&](const EvictionCandidate& a, const EvictionCandidate& b)
+		{
+			return MemoryGovernor::evictionScore(a, now) < MemoryGovernor::evictionScore(b, now);
+		});
+
+		if (cheapest == end(entries_))
+		{
+			return false;
+		}
+
+		candidate = *cheapest;
+		return true;
+	}
+
+	void evict(const uint64_t id) override
+	{
+		for (auto iter = begin(entries_); iter != end(entries_); ++iter)
+		{
+			if (iter->id == id)
+			{
+				governor_.add(Memory_Prefetch, -iter->bytes);
+				evicted_.push_back(id);
+				entries_.erase(iter);
+				return;
+			}
+		}
+	}
+
+private:
+
+	MemoryGovernor&					governor_;
+	std::vector<uint64_t>&			evicted_;
+	std::vector<EvictionCandidate>	entries_;
+};
+
+// ----------------------------------------------------------------------------
+
+// Every category is reported on its own and in the total, returned memory
+// comes off again and nothing is evicted without a budget
+static void TestUsage()
+{
+	MemoryGovernor governor;
+	governor.add(Memory_JobResults, 100);
+	governor.add(Memory_Prefetch, 20);
+	governor.add(Memory_Generation, 3000);
+	governor.add(Memory_MeshCache, 400);
+	governor.add(Memory_Generation, -1000);
+
+	MemoryUsage usage;
+	governor.usage(usage);
+	CHECK(usage.budget == 0);
+	CHECK(usage.jobResults == 100);
+	CHECK(usage.prefetch == 20);
+	CHECK(usage.generation == 2000);
+	CHECK(usage.meshCache == 400);
+	CHECK(usage.total == 2520 && governor.total() == 2520);
+	CHECK(usage.evictions == 0 && usage.evictedBytes == 0);
+
+	// negative budgets are taken as none
+	governor.setBudget(-5);
+	CHECK(governor.budget() == 0);
+}
+
+// ----------------------------------------------------------------------------
+
+// Over budget, the entries go cheapest to regenerate per byte first, an old
+// entry counting for less than a fresh one, across all the consumers, and
+// eviction stops as soon as the total is back under budget
+static void TestEvictionOrder()
+{
+	MemoryGovernor governor;
+	std::vector<uint64_t> evicted;
+	TestConsumer a(governor, evicted);
+	TestConsumer b(governor, evicted);
+	governor.addConsumer(&a);
+	governor.addConsumer(&b);
+
+	const auto now = Clock::now();
+	a.add(1, 1000, 8000, now);							// 8 per byte
+	a.add(2, 1000, 1500, now);							// 1.5 per byte
+	b.add(3, 1000, 4000, now);							// 4 per byte
+	b.add(4, 1000, 4000, now - std::chrono::seconds(30));	// 1 per byte after 30s
+	b.add(5, 4000, 10000, now);							// 2.5 per byte
+
+	// unevictable, the caches have to make room for it
+	governor.add(Memory_JobResults, 500);
+
+	governor.setBudget(4600);
+	CHECK(governor.total() <= 4600);
+
+	const std::vector<uint64_t> expected = { 4, 2, 5 };
+	CHECK(evicted == expected);
+
+	MemoryUsage usage;
+	governor.usage(usage);
+	CHECK(usage.evictions == 3);
+	CHECK(usage.evictedBytes == 6000);
+	CHECK(usage.prefetch == 2000 && usage.jobResults == 500);
+	CHECK(usage.total == 2500);
+
+	// with nothing left to give, enforce gives up rather than spinning
+	governor.setBudget(100);
+	CHECK(governor.total() == 500);
+	CHECK(evicted.size() == 5);
+
+	governor.removeConsumer(&a);
+	governor.removeConsumer(&b);
+}
+
+// ----------------------------------------------------------------------------
+
+// The mesh cache reports what it holds and gives up its least recently used
+// chunk first, a load counting as a use
+static void TestMeshCacheEviction()
+{
+	MemoryGovernor governor;
+	MeshCache cache(&governor);
+	cache.setCapacity(64 << 20);
+	governor.addConsumer(&cache);
+
+	ChunkRequest requests[3];
+	for (int i = 0; i < 3; i++)
+	{
+		requests[i] = MakeRequest(glm::ivec3(i * 16, 0, 0), 16, Pipeline_FastDC);
+
+		ChunkResult result;
+		CHECK(GenerateChunk(requests[i], result));
+		cache.store(requests[i], result, 1000, cache.epoch());
+	}
+
+	MemoryUsage usage;
+	governor.usage(usage);
+	CHECK(cache.numChunks() == 3);
+	CHECK(usage.meshCache == cache.bytes() && usage.total == cache.bytes());
+
+	// 0 is now the most recently used, 1 the least
+	ChunkResult loaded;
+	CHECK(cache.load(requests[0], loaded));
+
+	governor.setBudget(cache.bytes() - 1);
+	CHECK(cache.numChunks() == 2);
+	CHECK(!cache.load(requests[1], loaded));
+	CHECK(cache.load(requests[0], loaded) && cache.load(requests[2], loaded));
+
+	governor.usage(usage);
+	CHECK(usage.evictions == 1);
+	CHECK(usage.meshCache == cache.bytes());
+
+	governor.removeConsumer(&cache);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestUsage();
+	TestEvictionOrder();
+	TestMeshCacheEviction();
+	return TestResult("memory_governor");
+}
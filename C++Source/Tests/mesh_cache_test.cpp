@@ -0,0 +1,135 @@
+#include "mesh_cache.h"
+
+#include <vector>
+
+#include "test.h"
+#include "test_chunks.h"
+
+// ----------------------------------------------------------------------------
+
+// Stored chunks come back identical and are keyed on the request's settings
+static void TestRoundTrip()
+{
+	MeshCache cache;
+	cache.setCapacity(16 << 20);
+
+	const ChunkRequest request = MakeRequest(glm::ivec3(0), 16, Pipeline_FastDC);
+	ChunkResult generated;
+	CHECK(GenerateChunk(request, generated));
+	CHECK(generated.numVertices() > 0);
+
+	ChunkResult result;
+	CHECK(!cache.load(request, result));
+
+	cache.store(request, generated, 1000, cache.epoch());
+	CHECK(cache.numChunks() == 1);
+	CHECK(cache.bytes() > 0);
+
+	CHECK(cache.load(request, result));
+	CHECK(result.vertices == generated.vertices);
+	CHECK(result.indices == generated.indices);
+	CHECK(result.seamVoxels.size() == generated.seamVoxels.size());
+	CHECK(!result.subMeshes.empty());
+
+	// a different LOD or density is a different chunk
+	ChunkRequest coarser = request;
+	coarser.lod = 1;
+	CHECK(!cache.load(coarser, result));
+
+	ChunkRequest otherDensity = request;
+	otherDensity.density.params.maxHeight += 1.f;
+	CHECK(!cache.load(otherDensity, result));
+
+	// capacity 0 turns the cache off
+	cache.setCapacity(0);
+	CHECK(cache.numChunks() == 0 && cache.bytes() == 0);
+	cache.store(request, generated, 1000, cache.epoch());
+	CHECK(!cache.load(request, result));
+}
+
+// ----------------------------------------------------------------------------
+
+// invalidate() drops the chunks overlapping the box (a voxel's margin
+// included) and anything generated before it isn't stored afterwards
+static void TestEpochAndInvalidate()
+{
+	MeshCache cache;
+	cache.setCapacity(16 << 20);
+
+	std::vector<ChunkRequest> requests;
+	std::vector<ChunkResult> results;
+	for (int x = 0; x < 4; x++)
+	{
+		requests.push_back(MakeRequest(glm::ivec3(x * 16 + 8, 8, 8), 16, Pipeline_FastDC));
+		results.emplace_back();
+		GenerateChunk(requests.back(), results.back());
+		cache.store(requests.back(), results.back(), 1000, cache.epoch());
+	}
+
+	CHECK(cache.numChunks() == 4);
+
+	// chunk 1 spans x 16..32, this box touches it only through the margin
+	const uint64_t before = cache.epoch();
+	cache.invalidate(glm::ivec3(33, 8, 8), glm::ivec3(33, 8, 8));
+	CHECK(cache.epoch() != before);
+
+	ChunkResult result;
+	CHECK(cache.load(requests[0], result));
+	CHECK(!cache.load(requests[1], result));
+	CHECK(!cache.load(requests[2], result));
+	CHECK(cache.load(requests[3], result));
+	CHECK(cache.numChunks() == 2);
+
+	// a chunk whose generation started before the invalidation is stale
+	cache.store(requests[1], results[1], 1000, before);
+	CHECK(!cache.load(requests[1], result));
+
+	cache.store(requests[1], results[1], 1000, cache.epoch());
+	CHECK(cache.load(requests[1], result));
+
+	// far away edits leave everything alone
+	cache.invalidate(glm::ivec3(1000), glm::ivec3(1010));
+	CHECK(cache.numChunks() == 3);
+
+	cache.clear();
+	CHECK(cache.numChunks() == 0 && cache.bytes() == 0);
+}
+
+// ----------------------------------------------------------------------------
+
+// The least recently used chunks go first when the capacity is lowered
+static void TestCapacity()
+{
+	MeshCache cache;
+	cache.setCapacity(64 << 20);
+
+	std::vector<ChunkRequest> requests;
+	for (int x = 0; x < 3; x++)
+	{
+		requests.push_back(MakeRequest(glm::ivec3(x * 16 + 8, 8, 8), 16, Pipeline_FastDC));
+		ChunkResult generated;
+		GenerateChunk(requests.back(), generated);
+		cache.store(requests.back(), generated, 1000, cache.epoch());
+	}
+
+	// touch the first so the second is the oldest
+	ChunkResult result;
+	CHECK(cache.load(requests[0], result));
+
+	cache.setCapacity(cache.bytes() - 1);
+	CHECK(cache.numChunks() == 2);
+	CHECK(cache.load(requests[0], result));
+	CHECK(!cache.load(requests[1], result));
+	CHECK(cache.load(requests[2], result));
+	CHECK(cache.bytes() <= cache.capacity());
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestRoundTrip();
+	TestEpochAndInvalidate();
+	TestCapacity();
+	return TestResult("mesh_cache");
+}
@@ -0,0 +1,170 @@
+#include "sign_dag.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+#include "test.h"
+
+// ----------------------------------------------------------------------------
+
+static const glm::ivec3 kOrigin(-32, -16, -32);
+static const int kSize = 64;
+
+static bool Inside(const DensityParams& density, const glm::ivec3& corner)
+{
+	return Density_Func(density, glm::vec3(corner)) < 0.f;
+}
+
+// ----------------------------------------------------------------------------
+
+// The brute force answer for every corner of a box
+static CornerSigns ClassifyBox(const DensityParams& density, const glm::ivec3& min, const glm::ivec3& max)
+{
+	bool inside = false, outside = false;
+	for (int x = min.x; x <= max.x; x++)
+	for (int y = min.y; y <= max.y; y++)
+	for (int z = min.z; z <= max.z; z++)
+	{
+		(Inside(density, glm::ivec3(x, y, z)) ? inside : outside) = true;
+	}
+
+	return inside && outside ? CornerSigns_Mixed : inside ? CornerSigns_Inside : CornerSigns_Outside;
+}
+
+// ----------------------------------------------------------------------------
+
+// Every corner and a spread of boxes agree with sampling the density
+static void CheckAgainstDensity(const SignDag& dag, const DensityParams& density)
+{
+	int wrongCorners = 0;
+	for (int x = 0; x < kSize; x++)
+	for (int y = 0; y < kSize; y++)
+	for (int z = 0; z < kSize; z++)
+	{
+		const glm::ivec3 corner = kOrigin + glm::ivec3(x, y, z);
+		wrongCorners += dag.inside(corner) != Inside(density, corner);
+	}
+
+	CHECK(wrongCorners == 0);
+
+	std::mt19937 prng(7);
+	std::uniform_int_distribution<int> start(0, kSize - 17), extent(0, 16);
+
+	int wrongBoxes = 0, mixed = 0;
+	for (int i = 0; i < 300; i++)
+	{
+		const glm::ivec3 min = kOrigin + glm::ivec3(start(prng), start(prng), start(prng));
+		const glm::ivec3 max = min + glm::ivec3(extent(prng), extent(prng), extent(prng));
+		const CornerSigns expected = ClassifyBox(density, min, max);
+		wrongBoxes += dag.classify(min, max) != expected;
+		mixed += expected == CornerSigns_Mixed;
+	}
+
+	CHECK(wrongBoxes == 0);
+	CHECK(mixed > 0 && mixed < 300);
+
+	// a strided lattice like fast_dc's at LOD 1
+	const int count = 17;
+	std::vector<float> lattice(count * count * count);
+	dag.fill(kOrigin, 2, count, lattice.data());
+
+	int wrongLattice = 0;
+	for (int x = 0; x < count; x++)
+	for (int y = 0; y < count; y++)
+	for (int z = 0; z < count; z++)
+	{
+		const float expected = Inside(density, kOrigin + glm::ivec3(x, y, z) * 2) ? -1.f : 1.f;
+		wrongLattice += lattice[(x * count + y) * count + z] != expected;
+	}
+
+	CHECK(wrongLattice == 0);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	DensityParams density;
+	CHECK(GetDensityPreset("hills", density));
+	density.sphereOrigin = glm::vec3(3.5f, 10.f, -2.25f);
+	density.sphereRadius = 6.f;
+
+	const std::shared_ptr<SignDag> dag = SignDag::build(density, kOrigin, kSize, 2);
+	CHECK(dag != nullptr);
+	if (!dag)
+	{
+		return TestResult("sign_dag");
+	}
+
+	CHECK(dag->size() == kSize && dag->origin() == kOrigin);
+	CHECK(dag->contains(kOrigin, kOrigin + glm::ivec3(kSize - 1)));
+	CHECK(!dag->contains(kOrigin - glm::ivec3(1), kOrigin));
+	CHECK(dag->matches(density));
+
+	DensityParams other = density;
+	other.maxHeight += 1.f;
+	CHECK(!dag->matches(other));
+
+	const SignDagStats stats = dag->stats();
+	CHECK(stats.size == kSize && stats.numLeaves > 0 && stats.compression > 1.f);
+
+	CheckAgainstDensity(*dag, density);
+
+	// a cancelled build gives nothing back
+	std::atomic<bool> cancel(true);
+	CHECK(SignDag::build(density, kOrigin, kSize, 1, &cancel) == nullptr);
+
+	// save and load round trip
+	const std::string path = "sign_dag_test.dag";
+	CHECK(dag->save(path));
+
+	const std::shared_ptr<SignDag> loaded = SignDag::load(path);
+	CHECK(loaded != nullptr);
+	if (loaded)
+	{
+		CHECK(loaded->origin() == kOrigin && loaded->size() == kSize);
+		CHECK(loaded->matches(density));
+		CheckAgainstDensity(*loaded, density);
+	}
+
+	// a truncated file is rejected
+	FILE* file = fopen(path.c_str(), "rb");
+	std::vector<char> bytes;
+	if (file)
+	{
+		fseek(file, 0, SEEK_END);
+		bytes.resize(ftell(file));
+		fseek(file, 0, SEEK_SET);
+		CHECK(fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+		fclose(file);
+	}
+
+	CHECK(bytes.size() > 16);
+	file = fopen(path.c_str(), "wb");
+	if (file)
+	{
+		fwrite(bytes.data(), 1, bytes.size() / 2, file);
+		fclose(file);
+	}
+
+	CHECK(SignDag::load(path) == nullptr);
+
+	// as is a header claiming more nodes than the file holds
+	const size_t numNodesOffset = 36;
+	const uint32_t numNodes = 0x7fffffff;
+	memcpy(&bytes[numNodesOffset], &numNodes, sizeof(numNodes));
+	file = fopen(path.c_str(), "wb");
+	if (file)
+	{
+		fwrite(bytes.data(), 1, bytes.size(), file);
+		fclose(file);
+	}
+
+	CHECK(SignDag::load(path) == nullptr);
+	CHECK(SignDag::load("sign_dag_test_missing.dag") == nullptr);
+	remove(path.c_str());
+
+	return TestResult("sign_dag");
+}
@@ -0,0 +1,129 @@
+#include "sparse_volume.h"
+
+#include <math.h>
+#include <memory>
+
+#include "test.h"
+
+// ----------------------------------------------------------------------------
+
+static DensityParams FlatGround()
+{
+	// y = 0 plane, no noise and no sphere
+	DensityParams params;
+	params.maxHeight = 0.f;
+	params.noiseScale = 0.f;
+	params.sphereRadius = 0.f;
+	return params;
+}
+
+// ----------------------------------------------------------------------------
+
+// Carving a sphere out of the ground makes its centre air, leaves the far
+// away ground alone and only reports the edit's box as changed
+static void TestApplyAndSample()
+{
+	const DensityParams ground = FlatGround();
+
+	SparseVolume volume;
+	CHECK(volume.empty());
+
+	float density = 0.f;
+	CHECK(!volume.sample(glm::vec3(0.f), density));
+
+	DensityEdit edit;
+	edit.operation = DensityEditOperation_Subtract;
+	edit.centre = glm::vec3(0.5f, -3.5f, 0.5f);
+	edit.size = glm::vec3(3.f);
+
+	glm::ivec3 min, max;
+	volume.apply(ground, edit, min, max);
+	CHECK(!volume.empty());
+	CHECK(min.x <= -2 && min.y <= -6 && max.x >= 3 && max.y >= -1);
+	CHECK(max.x - min.x < 32 && max.y - min.y < 32 && max.z - min.z < 32);
+
+	// the centre was solid and is carved out
+	CHECK(Density_Func(ground, edit.centre) < 0.f);
+	CHECK(volume.sample(edit.centre, density));
+	CHECK(density >= 0.f);
+
+	// solid ground just outside the sphere is stored and still solid
+	CHECK(volume.sample(glm::vec3(5.5f, -3.5f, 0.5f), density));
+	CHECK(density < 0.f);
+
+	// the stored band follows the procedural density near the untouched surface
+	CHECK(volume.sample(glm::vec3(6.5f, -1.25f, 0.5f), density));
+	CHECK(fabsf(density - Density_Func(ground, glm::vec3(6.5f, -1.25f, 0.5f))) < 0.1f);
+
+	// nothing is stored away from the edit
+	CHECK(!volume.sample(glm::vec3(200.f, 0.f, 200.f), density));
+
+	const DensityEditStats stats = volume.stats();
+	CHECK(stats.numNodes >= 1 && stats.numLeaves >= 1 && stats.bytes > 0);
+
+	// the field sees the edit, the unedited field doesn't
+	DensityField field(ground);
+	field.edits = std::make_shared<SparseVolume>(volume);
+	CHECK(Density_Func(field, edit.centre) >= 0.f);
+	CHECK(Density_Func(DensityField(ground), edit.centre) < 0.f);
+}
+
+// ----------------------------------------------------------------------------
+
+// A copy shares the original's data until it's edited, the hash tells the two
+// apart only where they differ
+static void TestCopyOnWriteAndHash()
+{
+	const DensityParams ground = FlatGround();
+
+	DensityEdit edit;
+	edit.shape = DensityEditShape_Box;
+	edit.operation = DensityEditOperation_Add;
+	edit.centre = glm::vec3(0.f, 4.f, 0.f);
+	edit.size = glm::vec3(2.f);
+
+	SparseVolume original;
+	glm::ivec3 min, max;
+	original.apply(ground, edit, min, max);
+
+	const glm::ivec3 boxMin(-16), boxMax(16);
+	const glm::ivec3 farMin(500), farMax(532);
+
+	CHECK(original.hash(boxMin, boxMax) != 0);
+	CHECK(original.hash(farMin, farMax) == 0);
+
+	SparseVolume copy(original);
+	CHECK(copy.hash(boxMin, boxMax) == original.hash(boxMin, boxMax));
+
+	// the same edit made to a fresh volume stores the same data
+	SparseVolume again;
+	again.apply(ground, edit, min, max);
+	CHECK(again.hash(boxMin, boxMax) == original.hash(boxMin, boxMax));
+
+	DensityEdit second;
+	second.centre = glm::vec3(8.f, 4.f, 0.f);
+	second.size = glm::vec3(2.f);
+	copy.apply(ground, second, min, max);
+
+	CHECK(copy.hash(boxMin, boxMax) != original.hash(boxMin, boxMax));
+
+	// the original is untouched by the copy's edit
+	float density = 0.f;
+	CHECK(copy.sample(second.centre, density) && density < 0.f);
+	CHECK(!original.sample(second.centre, density) || density >= 0.f);
+
+	DensityRange range;
+	bool covered = false;
+	CHECK(copy.range(glm::ivec3(6, 2, -2), glm::ivec3(10, 6, 2), range, covered));
+	CHECK(covered && range.min < 0.f);
+	CHECK(!copy.range(farMin, farMax, range, covered));
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestApplyAndSample();
+	TestCopyOnWriteAndHash();
+	return TestResult("sparse_volume");
+}
@@ -0,0 +1,31 @@
+#ifndef		HAS_TEST_H_BEEN_INCLUDED
+#define		HAS_TEST_H_BEEN_INCLUDED
+
+#include <stdio.h>
+
+// ----------------------------------------------------------------------------
+
+// Each test is its own executable, ctest fails it on a non-zero exit code.
+// CHECK reports a failure and carries on so one run shows every failure.
+
+static int g_testFailures = 0;
+
+#define CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+			g_testFailures++; \
+		} \
+	} while (0)
+
+static inline int TestResult(const char* name)
+{
+	printf("%s: %s\n", name, g_testFailures ? "FAILED" : "passed");
+	return g_testFailures ? 1 : 0;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_TEST_H_BEEN_INCLUDED
@@ -0,0 +1,28 @@
+#ifndef		HAS_TEST_CHUNKS_H_BEEN_INCLUDED
+#define		HAS_TEST_CHUNKS_H_BEEN_INCLUDED
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+// The chunk fixtures shared by the tests which generate meshes, all over the
+// hills preset so there's a surface through every chunk near y = 0
+
+static inline ChunkRequest MakeRequest(const glm::ivec3& position, const int size, const int pipeline)
+{
+	ChunkRequest request;
+	request.position = position;
+	request.size = size;
+	request.pipeline = pipeline;
+	GetDensityPreset("hills", request.density.params);
+	return request;
+}
+
+static inline bool SameMesh(const ChunkResult& a, const ChunkResult& b)
+{
+	return a.vertices == b.vertices && a.indices == b.indices && a.cells == b.cells;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_TEST_CHUNKS_H_BEEN_INCLUDED
@@ -0,0 +1,146 @@
+#include "DualContouringPlugin.h"
+
+#include <stdint.h>
+#include <vector>
+
+#include "test.h"
+
+// ----------------------------------------------------------------------------
+
+// A flat strip of numVertices vertices and one triangle per vertex, with the
+// last triangle reaching the last vertex
+static ChunkResult MakeStrip(const int numVertices)
+{
+	ChunkResult result;
+	for (int i = 0; i < numVertices; i++)
+	{
+		const float vertex[6] = { (float)i, (float)(i % 7), (float)-(i % 3), 0.f, 1.f, 0.f };
+		result.vertices.insert(result.vertices.end(), vertex, vertex + 6);
+	}
+
+	for (int i = 0; i + 2 < numVertices; i++)
+	{
+		result.indices.push_back(i);
+		result.indices.push_back(i + 1);
+		result.indices.push_back(i + 2);
+	}
+
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+// 16-bit indices while every vertex is addressable with them, 32-bit beyond
+static void TestIndexFormat()
+{
+	ChunkResult small = MakeStrip(65535);
+	BuildUnityMeshLayout(small);
+	CHECK(small.indices16.size() == small.indices.size());
+	CHECK(small.indices16.back() == 65534);
+
+	ChunkResult large = MakeStrip(65537);
+	BuildUnityMeshLayout(large);
+	CHECK(large.indices16.empty());
+
+	// bounds over every vertex
+	CHECK(large.bounds.min == glm::vec3(0.f, 0.f, -2.f));
+	CHECK(large.bounds.max == glm::vec3(65536.f, 6.f, 0.f));
+
+	CHECK(large.subMeshes.size() == 1);
+	CHECK(large.subMeshes[0].indexCount == (int)large.indices.size());
+	CHECK(large.subMeshes[0].vertexCount == 65537);
+
+	// building again doesn't accumulate
+	BuildUnityMeshLayout(small);
+	CHECK(small.indices16.size() == small.indices.size());
+	CHECK(small.subMeshes.size() == 1);
+}
+
+// ----------------------------------------------------------------------------
+
+// A seam is a second submesh after the chunk's own mesh
+static void TestSeamSubMesh()
+{
+	ChunkResult result = MakeStrip(100);
+	result.seamFirstVertex = 60;
+	result.seamFirstIndex = 150;
+	BuildUnityMeshLayout(result);
+
+	CHECK(result.subMeshes.size() == 2);
+	CHECK(result.subMeshes[0].indexStart == 0 && result.subMeshes[0].indexCount == 150);
+	CHECK(result.subMeshes[1].indexStart == 150);
+	CHECK(result.subMeshes[1].indexCount == (int)result.indices.size() - 150);
+
+	// the chunk's own submesh is bounded by the vertices it uses
+	CHECK(result.subMeshes[0].bounds.max.x <= 51.f);
+	CHECK(result.subMeshes[1].bounds.max.x == 99.f);
+}
+
+// ----------------------------------------------------------------------------
+
+// What the managed side receives for a generated chunk
+static void TestUnityMeshDesc()
+{
+	GeneratorContext* context = CreateContext(-1);
+
+	ChunkDesc desc = {};
+	desc.x = 16;
+	desc.z = 16;
+	desc.size = 32;
+	desc.pipeline = Pipeline_FastDC;
+	desc.targetPolygonPercent = 1.f;
+
+	ChunkMeshDesc chunk;
+	CHECK(GenerateChunkBatch(context, &desc, 1, &chunk) == 1);
+
+	UnityMeshDesc mesh;
+	CHECK(GetJobUnityMesh(context, chunk.job, &mesh) == 1);
+	CHECK(mesh.vertexCount > 0);
+	CHECK(mesh.vertexStride == 6 * (int)sizeof(float));
+	CHECK(mesh.indexCount == chunk.indexBufferLength);
+	CHECK(mesh.indexFormat == 0);
+	CHECK(mesh.subMeshCount == 1);
+	CHECK(mesh.contents == ChunkContents_Surface);
+
+	int wrongIndices = 0, outOfBounds = 0;
+	const uint16_t* indices = static_cast<const uint16_t*>(mesh.indexData);
+	for (int i = 0; i < mesh.indexCount; i++)
+	{
+		wrongIndices += indices[i] != chunk.indexBufferData[i];
+	}
+
+	// position then normal, inside the bounds
+	for (int i = 0; i < mesh.vertexCount; i++)
+	{
+		const float* vertex = mesh.vertexData + i * 6;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			outOfBounds += vertex[axis] < mesh.boundsMin[axis] || vertex[axis] > mesh.boundsMax[axis];
+		}
+
+		const float length2 = vertex[3] * vertex[3] + vertex[4] * vertex[4] + vertex[5] * vertex[5];
+		outOfBounds += length2 < 0.5f || length2 > 1.5f;
+	}
+
+	CHECK(wrongIndices == 0);
+	CHECK(outOfBounds == 0);
+
+	UnitySubMeshDesc subMesh;
+	CHECK(GetJobUnitySubMeshes(context, chunk.job, &subMesh, 1) == 1);
+	CHECK(subMesh.indexCount == mesh.indexCount && subMesh.vertexCount == mesh.vertexCount);
+
+	ReleaseJob(context, chunk.job);
+	CHECK(GetJobUnityMesh(context, chunk.job, &mesh) == 0);
+
+	DestroyContext(context);
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+	TestIndexFormat();
+	TestSeamSubMesh();
+	TestUnityMeshDesc();
+	return TestResult("unity_layout");
+}
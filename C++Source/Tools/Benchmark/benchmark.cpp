@@ -0,0 +1,506 @@
+// benchmark : times each stage of both meshers and prints the results as JSON.
+//
+//	benchmark [--sizes 16,32,64,128,256] [--presets default,hills,mountains]
+//	          [--threads 1,8] [--pipelines fast_dc,octree] [--chunks n]
+//	          [--threshold t] [--simplify p] [--out file.json]
+//
+// Every combination of size, preset, pipeline and thread count is one run:
+// --chunks chunks per thread (default 2) of size^3 voxels at LOD 0, spread
+// along x through the surface, with the threads pulling chunks until they're
+// all done. Both meshers run the stages GenerateChunk does. fast_dc is timed
+// per stage (density sampling, active voxel search, QEF, triangle generation)
+// through FastDCGenerator::runStage, then SimplifyChunkMesh with --simplify as
+// the target percentage (default that of MeshSimplificationOptions, 1 turns it
+// off). The octree mesher is timed as BuildOctree (with --threshold, default 1
+// like ChunkRequest::octreeThreshold) and GenerateMeshFromOctree.
+//
+// Stage times are summed over the threads, so with more than one thread they
+// add up to more than the run's wall time. Voxels and triangles per second are
+// over wall time. Peak memory is the process' resident high water mark, reset
+// before each run where the kernel allows it (/proc/self/clear_refs).
+//
+// Progress goes to stderr so stdout can be piped into a file as it is.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chunk_generator.h"
+#include "density.h"
+#include "fast_dc.h"
+#include "octree.h"
+
+// ----------------------------------------------------------------------------
+
+enum BenchmarkStage
+{
+	BenchmarkStage_Density,
+	BenchmarkStage_ActiveVoxels,
+	BenchmarkStage_QEF,
+	BenchmarkStage_Triangles,
+	BenchmarkStage_Simplify,
+	BenchmarkStage_OctreeBuild,
+	BenchmarkStage_Contour,
+
+	BenchmarkStage_Count
+};
+
+static const char* STAGE_NAMES[BenchmarkStage_Count] =
+{
+	"density",
+	"active_voxels",
+	"qef",
+	"triangles",
+	"simplify",
+	"octree_build",
+	"contour",
+};
+
+struct BenchmarkOptions
+{
+	std::vector<int>			sizes = { 16, 32, 64, 128, 256 };
+	std::vector<std::string>	presets = { "default", "hills", "mountains" };
+	std::vector<int>			threads;		// 1 and every core when not given
+	std::vector<int>			pipelines = { Pipeline_FastDC, Pipeline_Octree };
+	int							chunksPerThread = 2;
+	float						threshold = 1.f;
+	MeshSimplificationOptions	simplify;
+	std::string					outputPath;
+};
+
+// what one thread measured, summed into the run's totals when it finishes
+struct BenchmarkTotals
+{
+	double			stageSeconds[BenchmarkStage_Count] = {};
+	long long		vertices = 0;
+	long long		triangles = 0;
+};
+
+struct BenchmarkRun
+{
+	int				pipeline = Pipeline_FastDC;
+	std::string		preset;
+	int				size = 0;
+	int				numThreads = 1;
+	int				numChunks = 0;
+	double			seconds = 0.0;
+	long long		peakMemoryBytes = 0;
+	BenchmarkTotals	totals;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// ----------------------------------------------------------------------------
+
+static double SecondsSince(const Clock::time_point& start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// ----------------------------------------------------------------------------
+
+static const char* PipelineName(const int pipeline)
+{
+	return pipeline == Pipeline_Octree ? "octree" : "fast_dc";
+}
+
+// ----------------------------------------------------------------------------
+
+static bool ParseIntList(const char* text, std::vector<int>& values)
+{
+	values.clear();
+	for (const char* p = text; *p;)
+	{
+		char* end = nullptr;
+		const long value = strtol(p, &end, 10);
+		if (end == p || value <= 0 || value > 4096)
+		{
+			return false;
+		}
+
+		values.push_back((int)value);
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	return !values.empty();
+}
+
+// ----------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const char* text)
+{
+	std::vector<std::string> values;
+	std::string current;
+	for (const char* p = text; ; p++)
+	{
+		if (*p == ',' || *p == '\0')
+		{
+			if (!current.empty())
+			{
+				values.push_back(current);
+			}
+			current.clear();
+
+			if (*p == '\0')
+			{
+				break;
+			}
+		}
+		else
+		{
+			current += *p;
+		}
+	}
+
+	return values;
+}
+
+// ----------------------------------------------------------------------------
+
+static void PrintUsage(const char* name)
+{
+	fprintf(stderr,
+		"usage: %s [--sizes 16,32,64,128,256] [--presets default,hills,mountains] [--threads 1,8]\n"
+		"       [--pipelines fast_dc,octree] [--chunks n] [--threshold t] [--simplify p] [--out file.json]\n", name);
+}
+
+// ----------------------------------------------------------------------------
+
+static bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		bool ok = value != nullptr;
+		if (arg == "--sizes" && value)
+		{
+			ok = ParseIntList(value, options.sizes);
+		}
+		else if (arg == "--presets" && value)
+		{
+			options.presets = SplitList(value);
+			DensityParams params;
+			for (const std::string& preset : options.presets)
+			{
+				ok = ok && GetDensityPreset(preset.c_str(), params);
+			}
+			ok = ok && !options.presets.empty();
+		}
+		else if (arg == "--threads" && value)
+		{
+			ok = ParseIntList(value, options.threads);
+		}
+		else if (arg == "--pipelines" && value)
+		{
+			options.pipelines.clear();
+			for (const std::string& pipeline : SplitList(value))
+			{
+				ok = ok && (pipeline == "fast_dc" || pipeline == "octree");
+				options.pipelines.push_back(pipeline == "octree" ? Pipeline_Octree : Pipeline_FastDC);
+			}
+			ok = ok && !options.pipelines.empty();
+		}
+		else if (arg == "--chunks" && value)
+		{
+			options.chunksPerThread = atoi(value);
+			ok = options.chunksPerThread > 0;
+		}
+		else if (arg == "--threshold" && value)
+		{
+			options.threshold = (float)atof(value);
+		}
+		else if (arg == "--simplify" && value)
+		{
+			options.simplify.targetPercentage = (float)atof(value);
+			ok = options.simplify.targetPercentage > 0.f;
+		}
+		else if (arg == "--out" && value)
+		{
+			options.outputPath = value;
+		}
+		else
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			fprintf(stderr, "benchmark: bad argument %s\n", arg.c_str());
+			return false;
+		}
+		i++;
+	}
+
+	if (options.threads.empty())
+	{
+		const int numCores = std::max(1, (int)std::thread::hardware_concurrency());
+		options.threads.push_back(1);
+		if (numCores > 1)
+		{
+			options.threads.push_back(numCores);
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Linux 4.0 and later reset VmHWM when 5 is written here, older kernels
+// refuse it and the peak carries over from the previous runs
+static void ResetPeakMemory()
+{
+	FILE* file = fopen("/proc/self/clear_refs", "w");
+	if (file)
+	{
+		fputs("5", file);
+		fclose(file);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static long long PeakMemoryBytes()
+{
+	FILE* file = fopen("/proc/self/status", "r");
+	if (file)
+	{
+		char line[256];
+		long long kilobytes = -1;
+		while (fgets(line, sizeof(line), file))
+		{
+			if (sscanf(line, "VmHWM: %lld kB", &kilobytes) == 1)
+			{
+				break;
+			}
+		}
+		fclose(file);
+
+		if (kilobytes >= 0)
+		{
+			return kilobytes * 1024;
+		}
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (long long)usage.ru_maxrss * 1024;
+}
+
+// ----------------------------------------------------------------------------
+
+static void MeshFastDC(const DensityField& density, const glm::ivec3& centre, const int size, const MeshSimplificationOptions& simplify, BenchmarkTotals& totals)
+{
+	FastDCGenerator generator(density, centre.x, centre.y, centre.z, size, 1);
+	while (generator.stage() < FastDCGenerator::Stage_Done)
+	{
+		// the generator's stages are in the same order as the first four here
+		const int stage = BenchmarkStage_Density + (generator.stage() - FastDCGenerator::Stage_Density);
+		const Clock::time_point start = Clock::now();
+		generator.runStage();
+		totals.stageSeconds[stage] += SecondsSince(start);
+	}
+
+	ChunkRequest request;
+	request.position = centre;
+	request.size = size;
+	request.pipeline = Pipeline_FastDC;
+	request.simplify = simplify;
+
+	ChunkResult result;
+	TakeFastDCMesh(generator, result);
+
+	const Clock::time_point start = Clock::now();
+	SimplifyChunkMesh(request, result);
+	totals.stageSeconds[BenchmarkStage_Simplify] += SecondsSince(start);
+
+	totals.vertices += result.numVertices();
+	totals.triangles += result.indices.size() / 3;
+}
+
+// ----------------------------------------------------------------------------
+
+static void MeshOctree(const DensityField& density, const glm::ivec3& centre, const int size, const float threshold, BenchmarkTotals& totals)
+{
+	Clock::time_point start = Clock::now();
+	OctreeNode* root = BuildOctree(density, centre - glm::ivec3(size / 2), size, threshold);
+	totals.stageSeconds[BenchmarkStage_OctreeBuild] += SecondsSince(start);
+
+	start = Clock::now();
+	VertexBuffer vertexBuffer;
+	IndexBuffer indices;
+	VertexData vertices;
+	GenerateMeshFromOctree(root, vertexBuffer, indices, vertices);
+	totals.stageSeconds[BenchmarkStage_Contour] += SecondsSince(start);
+
+	// position + normal per vertex, see GenerateVertexIndices
+	totals.vertices += vertices.size() / 6;
+	totals.triangles += indices.size() / 3;
+
+	DestroyOctree(root);
+}
+
+// ----------------------------------------------------------------------------
+
+static BenchmarkRun RunBenchmark(const BenchmarkOptions& options, const int pipeline, const std::string& preset, const int size, const int numThreads)
+{
+	BenchmarkRun run;
+	run.pipeline = pipeline;
+	run.preset = preset;
+	run.size = size;
+	run.numThreads = numThreads;
+	run.numChunks = numThreads * options.chunksPerThread;
+
+	DensityParams params;
+	GetDensityPreset(preset.c_str(), params);
+	const DensityField density(params);
+
+	std::vector<BenchmarkTotals> totals(numThreads);
+	std::atomic<int> next(0);
+
+	const auto work = [&](const int thread)
+	{
+		for (int i = next++; i < run.numChunks; i = next++)
+		{
+			// side by side through the surface at y = 0, the default preset's
+			// sphere sits in the first
+			const glm::ivec3 centre(i * size, 0, 0);
+			if (pipeline == Pipeline_Octree)
+			{
+				MeshOctree(density, centre, size, options.threshold, totals[thread]);
+			}
+			else
+			{
+				MeshFastDC(density, centre, size, options.simplify, totals[thread]);
+			}
+		}
+	};
+
+	ResetPeakMemory();
+	const Clock::time_point start = Clock::now();
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numThreads; i++)
+	{
+		threads.emplace_back(work, i);
+	}
+
+	work(0);
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	run.seconds = SecondsSince(start);
+	run.peakMemoryBytes = PeakMemoryBytes();
+
+	for (const BenchmarkTotals& thread : totals)
+	{
+		for (int i = 0; i < BenchmarkStage_Count; i++)
+		{
+			run.totals.stageSeconds[i] += thread.stageSeconds[i];
+		}
+		run.totals.vertices += thread.vertices;
+		run.totals.triangles += thread.triangles;
+	}
+
+	return run;
+}
+
+// ----------------------------------------------------------------------------
+
+static void WriteRun(FILE* file, const BenchmarkRun& run, const bool last)
+{
+	const double voxels = (double)run.size * run.size * run.size * run.numChunks;
+	const double seconds = std::max(run.seconds, 1e-9);
+
+	fprintf(file, "    {\n");
+	fprintf(file, "      \"pipeline\": \"%s\",\n", PipelineName(run.pipeline));
+	fprintf(file, "      \"preset\": \"%s\",\n", run.preset.c_str());
+	fprintf(file, "      \"size\": %d,\n", run.size);
+	fprintf(file, "      \"threads\": %d,\n", run.numThreads);
+	fprintf(file, "      \"chunks\": %d,\n", run.numChunks);
+	fprintf(file, "      \"seconds\": %.6f,\n", run.seconds);
+	fprintf(file, "      \"voxels_per_second\": %.1f,\n", voxels / seconds);
+	fprintf(file, "      \"vertices\": %lld,\n", run.totals.vertices);
+	fprintf(file, "      \"triangles\": %lld,\n", run.totals.triangles);
+	fprintf(file, "      \"triangles_per_second\": %.1f,\n", run.totals.triangles / seconds);
+	fprintf(file, "      \"peak_memory_bytes\": %lld,\n", run.peakMemoryBytes);
+	fprintf(file, "      \"stage_seconds\": {");
+
+	// only the stages this pipeline has
+	const int first = run.pipeline == Pipeline_Octree ? BenchmarkStage_OctreeBuild : BenchmarkStage_Density;
+	const int end = run.pipeline == Pipeline_Octree ? BenchmarkStage_Count : BenchmarkStage_OctreeBuild;
+	for (int i = first; i < end; i++)
+	{
+		fprintf(file, "%s\"%s\": %.6f", i == first ? " " : ", ", STAGE_NAMES[i], run.totals.stageSeconds[i]);
+	}
+
+	fprintf(file, " }\n");
+	fprintf(file, "    }%s\n", last ? "" : ",");
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::vector<BenchmarkRun> runs;
+	for (const int size : options.sizes)
+	for (const std::string& preset : options.presets)
+	for (const int pipeline : options.pipelines)
+	for (const int numThreads : options.threads)
+	{
+		// the octree halves down to single voxels
+		if (pipeline == Pipeline_Octree && (size & (size - 1)) != 0)
+		{
+			fprintf(stderr, "benchmark: skipping octree at size %d, not a power of two\n", size);
+			continue;
+		}
+
+		fprintf(stderr, "benchmark: %s %s size %d, %d threads... ", PipelineName(pipeline), preset.c_str(), size, numThreads);
+		runs.push_back(RunBenchmark(options, pipeline, preset, size, numThreads));
+		fprintf(stderr, "%.3fs\n", runs.back().seconds);
+	}
+
+	FILE* file = options.outputPath.empty() ? stdout : fopen(options.outputPath.c_str(), "w");
+	if (!file)
+	{
+		fprintf(stderr, "benchmark: can't create %s\n", options.outputPath.c_str());
+		return 1;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"cores\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(file, "  \"runs\": [\n");
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		WriteRun(file, runs[i], i + 1 == runs.size());
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	if (file != stdout && fclose(file) != 0)
+	{
+		fprintf(stderr, "benchmark: failed to write %s\n", options.outputPath.c_str());
+		return 1;
+	}
+
+	return 0;
+}
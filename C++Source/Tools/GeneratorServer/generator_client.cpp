@@ -0,0 +1,185 @@
+#include "generator_client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorClient::connect(const char* socketPath)
+{
+	disconnect();
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(socketPath) >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	strcpy(address.sun_path, socketPath);
+
+	fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		disconnect();
+		return false;
+	}
+
+	GeneratorMessage hello;
+	if (!read(hello) || hello.type != Message_Hello || hello.hello.version != GENERATOR_PROTOCOL_VERSION)
+	{
+		disconnect();
+		return false;
+	}
+
+	// the ring is only ever written by the server
+	const int shm = shm_open(hello.hello.shmName, O_RDONLY, 0);
+	if (shm < 0)
+	{
+		disconnect();
+		return false;
+	}
+
+	void* memory = mmap(nullptr, hello.hello.ringSize, PROT_READ, MAP_SHARED, shm, 0);
+	close(shm);
+	if (memory == MAP_FAILED)
+	{
+		disconnect();
+		return false;
+	}
+
+	ring_ = static_cast<const char*>(memory);
+	ringSize_ = hello.hello.ringSize;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorClient::disconnect()
+{
+	if (ring_)
+	{
+		munmap(const_cast<char*>(ring_), ringSize_);
+		ring_ = nullptr;
+		ringSize_ = 0;
+	}
+
+	if (fd_ >= 0)
+	{
+		close(fd_);
+		fd_ = -1;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorClient::generate(uint64_t tag, const ChunkDesc& chunk, const DensityParams& density)
+{
+	GeneratorMessage message = MakeMessage(Message_Generate);
+	message.generate.tag = tag;
+	message.generate.chunk = chunk;
+	message.generate.density = density;
+	return send(message);
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorClient::cancel(uint64_t tag)
+{
+	GeneratorMessage message = MakeMessage(Message_Cancel);
+	message.cancel.tag = tag;
+	return send(message);
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorClient::receive(GeneratorResult& result, const GeneratorBlock** block)
+{
+	GeneratorMessage message;
+	if (!read(message) || message.type != Message_Result)
+	{
+		return false;
+	}
+
+	result = message.result;
+	*block = nullptr;
+	if (result.status == JobStatus_Done && result.offset + result.size <= ringSize_)
+	{
+		*block = reinterpret_cast<const GeneratorBlock*>(ring_ + result.offset);
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorClient::release(const GeneratorResult& result)
+{
+	if (result.status != JobStatus_Done)
+	{
+		return true;
+	}
+
+	GeneratorMessage message = MakeMessage(Message_Release);
+	message.release.offset = result.offset;
+	return send(message);
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorClient::send(const GeneratorMessage& message)
+{
+	const char* data = reinterpret_cast<const char*>(&message);
+	size_t remaining = sizeof(message);
+	while (remaining > 0)
+	{
+		const ssize_t sent = ::send(fd_, data, remaining, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		data += sent;
+		remaining -= sent;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorClient::read(GeneratorMessage& message)
+{
+	char* data = reinterpret_cast<char*>(&message);
+	size_t remaining = sizeof(message);
+	while (remaining > 0)
+	{
+		const ssize_t received = recv(fd_, data, remaining, 0);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		data += received;
+		remaining -= received;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
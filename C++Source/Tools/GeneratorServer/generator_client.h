@@ -0,0 +1,52 @@
+#ifndef		HAS_GENERATOR_CLIENT_H_BEEN_INCLUDED
+#define		HAS_GENERATOR_CLIENT_H_BEEN_INCLUDED
+
+#include "generator_protocol.h"
+
+// ----------------------------------------------------------------------------
+
+// Minimal blocking client for generator_server. Results are read straight out
+// of the server's shared memory ring, the block stays valid until release.
+//
+//	GeneratorClient client;
+//	client.connect();
+//	client.generate(tag, chunk, density);
+//	client.receive(result, &block);
+//	... read BlockVertices(block), BlockIndices(block) ...
+//	client.release(result);
+class GeneratorClient
+{
+public:
+
+	GeneratorClient() {}
+	~GeneratorClient() { disconnect(); }
+
+	bool connect(const char* socketPath = GENERATOR_DEFAULT_SOCKET);
+	void disconnect();
+
+	bool generate(uint64_t tag, const ChunkDesc& chunk, const DensityParams& density);
+	bool cancel(uint64_t tag);
+
+	// Blocks until the next result arrives, block is null unless the status is Done
+	bool receive(GeneratorResult& result, const GeneratorBlock** block);
+	bool release(const GeneratorResult& result);
+
+	// for callers which want to poll() the socket themselves
+	int fd() const { return fd_; }
+
+private:
+
+	GeneratorClient(const GeneratorClient&) = delete;
+	GeneratorClient& operator=(const GeneratorClient&) = delete;
+
+	bool send(const GeneratorMessage& message);
+	bool read(GeneratorMessage& message);
+
+	int				fd_ = -1;
+	const char*		ring_ = nullptr;
+	uint64_t		ringSize_ = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_GENERATOR_CLIENT_H_BEEN_INCLUDED
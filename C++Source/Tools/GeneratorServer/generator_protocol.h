@@ -0,0 +1,116 @@
+#ifndef		HAS_GENERATOR_PROTOCOL_H_BEEN_INCLUDED
+#define		HAS_GENERATOR_PROTOCOL_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include "DualContouringPlugin.h"
+
+// ----------------------------------------------------------------------------
+// Wire format between generator_server and its clients. Messages are fixed
+// size structs sent over a Unix domain socket, mesh data never crosses the
+// socket: the server writes it into a shared memory ring and replies with
+// the offset, clients read it in place and send a release once done.
+// Both ends run on the same machine so structs are sent in native layout.
+
+#define GENERATOR_DEFAULT_SOCKET		"/tmp/dc_generator.sock"
+#define GENERATOR_DEFAULT_SHM			"/dc_generator_ring"
+#define GENERATOR_PROTOCOL_VERSION		1
+
+enum GeneratorMessageType
+{
+	Message_Hello = 1,		// server -> client on connect
+	Message_Generate,		// client -> server
+	Message_Cancel,			// client -> server
+	Message_Release,		// client -> server
+	Message_Result,			// server -> client
+};
+
+// ----------------------------------------------------------------------------
+
+struct GeneratorHello
+{
+	int32_t			version;
+	char			shmName[64];
+	uint64_t		ringSize;
+};
+
+// tag is chosen by the client and echoed back in the matching result
+struct GeneratorGenerate
+{
+	uint64_t		tag;
+	ChunkDesc		chunk;
+	DensityParams	density;
+};
+
+struct GeneratorCancel
+{
+	uint64_t		tag;
+};
+
+struct GeneratorRelease
+{
+	uint64_t		offset;
+};
+
+// status follows JobStatus, the block is only valid when status is Done.
+// The server holds the block until the client releases it. Failed means the
+// chunk was invalid (see IsValidChunkRequest), or its mesh needs size bytes
+// and can never fit in the ring.
+struct GeneratorResult
+{
+	uint64_t		tag;
+	int32_t			status;
+	uint64_t		offset;
+	uint64_t		size;
+};
+
+// Only the member matching type is meaningful. Not a union as DensityParams
+// has default member initialisers.
+struct GeneratorMessage
+{
+	int32_t				type = 0;
+	GeneratorHello		hello;
+	GeneratorGenerate	generate;
+	GeneratorCancel		cancel;
+	GeneratorRelease	release;
+	GeneratorResult		result;
+};
+
+// Value initialised, so everything not set explicitly is zero
+inline GeneratorMessage MakeMessage(const int type)
+{
+	GeneratorMessage message = GeneratorMessage();
+	message.type = type;
+	return message;
+}
+
+// ----------------------------------------------------------------------------
+
+#define GENERATOR_BLOCK_MAGIC			0x4b4c4244	// 'DBLK'
+
+// Layout of a result in the ring, the vertex stream (6 floats per vertex, as
+// ChunkResult) follows the header and the indices follow the vertices.
+// Indices are 16 bit whenever the mesh has fewer than 65536 vertices.
+struct GeneratorBlock
+{
+	uint32_t		magic;
+	int32_t			vertexCount;
+	int32_t			indexCount;
+	int32_t			indexFormat;	// 0 = UInt16, 1 = UInt32
+	float			boundsMin[3];
+	float			boundsMax[3];
+};
+
+inline const float* BlockVertices(const GeneratorBlock* block)
+{
+	return reinterpret_cast<const float*>(block + 1);
+}
+
+inline const void* BlockIndices(const GeneratorBlock* block)
+{
+	return BlockVertices(block) + block->vertexCount * 6;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_GENERATOR_PROTOCOL_H_BEEN_INCLUDED
@@ -0,0 +1,560 @@
+// generator_server : headless chunk generator shared by every process on the machine.
+//
+// Clients connect to a Unix domain socket, queue chunks with Message_Generate and
+// receive Message_Result replies pointing into a shared memory ring which they map
+// read only, see generator_protocol.h and generator_client.h.
+//
+//	generator_server [--socket path] [--shm name] [--ring-mb n] [--threads n]
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "generator_protocol.h"
+#include "ring_allocator.h"
+#include "generator_context.h"
+
+// ----------------------------------------------------------------------------
+
+struct ServerOptions
+{
+	std::string		socketPath = GENERATOR_DEFAULT_SOCKET;
+	std::string		shmName = GENERATOR_DEFAULT_SHM;
+	uint64_t		ringSize = 256ull << 20;
+	int				numThreads = 0;
+};
+
+// Sockets are non-blocking so a client which stops reading can't stall the
+// others, what doesn't fit in the socket waits in outgoing for POLLOUT
+struct Client
+{
+	int					fd = -1;
+	std::vector<char>	incoming;
+	std::vector<char>	outgoing;
+};
+
+// a client this far behind on reading its replies is disconnected
+static const size_t MAX_OUTGOING_BYTES = 1 << 20;
+
+// a job submitted on behalf of a client, waiting to be written into the ring
+struct PendingResult
+{
+	int				fd;
+	uint64_t		tag;
+};
+
+static volatile sig_atomic_t g_running = 1;
+
+// ----------------------------------------------------------------------------
+
+static void OnSignal(int)
+{
+	g_running = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool ParseOptions(int argc, char** argv, ServerOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--socket" && hasValue)
+		{
+			options.socketPath = argv[++i];
+		}
+		else if (arg == "--shm" && hasValue)
+		{
+			options.shmName = argv[++i];
+		}
+		else if (arg == "--ring-mb" && hasValue)
+		{
+			options.ringSize = strtoull(argv[++i], nullptr, 10) << 20;
+		}
+		else if (arg == "--threads" && hasValue)
+		{
+			options.numThreads = atoi(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--socket path] [--shm name] [--ring-mb n] [--threads n]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return options.ringSize > 0 && options.shmName.size() < sizeof(GeneratorHello::shmName);
+}
+
+// ----------------------------------------------------------------------------
+
+// Sends as much of the client's outgoing queue as the socket takes without
+// blocking, false if the connection is gone
+static bool Flush(Client& client)
+{
+	size_t sent = 0;
+	while (sent < client.outgoing.size())
+	{
+		const ssize_t count = send(client.fd, client.outgoing.data() + sent, client.outgoing.size() - sent, MSG_NOSIGNAL);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			break;
+		}
+
+		if (count <= 0)
+		{
+			return false;
+		}
+
+		sent += count;
+	}
+
+	client.outgoing.erase(begin(client.outgoing), begin(client.outgoing) + sent);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Queues the message behind anything not yet sent and flushes what it can,
+// false if the client has gone or isn't reading its replies
+static bool SendMessage(Client& client, const GeneratorMessage& message)
+{
+	const char* data = reinterpret_cast<const char*>(&message);
+	client.outgoing.insert(end(client.outgoing), data, data + sizeof(message));
+	return Flush(client) && client.outgoing.size() <= MAX_OUTGOING_BYTES;
+}
+
+// ----------------------------------------------------------------------------
+
+static uint64_t BlockSize(const ChunkResult& result)
+{
+	const bool use16BitIndices = !result.indices16.empty() || result.indices.empty();
+	const uint64_t indexSize = use16BitIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	return sizeof(GeneratorBlock) + result.vertices.size() * sizeof(float) + result.indices.size() * indexSize;
+}
+
+// ----------------------------------------------------------------------------
+
+static void WriteBlock(const ChunkResult& result, char* destination)
+{
+	GeneratorBlock* block = reinterpret_cast<GeneratorBlock*>(destination);
+	block->magic = GENERATOR_BLOCK_MAGIC;
+	block->vertexCount = result.numVertices();
+	block->indexCount = (int32_t)result.indices.size();
+	block->indexFormat = (!result.indices16.empty() || result.indices.empty()) ? 0 : 1;
+
+	const bool empty = result.bounds.empty();
+	for (int i = 0; i < 3; i++)
+	{
+		block->boundsMin[i] = empty ? 0.f : result.bounds.min[i];
+		block->boundsMax[i] = empty ? 0.f : result.bounds.max[i];
+	}
+
+	// std::copy rather than memcpy, an empty or solid chunk has no vertices
+	// and data() is null then
+	float* vertices = const_cast<float*>(BlockVertices(block));
+	std::copy(begin(result.vertices), end(result.vertices), vertices);
+
+	void* indices = const_cast<void*>(BlockIndices(block));
+	if (block->indexFormat == 0)
+	{
+		std::copy(begin(result.indices16), end(result.indices16), static_cast<uint16_t*>(indices));
+	}
+	else
+	{
+		std::copy(begin(result.indices), end(result.indices), static_cast<int*>(indices));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+class GeneratorServer
+{
+public:
+
+	GeneratorServer(const ServerOptions& options)
+		: options_(options)
+		, context_(options.numThreads)
+		, ring_(options.ringSize)
+	{
+	}
+
+	~GeneratorServer();
+
+	bool open();
+	void run();
+
+private:
+
+	void accept();
+	bool receive(Client& client);
+	void handle(Client& client, const GeneratorMessage& message);
+	void disconnect(int fd);
+	void publishResults();
+
+	ServerOptions						options_;
+	GeneratorContext					context_;
+	RingAllocator						ring_;
+
+	int									listenFD_ = -1;
+	int									shmFD_ = -1;
+	char*								ringMemory_ = nullptr;
+
+	std::unordered_map<int, Client>		clients_;
+	std::unordered_map<int, PendingResult> pending_;	// keyed by job id
+};
+
+// ----------------------------------------------------------------------------
+
+GeneratorServer::~GeneratorServer()
+{
+	for (auto& pair : clients_)
+	{
+		close(pair.first);
+	}
+
+	if (listenFD_ >= 0)
+	{
+		close(listenFD_);
+		unlink(options_.socketPath.c_str());
+	}
+
+	if (ringMemory_)
+	{
+		munmap(ringMemory_, options_.ringSize);
+	}
+
+	if (shmFD_ >= 0)
+	{
+		close(shmFD_);
+		shm_unlink(options_.shmName.c_str());
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorServer::open()
+{
+	// a previous instance may have died without cleaning up
+	shm_unlink(options_.shmName.c_str());
+	shmFD_ = shm_open(options_.shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (shmFD_ < 0 || ftruncate(shmFD_, options_.ringSize) != 0)
+	{
+		fprintf(stderr, "generator_server: can't create shared memory %s: %s\n", options_.shmName.c_str(), strerror(errno));
+		return false;
+	}
+
+	void* memory = mmap(nullptr, options_.ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFD_, 0);
+	if (memory == MAP_FAILED)
+	{
+		fprintf(stderr, "generator_server: can't map shared memory: %s\n", strerror(errno));
+		return false;
+	}
+	ringMemory_ = static_cast<char*>(memory);
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (options_.socketPath.size() >= sizeof(address.sun_path))
+	{
+		fprintf(stderr, "generator_server: socket path too long\n");
+		return false;
+	}
+	strcpy(address.sun_path, options_.socketPath.c_str());
+
+	unlink(options_.socketPath.c_str());
+	listenFD_ = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFD_ < 0 ||
+		bind(listenFD_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(listenFD_, 16) != 0)
+	{
+		fprintf(stderr, "generator_server: can't listen on %s: %s\n", options_.socketPath.c_str(), strerror(errno));
+		return false;
+	}
+
+	printf("generator_server: listening on %s, %llu MB ring %s, %d workers\n", options_.socketPath.c_str(),
+		(unsigned long long)(options_.ringSize >> 20), options_.shmName.c_str(), context_.jobs().numThreads());
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorServer::run()
+{
+	std::vector<pollfd> fds;
+	while (g_running)
+	{
+		fds.clear();
+		fds.push_back({ listenFD_, POLLIN, 0 });
+		for (auto& pair : clients_)
+		{
+			const short events = POLLIN | (pair.second.outgoing.empty() ? 0 : POLLOUT);
+			fds.push_back({ pair.first, events, 0 });
+		}
+
+		// while jobs are outstanding wake up regularly to publish them
+		const int timeoutMs = pending_.empty() ? -1 : 2;
+		const int ready = poll(fds.data(), fds.size(), timeoutMs);
+		if (ready < 0 && errno != EINTR)
+		{
+			fprintf(stderr, "generator_server: poll failed: %s\n", strerror(errno));
+			break;
+		}
+
+		for (size_t i = 1; ready > 0 && i < fds.size(); i++)
+		{
+			if (fds[i].revents == 0)
+			{
+				continue;
+			}
+
+			auto iter = clients_.find(fds[i].fd);
+			if (iter == end(clients_))
+			{
+				continue;
+			}
+
+			const bool writable = (fds[i].revents & POLLOUT) != 0;
+			const bool readable = (fds[i].revents & ~POLLOUT) != 0;
+			if ((writable && !Flush(iter->second)) || (readable && !receive(iter->second)))
+			{
+				disconnect(fds[i].fd);
+			}
+		}
+
+		if (ready > 0 && (fds[0].revents & POLLIN))
+		{
+			accept();
+		}
+
+		publishResults();
+	}
+
+	const GeneratorStats& stats = context_.stats();
+	printf("generator_server: shutting down, %lld chunks generated, %lld cancelled\n",
+		stats.chunksGenerated.load(), stats.chunksCancelled.load());
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorServer::accept()
+{
+	const int fd = ::accept(listenFD_, nullptr, nullptr);
+	if (fd < 0)
+	{
+		return;
+	}
+
+	const int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)
+	{
+		close(fd);
+		return;
+	}
+
+	GeneratorMessage hello = MakeMessage(Message_Hello);
+	hello.hello.version = GENERATOR_PROTOCOL_VERSION;
+	strcpy(hello.hello.shmName, options_.shmName.c_str());
+	hello.hello.ringSize = options_.ringSize;
+
+	Client& client = clients_[fd];
+	client.fd = fd;
+	if (!SendMessage(client, hello))
+	{
+		clients_.erase(fd);
+		close(fd);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool GeneratorServer::receive(Client& client)
+{
+	char buffer[4096];
+	const ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+	if (received <= 0)
+	{
+		return received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+
+	client.incoming.insert(end(client.incoming), buffer, buffer + received);
+
+	size_t consumed = 0;
+	while (client.incoming.size() - consumed >= sizeof(GeneratorMessage))
+	{
+		GeneratorMessage message;
+		memcpy(&message, client.incoming.data() + consumed, sizeof(message));
+		consumed += sizeof(message);
+
+		handle(client, message);
+	}
+
+	client.incoming.erase(begin(client.incoming), begin(client.incoming) + consumed);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorServer::handle(Client& client, const GeneratorMessage& message)
+{
+	switch (message.type)
+	{
+	case Message_Generate:
+	{
+		ChunkRequest request = RequestFromDesc(message.generate.chunk);
+		request.density = message.generate.density;
+
+		const int job = context_.jobs().submit(request);
+		pending_[job] = { client.fd, message.generate.tag };
+		break;
+	}
+
+	case Message_Cancel:
+		for (auto& pair : pending_)
+		{
+			if (pair.second.fd == client.fd && pair.second.tag == message.cancel.tag)
+			{
+				context_.jobs().cancel(pair.first);
+			}
+		}
+		break;
+
+	case Message_Release:
+		ring_.release(message.release.offset, client.fd);
+		break;
+
+	default:
+		fprintf(stderr, "generator_server: unknown message %d\n", message.type);
+		break;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorServer::disconnect(int fd)
+{
+	for (auto iter = begin(pending_); iter != end(pending_);)
+	{
+		if (iter->second.fd == fd)
+		{
+			context_.jobs().cancel(iter->first);
+			context_.jobs().release(iter->first);
+			iter = pending_.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	ring_.releaseOwner(fd);
+	clients_.erase(fd);
+	close(fd);
+}
+
+// ----------------------------------------------------------------------------
+
+void GeneratorServer::publishResults()
+{
+	std::vector<int> disconnected;
+
+	for (auto iter = begin(pending_); iter != end(pending_);)
+	{
+		const int job = iter->first;
+		const PendingResult& pending = iter->second;
+
+		GeneratorMessage reply = MakeMessage(Message_Result);
+		reply.result.tag = pending.tag;
+		reply.result.status = context_.jobs().poll(job);
+
+		if (reply.result.status == JobStatus_Pending || reply.result.status == JobStatus_Running)
+		{
+			++iter;
+			continue;
+		}
+
+		if (reply.result.status == JobStatus_Done)
+		{
+			const ChunkResult* result = context_.jobs().result(job);
+			reply.result.size = BlockSize(*result);
+
+			if (reply.result.size > ring_.capacity())
+			{
+				// waiting wouldn't help, nothing released will make room
+				fprintf(stderr, "generator_server: result too large, %llu bytes for a %llu byte ring\n",
+					(unsigned long long)reply.result.size, (unsigned long long)ring_.capacity());
+				reply.result.status = JobStatus_Failed;
+			}
+			else if (!ring_.allocate(reply.result.size, pending.fd, reply.result.offset))
+			{
+				// the ring is full, hold on to the job until a client releases something
+				++iter;
+				continue;
+			}
+			else
+			{
+				WriteBlock(*result, ringMemory_ + reply.result.offset);
+			}
+		}
+
+		const auto client = clients_.find(pending.fd);
+		if (client != end(clients_) && !SendMessage(client->second, reply))
+		{
+			disconnected.push_back(pending.fd);
+		}
+
+		context_.jobs().release(job);
+		iter = pending_.erase(iter);
+	}
+
+	for (const int fd : disconnected)
+	{
+		if (clients_.count(fd))
+		{
+			disconnect(fd);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+	ServerOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		return 1;
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+	signal(SIGPIPE, SIG_IGN);
+
+	GeneratorServer server(options);
+	if (!server.open())
+	{
+		return 1;
+	}
+
+	server.run();
+	return 0;
+}
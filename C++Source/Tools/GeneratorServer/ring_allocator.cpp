@@ -0,0 +1,113 @@
+#include "ring_allocator.h"
+
+// ----------------------------------------------------------------------------
+
+static const int PADDING_OWNER = -1;
+
+// ----------------------------------------------------------------------------
+
+RingAllocator::RingAllocator(uint64_t capacity)
+	: capacity_(capacity)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+bool RingAllocator::allocate(uint64_t size, int owner, uint64_t& offset)
+{
+	// keep every range 16 byte aligned so the float streams can be read in place
+	size = (size + 15) & ~(uint64_t)15;
+	if (size == 0 || size > capacity_)
+	{
+		return false;
+	}
+
+	if (ranges_.empty())
+	{
+		head_ = 0;
+	}
+	else
+	{
+		const uint64_t tail = ranges_.front().offset;
+		if (head_ > tail)
+		{
+			// free space is [head, capacity) then [0, tail)
+			if (size > capacity_ - head_)
+			{
+				if (size > tail)
+				{
+					return false;
+				}
+
+				// the end of the buffer is too small, pad it out and wrap
+				if (head_ < capacity_)
+				{
+					ranges_.push_back({ head_, capacity_ - head_, PADDING_OWNER, true });
+					used_ += capacity_ - head_;
+				}
+				head_ = 0;
+			}
+		}
+		else if (size > tail - head_)
+		{
+			// wrapped, free space is [head, tail), head == tail means full
+			return false;
+		}
+	}
+
+	offset = head_;
+	ranges_.push_back({ head_, size, owner, false });
+	head_ += size;
+	used_ += size;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool RingAllocator::release(uint64_t offset, int owner)
+{
+	for (auto& range : ranges_)
+	{
+		if (range.offset == offset && range.owner == owner && !range.released)
+		{
+			range.released = true;
+			reclaim();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ----------------------------------------------------------------------------
+
+void RingAllocator::releaseOwner(int owner)
+{
+	for (auto& range : ranges_)
+	{
+		if (range.owner == owner)
+		{
+			range.released = true;
+		}
+	}
+
+	reclaim();
+}
+
+// ----------------------------------------------------------------------------
+
+void RingAllocator::reclaim()
+{
+	while (!ranges_.empty() && ranges_.front().released)
+	{
+		used_ -= ranges_.front().size;
+		ranges_.pop_front();
+	}
+
+	if (ranges_.empty())
+	{
+		head_ = 0;
+	}
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,49 @@
+#ifndef		HAS_RING_ALLOCATOR_H_BEEN_INCLUDED
+#define		HAS_RING_ALLOCATOR_H_BEEN_INCLUDED
+
+#include <deque>
+#include <stdint.h>
+
+// ----------------------------------------------------------------------------
+
+// Hands out contiguous ranges of a fixed size buffer in FIFO order. Ranges
+// may be released in any order, space is only reclaimed once everything
+// allocated before it has been released too. Not thread safe.
+class RingAllocator
+{
+public:
+
+	explicit RingAllocator(uint64_t capacity);
+
+	// Returns false when there isn't room, the caller should try again after
+	// something has been released
+	bool allocate(uint64_t size, int owner, uint64_t& offset);
+
+	// Only the owner passed to allocate can release a range
+	bool release(uint64_t offset, int owner);
+	void releaseOwner(int owner);
+
+	uint64_t capacity() const { return capacity_; }
+	uint64_t used() const { return used_; }
+
+private:
+
+	struct Range
+	{
+		uint64_t	offset;
+		uint64_t	size;
+		int			owner;
+		bool		released;
+	};
+
+	void reclaim();
+
+	std::deque<Range>	ranges_;
+	uint64_t			capacity_;
+	uint64_t			head_ = 0;
+	uint64_t			used_ = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_RING_ALLOCATOR_H_BEEN_INCLUDED
@@ -0,0 +1,164 @@
+#include "brick_store.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+
+static const uint64_t PAGE_BYTES = 4096;
+
+// ----------------------------------------------------------------------------
+
+static uint64_t RoundUpToPage(const uint64_t bytes)
+{
+	return (bytes + PAGE_BYTES - 1) & ~(PAGE_BYTES - 1);
+}
+
+// ----------------------------------------------------------------------------
+
+BrickStore::~BrickStore()
+{
+	if (data_)
+	{
+		msync(data_, mappedSize_, MS_SYNC);
+		munmap(data_, mappedSize_);
+	}
+
+	if (file_ >= 0)
+	{
+		close(file_);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+std::unique_ptr<BrickStore> BrickStore::open(const std::string& path, const BrickFileHeader& desc)
+{
+	BrickFileHeader header = desc;
+	header.magic = BRICK_FILE_MAGIC;
+	header.version = BRICK_FILE_VERSION;
+	for (int i = 0; i < 3; i++)
+	{
+		header.numBricks[i] = (header.numCorners[i] + BRICK_SIZE - 1) / BRICK_SIZE;
+	}
+
+	const uint64_t numBricks = (uint64_t)header.numBricks[0] * header.numBricks[1] * header.numBricks[2];
+	const uint64_t bricksOffset = RoundUpToPage(sizeof(BrickFileHeader) + numBricks);
+	const uint64_t fileSize = bricksOffset + numBricks * brickBytes();
+
+	std::unique_ptr<BrickStore> store(new BrickStore);
+	store->file_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (store->file_ < 0)
+	{
+		return nullptr;
+	}
+
+	// anything which doesn't describe this lattice starts over, the bricks
+	// nobody samples stay holes in a sparse file
+	BrickFileHeader existing;
+	struct stat info;
+	const bool reuse = fstat(store->file_, &info) == 0 && (uint64_t)info.st_size == fileSize &&
+		pread(store->file_, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing) &&
+		memcmp(&existing, &header, sizeof(header)) == 0;
+
+	if (!reuse)
+	{
+		if (ftruncate(store->file_, 0) != 0 || ftruncate(store->file_, (off_t)fileSize) != 0 ||
+			pwrite(store->file_, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+		{
+			return nullptr;
+		}
+	}
+
+	void* view = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, store->file_, 0);
+	if (view == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	store->data_ = static_cast<uint8_t*>(view);
+	store->mappedSize_ = fileSize;
+	store->bricksOffset_ = bricksOffset;
+	store->numBricks_ = glm::ivec3(header.numBricks[0], header.numBricks[1], header.numBricks[2]);
+	store->numCorners_ = glm::ivec3(header.numCorners[0], header.numCorners[1], header.numCorners[2]);
+	store->origin_ = glm::ivec3(header.origin[0], header.origin[1], header.origin[2]);
+	store->voxelSize_ = header.voxelSize;
+
+	store->resident_.reset(new std::atomic<uint8_t>[numBricks]);
+	for (uint64_t i = 0; i < numBricks; i++)
+	{
+		store->resident_[i] = 0;
+	}
+
+	return store;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t BrickStore::brickIndex(const glm::ivec3& brick) const
+{
+	return ((size_t)brick.x * numBricks_.y + brick.y) * numBricks_.z + brick.z;
+}
+
+// ----------------------------------------------------------------------------
+
+BrickSign BrickStore::sign(const glm::ivec3& brick) const
+{
+	return (BrickSign)data_[sizeof(BrickFileHeader) + brickIndex(brick)];
+}
+
+// ----------------------------------------------------------------------------
+
+void BrickStore::setSign(const glm::ivec3& brick, const BrickSign sign)
+{
+	data_[sizeof(BrickFileHeader) + brickIndex(brick)] = (uint8_t)sign;
+}
+
+// ----------------------------------------------------------------------------
+
+float* BrickStore::brick(const glm::ivec3& brick)
+{
+	const size_t index = brickIndex(brick);
+	numTouches_++;
+
+	if (resident_[index].exchange(1) == 0)
+	{
+		const int resident = ++numResident_;
+		int peak = peakResident_.load();
+		while (resident > peak && !peakResident_.compare_exchange_weak(peak, resident))
+		{
+		}
+	}
+
+	return reinterpret_cast<float*>(data_ + bricksOffset_ + index * brickBytes());
+}
+
+// ----------------------------------------------------------------------------
+
+void BrickStore::release(const glm::ivec3& brick)
+{
+	const size_t index = brickIndex(brick);
+	if (resident_[index].exchange(0) == 0)
+	{
+		return;
+	}
+
+	// MADV_DONTNEED on a shared file mapping only unmaps the pages, dirty ones
+	// stay in the page cache until the kernel writes them back
+	uint8_t* pages = data_ + bricksOffset_ + index * brickBytes();
+	msync(pages, brickBytes(), MS_ASYNC);
+	madvise(pages, brickBytes(), MADV_DONTNEED);
+	numResident_--;
+}
+
+// ----------------------------------------------------------------------------
+
+bool BrickStore::sync()
+{
+	return msync(data_, mappedSize_, MS_SYNC) == 0;
+}
+
+// ----------------------------------------------------------------------------
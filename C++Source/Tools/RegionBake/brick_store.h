@@ -0,0 +1,119 @@
+#ifndef		HAS_BRICK_STORE_H_BEEN_INCLUDED
+#define		HAS_BRICK_STORE_H_BEEN_INCLUDED
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "glm/glm.hpp"
+
+// ----------------------------------------------------------------------------
+
+#define BRICK_FILE_MAGIC		0x4b524244	// 'DBRK'
+#define BRICK_FILE_VERSION		1
+
+// The density lattice is split into bricks of BRICK_SIZE^3 corners, each brick
+// a whole number of pages so releasing one never drops part of another
+#define BRICK_SIZE				16
+
+// Written at the start of the file, followed by one BrickSign per brick and
+// then (from the next page) the bricks' samples, x major as in fast_dc
+struct BrickFileHeader
+{
+	uint32_t		magic;
+	uint32_t		version;
+	uint64_t		paramsHash;		// MakeChunkArchiveKey's, over the density
+	int32_t			origin[3];		// world position of corner 0,0,0
+	int32_t			voxelSize;
+	int32_t			numCorners[3];
+	int32_t			numBricks[3];
+};
+
+// What a brick holds, kept apart from the samples so empty and solid parts of
+// the volume are recognised without reading them back
+enum BrickSign
+{
+	BrickSign_Unsampled = 0,
+	BrickSign_Outside = 1,		// every corner >= 0
+	BrickSign_Inside = 2,		// every corner < 0
+	BrickSign_Mixed = 3,
+};
+
+// ----------------------------------------------------------------------------
+
+// A density lattice larger than memory, in a file mapped shared so the kernel
+// pages bricks in and writes them back as needed. Bricks sampled by an earlier
+// run of the same bake are kept, the file is only reset if the header doesn't
+// match (different region, LOD or density).
+//
+// Callers say when they're done with a brick and its pages are dropped from
+// the process straight away, resident memory is then the bricks in use rather
+// than everything touched so far. Different bricks can be written and released
+// from different threads.
+class BrickStore
+{
+public:
+
+	~BrickStore();
+
+	// numCorners is the lattice size, voxels + 1 along each axis. Null if the
+	// file can't be created or mapped.
+	static std::unique_ptr<BrickStore> open(const std::string& path, const BrickFileHeader& header);
+
+	const glm::ivec3& numBricks() const { return numBricks_; }
+	const glm::ivec3& numCorners() const { return numCorners_; }
+	const glm::ivec3& origin() const { return origin_; }
+	int voxelSize() const { return voxelSize_; }
+
+	BrickSign sign(const glm::ivec3& brick) const;
+	void setSign(const glm::ivec3& brick, const BrickSign sign);
+
+	// BRICK_SIZE^3 samples, valid until the store is destroyed. Every call
+	// counts as a touch, see numTouches.
+	float* brick(const glm::ivec3& brick);
+
+	// Writes the brick back (asynchronously) and drops its pages from the
+	// process, the next touch faults them in from the file again
+	void release(const glm::ivec3& brick);
+
+	// Flushes everything to the file, e.g. once every brick has been sampled
+	bool sync();
+
+	long long numTouches() const { return numTouches_.load(); }
+
+	// bricks touched and not released yet, and the most there have been at once
+	int numResident() const { return numResident_.load(); }
+	int peakResident() const { return peakResident_.load(); }
+
+	static size_t brickBytes() { return BRICK_SIZE * BRICK_SIZE * BRICK_SIZE * sizeof(float); }
+
+private:
+
+	BrickStore() = default;
+	BrickStore(const BrickStore&) = delete;
+	BrickStore& operator=(const BrickStore&) = delete;
+
+	size_t brickIndex(const glm::ivec3& brick) const;
+
+	int						file_ = -1;
+	uint8_t*				data_ = nullptr;
+	uint64_t				mappedSize_ = 0;
+	uint64_t				bricksOffset_ = 0;
+
+	glm::ivec3				numBricks_;
+	glm::ivec3				numCorners_;
+	glm::ivec3				origin_;
+	int						voxelSize_ = 1;
+
+	// whether each brick is paged in, 0 or 1 per brick
+	std::unique_ptr<std::atomic<uint8_t>[]> resident_;
+	std::atomic<long long>	numTouches_ { 0 };
+	std::atomic<int>		numResident_ { 0 };
+	std::atomic<int>		peakResident_ { 0 };
+};
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_BRICK_STORE_H_BEEN_INCLUDED
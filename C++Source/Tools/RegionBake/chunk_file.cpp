@@ -0,0 +1,110 @@
+#include "chunk_file.h"
+
+#include <stdio.h>
+
+#include "chunk_archive.h"
+
+// ----------------------------------------------------------------------------
+
+bool WriteChunkFile(const std::string& path, const ChunkRequest& request, const ChunkResult& result)
+{
+	ChunkFileHeader header;
+	header.magic = CHUNK_FILE_MAGIC;
+	header.version = CHUNK_FILE_VERSION;
+	header.paramsHash = MakeChunkArchiveKey(request).paramsHash;
+	header.position[0] = request.position.x;
+	header.position[1] = request.position.y;
+	header.position[2] = request.position.z;
+	header.size = request.size;
+	header.lod = request.lod;
+	header.pipeline = request.pipeline;
+	header.vertexCount = result.numVertices();
+	header.indexCount = (int32_t)result.indices.size();
+
+	const bool empty = result.bounds.empty();
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = empty ? 0.f : result.bounds.min[i];
+		header.boundsMax[i] = empty ? 0.f : result.bounds.max[i];
+	}
+
+	const std::string temporaryPath = path + ".tmp";
+	FILE* file = fopen(temporaryPath.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(result.vertices.data(), sizeof(float), result.vertices.size(), file) == result.vertices.size();
+	ok = ok && fwrite(result.indices.data(), sizeof(int), result.indices.size(), file) == result.indices.size();
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok || rename(temporaryPath.c_str(), path.c_str()) != 0)
+	{
+		remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ReadChunkFile(const std::string& path, ChunkRequest& request, ChunkResult& result)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	ChunkFileHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == CHUNK_FILE_MAGIC && header.version == CHUNK_FILE_VERSION &&
+		header.vertexCount >= 0 && header.indexCount >= 0;
+
+	if (ok)
+	{
+		request.position = glm::ivec3(header.position[0], header.position[1], header.position[2]);
+		request.size = header.size;
+		request.lod = header.lod;
+		request.pipeline = header.pipeline;
+
+		result = ChunkResult();
+		result.vertices.resize(header.vertexCount * 6);
+		result.indices.resize(header.indexCount);
+		ok = fread(result.vertices.data(), sizeof(float), result.vertices.size(), file) == result.vertices.size() &&
+			fread(result.indices.data(), sizeof(int), result.indices.size(), file) == result.indices.size();
+	}
+
+	fclose(file);
+	if (ok)
+	{
+		BuildUnityMeshLayout(result);
+	}
+
+	return ok;
+}
+
+// ----------------------------------------------------------------------------
+
+bool ChunkFileMatches(const std::string& path, const ChunkRequest& request)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	ChunkFileHeader header;
+	const bool ok = fread(&header, sizeof(header), 1, file) == 1;
+	fclose(file);
+
+	return ok && header.magic == CHUNK_FILE_MAGIC && header.version == CHUNK_FILE_VERSION &&
+		header.paramsHash == MakeChunkArchiveKey(request).paramsHash &&
+		header.position[0] == request.position.x && header.position[1] == request.position.y && header.position[2] == request.position.z &&
+		header.size == request.size && header.lod == request.lod && header.pipeline == request.pipeline;
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,47 @@
+#ifndef		HAS_CHUNK_FILE_H_BEEN_INCLUDED
+#define		HAS_CHUNK_FILE_H_BEEN_INCLUDED
+
+#include <stdint.h>
+#include <string>
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+#define CHUNK_FILE_MAGIC		0x4b434344	// 'DCCK'
+#define CHUNK_FILE_VERSION		2
+
+// Followed by vertexCount * 6 floats (ChunkResult::vertices) and indexCount
+// 32 bit indices, all little endian. paramsHash is the chunk archive's (see
+// MakeChunkArchiveKey), it covers the density parameters and pipeline settings.
+struct ChunkFileHeader
+{
+	uint32_t		magic;
+	uint32_t		version;
+	uint64_t		paramsHash;
+	int32_t			position[3];
+	int32_t			size;
+	int32_t			lod;
+	int32_t			pipeline;
+	int32_t			vertexCount;
+	int32_t			indexCount;
+	float			boundsMin[3];
+	float			boundsMax[3];
+};
+
+// ----------------------------------------------------------------------------
+
+// Written to path.tmp then renamed, so a partially written chunk is never
+// mistaken for a finished one
+bool WriteChunkFile(const std::string& path, const ChunkRequest& request, const ChunkResult& result);
+
+// Reads the mesh back, request only has the position/size/lod/pipeline set
+bool ReadChunkFile(const std::string& path, ChunkRequest& request, ChunkResult& result);
+
+// True if path holds a chunk of the current version which was generated from
+// the same inputs as request, i.e. baking request again would write the same mesh
+bool ChunkFileMatches(const std::string& path, const ChunkRequest& request);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_CHUNK_FILE_H_BEEN_INCLUDED
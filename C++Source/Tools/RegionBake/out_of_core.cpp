@@ -0,0 +1,510 @@
+#include "out_of_core.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "brick_store.h"
+#include "chunk_archive.h"
+#include "fast_dc.h"
+
+// ----------------------------------------------------------------------------
+
+// The 4 voxels around an edge along each axis, relative to the edge's min
+// corner (subtracted), in the order fast_dc winds its quads
+static const glm::ivec3 EDGE_VOXEL_OFFSETS[3][4] =
+{
+	{ glm::ivec3(0), glm::ivec3(0, 0, 1), glm::ivec3(0, 1, 0), glm::ivec3(0, 1, 1) },
+	{ glm::ivec3(0), glm::ivec3(1, 0, 0), glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 1) },
+	{ glm::ivec3(0), glm::ivec3(0, 1, 0), glm::ivec3(1, 0, 0), glm::ivec3(1, 1, 0) },
+};
+
+// A voxel's 12 edges by axis, relative to its min corner (added), in the order
+// fast_dc gathers them for the QEF so the vertices come out the same
+static const glm::ivec3 VOXEL_EDGE_OFFSETS[3][4] =
+{
+	{ glm::ivec3(0), glm::ivec3(0, 0, 1), glm::ivec3(0, 1, 0), glm::ivec3(0, 1, 1) },
+	{ glm::ivec3(0), glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 0), glm::ivec3(1, 0, 1) },
+	{ glm::ivec3(0), glm::ivec3(0, 1, 0), glm::ivec3(1, 0, 0), glm::ivec3(1, 1, 0) },
+};
+
+// stands in for the samples of a brick known to be all one sign, only the
+// sign of a sample is used once the lattice is built
+static const float OUTSIDE_SAMPLE = 1.f;
+static const float INSIDE_SAMPLE = -1.f;
+
+// ----------------------------------------------------------------------------
+
+static bool Interrupted(const OutOfCoreOptions& options)
+{
+	return options.interrupted && *options.interrupted;
+}
+
+// ----------------------------------------------------------------------------
+
+static void UpdateMax(std::atomic<long long>& value, const long long candidate)
+{
+	long long current = value.load();
+	while (candidate > current && !value.compare_exchange_weak(current, candidate))
+	{
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Runs work(0 .. count-1) on numThreads threads, in order of index as far as
+// the threads allow, stopping early if the bake is interrupted
+static void RunWorkers(const OutOfCoreOptions& options, const int count, const std::function<void(int)>& work)
+{
+	std::atomic<int> next(0);
+	const auto loop = [&]()
+	{
+		for (int i = next++; i < count && !Interrupted(options); i = next++)
+		{
+			work(i);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < options.numThreads; i++)
+	{
+		threads.emplace_back(loop);
+	}
+
+	loop();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// The lattice corner at the tile's min corner
+static glm::ivec3 TileMinCorner(const BrickStore& store, const ChunkRequest& tile)
+{
+	return (tile.position - glm::ivec3(tile.size / 2) - store.origin()) / store.voxelSize();
+}
+
+// ----------------------------------------------------------------------------
+
+// The bricks under a tile's window, [first, last]. The window is the tile's
+// corners plus one layer either side, the voxels just below its min faces are
+// solved as well so it can close the gaps with the tiles there.
+static void WindowBricks(const BrickStore& store, const glm::ivec3& tileMin, const int tileVoxels, glm::ivec3& first, glm::ivec3& last)
+{
+	const glm::ivec3 lo = glm::max(tileMin - glm::ivec3(1), glm::ivec3(0));
+	const glm::ivec3 hi = glm::min(tileMin + glm::ivec3(tileVoxels), store.numCorners() - glm::ivec3(1));
+	first = lo / BRICK_SIZE;
+	last = hi / BRICK_SIZE;
+}
+
+// ----------------------------------------------------------------------------
+
+static size_t BrickIndex(const BrickStore& store, const glm::ivec3& brick)
+{
+	const glm::ivec3& numBricks = store.numBricks();
+	return ((size_t)brick.x * numBricks.y + brick.y) * numBricks.z + brick.z;
+}
+
+// ----------------------------------------------------------------------------
+
+// Pass 1 for one brick. Bricks the density's bounds put entirely on one side
+// of the surface are recorded without sampling and never read back.
+static BrickSign SampleBrick(BrickStore& store, const DensityParams& density, const glm::ivec3& brick)
+{
+	const glm::ivec3 first = brick * BRICK_SIZE;
+	const glm::ivec3 last = glm::min(first + glm::ivec3(BRICK_SIZE), store.numCorners()) - glm::ivec3(1);
+
+	const glm::vec3 boxMin(store.origin() + first * store.voxelSize());
+	const glm::vec3 boxMax(store.origin() + last * store.voxelSize());
+	const DensityRange range = Density_Range(density, boxMin, boxMax);
+	if (range.min >= 0.f)
+	{
+		return BrickSign_Outside;
+	}
+	if (range.max < 0.f)
+	{
+		return BrickSign_Inside;
+	}
+
+	float* samples = store.brick(brick);
+	bool outside = false, inside = false;
+	for (int x = first.x; x <= last.x; x++)
+	for (int y = first.y; y <= last.y; y++)
+	{
+		float* column = &samples[((x - first.x) * BRICK_SIZE + (y - first.y)) * BRICK_SIZE];
+		for (int z = first.z; z <= last.z; z++)
+		{
+			const glm::ivec3 corner(x, y, z);
+			const float d = Density_Func(density, glm::vec3(store.origin() + corner * store.voxelSize()));
+			column[z - first.z] = d;
+			outside |= d >= 0.f;
+			inside |= d < 0.f;
+		}
+	}
+
+	store.release(brick);
+	return outside && inside ? BrickSign_Mixed : outside ? BrickSign_Outside : BrickSign_Inside;
+}
+
+// ----------------------------------------------------------------------------
+
+// Copies the tile's window of corners out of the bricks, x major. Corners
+// outside the lattice are NaN.
+static void CopyWindow(BrickStore& store, const glm::ivec3& tileMin, const int tileVoxels, std::vector<float>& window)
+{
+	const int size = tileVoxels + 2;
+	const glm::ivec3 windowMin = tileMin - glm::ivec3(1);
+	window.assign((size_t)size * size * size, NAN);
+
+	glm::ivec3 first, last;
+	WindowBricks(store, tileMin, tileVoxels, first, last);
+
+	for (int bx = first.x; bx <= last.x; bx++)
+	for (int by = first.y; by <= last.y; by++)
+	for (int bz = first.z; bz <= last.z; bz++)
+	{
+		const glm::ivec3 brick(bx, by, bz);
+		const glm::ivec3 brickMin = brick * BRICK_SIZE;
+		const glm::ivec3 lo = glm::max(glm::max(brickMin, windowMin), glm::ivec3(0));
+		const glm::ivec3 hi = glm::min(glm::min(brickMin + glm::ivec3(BRICK_SIZE), windowMin + glm::ivec3(size)), store.numCorners());
+
+		const BrickSign sign = store.sign(brick);
+		const float* samples = sign == BrickSign_Mixed ? store.brick(brick) : nullptr;
+
+		for (int x = lo.x; x < hi.x; x++)
+		for (int y = lo.y; y < hi.y; y++)
+		{
+			float* to = &window[((size_t)(x - windowMin.x) * size + (y - windowMin.y)) * size + (lo.z - windowMin.z)];
+			if (samples)
+			{
+				const float* from = &samples[((x - brickMin.x) * BRICK_SIZE + (y - brickMin.y)) * BRICK_SIZE + (lo.z - brickMin.z)];
+				memcpy(to, from, (hi.z - lo.z) * sizeof(float));
+			}
+			else
+			{
+				std::fill(to, to + (hi.z - lo.z), sign == BrickSign_Inside ? INSIDE_SAMPLE : OUTSIDE_SAMPLE);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Pass 2 for one tile once its window has been copied out, the fast_dc
+// Hermite, QEF and contour stages over the window. Returns the bytes used.
+static size_t ContourWindow(const DensityField& density, const glm::ivec3& windowOrigin, const int voxelSize, const int tileVoxels,
+	const std::vector<float>& window, ChunkResult& result)
+{
+	const int size = tileVoxels + 2;
+	const auto cornerIndex = [size](const glm::ivec3& c) { return ((size_t)c.x * size + c.y) * size + c.z; };
+	const auto cornerPosition = [&](const glm::ivec3& c) { return glm::vec4(glm::vec3(windowOrigin + c * voxelSize), 1.f); };
+
+	// Hermite data on every edge of the window with a sign change, by corner
+	// and axis, -1 elsewhere
+	std::vector<int> edges(window.size() * 3, -1);
+	std::vector<glm::vec4> positions, normals;
+	for (int x = 0; x < size; x++)
+	for (int y = 0; y < size; y++)
+	for (int z = 0; z < size; z++)
+	{
+		const glm::ivec3 p(x, y, z);
+		const float pDensity = window[cornerIndex(p)];
+		if (isnan(pDensity))
+		{
+			continue;
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			glm::ivec3 q = p;
+			if (++q[axis] == size)
+			{
+				continue;
+			}
+
+			const float qDensity = window[cornerIndex(q)];
+			if (isnan(qDensity) || (pDensity >= 0.f) == (qDensity >= 0.f))
+			{
+				continue;
+			}
+
+			glm::vec4 position, normal;
+			FindEdgeHermite(density, cornerPosition(p), cornerPosition(q), position, normal);
+			edges[cornerIndex(p) * 3 + axis] = (int)positions.size();
+			positions.push_back(position);
+			normals.push_back(normal);
+		}
+	}
+
+	// voxels [0, tileVoxels] of the window, solved the first time a quad
+	// needs them: -2 until then, -1 if the voxel has no vertex
+	const int numVoxels = tileVoxels + 1;
+	std::vector<int> vertices((size_t)numVoxels * numVoxels * numVoxels, -2);
+	const auto vertexOf = [&](const glm::ivec3& v)
+	{
+		int& index = vertices[((size_t)v.x * numVoxels + v.y) * numVoxels + v.z];
+		if (index != -2)
+		{
+			return index;
+		}
+
+		// as in fast_dc a voxel only exists where all its corners do, i.e.
+		// inside the region
+		index = -1;
+		for (int i = 0; i < 8; i++)
+		{
+			if (isnan(window[cornerIndex(v + glm::ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1))]))
+			{
+				return index;
+			}
+		}
+
+		glm::vec4 p[12], n[12];
+		int count = 0;
+		for (int axis = 0; axis < 3; axis++)
+		for (int i = 0; i < 4; i++)
+		{
+			const int edge = edges[cornerIndex(v + VOXEL_EDGE_OFFSETS[axis][i]) * 3 + axis];
+			if (edge >= 0)
+			{
+				p[count] = positions[edge];
+				n[count] = normals[edge];
+				count++;
+			}
+		}
+
+		if (count > 1)
+		{
+			glm::vec4 normal;
+			const glm::vec4 position = SolveVoxelVertex(p, n, count, normal);
+			index = result.numVertices();
+			result.vertices.insert(end(result.vertices), { position.x, position.y, position.z, normal.x, normal.y, normal.z });
+		}
+
+		return index;
+	};
+
+	// a quad for every edge the tile owns, i.e. whose min corner is in the
+	// tile rather than the layer around it
+	for (int x = 1; x <= tileVoxels; x++)
+	for (int y = 1; y <= tileVoxels; y++)
+	for (int z = 1; z <= tileVoxels; z++)
+	{
+		const glm::ivec3 c(x, y, z);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (edges[cornerIndex(c) * 3 + axis] < 0)
+			{
+				continue;
+			}
+
+			int quad[4];
+			int numFound = 0;
+			for (; numFound < 4; numFound++)
+			{
+				quad[numFound] = vertexOf(c - EDGE_VOXEL_OFFSETS[axis][numFound]);
+				if (quad[numFound] < 0)
+				{
+					break;
+				}
+			}
+
+			if (numFound < 4)
+			{
+				continue;
+			}
+
+			if (window[cornerIndex(c)] >= 0.f)
+			{
+				result.indices.insert(end(result.indices), { quad[0], quad[1], quad[3], quad[0], quad[3], quad[2] });
+			}
+			else
+			{
+				result.indices.insert(end(result.indices), { quad[0], quad[3], quad[1], quad[0], quad[2], quad[3] });
+			}
+		}
+	}
+
+	return window.size() * sizeof(float) + edges.size() * sizeof(int) + vertices.size() * sizeof(int) +
+		positions.size() * 2 * sizeof(glm::vec4) + result.memoryBytes();
+}
+
+// ----------------------------------------------------------------------------
+
+bool BakeOutOfCore(const OutOfCoreOptions& options, const OutOfCoreWriter& write, OutOfCoreStats& stats)
+{
+	stats = OutOfCoreStats();
+
+	const int voxelSize = 1 << options.lod;
+	const int tileVoxels = options.chunkSize / voxelSize;
+	const glm::ivec3 numVoxels = (options.lastChunk - options.firstChunk + glm::ivec3(1)) * tileVoxels;
+
+	// keyed like the archive so a brick file left by a bake of a different
+	// volume is started over rather than reused
+	ChunkRequest volume;
+	volume.position = options.firstChunk * options.chunkSize;
+	volume.size = options.chunkSize;
+	volume.lod = options.lod;
+	volume.density = options.density;
+
+	BrickFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.paramsHash = MakeChunkArchiveKey(volume).paramsHash;
+	for (int i = 0; i < 3; i++)
+	{
+		header.origin[i] = options.firstChunk[i] * options.chunkSize - options.chunkSize / 2;
+		header.numCorners[i] = numVoxels[i] + 1;
+	}
+	header.voxelSize = voxelSize;
+
+	auto store = BrickStore::open(options.bricksPath, header);
+	if (!store)
+	{
+		return false;
+	}
+
+	// tiles in file order, so the sweep walks the bricks in the order they're laid out
+	std::vector<ChunkRequest> tiles = options.tiles;
+	std::sort(begin(tiles), end(tiles), [](const ChunkRequest& a, const ChunkRequest& b)
+	{
+		const glm::ivec3& p = a.position;
+		const glm::ivec3& q = b.position;
+		return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+	});
+
+	// how many pending tiles overlap each brick, a brick is released when the
+	// last of them has copied it out
+	const glm::ivec3& numBricks = store->numBricks();
+	const size_t totalBricks = (size_t)numBricks.x * numBricks.y * numBricks.z;
+	std::unique_ptr<std::atomic<int>[]> remaining(new std::atomic<int>[totalBricks]);
+	for (size_t i = 0; i < totalBricks; i++)
+	{
+		remaining[i] = 0;
+	}
+
+	for (const ChunkRequest& tile : tiles)
+	{
+		glm::ivec3 first, last;
+		WindowBricks(*store, TileMinCorner(*store, tile), tileVoxels, first, last);
+		for (int x = first.x; x <= last.x; x++)
+		for (int y = first.y; y <= last.y; y++)
+		for (int z = first.z; z <= last.z; z++)
+		{
+			remaining[BrickIndex(*store, glm::ivec3(x, y, z))]++;
+		}
+	}
+
+	// pass 1, the lattice
+	std::vector<glm::ivec3> needed;
+	for (int x = 0; x < numBricks.x; x++)
+	for (int y = 0; y < numBricks.y; y++)
+	for (int z = 0; z < numBricks.z; z++)
+	{
+		const glm::ivec3 brick(x, y, z);
+		if (remaining[BrickIndex(*store, brick)] > 0)
+		{
+			needed.push_back(brick);
+		}
+	}
+
+	std::atomic<int> sampled(0), reused(0);
+	RunWorkers(options, (int)needed.size(), [&](const int i)
+	{
+		const glm::ivec3& brick = needed[i];
+		if (store->sign(brick) != BrickSign_Unsampled)
+		{
+			reused++;
+			return;
+		}
+
+		// the sign goes in last, a brick with a sign is finished
+		store->setSign(brick, SampleBrick(*store, options.density, brick));
+		sampled++;
+	});
+
+	stats.bricksSampled = sampled;
+	stats.bricksReused = reused;
+	stats.brickTouches = store->numTouches();
+	if (Interrupted(options))
+	{
+		// the bricks sampled so far are picked up by the next run
+		return true;
+	}
+
+	if (!store->sync())
+	{
+		return false;
+	}
+
+	// pass 2, the tiles
+	std::mutex writeMutex;
+	std::atomic<int> uniform(0);
+	std::atomic<long long> peakTileBytes(0);
+
+	RunWorkers(options, (int)tiles.size(), [&](const int i)
+	{
+		const ChunkRequest& tile = tiles[i];
+		const glm::ivec3 tileMin = TileMinCorner(*store, tile);
+
+		glm::ivec3 first, last;
+		WindowBricks(*store, tileMin, tileVoxels, first, last);
+
+		int signs = 0;
+		for (int x = first.x; x <= last.x; x++)
+		for (int y = first.y; y <= last.y; y++)
+		for (int z = first.z; z <= last.z; z++)
+		{
+			signs |= store->sign(glm::ivec3(x, y, z));
+		}
+
+		ChunkResult result;
+		std::vector<float> window;
+		if (signs == BrickSign_Outside || signs == BrickSign_Inside)
+		{
+			result.contents = signs == BrickSign_Outside ? ChunkContents_Empty : ChunkContents_Solid;
+			uniform++;
+		}
+		else
+		{
+			CopyWindow(*store, tileMin, tileVoxels, window);
+		}
+
+		for (int x = first.x; x <= last.x; x++)
+		for (int y = first.y; y <= last.y; y++)
+		for (int z = first.z; z <= last.z; z++)
+		{
+			const glm::ivec3 brick(x, y, z);
+			if (--remaining[BrickIndex(*store, brick)] == 0)
+			{
+				store->release(brick);
+			}
+		}
+
+		if (!window.empty())
+		{
+			const glm::ivec3 windowOrigin = store->origin() + (tileMin - glm::ivec3(1)) * voxelSize;
+			UpdateMax(peakTileBytes, (long long)ContourWindow(options.density, windowOrigin, voxelSize, tileVoxels, window, result));
+		}
+
+		BuildUnityMeshLayout(result);
+
+		std::lock_guard<std::mutex> lock(writeMutex);
+		write(tile, result);
+	});
+
+	stats.tilesUniform = uniform;
+	stats.brickTouches = store->numTouches();
+	stats.brickBytes = (long long)BrickStore::brickBytes();
+	stats.peakResidentBricks = store->peakResident();
+	stats.peakTileBytes = peakTileBytes;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
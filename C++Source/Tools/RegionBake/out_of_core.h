@@ -0,0 +1,69 @@
+#ifndef		HAS_OUT_OF_CORE_H_BEEN_INCLUDED
+#define		HAS_OUT_OF_CORE_H_BEEN_INCLUDED
+
+#include <signal.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "chunk_generator.h"
+
+// ----------------------------------------------------------------------------
+
+// One LOD of a region baked as a single volume, for regions whose lattice and
+// Hermite data don't fit in memory. firstChunk and lastChunk bound the region
+// in chunks (inclusive, chunks centred on multiples of chunkSize as in the
+// regular bake) and tiles lists the chunks still to be written.
+struct OutOfCoreOptions
+{
+	glm::ivec3			firstChunk = glm::ivec3(0);
+	glm::ivec3			lastChunk = glm::ivec3(0);
+	int					chunkSize = 16;
+	int					lod = 0;
+	DensityParams		density;
+	std::vector<ChunkRequest> tiles;
+	std::string			bricksPath;
+	int					numThreads = 1;
+
+	// checked between bricks and tiles, the bake stops early once it's set
+	const volatile sig_atomic_t* interrupted = nullptr;
+};
+
+struct OutOfCoreStats
+{
+	int					bricksSampled = 0;
+	int					bricksReused = 0;		// sampled by an earlier run
+	int					tilesUniform = 0;		// empty or solid, decided from the brick signs
+	long long			brickTouches = 0;
+	long long			brickBytes = 0;
+	int					peakResidentBricks = 0;
+	long long			peakTileBytes = 0;		// Hermite data and window of the largest tile
+};
+
+// Called for every finished tile, from the workers but one call at a time
+typedef std::function<void(const ChunkRequest& request, const ChunkResult& result)> OutOfCoreWriter;
+
+// Two streaming passes over a BrickStore (see brick_store.h):
+//
+// 1. lattice: every brick under a pending tile is sampled once, in file order,
+//    and released as soon as it's written. Its sign is recorded alongside.
+// 2. contour: each tile copies the window of corners it needs (its own plus
+//    one layer either side) out of the bricks, then finds the Hermite data,
+//    solves the vertices and emits the quads of the edges it owns with the
+//    fast_dc stages' code. A brick is released once the last tile which
+//    overlaps it has copied it out. Tiles whose bricks are all empty or all
+//    solid never touch the samples.
+//
+// Every edge belongs to the tile holding its min corner and each tile solves
+// the vertices of the voxel layer below its min faces as well, so the tiles
+// join up without a seam pass: the vertices they share are bitwise identical
+// copies (see MergeChunkMeshes). Resident memory is the bricks the tiles in
+// flight overlap plus one tile's window and Hermite data per worker.
+//
+// Returns false if the brick file can't be opened or written.
+bool BakeOutOfCore(const OutOfCoreOptions& options, const OutOfCoreWriter& write, OutOfCoreStats& stats);
+
+// ----------------------------------------------------------------------------
+
+#endif	//	HAS_OUT_OF_CORE_H_BEEN_INCLUDED
@@ -0,0 +1,680 @@
+// region_bake : generates every chunk of a region offline on all cores.
+//
+//	region_bake --min x,y,z --max x,y,z --out dir [--chunk-size n] [--lods 0,1,2]
+//	            [--pipeline octree|fast_dc|heightfield] [--preset default|hills|mountains]
+//	            [--threads n] [--force] [--export file.ply|obj|gltf|glb] [--out-of-core | --sign-dag]
+//
+// Each chunk is written to <out>/lod<L>/<x>_<y>_<z>.chunk (see chunk_file.h)
+// through a temporary file, so an interrupted bake can simply be run again:
+// chunks already on disk are skipped unless --force is given. Each chunk file
+// records a hash of the density parameters and pipeline settings, a bake into
+// a directory holding chunks from a different preset or pipeline refuses to
+// start rather than mix the two, --force rebakes them. --export also streams
+// every chunk generated by this run into a single mesh file.
+//
+// --out-of-core (fast_dc only) bakes each LOD of the region as one volume
+// instead of independent chunks, for regions too large for their lattice to
+// fit in memory. The density goes to <out>/lod<L>.bricks, which is kept so an
+// interrupted bake doesn't sample it again, and the chunks are cut from the
+// volume as tiles which join up without seams, see out_of_core.h.
+//
+// --sign-dag first bakes the sign of every corner of the region into
+// <out>/signs.dag (see sign_dag.h), or reuses it if it's already there for the
+// same density, and the chunks read their signs from it instead of sampling.
+// The same file can be loaded by the plugin, see LoadSignDag.
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "chunk_file.h"
+#include "generator_context.h"
+#include "mesh_export.h"
+#include "out_of_core.h"
+#include "sign_dag.h"
+
+// ----------------------------------------------------------------------------
+
+struct BakeOptions
+{
+	glm::ivec3			min = glm::ivec3(0);
+	glm::ivec3			max = glm::ivec3(0);
+	int					chunkSize = 16;
+	std::vector<int>	lods = { 0 };
+	int					pipeline = Pipeline_FastDC;
+	std::string			preset = "default";
+	std::string			outputPath;
+	std::string			exportPath;
+	int					numThreads = 0;
+	bool				force = false;
+	bool				outOfCore = false;
+	bool				signDag = false;
+};
+
+// a chunk still to be generated and where it goes
+struct BakeChunk
+{
+	ChunkRequest		request;
+	std::string			path;
+	int					job = 0;
+};
+
+static volatile sig_atomic_t g_interrupted = 0;
+
+// the same, for SignDag::build (lock free, so fine to set from the handler)
+static std::atomic<bool> g_cancelled(false);
+
+// ----------------------------------------------------------------------------
+
+static void OnSignal(int)
+{
+	g_interrupted = 1;
+	g_cancelled = true;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool ParseVector(const char* text, glm::ivec3& v)
+{
+	return sscanf(text, "%d,%d,%d", &v.x, &v.y, &v.z) == 3;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool ParseList(const char* text, std::vector<int>& values)
+{
+	values.clear();
+	for (const char* p = text; *p;)
+	{
+		char* end = nullptr;
+		const long value = strtol(p, &end, 10);
+		if (end == p || value < 0 || value > 8)
+		{
+			return false;
+		}
+
+		values.push_back((int)value);
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	return !values.empty();
+}
+
+// ----------------------------------------------------------------------------
+
+static void PrintUsage(const char* name)
+{
+	fprintf(stderr,
+		"usage: %s --min x,y,z --max x,y,z --out dir [--chunk-size n] [--lods 0,1,2]\n"
+		"       [--pipeline octree|fast_dc|heightfield] [--preset default|hills|mountains] [--threads n] [--force]\n"
+		"       [--export file.ply|obj|gltf|glb] [--out-of-core | --sign-dag]\n", name);
+}
+
+// ----------------------------------------------------------------------------
+
+static bool ParseOptions(int argc, char** argv, BakeOptions& options)
+{
+	bool hasMin = false, hasMax = false;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		bool ok = value != nullptr;
+		if (arg == "--force")
+		{
+			options.force = true;
+			continue;
+		}
+		else if (arg == "--out-of-core")
+		{
+			options.outOfCore = true;
+			continue;
+		}
+		else if (arg == "--sign-dag")
+		{
+			options.signDag = true;
+			continue;
+		}
+		else if (arg == "--min" && value)
+		{
+			ok = hasMin = ParseVector(value, options.min);
+		}
+		else if (arg == "--max" && value)
+		{
+			ok = hasMax = ParseVector(value, options.max);
+		}
+		else if (arg == "--chunk-size" && value)
+		{
+			options.chunkSize = atoi(value);
+		}
+		else if (arg == "--lods" && value)
+		{
+			ok = ParseList(value, options.lods);
+		}
+		else if (arg == "--pipeline" && value)
+		{
+			ok = strcmp(value, "octree") == 0 || strcmp(value, "fast_dc") == 0 || strcmp(value, "heightfield") == 0;
+			options.pipeline = strcmp(value, "octree") == 0 ? Pipeline_Octree :
+				strcmp(value, "heightfield") == 0 ? Pipeline_Heightfield : Pipeline_FastDC;
+		}
+		else if (arg == "--preset" && value)
+		{
+			options.preset = value;
+		}
+		else if (arg == "--out" && value)
+		{
+			options.outputPath = value;
+		}
+		else if (arg == "--export" && value)
+		{
+			options.exportPath = value;
+			ok = MeshExportFormatFromPath(value) != Export_Unknown;
+		}
+		else if (arg == "--threads" && value)
+		{
+			options.numThreads = atoi(value);
+		}
+		else
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			fprintf(stderr, "region_bake: bad argument %s\n", arg.c_str());
+			return false;
+		}
+		i++;
+	}
+
+	if (!hasMin || !hasMax || options.outputPath.empty() || options.chunkSize <= 0)
+	{
+		return false;
+	}
+
+	if (options.outOfCore && options.pipeline != Pipeline_FastDC)
+	{
+		fprintf(stderr, "region_bake: --out-of-core only bakes the fast_dc pipeline\n");
+		return false;
+	}
+
+	if (options.outOfCore && options.signDag)
+	{
+		fprintf(stderr, "region_bake: --sign-dag doesn't apply to --out-of-core, which samples each LOD's volume once already\n");
+		return false;
+	}
+
+	// chunks must hold a whole number of voxels at every LOD
+	for (const int lod : options.lods)
+	{
+		if (options.chunkSize % (1 << lod) != 0)
+		{
+			fprintf(stderr, "region_bake: chunk size %d isn't a multiple of the LOD %d voxel size\n", options.chunkSize, lod);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool MakeDirectory(const std::string& path)
+{
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool FileExists(const std::string& path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0;
+}
+
+// ----------------------------------------------------------------------------
+
+// The region's chunks, [first, last] in units of the chunk size
+static void ChunkRange(const BakeOptions& options, glm::ivec3& first, glm::ivec3& last)
+{
+	const int size = options.chunkSize;
+	first = glm::ivec3(glm::floor(glm::vec3(options.min) / (float)size));
+	last = glm::ivec3(glm::ceil(glm::vec3(options.max) / (float)size));
+}
+
+// ----------------------------------------------------------------------------
+
+// Every chunk of the region at every LOD, skipping the ones already on disk.
+// Chunks are centred on their position, positions are multiples of the chunk
+// size. Files on disk which were baked from other inputs (or by an older
+// version) are counted in numStale and collected as well, staleExample is the
+// first of them.
+static bool CollectChunks(const BakeOptions& options, const DensityParams& density, std::vector<BakeChunk>& chunks, int& numSkipped, int& numStale, std::string& staleExample)
+{
+	numSkipped = 0;
+	numStale = 0;
+	if (!MakeDirectory(options.outputPath))
+	{
+		return false;
+	}
+
+	const int size = options.chunkSize;
+	glm::ivec3 first, last;
+	ChunkRange(options, first, last);
+
+	for (const int lod : options.lods)
+	{
+		const std::string directory = options.outputPath + "/lod" + std::to_string(lod);
+		if (!MakeDirectory(directory))
+		{
+			return false;
+		}
+
+		for (int z = first.z; z <= last.z; z++)
+		for (int y = first.y; y <= last.y; y++)
+		for (int x = first.x; x <= last.x; x++)
+		{
+			BakeChunk chunk;
+			chunk.request.position = glm::ivec3(x, y, z) * size;
+			chunk.request.size = size;
+			chunk.request.lod = lod;
+			chunk.request.pipeline = options.pipeline;
+			chunk.request.density = density;
+			chunk.path = directory + "/" + std::to_string(chunk.request.position.x) + "_" +
+				std::to_string(chunk.request.position.y) + "_" + std::to_string(chunk.request.position.z) + ".chunk";
+
+			if (!options.force && FileExists(chunk.path))
+			{
+				if (ChunkFileMatches(chunk.path, chunk.request))
+				{
+					numSkipped++;
+					continue;
+				}
+
+				if (numStale++ == 0)
+				{
+					staleExample = chunk.path;
+				}
+			}
+
+			chunks.push_back(chunk);
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// --sign-dag, the signs of a cube holding every chunk's corners, loaded from
+// <out>/signs.dag when it covers them for this density and baked otherwise.
+// Null if interrupted or the file can't be written.
+static std::shared_ptr<const SignDag> PrepareSignDag(const BakeOptions& options, const DensityParams& density, const int numThreads)
+{
+	const int size = options.chunkSize;
+	glm::ivec3 first, last;
+	ChunkRange(options, first, last);
+	const glm::ivec3 min = first * size - glm::ivec3(size / 2);
+	const glm::ivec3 max = last * size + glm::ivec3(size - size / 2);
+
+	const std::string path = options.outputPath + "/signs.dag";
+	std::shared_ptr<const SignDag> signs = options.force ? nullptr : SignDag::load(path);
+	if (signs && signs->matches(density) && signs->contains(min, max))
+	{
+		printf("region_bake: reusing %s\n", path.c_str());
+		return signs;
+	}
+
+	const glm::ivec3 extent = max - min + glm::ivec3(1);
+	int cubeSize = 1 << SIGN_DAG_LEAF_LOG2;
+	while (cubeSize < extent.x || cubeSize < extent.y || cubeSize < extent.z)
+	{
+		cubeSize *= 2;
+	}
+
+	printf("region_bake: baking the signs of %d^3 corners\n", cubeSize);
+	const auto start = std::chrono::steady_clock::now();
+	std::shared_ptr<SignDag> baked = SignDag::build(density, min, cubeSize, numThreads, &g_cancelled);
+	if (!baked)
+	{
+		return nullptr;
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!baked->save(path))
+	{
+		fprintf(stderr, "region_bake: can't write %s: %s\n", path.c_str(), strerror(errno));
+		return nullptr;
+	}
+
+	printf("region_bake: baked %s in %.2fs\n", path.c_str(), seconds);
+	return baked;
+}
+
+// ----------------------------------------------------------------------------
+
+class ProgressReport
+{
+public:
+
+	explicit ProgressReport(int total)
+		: total_(total)
+		, start_(std::chrono::steady_clock::now())
+		, lastPrint_(start_)
+	{
+	}
+
+	void add(const ChunkResult& result)
+	{
+		done_++;
+		vertices_ += result.numVertices();
+		triangles_ += result.indices.size() / 3;
+	}
+
+	void print(bool force)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (!force && now - lastPrint_ < std::chrono::milliseconds(500))
+		{
+			return;
+		}
+		lastPrint_ = now;
+
+		const double seconds = std::max(1e-3, std::chrono::duration<double>(now - start_).count());
+		const double chunksPerSecond = done_ / seconds;
+		const double eta = chunksPerSecond > 0.0 ? (total_ - done_) / chunksPerSecond : 0.0;
+
+		printf("\r[%d/%d] %5.1f%%  %.1f chunks/s  %.2f Mtris/s  eta %.0fs   ", done_, total_,
+			total_ ? 100.0 * done_ / total_ : 100.0, chunksPerSecond, triangles_ / seconds / 1e6, eta);
+		fflush(stdout);
+	}
+
+	double elapsed() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+	}
+
+	int done() const { return done_; }
+	long long vertices() const { return vertices_; }
+	long long triangles() const { return triangles_; }
+
+private:
+
+	int				total_ = 0;
+	int				done_ = 0;
+	long long		vertices_ = 0;
+	long long		triangles_ = 0;
+
+	std::chrono::steady_clock::time_point start_;
+	std::chrono::steady_clock::time_point lastPrint_;
+};
+
+// ----------------------------------------------------------------------------
+
+// --out-of-core, one BakeOutOfCore per LOD over the same chunks the regular
+// bake would write. Returns the process exit code.
+static int RunOutOfCore(const BakeOptions& options, const DensityParams& density, const std::vector<BakeChunk>& chunks, const int numThreads, MeshExporter* exporter)
+{
+	printf("region_bake: %d chunks to bake out of core, %d threads\n", (int)chunks.size(), numThreads);
+
+	OutOfCoreOptions outOfCore;
+	ChunkRange(options, outOfCore.firstChunk, outOfCore.lastChunk);
+	outOfCore.chunkSize = options.chunkSize;
+	outOfCore.density = density;
+	outOfCore.numThreads = numThreads;
+	outOfCore.interrupted = &g_interrupted;
+
+	ProgressReport progress((int)chunks.size());
+	int numFailed = 0;
+
+	for (const int lod : options.lods)
+	{
+		outOfCore.lod = lod;
+		outOfCore.bricksPath = options.outputPath + "/lod" + std::to_string(lod) + ".bricks";
+		outOfCore.tiles.clear();
+		std::map<std::tuple<int, int, int>, const BakeChunk*> pending;
+		for (const BakeChunk& chunk : chunks)
+		{
+			if (chunk.request.lod == lod)
+			{
+				outOfCore.tiles.push_back(chunk.request);
+				pending[std::make_tuple(chunk.request.position.x, chunk.request.position.y, chunk.request.position.z)] = &chunk;
+			}
+		}
+
+		if (outOfCore.tiles.empty())
+		{
+			continue;
+		}
+
+		const auto write = [&](const ChunkRequest& request, const ChunkResult& result)
+		{
+			const BakeChunk* chunk = pending[std::make_tuple(request.position.x, request.position.y, request.position.z)];
+			if (!WriteChunkFile(chunk->path, chunk->request, result))
+			{
+				fprintf(stderr, "\nregion_bake: failed to write %s\n", chunk->path.c_str());
+				numFailed++;
+				return;
+			}
+
+			progress.add(result);
+			progress.print(false);
+			if (exporter && !exporter->add(result))
+			{
+				fprintf(stderr, "\nregion_bake: failed to export to %s\n", options.exportPath.c_str());
+				numFailed++;
+			}
+		};
+
+		OutOfCoreStats stats;
+		if (!BakeOutOfCore(outOfCore, write, stats))
+		{
+			fprintf(stderr, "\nregion_bake: can't bake %s: %s\n", outOfCore.bricksPath.c_str(), strerror(errno));
+			return 1;
+		}
+
+		const int numBricks = stats.bricksSampled + stats.bricksReused;
+		progress.print(true);
+		printf("\nregion_bake: lod %d bricks %d sampled %d reused, %.2f touches per brick, %d tiles empty or solid, "
+			"peak %.1fMB of bricks resident, %.1fMB per tile\n", lod, stats.bricksSampled, stats.bricksReused,
+			numBricks > 0 ? (double)stats.brickTouches / numBricks : 0.0, stats.tilesUniform,
+			stats.peakResidentBricks * stats.brickBytes / 1048576.0, stats.peakTileBytes / 1048576.0);
+
+		if (g_interrupted)
+		{
+			break;
+		}
+	}
+
+	if (exporter && !exporter->finish())
+	{
+		fprintf(stderr, "region_bake: failed to finish %s\n", options.exportPath.c_str());
+		numFailed++;
+	}
+
+	if (g_interrupted)
+	{
+		printf("region_bake: interrupted after %d chunks, run again to resume\n", progress.done());
+		return 2;
+	}
+
+	printf("region_bake: %d chunks, %lld vertices, %lld triangles in %.2fs\n", progress.done(), progress.vertices(), progress.triangles(), progress.elapsed());
+	return numFailed > 0 ? 1 : 0;
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+	BakeOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	DensityParams density;
+	if (!GetDensityPreset(options.preset.c_str(), density))
+	{
+		fprintf(stderr, "region_bake: unknown density preset %s\n", options.preset.c_str());
+		return 1;
+	}
+
+	std::vector<BakeChunk> chunks;
+	int numSkipped = 0, numStale = 0;
+	std::string staleExample;
+	if (!CollectChunks(options, density, chunks, numSkipped, numStale, staleExample))
+	{
+		fprintf(stderr, "region_bake: can't create %s: %s\n", options.outputPath.c_str(), strerror(errno));
+		return 1;
+	}
+
+	if (numStale > 0)
+	{
+		fprintf(stderr, "region_bake: %d chunks in %s (e.g. %s) were baked with a different preset, pipeline or version, "
+			"use --force to rebake them\n", numStale, options.outputPath.c_str(), staleExample.c_str());
+		return 1;
+	}
+
+	std::unique_ptr<MeshExporter> exporter;
+	if (!options.exportPath.empty())
+	{
+		exporter = CreateMeshExporter(options.exportPath.c_str(), MeshExportFormatFromPath(options.exportPath.c_str()));
+		if (!exporter)
+		{
+			fprintf(stderr, "region_bake: can't create %s\n", options.exportPath.c_str());
+			return 1;
+		}
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	// unlike the plugin, nothing else needs a core
+	const int numThreads = options.numThreads > 0 ? options.numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+	if (options.outOfCore)
+	{
+		return RunOutOfCore(options, density, chunks, numThreads, exporter.get());
+	}
+
+	if (options.signDag && !chunks.empty())
+	{
+		const std::shared_ptr<const SignDag> signs = PrepareSignDag(options, density, numThreads);
+		if (!signs)
+		{
+			if (g_interrupted)
+			{
+				printf("region_bake: interrupted baking the signs, run again to resume\n");
+				return 2;
+			}
+			return 1;
+		}
+
+		const SignDagStats stats = signs->stats();
+		printf("region_bake: signs %d nodes %d leaves, %.1fMB, %.0fx smaller than a bit per corner\n",
+			stats.numNodes, stats.numLeaves, stats.bytes / 1048576.0, stats.compression);
+
+		for (BakeChunk& chunk : chunks)
+		{
+			chunk.request.density.signs = signs;
+		}
+	}
+
+	GeneratorContext context(numThreads);
+	JobSystem& jobs = context.jobs();
+
+	printf("region_bake: %d chunks to generate, %d already baked, %d threads\n", (int)chunks.size(), numSkipped, numThreads);
+
+	// keep a few jobs per worker queued so results are written as they finish
+	// rather than holding the whole region in memory
+	const size_t maxInFlight = numThreads * 4;
+	std::vector<BakeChunk*> inFlight;
+	size_t next = 0;
+	int numFailed = 0;
+
+	ProgressReport progress((int)chunks.size());
+	while (!g_interrupted && (next < chunks.size() || !inFlight.empty()))
+	{
+		while (next < chunks.size() && inFlight.size() < maxInFlight)
+		{
+			BakeChunk& chunk = chunks[next++];
+			chunk.job = jobs.submit(chunk.request);
+			inFlight.push_back(&chunk);
+		}
+
+		bool finishedAny = false;
+		for (auto iter = begin(inFlight); iter != end(inFlight);)
+		{
+			BakeChunk* chunk = *iter;
+			const int status = jobs.poll(chunk->job);
+			if (status == JobStatus_Pending || status == JobStatus_Running)
+			{
+				++iter;
+				continue;
+			}
+
+			const ChunkResult* result = jobs.result(chunk->job);
+			if (result && WriteChunkFile(chunk->path, chunk->request, *result))
+			{
+				progress.add(*result);
+				if (exporter && !exporter->add(*result))
+				{
+					fprintf(stderr, "\nregion_bake: failed to export to %s\n", options.exportPath.c_str());
+					numFailed++;
+				}
+			}
+			else
+			{
+				fprintf(stderr, "\nregion_bake: failed to write %s\n", chunk->path.c_str());
+				numFailed++;
+			}
+
+			jobs.release(chunk->job);
+			iter = inFlight.erase(iter);
+			finishedAny = true;
+		}
+
+		progress.print(false);
+		if (!finishedAny)
+		{
+			jobs.wait(inFlight.front()->job, 10);
+		}
+	}
+
+	progress.print(true);
+	printf("\n");
+
+	if (exporter && !exporter->finish())
+	{
+		fprintf(stderr, "region_bake: failed to finish %s\n", options.exportPath.c_str());
+		numFailed++;
+	}
+
+	if (g_interrupted)
+	{
+		for (BakeChunk* chunk : inFlight)
+		{
+			jobs.cancel(chunk->job);
+			jobs.release(chunk->job);
+		}
+
+		printf("region_bake: interrupted after %d chunks, run again to resume\n", progress.done());
+		return 2;
+	}
+
+	printf("region_bake: %d chunks, %lld vertices, %lld triangles in %.2fs\n", progress.done(), progress.vertices(), progress.triangles(), progress.elapsed());
+	return numFailed > 0 ? 1 : 0;
+}
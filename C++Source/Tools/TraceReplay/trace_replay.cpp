@@ -0,0 +1,700 @@
+// trace_replay : re-issues a trace recorded by the plugin (StartRecording) headlessly.
+//
+//	trace_replay trace.dctr [--speed original|max] [--threads n] [--exports] [--archives]
+//
+// --speed original waits until each call's recorded start time before issuing
+// it, max issues calls back to back. Calls are replayed in the order they were
+// recorded from a single thread. Job handles and contexts are remapped to the
+// ones created during the replay, so the trace doesn't depend on the plugin
+// issuing the same IDs. --threads overrides the worker count of every context,
+// ExportJobMeshes calls are skipped unless --exports is given since they
+// write to the paths the recorded session used. OpenChunkArchive is skipped
+// unless --archives is given for the same reason, and because chunks served
+// from an archive don't measure generation.
+//
+// Prints the recorded and replayed time spent in each export, so two builds
+// can be compared on the same real workload.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "DualContouringPlugin.h"
+#include "call_recorder.h"
+
+// ----------------------------------------------------------------------------
+
+struct ReplayOptions
+{
+	std::string		tracePath;
+	bool			originalSpeed = false;
+	int				numThreads = 0;		// 0 keeps the recorded count
+	bool			exports = false;
+	bool			archives = false;
+};
+
+// time spent in one export, as recorded and as replayed
+struct CallTiming
+{
+	long long		count = 0;
+	long long		recordedMicroseconds = 0;
+	long long		replayedMicroseconds = 0;
+	long long		recordedMax = 0;
+	long long		replayedMax = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+static void PrintUsage(const char* name)
+{
+	fprintf(stderr, "usage: %s trace.dctr [--speed original|max] [--threads n] [--exports] [--archives]\n", name);
+}
+
+// ----------------------------------------------------------------------------
+
+static bool ParseOptions(int argc, char** argv, ReplayOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (arg == "--exports")
+		{
+			options.exports = true;
+			continue;
+		}
+		else if (arg == "--archives")
+		{
+			options.archives = true;
+			continue;
+		}
+		else if (arg == "--speed" && value && (strcmp(value, "original") == 0 || strcmp(value, "max") == 0))
+		{
+			options.originalSpeed = strcmp(value, "original") == 0;
+		}
+		else if (arg == "--threads" && value)
+		{
+			options.numThreads = atoi(value);
+		}
+		else if (arg[0] != '-' && options.tracePath.empty())
+		{
+			options.tracePath = arg;
+			continue;
+		}
+		else
+		{
+			fprintf(stderr, "trace_replay: bad argument %s\n", arg.c_str());
+			return false;
+		}
+		i++;
+	}
+
+	return !options.tracePath.empty();
+}
+
+// ----------------------------------------------------------------------------
+
+// Live contexts and jobs for the recorded ones
+class ReplayState
+{
+public:
+
+	explicit ReplayState(int numThreads)
+		: numThreads_(numThreads)
+	{
+	}
+
+	~ReplayState()
+	{
+		for (auto& pair : contexts_)
+		{
+			DestroyContext(pair.second);
+		}
+	}
+
+	// Contexts created before the recording started show up without a
+	// CreateContext call, they get the default worker count
+	GeneratorContext* context(const uint32_t id)
+	{
+		if (id == 0)
+		{
+			return nullptr;
+		}
+
+		const auto iter = contexts_.find(id);
+		if (iter != end(contexts_))
+		{
+			return iter->second;
+		}
+
+		return create(id, 0);
+	}
+
+	GeneratorContext* create(const uint32_t id, const int recordedThreads)
+	{
+		GeneratorContext* context = CreateContext(numThreads_ != 0 ? numThreads_ : recordedThreads);
+		contexts_[id] = context;
+		return context;
+	}
+
+	void destroy(const uint32_t id)
+	{
+		const auto iter = contexts_.find(id);
+		if (iter == end(contexts_))
+		{
+			return;
+		}
+
+		DestroyContext(iter->second);
+		contexts_.erase(iter);
+
+		for (auto job = begin(jobs_); job != end(jobs_);)
+		{
+			job = (job->first >> 32) == id ? jobs_.erase(job) : std::next(job);
+		}
+	}
+
+	void mapJob(const uint32_t context, const int recorded, const int live)
+	{
+		if (recorded != 0)
+		{
+			jobs_[key(context, recorded)] = live;
+		}
+	}
+
+	// Jobs the replay never submitted (submitted before the recording started)
+	// map to 0, which is never a valid handle
+	int job(const uint32_t context, const int recorded) const
+	{
+		const auto iter = jobs_.find(key(context, recorded));
+		return iter != end(jobs_) ? iter->second : 0;
+	}
+
+	// Clipmap chunks are submitted (and merged) by the plugin itself, the
+	// recorded and live jobs are matched up by the chunk or block their load
+	// and merge events name
+	void clipmapLoaded(const uint32_t context, const ClipmapEvent& event, const bool live)
+	{
+		const ClipmapKey key(context, event.lod, event.position[0], event.position[1], event.position[2]);
+		auto& mine = live ? liveLoads_ : recordedLoads_;
+		auto& other = live ? recordedLoads_ : liveLoads_;
+
+		const auto match = other.find(key);
+		if (match == end(other))
+		{
+			mine[key] = event.job;
+			return;
+		}
+
+		mapJob(context, live ? match->second : event.job, live ? event.job : match->second);
+		other.erase(match);
+	}
+
+	std::vector<int> jobs(const uint32_t context, const std::vector<int>& recorded) const
+	{
+		std::vector<int> live(recorded.size());
+		for (size_t i = 0; i < recorded.size(); i++)
+		{
+			live[i] = job(context, recorded[i]);
+		}
+
+		return live;
+	}
+
+private:
+
+	static uint64_t key(const uint32_t context, const int job)
+	{
+		return ((uint64_t)context << 32) | (uint32_t)job;
+	}
+
+	typedef std::tuple<uint32_t, int, int, int, int> ClipmapKey;
+
+	int				numThreads_ = 0;
+	std::unordered_map<uint32_t, GeneratorContext*> contexts_;
+	std::map<ClipmapKey, int> recordedLoads_;
+	std::map<ClipmapKey, int> liveLoads_;
+	std::unordered_map<uint64_t, int> jobs_;
+};
+
+// ----------------------------------------------------------------------------
+
+static void FreeMesh(int* indices, float* vertices)
+{
+	free(indices);
+	free(vertices);
+}
+
+// ----------------------------------------------------------------------------
+
+// Issues one recorded call against the live state, returns false if the
+// payload doesn't match what the call expects
+static bool ReplayCall(const TraceRecordHeader& record, TraceReader& trace, ReplayState& state, const ReplayOptions& options)
+{
+	GeneratorContext* context = record.call == Call_CreateContext ? nullptr : state.context(record.context);
+
+	int indexLength = 0, vertexLength = 0, cellLength = 0;
+	int* indexData = nullptr;
+	float* vertexData = nullptr;
+	float* cellData = nullptr;
+
+	switch (record.call)
+	{
+	case Call_CreateOctreeAndDualContour:
+	{
+		const int x = trace.read<int>(), y = trace.read<int>(), z = trace.read<int>();
+		const int size = trace.read<int>();
+		const float res = trace.read<float>();
+		CreateOctreeAndDualContour(context, x, y, z, size, res, &indexLength, &indexData, &vertexLength, &vertexData);
+		FreeMesh(indexData, vertexData);
+		break;
+	}
+
+	case Call_FastDualContourTest:
+		FastDualContourTest();
+		break;
+
+	case Call_FastDualContour:
+	case Call_SubmitFastDualContourJob:
+	{
+		const int x = trace.read<int>(), y = trace.read<int>(), z = trace.read<int>();
+		const int cellSize = trace.read<int>();
+		const float targetPolygonPercent = trace.read<float>();
+		const int maxSimplifyIterations = trace.read<int>();
+		const float edgeFraction = trace.read<float>();
+		const float maxEdgeSize = trace.read<float>();
+		const float maxError = trace.read<float>();
+		const float minAngleCosine = trace.read<float>();
+
+		if (record.call == Call_SubmitFastDualContourJob)
+		{
+			const int live = SubmitFastDualContourJob(context, x, y, z, cellSize, targetPolygonPercent, maxSimplifyIterations, edgeFraction, maxEdgeSize, maxError, minAngleCosine);
+			state.mapJob(record.context, trace.read<int>(), live);
+			break;
+		}
+
+		float debugVal = 0.f, debugVal2 = 0.f;
+		FastDualContour(context, x, y, z, cellSize, targetPolygonPercent, maxSimplifyIterations, edgeFraction, maxEdgeSize, maxError, minAngleCosine,
+			&debugVal, &debugVal2, &indexLength, &indexData, &vertexLength, &vertexData, &cellLength, &cellData);
+		FreeMesh(indexData, vertexData);
+		free(cellData);
+		break;
+	}
+
+	case Call_SubmitOctreeJob:
+	{
+		const int x = trace.read<int>(), y = trace.read<int>(), z = trace.read<int>();
+		const int size = trace.read<int>();
+		const float res = trace.read<float>();
+		const int live = SubmitOctreeJob(context, x, y, z, size, res);
+		state.mapJob(record.context, trace.read<int>(), live);
+		break;
+	}
+
+	case Call_PollJob:
+		PollJob(context, state.job(record.context, trace.read<int>()));
+		break;
+
+	case Call_WaitForJob:
+	{
+		const int job = state.job(record.context, trace.read<int>());
+		WaitForJob(context, job, trace.read<int>());
+		break;
+	}
+
+	case Call_CancelJob:
+		CancelJob(context, state.job(record.context, trace.read<int>()));
+		break;
+
+	case Call_GetJobResult:
+		GetJobResult(context, state.job(record.context, trace.read<int>()), &indexLength, &indexData, &vertexLength, &vertexData);
+		break;
+
+	case Call_GetJobCellData:
+		GetJobCellData(context, state.job(record.context, trace.read<int>()), &cellLength, &cellData);
+		break;
+
+	case Call_ReleaseJob:
+		ReleaseJob(context, state.job(record.context, trace.read<int>()));
+		break;
+
+	case Call_CreateContext:
+		state.create(record.context, trace.read<int>());
+		break;
+
+	case Call_DestroyContext:
+		state.destroy(record.context);
+		break;
+
+	case Call_SetDensityParams:
+	{
+		const DensityParams params = trace.read<DensityParams>();
+		SetDensityParams(context, &params);
+		break;
+	}
+
+	case Call_GetDensityParams:
+	{
+		DensityParams params;
+		GetDensityParams(context, &params);
+		break;
+	}
+
+	case Call_GetContextStats:
+	{
+		ContextStats stats;
+		GetContextStats(context, &stats);
+		break;
+	}
+
+	case Call_SetViewer:
+	{
+		const ViewerParams viewer = trace.read<ViewerParams>();
+		SetViewer(context, &viewer);
+		break;
+	}
+
+	case Call_GetPendingJobCount:
+		GetPendingJobCount(context);
+		break;
+
+	case Call_DrainCompletedJobs:
+	{
+		const int maxJobs = trace.read<int>();
+		const int maxBytes = trace.read<int>();
+		std::vector<CompletedJob> completed(std::max(0, maxJobs));
+		int overflowed = 0;
+		DrainCompletedJobs(context, completed.data(), (int)completed.size(), maxBytes, &overflowed);
+		break;
+	}
+
+	case Call_RunJobsFor:
+		RunJobsFor(context, trace.read<int>());
+		break;
+
+	case Call_SubmitChunkBatch:
+	case Call_GenerateChunkBatch:
+	{
+		const std::vector<ChunkDesc> chunks = trace.readArray<ChunkDesc>();
+		const std::vector<int> recorded = trace.readArray<int>();
+
+		std::vector<int> live(chunks.size());
+		if (record.call == Call_SubmitChunkBatch)
+		{
+			SubmitChunkBatch(context, chunks.data(), (int)chunks.size(), live.data());
+		}
+		else
+		{
+			std::vector<ChunkMeshDesc> meshes(chunks.size());
+			GenerateChunkBatch(context, chunks.data(), (int)chunks.size(), meshes.data());
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				live[i] = meshes[i].job;
+			}
+		}
+
+		for (size_t i = 0; i < recorded.size() && i < live.size(); i++)
+		{
+			state.mapJob(record.context, recorded[i], live[i]);
+		}
+		break;
+	}
+
+	case Call_ReleaseJobs:
+	{
+		const std::vector<int> jobs = state.jobs(record.context, trace.readArray<int>());
+		ReleaseJobs(context, jobs.data(), (int)jobs.size());
+		break;
+	}
+
+	case Call_GetJobUnityMesh:
+	{
+		UnityMeshDesc mesh;
+		GetJobUnityMesh(context, state.job(record.context, trace.read<int>()), &mesh);
+		break;
+	}
+
+	case Call_GetJobUnityMeshes:
+	{
+		const std::vector<int> jobs = state.jobs(record.context, trace.readArray<int>());
+		std::vector<UnityMeshDesc> meshes(jobs.size());
+		GetJobUnityMeshes(context, jobs.data(), (int)jobs.size(), meshes.data());
+		break;
+	}
+
+	case Call_GetJobUnitySubMeshes:
+	{
+		const int job = state.job(record.context, trace.read<int>());
+		const int maxSubMeshes = trace.read<int>();
+		std::vector<UnitySubMeshDesc> subMeshes(std::max(0, maxSubMeshes));
+		GetJobUnitySubMeshes(context, job, subMeshes.data(), (int)subMeshes.size());
+		break;
+	}
+
+	case Call_BuildJobSeam:
+	{
+		const int job = state.job(record.context, trace.read<int>());
+		const std::vector<int> neighbours = state.jobs(record.context, trace.readArray<int>());
+		BuildJobSeam(context, job, neighbours.data(), (int)neighbours.size());
+		break;
+	}
+
+	case Call_MergeJobMeshes:
+	{
+		const std::vector<int> jobs = state.jobs(record.context, trace.readArray<int>());
+		const int optimizeVertexCache = trace.read<int>();
+		const int live = MergeJobMeshes(context, jobs.data(), (int)jobs.size(), optimizeVertexCache);
+		state.mapJob(record.context, trace.read<int>(), live);
+		break;
+	}
+
+	case Call_ExportJobMeshes:
+	{
+		const std::vector<int> jobs = state.jobs(record.context, trace.readArray<int>());
+		const std::string path = trace.readString();
+		if (options.exports)
+		{
+			ExportJobMeshes(context, jobs.data(), (int)jobs.size(), path.c_str());
+		}
+		break;
+	}
+
+	case Call_EnableClipmap:
+	{
+		const ClipmapParams params = trace.read<ClipmapParams>();
+		EnableClipmap(context, &params);
+		break;
+	}
+
+	case Call_DisableClipmap:
+		DisableClipmap(context);
+		break;
+
+	case Call_SetClipmapViewer:
+	{
+		const float x = trace.read<float>(), y = trace.read<float>(), z = trace.read<float>();
+		SetClipmapViewer(context, x, y, z);
+		break;
+	}
+
+	case Call_DrainClipmapEvents:
+	{
+		const int maxEvents = trace.read<int>();
+		std::vector<ClipmapEvent> events(std::max(0, maxEvents));
+		events.resize(DrainClipmapEvents(context, events.data(), (int)events.size()));
+
+		for (const auto& event : events)
+		{
+			if (event.type == ClipmapEvent_Load || event.type == ClipmapEvent_Merge)
+			{
+				state.clipmapLoaded(record.context, event, true);
+			}
+		}
+
+		for (const auto& event : trace.readArray<ClipmapEvent>())
+		{
+			if (event.type == ClipmapEvent_Load || event.type == ClipmapEvent_Merge)
+			{
+				state.clipmapLoaded(record.context, event, false);
+			}
+		}
+		break;
+	}
+
+	case Call_GetClipmapChunkCount:
+	{
+		int numLoaded = 0;
+		GetClipmapChunkCount(context, &numLoaded);
+		break;
+	}
+
+	case Call_SetClipmapViewerMotion:
+	{
+		float values[9];
+		for (float& value : values)
+		{
+			value = trace.read<float>();
+		}
+
+		SetClipmapViewerMotion(context, values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7], values[8]);
+		break;
+	}
+
+	case Call_GetClipmapPrefetchStats:
+	{
+		ClipmapPrefetchStats stats;
+		GetClipmapPrefetchStats(context, &stats);
+		break;
+	}
+
+	case Call_SetMemoryBudget:
+		SetMemoryBudget(context, trace.read<long long>());
+		break;
+
+	case Call_GetMemoryUsage:
+	{
+		MemoryUsage usage;
+		GetMemoryUsage(context, &usage);
+		break;
+	}
+
+	case Call_SetMeshCacheCapacity:
+		SetMeshCacheCapacity(context, trace.read<long long>());
+		break;
+
+	case Call_InvalidateMeshCache:
+	{
+		const int minX = trace.read<int>(), minY = trace.read<int>(), minZ = trace.read<int>();
+		const int maxX = trace.read<int>(), maxY = trace.read<int>(), maxZ = trace.read<int>();
+		InvalidateMeshCache(context, minX, minY, minZ, maxX, maxY, maxZ);
+		break;
+	}
+
+	case Call_EditDensity:
+	{
+		const DensityEdit edit = trace.read<DensityEdit>();
+		EditDensity(context, &edit);
+		break;
+	}
+
+	case Call_ClearDensityEdits:
+		ClearDensityEdits(context);
+		break;
+
+	case Call_GetDensityEditStats:
+	{
+		DensityEditStats stats;
+		GetDensityEditStats(context, &stats);
+		break;
+	}
+
+	case Call_LoadSignDag:
+	{
+		const std::string path = trace.readString();
+		LoadSignDag(context, path.c_str());
+		break;
+	}
+
+	case Call_UnloadSignDag:
+		UnloadSignDag(context);
+		break;
+
+	case Call_GetSignDagStats:
+	{
+		SignDagStats stats;
+		GetSignDagStats(context, &stats);
+		break;
+	}
+
+	case Call_OpenChunkArchive:
+	{
+		const std::string path = trace.readString();
+		if (options.archives)
+		{
+			OpenChunkArchive(context, path.c_str());
+		}
+		break;
+	}
+
+	case Call_CloseChunkArchive:
+		CloseChunkArchive(context);
+		break;
+
+	case Call_CompactChunkArchive:
+		CompactChunkArchive(context);
+		break;
+
+	default:
+		return false;
+	}
+
+	return !trace.payloadError();
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+	ReplayOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	TraceReader trace;
+	std::string error;
+	if (!trace.open(options.tracePath.c_str(), error))
+	{
+		fprintf(stderr, "trace_replay: %s: %s\n", options.tracePath.c_str(), error.c_str());
+		return 1;
+	}
+
+	std::vector<CallTiming> timings(Call_Count);
+	long long numCalls = 0, numSkipped = 0, recordedEnd = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	{
+		ReplayState state(options.numThreads);
+
+		TraceRecordHeader record;
+		while (trace.next(record))
+		{
+			if (options.originalSpeed)
+			{
+				std::this_thread::sleep_until(start + std::chrono::microseconds(record.start));
+			}
+
+			const auto callStart = std::chrono::steady_clock::now();
+			if (!ReplayCall(record, trace, state, options))
+			{
+				numSkipped++;
+				continue;
+			}
+			const long long replayed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - callStart).count();
+
+			CallTiming& timing = timings[record.call];
+			timing.count++;
+			timing.recordedMicroseconds += record.duration;
+			timing.replayedMicroseconds += replayed;
+			timing.recordedMax = std::max<long long>(timing.recordedMax, record.duration);
+			timing.replayedMax = std::max(timing.replayedMax, replayed);
+
+			recordedEnd = std::max<long long>(recordedEnd, record.start + record.duration);
+			numCalls++;
+		}
+	}
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%-28s %8s %14s %14s %12s %12s\n", "call", "count", "recorded ms", "replayed ms", "rec max us", "rep max us");
+	for (int call = 1; call < Call_Count; call++)
+	{
+		const CallTiming& timing = timings[call];
+		if (timing.count == 0)
+		{
+			continue;
+		}
+
+		printf("%-28s %8lld %14.3f %14.3f %12lld %12lld\n", RecordedCallName(call), timing.count,
+			timing.recordedMicroseconds / 1000.0, timing.replayedMicroseconds / 1000.0, timing.recordedMax, timing.replayedMax);
+	}
+
+	printf("trace_replay: %lld calls replayed in %.3fs (recorded session %.3fs)", numCalls, elapsed, recordedEnd / 1e6);
+	if (numSkipped > 0)
+	{
+		printf(", %lld unreadable records skipped", numSkipped);
+	}
+	printf("\n");
+
+	return 0;
+}